@@ -0,0 +1,75 @@
+#include "aligner.h"
+
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+
+void Aligner::align_infix(const vector<AlignmentJob> &jobs){
+    //never shrink the alignments, so that their ops keep their memory from one batch to the next
+    if (alignments.size() < jobs.size()){
+        alignments.resize(jobs.size());
+    }
+    for (size_t j = 0 ; j < jobs.size() ; j++){
+        align(jobs[j], alignments[j]);
+    }
+}
+
+const Alignment& Aligner::align_infix(const AlignmentJob &job){
+    if (alignments.empty()){
+        alignments.resize(1);
+    }
+    align(job, alignments[0]);
+    return alignments[0];
+}
+
+void Aligner::align(const AlignmentJob &job, Alignment &alignment){
+    EdlibAlignResult result = edlibAlign(job.query, job.queryLength, job.target, job.targetLength,
+                                        edlibNewAlignConfig(job.k, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
+    if (job.k >= 0 && result.status == EDLIB_STATUS_OK && result.editDistance < 0){ //the band was too narrow
+        edlibFreeAlignResult(result);
+        result = edlibAlign(job.query, job.queryLength, job.target, job.targetLength,
+                            edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
+    }
+
+    alignment.ops.clear();
+    if (result.status == EDLIB_STATUS_OK && result.editDistance >= 0 && result.startLocations != NULL){
+        alignment.editDistance = result.editDistance;
+        alignment.targetStart = result.startLocations[0];
+        alignment.targetEnd = result.endLocations[0];
+        alignment.ops.insert(alignment.ops.end(), result.alignment, result.alignment+result.alignmentLength);
+    }
+    else{ //e.g. an empty sequence
+        alignment.editDistance = -1;
+        alignment.targetStart = 0;
+        alignment.targetEnd = -1;
+    }
+    edlibFreeAlignResult(result);
+}
+
+Aligner& thread_aligner(){
+    static thread_local Aligner aligner;
+    return aligner;
+}
+
+int banded_k(int queryLength, int targetLength, float errorRate){
+    //the errors of both sequences, the bases of the query that cannot be on the target, and a margin for the short sequences
+    return int(std::ceil(2*errorRate*queryLength)) + std::max(0, queryLength-targetLength) + 16;
+}
+
+string ops_to_cigar(const vector<unsigned char> &ops){
+    static const char letters[4] = {'M', 'I', 'D', 'M'};
+    string cigar;
+    size_t i = 0;
+    while (i < ops.size()){
+        char letter = letters[ops[i]];
+        size_t j = i;
+        while (j < ops.size() && letters[ops[j]] == letter){
+            j++;
+        }
+        cigar += std::to_string(j-i) + letter;
+        i = j;
+    }
+    return cigar;
+}
@@ -0,0 +1,56 @@
+#ifndef ALIGNER_H
+#define ALIGNER_H
+
+#include <vector>
+#include <string>
+#include "edlib/include/edlib.h"
+
+//one infix (HW) alignment to compute: the query is aligned anywhere on the target
+struct AlignmentJob{
+    const char* query;
+    int queryLength;
+    const char* target;
+    int targetLength;
+    int k; //maximum edit distance expected, -1 to let edlib find it
+};
+
+struct Alignment{
+    int editDistance; //-1 if no alignment was found
+    int targetStart; //first base of the target aligned
+    int targetEnd; //last base of the target aligned
+    std::vector<unsigned char> ops; //EDLIB_EDOP_MATCH, EDLIB_EDOP_INSERT (base of the query only), EDLIB_EDOP_DELETE (base of the target only) or EDLIB_EDOP_MISMATCH
+};
+
+/**
+ * @brief Aligns batches of query/target pairs with edlib, keeping the alignments (and the memory of their ops) from one batch to the next.
+ * A banded job (k >= 0) that has no alignment within k is aligned again without band
+ */
+class Aligner{
+
+public :
+    //the alignment of jobs[j] is then alignment(j), until the next call on this aligner
+    void align_infix(const std::vector<AlignmentJob> &jobs);
+    const Alignment& align_infix(const AlignmentJob &job);
+    const Alignment& alignment(size_t job) const {return alignments[job];}
+
+private :
+    void align(const AlignmentJob &job, Alignment &alignment);
+
+    std::vector<Alignment> alignments;
+};
+
+Aligner& thread_aligner(); //the aligner of the calling thread
+
+/**
+ * @brief Band of an alignment between a sequence and its polished version: both may carry errors, and the query may be longer than the target
+ *
+ * @param queryLength
+ * @param targetLength
+ * @param errorRate error rate of the reads
+ * @return the k to use in an AlignmentJob
+ */
+int banded_k(int queryLength, int targetLength, float errorRate);
+
+std::string ops_to_cigar(const std::vector<unsigned char> &ops); //standard CIGAR (M, I, D) of the alignment, as edlibAlignmentToCigar
+
+#endif
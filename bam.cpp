@@ -0,0 +1,257 @@
+#include "bam.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+using std::pair;
+using std::make_pair;
+
+const char BAM_CIGAR_CHARS[] = "MIDNSHP=X";
+const char BAM_SEQ_CHARS[] = "=ACMGRSVTWYHKDBN";
+
+std::string BamRecord::name() const{
+    return string(reinterpret_cast<const char*>(data.data()), l_read_name > 0 ? l_read_name-1 : 0); //the name is NUL-terminated
+}
+
+const uint32_t* BamRecord::cigar() const{
+    return reinterpret_cast<const uint32_t*>(data.data() + l_read_name);
+}
+
+uint8_t BamRecord::base_code(int i) const{
+    const uint8_t* seq = data.data() + l_read_name + 4*n_cigar_op;
+    return (seq[i/2] >> (4*(1-i%2))) & 0xF;
+}
+
+char BamRecord::base(int i) const{
+    return BAM_SEQ_CHARS[base_code(i)];
+}
+
+uint8_t BamRecord::quality(int i) const{
+    const uint8_t* qual = data.data() + l_read_name + 4*n_cigar_op + (l_seq+1)/2;
+    return qual[i];
+}
+
+std::string BamRecord::sequence() const{
+    string seq(l_seq, 'N');
+    for (int i = 0 ; i < l_seq ; i++){
+        seq[i] = base(i);
+    }
+    return seq;
+}
+
+std::string BamRecord::cigar_string() const{
+    const uint32_t* c = cigar();
+    string res;
+    for (uint32_t i = 0 ; i < n_cigar_op ; i++){
+        res += std::to_string(c[i] >> 4);
+        res += BAM_CIGAR_CHARS[c[i] & 0xF];
+    }
+    return res;
+}
+
+int32_t BamRecord::end() const{
+    const uint32_t* c = cigar();
+    int32_t end = pos;
+    for (uint32_t i = 0 ; i < n_cigar_op ; i++){
+        int op = c[i] & 0xF;
+        if (op == BAM_CMATCH || op == BAM_CDEL || op == BAM_CREF_SKIP || op == BAM_CEQUAL || op == BAM_CDIFF){
+            end += c[i] >> 4;
+        }
+    }
+    return end;
+}
+
+/**
+ * @brief Opens a BAM file and parses its header
+ *
+ * @param file name of the BAM file
+ */
+BamReader::BamReader(std::string file) : bgzf(file){
+
+    char magic[4];
+    int32_t l_text = 0;
+    if (!bgzf.read_exactly(magic, 4) || memcmp(magic, "BAM\1", 4) != 0 || !bgzf.read_exactly(&l_text, 4)){
+        cout << "ERROR: " << file << " does not look like a BAM file" << endl;
+        throw std::invalid_argument( "Input file '"+file +"' is not a BAM file" );
+    }
+    header_text.resize(l_text);
+    bgzf.read_exactly(&header_text[0], l_text);
+    header_text = header_text.c_str(); //the text may be NUL-padded
+
+    int32_t n_ref = 0;
+    bgzf.read_exactly(&n_ref, 4);
+    for (int r = 0 ; r < n_ref ; r++){
+        int32_t l_name = 0;
+        bgzf.read_exactly(&l_name, 4);
+        string name(l_name, '\0');
+        bgzf.read_exactly(&name[0], l_name);
+        int32_t l_ref = 0;
+        bgzf.read_exactly(&l_ref, 4);
+        reference_names.push_back(name.c_str());
+        reference_lengths.push_back(l_ref);
+    }
+}
+
+/**
+ * @brief Reads the next alignment of the file
+ *
+ * @param record filled with the alignment
+ * @return false at the end of the file
+ */
+bool BamReader::next(BamRecord &record){
+
+    int32_t block_size = 0;
+    if (!bgzf.read_exactly(&block_size, 4)){
+        return false;
+    }
+    if (block_size < 32){
+        throw std::runtime_error("Corrupted BAM record");
+    }
+
+    unsigned char fixed[32];
+    if (!bgzf.read_exactly(fixed, 32)){
+        throw std::runtime_error("Truncated BAM file");
+    }
+    memcpy(&record.refID, fixed, 4);
+    memcpy(&record.pos, fixed+4, 4);
+    record.l_read_name = fixed[8];
+    record.mapq = fixed[9];
+    uint16_t n_cigar_op;
+    memcpy(&n_cigar_op, fixed+12, 2);
+    record.n_cigar_op = n_cigar_op;
+    memcpy(&record.flag, fixed+14, 2);
+    memcpy(&record.l_seq, fixed+16, 4);
+
+    record.data.resize(block_size-32);
+    if (!bgzf.read_exactly(record.data.data(), block_size-32)){
+        throw std::runtime_error("Truncated BAM file");
+    }
+    return true;
+}
+
+uint64_t BamReader::tell(){
+    return bgzf.tell();
+}
+
+void BamReader::seek(uint64_t virtualOffset){
+    bgzf.seek(virtualOffset);
+}
+
+uint64_t BamReader::bytes_read(){
+    return bgzf.uncompressed_bytes_read();
+}
+
+/**
+ * @brief Loads the index of a BAM file if there is an up-to-date one next to it
+ *
+ * @param fileBAM name of the BAM file (not of the index)
+ */
+BamIndex::BamIndex(std::string fileBAM){
+
+    loaded = false;
+    vector<string> candidates = {fileBAM + ".bai"};
+    if (fileBAM.size() > 4 && fileBAM.substr(fileBAM.size()-4) == ".bam"){
+        candidates.push_back(fileBAM.substr(0, fileBAM.size()-4) + ".bai");
+    }
+
+    struct stat bamStat;
+    if (stat(fileBAM.c_str(), &bamStat) != 0){
+        return;
+    }
+    for (auto &candidate : candidates){
+        struct stat indexStat;
+        if (stat(candidate.c_str(), &indexStat) != 0){
+            continue;
+        }
+        if (indexStat.st_mtime < bamStat.st_mtime){
+            cout << "WARNING: the index " << candidate << " is older than " << fileBAM << ", ignoring it" << endl;
+            continue;
+        }
+        if (load(candidate)){
+            loaded = true;
+            return;
+        }
+        cout << "WARNING: could not read the index " << candidate << ", ignoring it" << endl;
+    }
+}
+
+/**
+ * @brief Parses a .bai file. Only the chunks of the bins are used, to know where the alignments of each reference start and end
+ *
+ * @param fileBAI name of the index
+ * @return false if the file is not a valid index
+ */
+bool BamIndex::load(std::string fileBAI){
+
+    std::ifstream in(fileBAI, std::ios::binary);
+    char magic[4];
+    int32_t n_ref = 0;
+    if (!in.read(magic, 4) || memcmp(magic, "BAI\1", 4) != 0 || !in.read(reinterpret_cast<char*>(&n_ref), 4) || n_ref < 0){
+        return false;
+    }
+
+    const uint32_t PSEUDO_BIN = 37450; //holds statistics, not alignments
+    spans.assign(n_ref, make_pair(0,0));
+    for (int r = 0 ; r < n_ref ; r++){
+        int32_t n_bin = 0;
+        if (!in.read(reinterpret_cast<char*>(&n_bin), 4)){
+            return false;
+        }
+        uint64_t begin = UINT64_MAX;
+        uint64_t end = 0;
+        for (int b = 0 ; b < n_bin ; b++){
+            uint32_t bin = 0;
+            int32_t n_chunk = 0;
+            in.read(reinterpret_cast<char*>(&bin), 4);
+            in.read(reinterpret_cast<char*>(&n_chunk), 4);
+            vector<uint64_t> chunks (2*std::max(n_chunk, 0));
+            if (!in.read(reinterpret_cast<char*>(chunks.data()), 8*chunks.size())){
+                return false;
+            }
+            if (bin == PSEUDO_BIN){
+                continue;
+            }
+            for (int c = 0 ; c < n_chunk ; c++){
+                begin = std::min(begin, chunks[2*c]);
+                end = std::max(end, chunks[2*c+1]);
+            }
+        }
+        if (begin < end){
+            spans[r] = make_pair(begin, end);
+        }
+
+        int32_t n_intv = 0;
+        if (!in.read(reinterpret_cast<char*>(&n_intv), 4) || !in.seekg(8*(int64_t)std::max(n_intv, 0), std::ios::cur)){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BamIndex::good() const{
+    return loaded;
+}
+
+/**
+ * @brief Where to read the alignments of a reference
+ *
+ * @param refID index of the reference in the header of the BAM
+ * @param begin virtual offset of the first alignment on refID
+ * @param end virtual offset right after the last alignment on refID
+ * @return false if no alignment is stored for refID
+ */
+bool BamIndex::reference_span(int32_t refID, uint64_t &begin, uint64_t &end) const{
+    if (refID < 0 || refID >= (int32_t) spans.size() || spans[refID].second == 0){
+        return false;
+    }
+    begin = spans[refID].first;
+    end = spans[refID].second;
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef BAM_H
+#define BAM_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "bgzf.h"
+
+//flags of the SAM specification
+#define BAM_FPAIRED        1
+#define BAM_FPROPER_PAIR   2
+#define BAM_FUNMAP         4
+#define BAM_FREVERSE      16
+#define BAM_FSECONDARY   256
+#define BAM_FQCFAIL      512
+#define BAM_FDUP        1024
+#define BAM_FSUPPLEMENTARY 2048
+
+//operations of the packed CIGAR, in the order of the BAM specification
+#define BAM_CMATCH      0
+#define BAM_CINS        1
+#define BAM_CDEL        2
+#define BAM_CREF_SKIP   3
+#define BAM_CSOFT_CLIP  4
+#define BAM_CHARD_CLIP  5
+#define BAM_CPAD        6
+#define BAM_CEQUAL      7
+#define BAM_CDIFF       8
+
+extern const char BAM_CIGAR_CHARS[];
+extern const char BAM_SEQ_CHARS[];
+
+/**
+ * @brief One alignment of a BAM file. The variable-length fields are kept packed as in the file
+ */
+struct BamRecord{
+    int32_t refID;
+    int32_t pos; //0-based leftmost position on the reference
+    uint8_t mapq;
+    uint16_t flag;
+    uint32_t n_cigar_op;
+    int32_t l_seq;
+
+    std::vector<uint8_t> data; //read_name, cigar, seq and qual, as in the file
+
+    std::string name() const;
+    const uint32_t* cigar() const;
+    char base(int i) const; //base at position i of the read, as a letter of =ACMGRSVTWYHKDBN
+    uint8_t base_code(int i) const;
+    uint8_t quality(int i) const;
+    std::string sequence() const;
+    std::string cigar_string() const;
+    int32_t end() const; //0-based position on the reference right after the alignment
+
+private :
+    friend class BamReader;
+    uint8_t l_read_name;
+};
+
+/**
+ * @brief Sequential reader of BAM files
+ */
+class BamReader{
+
+public :
+    BamReader(std::string file);
+
+    bool next(BamRecord &record); //returns false at the end of the file
+    uint64_t tell();
+    void seek(uint64_t virtualOffset);
+
+    uint64_t bytes_read();
+
+    std::string header_text;
+    std::vector<std::string> reference_names;
+    std::vector<int32_t> reference_lengths;
+
+private :
+    BgzfReader bgzf;
+};
+
+/**
+ * @brief Reads a .bai index and keeps, for each reference, the span of the BAM where its alignments are stored
+ */
+class BamIndex{
+
+public :
+    BamIndex(std::string fileBAM); //looks for file.bam.bai, then file.bai
+
+    bool good() const; //false if no usable index was found
+    bool reference_span(int32_t refID, uint64_t &begin, uint64_t &end) const; //virtual offsets, false if nothing aligns on refID
+
+private :
+    std::vector<std::pair<uint64_t,uint64_t>> spans; //(first, last) virtual offset of each reference, (0,0) when empty
+    bool loaded;
+
+    bool load(std::string fileBAI);
+};
+
+#endif
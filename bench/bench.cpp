@@ -0,0 +1,305 @@
+#include <benchmark/benchmark.h>
+
+#include <iostream>
+#include <filesystem>
+#include <random>
+
+#include "fixtures.h"
+#include "sequence.h"
+#include "tools.h"
+#include "input_output.h"
+#include "reads_index.h"
+#include "read_store.h"
+#include "profiling.h"
+#include "create_new_contigs.h"
+
+using std::string;
+using std::vector;
+using std::cout;
+
+//the functions benchmarked log on cout, which must stay clean for the JSON report
+struct SilenceCout{
+    std::streambuf* previous;
+    SilenceCout() : previous(cout.rdbuf(nullptr)){
+    }
+    ~SilenceCout(){
+        cout.rdbuf(previous);
+        cout.clear();
+    }
+};
+
+static string random_sequence(size_t length, unsigned int seed = 1){
+    std::mt19937 rng (seed);
+    string seq (length, 'A');
+    for (char &c : seq){
+        c = "ACGT"[rng()%4];
+    }
+    return seq;
+}
+
+/*********************
+ *      Sequence     *
+ *********************/
+
+static void BM_sequence_encode(benchmark::State &state){
+    string seq = random_sequence(state.range(0));
+    for (auto _ : state){
+        Sequence s (seq);
+        benchmark::DoNotOptimize(s);
+    }
+    state.SetBytesProcessed(state.iterations()*seq.size());
+}
+BENCHMARK(BM_sequence_encode)->Arg(1000)->Arg(50000);
+
+static void BM_sequence_decode(benchmark::State &state){
+    string seq = random_sequence(state.range(0));
+    Sequence s (seq);
+    for (auto _ : state){
+        benchmark::DoNotOptimize(s.str());
+    }
+    state.SetBytesProcessed(state.iterations()*seq.size());
+}
+BENCHMARK(BM_sequence_decode)->Arg(1000)->Arg(50000);
+
+static void BM_sequence_reverse_complement(benchmark::State &state){
+    string seq = random_sequence(state.range(0));
+    Sequence s (seq);
+    for (auto _ : state){
+        benchmark::DoNotOptimize(s.reverse_complement());
+    }
+    state.SetBytesProcessed(state.iterations()*seq.size());
+}
+BENCHMARK(BM_sequence_reverse_complement)->Arg(1000)->Arg(50000);
+
+//a window of 5 kb in the middle of a 50 kb read, as taken by the polishing of an interval
+static void BM_sequence_subseq(benchmark::State &state){
+    string seq = random_sequence(50000);
+    Sequence s (seq);
+    for (auto _ : state){
+        benchmark::DoNotOptimize(s.subseq(20001, 5000));
+    }
+    state.SetBytesProcessed(state.iterations()*5000);
+}
+BENCHMARK(BM_sequence_subseq);
+
+static void BM_sequence_decode_window(benchmark::State &state){
+    string seq = random_sequence(50000);
+    Sequence s (seq);
+    for (auto _ : state){
+        if (state.range(0)){
+            benchmark::DoNotOptimize(s.reverse_complement_str(20001, 5000));
+        }
+        else{
+            benchmark::DoNotOptimize(s.str(20001, 5000));
+        }
+    }
+    state.SetBytesProcessed(state.iterations()*5000);
+}
+BENCHMARK(BM_sequence_decode_window)->ArgName("reverse")->Arg(0)->Arg(1);
+
+/*********************
+ *       CIGARs      *
+ *********************/
+
+//the CIGARs of the alignments of the fixture
+static vector<string> fixture_CIGARs(){
+    const ParsedFixture &p = parsed_fixture();
+    vector<string> cigars;
+    for (auto &overlap : p.allOverlaps){
+        cigars.push_back(p.allCIGARs.str(overlap.CIGAROffset, overlap.CIGARLength));
+    }
+    return cigars;
+}
+
+static void BM_convert_cigar(benchmark::State &state){
+    vector<string> cigars = fixture_CIGARs();
+    size_t bytes = 0;
+    for (auto _ : state){
+        for (string &cigar : cigars){
+            benchmark::DoNotOptimize(convert_cigar(cigar));
+        }
+    }
+    for (string &cigar : cigars){
+        bytes += cigar.size();
+    }
+    state.SetBytesProcessed(state.iterations()*bytes);
+}
+BENCHMARK(BM_convert_cigar);
+
+static void BM_convert_cigar2(benchmark::State &state){
+    vector<string> alignments;
+    size_t bytes = 0;
+    for (string &cigar : fixture_CIGARs()){
+        alignments.push_back(convert_cigar(cigar));
+        bytes += alignments.back().size();
+    }
+    for (auto _ : state){
+        for (string &alignment : alignments){
+            benchmark::DoNotOptimize(convert_cigar2(alignment));
+        }
+    }
+    state.SetBytesProcessed(state.iterations()*bytes);
+}
+BENCHMARK(BM_convert_cigar2);
+
+/*********************
+ *      Parsing      *
+ *********************/
+
+static void BM_parse_reads(benchmark::State &state){
+    const Fixture &fixture = bench_fixture();
+    SilenceCout silence;
+    for (auto _ : state){
+        ReadsIndex readsIndex (fixture.reads);
+        vector<Read> allreads;
+        robin_hood::unordered_map<string, unsigned long int> indices;
+        parse_reads(readsIndex, allreads, indices);
+        benchmark::DoNotOptimize(allreads.data());
+    }
+    state.SetBytesProcessed(state.iterations()*std::filesystem::file_size(fixture.reads));
+}
+BENCHMARK(BM_parse_reads)->Unit(benchmark::kMillisecond);
+
+static void BM_parse_SAM(benchmark::State &state){
+    const Fixture &fixture = bench_fixture();
+    const ParsedFixture &parsed = parsed_fixture(false);
+    SilenceCout silence;
+    for (auto _ : state){
+        state.PauseTiming();
+        vector<Read> allreads = parsed.allreads;
+        robin_hood::unordered_map<string, unsigned long int> indices = parsed.indices;
+        vector<Overlap> allOverlaps;
+        CigarArena allCIGARs;
+        state.ResumeTiming();
+        parse_SAM(fixture.sam, allOverlaps, allCIGARs, allreads, indices, state.range(0));
+        benchmark::DoNotOptimize(allOverlaps.data());
+    }
+    state.SetBytesProcessed(state.iterations()*std::filesystem::file_size(fixture.sam));
+}
+BENCHMARK(BM_parse_SAM)->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_parse_split_file(benchmark::State &state){
+    string split = bench_fixture().split;
+    ParsedFixture parsed = parsed_fixture();
+    SilenceCout silence;
+    for (auto _ : state){
+        Partitions partitions;
+        parse_split_file(split, parsed.allreads, parsed.allOverlaps, partitions);
+        benchmark::DoNotOptimize(partitions.size());
+    }
+    state.SetBytesProcessed(state.iterations()*std::filesystem::file_size(split));
+}
+BENCHMARK(BM_parse_split_file)->Unit(benchmark::kMillisecond);
+
+/*********************
+ *     Intervals     *
+ *********************/
+
+static void BM_merge_intervals(benchmark::State &state){
+    string split = bench_fixture().split;
+    ParsedFixture parsed = parsed_fixture();
+    Partitions unmerged;
+    parse_split_file(split, parsed.allreads, parsed.allOverlaps, unmerged);
+    SilenceCout silence;
+    for (auto _ : state){
+        state.PauseTiming();
+        Partitions partitions = unmerged;
+        state.ResumeTiming();
+        merge_intervals(partitions, 1);
+        benchmark::DoNotOptimize(partitions.size());
+    }
+}
+BENCHMARK(BM_merge_intervals)->Unit(benchmark::kMicrosecond);
+
+//stitches all the consecutive intervals of all the backbones, as modify_GFA does
+static void BM_stitch(benchmark::State &state){
+    const ParsedFixture &parsed = parsed_fixture();
+    StitchTable table;
+    size_t junctions = 0;
+    for (auto _ : state){
+        junctions = 0;
+        for (auto &backbone : parsed.partitions){
+            auto &intervals = backbone.second;
+            for (int n = 1 ; n < intervals.size() ; n++){
+                stitch(intervals[n].second, intervals[n-1].second, intervals[n].first.first, table);
+                table.link_unstitched(true);
+                benchmark::DoNotOptimize(table.parts());
+                junctions++;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*junctions);
+}
+BENCHMARK(BM_stitch);
+
+/*********************
+ *    End to end     *
+ *********************/
+
+//the new contigs of the split backbone with the most intervals, polished with the in-memory polisher so that no external tool runs
+static void BM_modify_GFA(benchmark::State &state){
+    const Fixture &fixture = bench_fixture();
+    const ParsedFixture &parsed = parsed_fixture();
+    vector<unsigned long int> backbones;
+    for (auto &backbone : parsed.partitions){
+        if (backbones.empty() || backbone.second.size() > parsed.partitions.at(backbones[0]).size()){
+            backbones = {backbone.first};
+        }
+    }
+    if (backbones.empty()){
+        state.SkipWithError("no interval in the fixture");
+        return;
+    }
+
+    string outFolder = fixture.folder + "/modify_GFA";
+    std::filesystem::create_directories(outFolder);
+    string polisher = "fast";
+    string techno = "ont";
+    string tool = "none";
+    string path_src = "";
+    ReadsIndex readsIndex (fixture.reads);
+    CigarArena allCIGARs = parsed.allCIGARs;
+    SilenceCout silence;
+    for (auto _ : state){
+        state.PauseTiming();
+        vector<Read> allreads = parsed.allreads;
+        vector<Link> allLinks = parsed.allLinks;
+        vector<Overlap> allOverlaps = parsed.allOverlaps;
+        Partitions partitions = parsed.partitions;
+        vector<unsigned long int> toModify = backbones;
+        ReadStore readStore (readsIndex, allreads, 0);
+        Profiler profiler;
+        state.ResumeTiming();
+        modify_GFA(readStore, allreads, toModify, allOverlaps, allCIGARs, partitions, allLinks, 1, profiler,
+            outFolder, 0.02, polisher, false, techno, tool, tool, tool, tool, tool, path_src, false);
+        benchmark::DoNotOptimize(allreads.data());
+    }
+    state.counters["bases"] = parsed.allreads[backbones[0]].sequence_.size();
+}
+BENCHMARK(BM_modify_GFA)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//the results are printed as JSON unless another format is asked for
+int main(int argc, char** argv){
+    vector<char*> args (argv, argv+argc);
+    string json = "--benchmark_format=json";
+    bool format = false;
+    for (int a = 1 ; a < argc ; a++){
+        format = format || string(argv[a]).rfind("--benchmark_format", 0) == 0;
+    }
+    if (!format){
+        args.insert(args.begin()+1, &json[0]);
+    }
+    int nbArgs = args.size();
+    benchmark::Initialize(&nbArgs, args.data());
+    if (benchmark::ReportUnrecognizedArguments(nbArgs, args.data())){
+        return 1;
+    }
+    {
+        SilenceCout silence; //the fixture is parsed before, so that its logs do not end in the report
+        parsed_fixture(false);
+        parsed_fixture();
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
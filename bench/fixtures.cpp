@@ -0,0 +1,246 @@
+#include "fixtures.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <filesystem>
+#include <cstdlib>
+
+#include "input_output.h"
+#include "reads_index.h"
+#include "create_new_contigs.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::cerr;
+using std::endl;
+
+static string reverse_complement_of(const string &seq){
+    string rc (seq.rbegin(), seq.rend());
+    for (char &c : rc){
+        switch (c){
+            case 'A' : c = 'T'; break;
+            case 'C' : c = 'G'; break;
+            case 'G' : c = 'C'; break;
+            case 'T' : c = 'A'; break;
+        }
+    }
+    return rc;
+}
+
+Fixture synthetic_fixture(string folder, unsigned int seed){
+
+    std::mt19937 rng (seed);
+    const string bases = "ACGT";
+    auto random_base = [&](){return bases[rng()%4];};
+    auto other_base = [&](char b){ //a base different from b
+        char o = random_base();
+        while (o == b){
+            o = random_base();
+        }
+        return o;
+    };
+    auto uniform = [&](){return std::uniform_real_distribution<double>(0,1)(rng);};
+
+    vector<pair<string,int>> contigs = {{"ctg1", 30000}, {"ctg2", 12000}, {"ctg3", 8000}};
+    vector<vector<string>> strains; //two strains of each contig, ctg3 has only one
+    for (auto &contig : contigs){
+        string ref;
+        for (int i = 0 ; i < contig.second ; i++){
+            ref += random_base();
+        }
+        string other = ref;
+        if (contig.first != "ctg3"){
+            for (int p = 200 ; p < contig.second-200 ; p += 60){
+                other[p] = other_base(other[p]);
+            }
+        }
+        strains.push_back({ref, other});
+    }
+
+    struct SimulatedRead{
+        string name;
+        string seq; //in the orientation of the contig
+        int contig;
+        int start;
+        int end;
+        string cigar;
+        bool reverse;
+        int strain;
+    };
+    vector<SimulatedRead> reads;
+    for (int c = 0 ; c < contigs.size() ; c++){
+        int length = contigs[c].second;
+        for (int k = 0 ; k < length*30/4000 ; k++){
+            SimulatedRead read;
+            int readLength = 2500 + rng()%2501;
+            read.contig = c;
+            read.start = rng()%(length-readLength+1);
+            read.strain = rng()%2;
+            read.reverse = rng()%2;
+            read.name = "read" + std::to_string(reads.size()) + "_" + contigs[c].first + "_" + std::to_string(read.strain);
+
+            //substitutions, insertions and deletions, 2% in total
+            const string &tmpl = strains[c][read.strain];
+            char lastOp = ' ';
+            int lastLength = 0;
+            auto add = [&](char op){
+                if (op != lastOp && lastOp != ' '){
+                    read.cigar += std::to_string(lastLength) + lastOp;
+                    lastLength = 0;
+                }
+                lastOp = op;
+                lastLength++;
+            };
+            if (uniform() < 0.3){ //soft clip
+                read.cigar = "20S";
+                for (int i = 0 ; i < 20 ; i++){
+                    read.seq += random_base();
+                }
+            }
+            int pos = read.start;
+            while (pos < read.start+readLength){
+                double r = uniform();
+                if (r < 0.01){
+                    read.seq += other_base(tmpl[pos++]);
+                    add('M');
+                }
+                else if (r < 0.015){
+                    read.seq += random_base();
+                    add('I');
+                }
+                else if (r < 0.02){
+                    pos++;
+                    add('D');
+                }
+                else{
+                    read.seq += tmpl[pos++];
+                    add('M');
+                }
+            }
+            read.cigar += std::to_string(lastLength) + lastOp;
+            read.end = pos;
+            reads.push_back(read);
+        }
+    }
+
+    Fixture fixture;
+    fixture.folder = folder;
+    fixture.assembly = folder + "/assembly.gfa";
+    fixture.reads = folder + "/reads.fasta";
+    fixture.sam = folder + "/aln.sam";
+    fixture.split = folder + "/split.gro";
+
+    std::ofstream gfa (fixture.assembly);
+    gfa << "H\tVN:Z:1.0\n";
+    for (int c = 0 ; c < contigs.size() ; c++){
+        gfa << "S\t" << contigs[c].first << "\t" << strains[c][0] << "\tdp:f:30\n";
+    }
+    gfa << "L\tctg1\t+\tctg2\t+\t0M\nL\tctg2\t+\tctg3\t-\t0M\nL\tctg3\t+\tctg1\t+\t0M\n";
+    gfa.close();
+
+    //the reads aligned on the reverse strand are stored reverse complemented
+    std::ofstream fasta (fixture.reads);
+    for (auto &read : reads){
+        fasta << ">" << read.name << " some comment\n" << (read.reverse ? reverse_complement_of(read.seq) : read.seq) << "\n";
+    }
+    fasta.close();
+
+    std::ofstream sam (fixture.sam);
+    sam << "@HD\tVN:1.6\tSO:unsorted\n";
+    for (auto &contig : contigs){
+        sam << "@SQ\tSN:" << contig.first << "\tLN:" << contig.second << "\n";
+    }
+    for (auto &read : reads){
+        sam << read.name << "\t" << (read.reverse ? 16 : 0) << "\t" << contigs[read.contig].first << "\t" << read.start+1 << "\t60\t" << read.cigar
+            << "\t*\t0\t0\t" << read.seq << "\t" << string(read.seq.size(), 'I') << "\n";
+    }
+    sam.close();
+
+    //one group per window of 2 kb, with the reads spanning it labelled by their strain (ctg3 is not split)
+    std::ofstream split (fixture.split);
+    for (int c = 0 ; c < contigs.size() ; c++){
+        int length = contigs[c].second;
+        split << "CONTIG\t" << contigs[c].first << "\t" << length << "\t1\n";
+        vector<const SimulatedRead*> onContig;
+        for (auto &read : reads){
+            if (read.contig == c){
+                onContig.push_back(&read);
+                split << "READ\t" << read.name << "\t-1\t-1\t-1\t-1\t-1\n";
+            }
+        }
+        for (int start = 0 ; start < length ; start += 2000){
+            int end = std::min(length, start+2000);
+            string indices, labels;
+            for (int r = 0 ; r < onContig.size() ; r++){
+                if (onContig[r]->start <= start+100 && onContig[r]->end >= end-100){
+                    indices += std::to_string(r) + ",";
+                    labels += std::to_string(contigs[c].first == "ctg3" ? -1 : onContig[r]->strain) + ",";
+                }
+            }
+            split << "GROUP\t" << start << "\t" << end << "\t" << indices << "\t" << labels << "\n";
+        }
+    }
+    split.close();
+
+    if (!gfa || !fasta || !sam || !split){
+        cerr << "ERROR: could not write the fixture in " << folder << endl;
+        exit(1);
+    }
+    return fixture;
+}
+
+//removes the synthetic fixture at exit
+struct TemporaryFolder{
+    string folder;
+    ~TemporaryFolder(){
+        if (folder != ""){
+            std::error_code error;
+            std::filesystem::remove_all(folder, error);
+        }
+    }
+};
+
+const Fixture& bench_fixture(){
+    static TemporaryFolder temporary;
+    static Fixture fixture = [](){
+        const char* real = std::getenv("STRAINMINER_BENCH_FIXTURE");
+        if (real != nullptr){
+            string folder = real;
+            return Fixture{folder, folder+"/assembly.gfa", folder+"/reads.fasta", folder+"/aln.sam", folder+"/split.gro"};
+        }
+        string folder = (std::filesystem::temp_directory_path() / "strainminer_bench_XXXXXX").string();
+        if (mkdtemp(&folder[0]) == nullptr){
+            cerr << "ERROR: could not create a temporary folder for the benchmarks" << endl;
+            exit(1);
+        }
+        temporary.folder = folder;
+        return synthetic_fixture(folder);
+    }();
+    return fixture;
+}
+
+static ParsedFixture parse_fixture(bool alignments){
+    const Fixture &fixture = bench_fixture();
+    ParsedFixture p;
+    ReadsIndex readsIndex (fixture.reads);
+    parse_reads(readsIndex, p.allreads, p.indices);
+    parse_assembly(fixture.assembly, p.allreads, p.indices, p.backbones, p.allLinks);
+    if (alignments){
+        parse_SAM(fixture.sam, p.allOverlaps, p.allCIGARs, p.allreads, p.indices);
+        string split = fixture.split;
+        parse_split_file(split, p.allreads, p.allOverlaps, p.partitions);
+        merge_intervals(p.partitions, 1);
+    }
+    return p;
+}
+
+const ParsedFixture& parsed_fixture(bool alignments){
+    if (alignments){
+        static ParsedFixture parsed = parse_fixture(true);
+        return parsed;
+    }
+    static ParsedFixture parsed = parse_fixture(false);
+    return parsed;
+}
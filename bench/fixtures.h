@@ -0,0 +1,53 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <string>
+#include <vector>
+
+#include "robin_hood.h"
+#include "read.h"
+#include "cigar.h"
+#include "split_file.h"
+
+/**
+ * @brief Input files of create_new_contigs on which the benchmarks run
+ */
+struct Fixture{
+    std::string folder;
+    std::string assembly; //GFA
+    std::string reads; //FASTA
+    std::string sam;
+    std::string split; //.gro file
+};
+
+/**
+ * @brief Writes in folder a small metagenome: three contigs, two strains differing by a SNP every 60 bases on the first two contigs,
+ * 30x of 2.5-5 kb reads with 2% of errors on both strands, their alignments and the partition of the reads on windows of 2 kb
+ *
+ * @param folder existing folder
+ * @param seed the fixture only depends on it
+ */
+Fixture synthetic_fixture(std::string folder, unsigned int seed = 1);
+
+/**
+ * @brief The fixture of the benchmarks: the files assembly.gfa, reads.fasta, aln.sam and split.gro of the folder given in the environment
+ * variable STRAINMINER_BENCH_FIXTURE (e.g. a small real dataset), or else a synthetic fixture written once in a temporary folder
+ */
+const Fixture& bench_fixture();
+
+/**
+ * @brief What create_new_contigs has in memory once the files of a fixture are parsed, before modify_GFA
+ */
+struct ParsedFixture{
+    std::vector<Read> allreads;
+    robin_hood::unordered_map<std::string, unsigned long int> indices;
+    std::vector<unsigned long int> backbones;
+    std::vector<Link> allLinks;
+    std::vector<Overlap> allOverlaps;
+    CigarArena allCIGARs;
+    Partitions partitions;
+};
+
+const ParsedFixture& parsed_fixture(bool alignments = true); //parsed once, with the intervals merged. Without the alignments, only the reads and the assembly are parsed
+
+#endif
@@ -0,0 +1,314 @@
+#include "bgzf.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+static const size_t BGZF_MAX_BLOCK_SIZE = 65536;
+static const size_t BGZF_HEADER_SIZE = 18;
+static const size_t BGZF_FOOTER_SIZE = 8;
+static const size_t BGZF_MAX_INPUT_SIZE = 0xff00; //as bgzip, so that a block stays below 64 kB even if its content does not compress
+
+/**
+ * @brief Checks if a file starts with a BGZF block header (gzip with the 'BC' extra subfield)
+ *
+ * @param file
+ * @return true if the file is in BGZF format
+ */
+bool is_bgzf(std::string file){
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0){
+        return false;
+    }
+    unsigned char header[BGZF_HEADER_SIZE];
+    ssize_t n = pread(fd, header, BGZF_HEADER_SIZE, 0);
+    close(fd);
+    return n == (ssize_t) BGZF_HEADER_SIZE && bgzf_block_size(header, BGZF_HEADER_SIZE) > 0;
+}
+
+/**
+ * @brief Reads the total size of a BGZF block from its header
+ *
+ * @param header beginning of the block
+ * @param available number of bytes available in header
+ * @return size of the block (including header and footer), 0 if this is not a BGZF block
+ */
+size_t bgzf_block_size(const unsigned char* header, size_t available){
+
+    if (available < BGZF_HEADER_SIZE || header[0] != 31 || header[1] != 139 || header[2] != 8 || (header[3] & 4) == 0){
+        return 0;
+    }
+    size_t xlen = header[10] | (header[11] << 8);
+    size_t pos = 12;
+    //look for the BC subfield in the extra field
+    while (pos + 4 <= 12 + xlen && pos + 4 <= available){
+        size_t slen = header[pos+2] | (header[pos+3] << 8);
+        if (header[pos] == 'B' && header[pos+1] == 'C' && slen == 2 && pos + 6 <= available){
+            return (header[pos+4] | (header[pos+5] << 8)) + 1;
+        }
+        pos += 4 + slen;
+    }
+    return 0;
+}
+
+/**
+ * @brief Inflates one full BGZF block
+ *
+ * @param strm zlib stream initialized for raw inflating (windowBits = -15), reset here
+ * @param data the block, header included
+ * @param size total size of the block
+ * @param out filled with the uncompressed content of the block
+ * @return false if the block is corrupted
+ */
+bool inflate_bgzf_block(z_stream &strm, const unsigned char* data, size_t size, std::vector<unsigned char> &out){
+
+    size_t xlen = data[10] | (data[11] << 8);
+    size_t start = 12 + xlen;
+    if (size < start + 8){
+        return false;
+    }
+    size_t isize = data[size-4] | (data[size-3] << 8) | (data[size-2] << 16) | ((size_t)data[size-1] << 24);
+    out.resize(isize);
+    if (isize == 0){
+        return true;
+    }
+
+    inflateReset(&strm);
+    strm.next_in = const_cast<unsigned char*>(data + start);
+    strm.avail_in = size - start - 8;
+    strm.next_out = out.data();
+    strm.avail_out = isize;
+    int ret = inflate(&strm, Z_FINISH);
+    if (ret != Z_STREAM_END){
+        return false;
+    }
+
+    uint32_t crc = data[size-8] | (data[size-7] << 8) | (data[size-6] << 16) | ((uint32_t)data[size-5] << 24);
+    return crc32(0L, out.data(), isize) == crc;
+}
+
+BgzfReader::BgzfReader(std::string file){
+
+    fd = open(file.c_str(), O_RDONLY);
+    memset(&strm, 0, sizeof(strm));
+    inflateInit2(&strm, -15);
+    compressed.resize(BGZF_MAX_BLOCK_SIZE);
+    blockAddress = 0;
+    nextBlockAddress = 0;
+    posInBlock = 0;
+    totalRead = 0;
+    endOfFile = false;
+
+    if (fd < 0){
+        cout << "ERROR: could not open " << file << endl;
+        throw std::invalid_argument( "Input file '"+file +"' could not be read" );
+    }
+    if (!is_bgzf(file)){
+        cout << "ERROR: " << file << " is not in BGZF format (as BAM files and bgzipped files are)" << endl;
+        throw std::invalid_argument( "Input file '"+file +"' is not BGZF-compressed" );
+    }
+    load_block(0);
+}
+
+BgzfReader::~BgzfReader(){
+    inflateEnd(&strm);
+    if (fd >= 0){
+        close(fd);
+    }
+}
+
+bool BgzfReader::good(){
+    return fd >= 0;
+}
+
+bool BgzfReader::load_block(uint64_t address){
+
+    blockAddress = address;
+    posInBlock = 0;
+    block.clear();
+
+    ssize_t n = pread(fd, compressed.data(), BGZF_HEADER_SIZE, address);
+    if (n <= 0){
+        endOfFile = true;
+        nextBlockAddress = address;
+        return false;
+    }
+    size_t size = bgzf_block_size(compressed.data(), n);
+    if (size == 0 || size > BGZF_MAX_BLOCK_SIZE){
+        cout << "ERROR: corrupted BGZF block at offset " << address << endl;
+        throw std::runtime_error("Corrupted BGZF file");
+    }
+    n = pread(fd, compressed.data(), size, address);
+    if (n != (ssize_t) size || !inflate_bgzf_block(strm, compressed.data(), size, block)){
+        cout << "ERROR: corrupted BGZF block at offset " << address << endl;
+        throw std::runtime_error("Corrupted BGZF file");
+    }
+    nextBlockAddress = address + size;
+    endOfFile = false;
+    return true;
+}
+
+size_t BgzfReader::read(void* dest, size_t length){
+
+    unsigned char* out = static_cast<unsigned char*>(dest);
+    size_t done = 0;
+    while (done < length){
+        if (posInBlock == block.size()){
+            if (endOfFile || !load_block(nextBlockAddress)){
+                break;
+            }
+            continue; //the block may be empty (e.g. the EOF marker)
+        }
+        size_t chunk = std::min(length - done, block.size() - posInBlock);
+        memcpy(out + done, block.data() + posInBlock, chunk);
+        posInBlock += chunk;
+        done += chunk;
+    }
+    totalRead += done;
+    return done;
+}
+
+bool BgzfReader::read_exactly(void* dest, size_t length){
+    return read(dest, length) == length;
+}
+
+/**
+ * @brief Returns the virtual offset of the next byte to be read
+ */
+uint64_t BgzfReader::tell(){
+    if (posInBlock == block.size() && !endOfFile){
+        //at the very end of a block, the next byte is at the beginning of the next block
+        return nextBlockAddress << 16;
+    }
+    return (blockAddress << 16) | posInBlock;
+}
+
+void BgzfReader::seek(uint64_t virtualOffset){
+    uint64_t address = virtualOffset >> 16;
+    size_t offset = virtualOffset & 0xFFFF;
+    if (address != blockAddress || block.empty()){
+        load_block(address);
+    }
+    posInBlock = std::min(offset, block.size());
+}
+
+uint64_t BgzfReader::block_address(){
+    return blockAddress;
+}
+
+uint64_t BgzfReader::uncompressed_bytes_read(){
+    return totalRead;
+}
+
+BgzfWriter::BgzfWriter(std::string file, int level) : out(file), ok(true), closed(false), compressedOffset(0), uncompressedOffset(0){
+    memset(&strm, 0, sizeof(strm));
+    ok = deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    block.reserve(BGZF_MAX_INPUT_SIZE);
+    compressed.resize(BGZF_MAX_BLOCK_SIZE);
+}
+
+BgzfWriter::~BgzfWriter(){
+    close();
+    deflateEnd(&strm);
+}
+
+void BgzfWriter::write(std::string_view text){
+    while (!text.empty()){
+        size_t chunk = std::min(text.size(), BGZF_MAX_INPUT_SIZE - block.size());
+        block.append(text.data(), chunk);
+        text.remove_prefix(chunk);
+        if (block.size() == BGZF_MAX_INPUT_SIZE){
+            compress_block();
+        }
+    }
+}
+
+/**
+ * @brief Compresses the pending content in one block, or in several if it does not fit once compressed
+ */
+void BgzfWriter::compress_block(){
+    std::string_view pending = block;
+    while (ok && !pending.empty()){
+        size_t input = pending.size();
+        size_t size = 0;
+        while (size == 0){
+            deflateReset(&strm);
+            strm.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(pending.data()));
+            strm.avail_in = input;
+            strm.next_out = compressed.data() + BGZF_HEADER_SIZE;
+            strm.avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+            int ret = deflate(&strm, Z_FINISH);
+            if (ret == Z_STREAM_END){
+                size = BGZF_HEADER_SIZE + strm.total_out + BGZF_FOOTER_SIZE;
+            }
+            else if ((ret == Z_OK || ret == Z_BUF_ERROR) && input > 1024){
+                input -= 1024; //does not fit, retry with less content
+            }
+            else{
+                ok = false;
+                return;
+            }
+        }
+
+        unsigned char header[BGZF_HEADER_SIZE] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+            (unsigned char) ((size-1) & 0xff), (unsigned char) ((size-1) >> 8)};
+        memcpy(compressed.data(), header, BGZF_HEADER_SIZE);
+        uint32_t crc = crc32(0L, reinterpret_cast<const unsigned char*>(pending.data()), input);
+        unsigned char* footer = compressed.data() + size - BGZF_FOOTER_SIZE;
+        for (int b = 0 ; b < 4 ; b++){
+            footer[b] = (crc >> (8*b)) & 0xff;
+            footer[4+b] = (input >> (8*b)) & 0xff;
+        }
+        out.write(std::string_view(reinterpret_cast<char*>(compressed.data()), size));
+
+        compressedOffset += size;
+        uncompressedOffset += input;
+        blockOffsets.push_back(std::make_pair(compressedOffset, uncompressedOffset));
+        pending.remove_prefix(input);
+    }
+    block.clear();
+}
+
+bool BgzfWriter::close(){
+    if (!closed){
+        compress_block();
+        //empty block marking the end of the file
+        static const unsigned char eof[28] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        out.write(std::string_view(reinterpret_cast<const char*>(eof), sizeof(eof)));
+        ok = out.close() && ok;
+        closed = true;
+    }
+    return ok;
+}
+
+/**
+ * @brief Writes the index of the blocks in the format of bgzip -i: the number of entries, then the compressed and uncompressed offsets of each
+ * block but the first, as little-endian 64-bit integers
+ *
+ * @param file the .gzi file
+ * @return false if the file cannot be written
+ */
+bool BgzfWriter::write_gzi(std::string file){
+    BufferedWriter gzi (file);
+    auto write_number = [&](uint64_t number){
+        char bytes[8];
+        for (int b = 0 ; b < 8 ; b++){
+            bytes[b] = (number >> (8*b)) & 0xff;
+        }
+        gzi.write(std::string_view(bytes, 8));
+    };
+    write_number(blockOffsets.size());
+    for (auto &offsets : blockOffsets){
+        write_number(offsets.first);
+        write_number(offsets.second);
+    }
+    return gzi.close();
+}
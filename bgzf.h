@@ -0,0 +1,83 @@
+#ifndef BGZF_H
+#define BGZF_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <zlib.h>
+
+#include "buffered_writer.h"
+
+bool is_bgzf(std::string file);
+bool inflate_bgzf_block(z_stream &strm, const unsigned char* data, size_t size, std::vector<unsigned char> &out);
+size_t bgzf_block_size(const unsigned char* header, size_t available);
+
+/**
+ * @brief Reader of BGZF files (the blocked gzip format used by BAM and bgzip), needs only zlib.
+ * Supports sequential reading and seeking to virtual offsets (compressed offset of the block << 16 | offset in the block)
+ */
+class BgzfReader{
+
+public :
+    BgzfReader(std::string file);
+    ~BgzfReader();
+    BgzfReader(const BgzfReader&) = delete;
+    BgzfReader& operator=(const BgzfReader&) = delete;
+
+    bool good();
+    size_t read(void* dest, size_t length); //returns the number of bytes read, smaller than length only at the end of the file
+    bool read_exactly(void* dest, size_t length);
+    uint64_t tell();
+    void seek(uint64_t virtualOffset);
+
+    uint64_t block_address(); //compressed offset of the block being read
+    uint64_t uncompressed_bytes_read();
+
+private :
+    bool load_block(uint64_t address); //returns false at the end of the file
+
+    int fd;
+    z_stream strm;
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> block;
+    uint64_t blockAddress;
+    uint64_t nextBlockAddress;
+    size_t posInBlock;
+    uint64_t totalRead;
+    bool endOfFile;
+};
+
+/**
+ * @brief Writer of BGZF files, readable by BgzfReader, bgzip, samtools and htslib. The offsets of the blocks can be written as a .gzi index,
+ * as bgzip -i does, for samtools faidx to read bgzipped FASTA files
+ */
+class BgzfWriter{
+
+public :
+    BgzfWriter(std::string file, int level = Z_DEFAULT_COMPRESSION);
+    ~BgzfWriter();
+    BgzfWriter(const BgzfWriter&) = delete;
+    BgzfWriter& operator=(const BgzfWriter&) = delete;
+
+    bool good() const {return ok && out.good();}
+    void write(std::string_view text);
+    uint64_t uncompressed_bytes_written() const {return uncompressedOffset + block.size();}
+
+    bool close(); //compresses the last block and writes the end of file marker, returns good()
+    bool write_gzi(std::string file); //after close()
+
+private :
+    void compress_block();
+
+    BufferedWriter out;
+    z_stream strm;
+    bool ok;
+    bool closed;
+    std::string block;
+    std::vector<unsigned char> compressed;
+    uint64_t compressedOffset;
+    uint64_t uncompressedOffset;
+    std::vector<std::pair<uint64_t, uint64_t>> blockOffsets; //compressed and uncompressed offsets of the beginning of each block but the first
+};
+
+#endif
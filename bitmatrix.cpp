@@ -0,0 +1,223 @@
+#include "bitmatrix.h"
+#include "cpu_dispatch.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+#ifdef __AVX2__
+//number of 1s of each 64-bit lane
+static inline __m256i popcount_256(__m256i v){
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+    return _mm256_popcnt_epi64(v);
+#else
+    //nibble lookup table, then sum of the bytes of each lane
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, lowNibbles));
+    __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+#endif
+}
+
+static inline __m256i load(const uint64_t* p){
+    return _mm256_loadu_si256((const __m256i*) p);
+}
+#endif
+
+/**
+ * @brief Sums the popcount of a combination of words, 4 words at a time with AVX2. In a portable build (no __AVX2__ here), the kernels
+ * below are MULTIVERSIONED instead: the scalar loop gets the POPCNT instruction, and is vectorized with the AVX-512 vector popcount
+ *
+ * @param words number of words
+ * @param vectorized combination of 4 words starting at a given word, as a __m256i
+ * @param scalar combination of one word
+ */
+template <class Vectorized, class Scalar>
+static inline uint64_t popcount_of(size_t words, Vectorized vectorized, Scalar scalar){
+    uint64_t total = 0;
+    size_t w = 0;
+#ifdef __AVX2__
+    __m256i sums = _mm256_setzero_si256();
+    for ( ; w+4 <= words ; w += 4){
+        sums = _mm256_add_epi64(sums, popcount_256(vectorized(w)));
+    }
+    total = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+#else
+    (void) vectorized;
+#endif
+    for ( ; w < words ; w++){
+        total += __builtin_popcountll(scalar(w));
+    }
+    return total;
+}
+
+#ifdef __AVX2__
+#define VECTORIZED(expression) [&](size_t w){return expression;}
+#else
+#define VECTORIZED(expression) 0
+#endif
+
+MULTIVERSIONED uint64_t popcount_and(const uint64_t* a, const uint64_t* b, size_t words){
+    return popcount_of(words,
+        VECTORIZED(_mm256_and_si256(load(a+w), load(b+w))),
+        [&](size_t w){return a[w] & b[w];});
+}
+
+MULTIVERSIONED uint64_t popcount_andnot_and(const uint64_t* a, const uint64_t* b, const uint64_t* c, size_t words){
+    return popcount_of(words,
+        VECTORIZED(_mm256_and_si256(_mm256_andnot_si256(load(a+w), load(b+w)), load(c+w))),
+        [&](size_t w){return ~a[w] & b[w] & c[w];});
+}
+
+MULTIVERSIONED uint64_t popcount_difference(const uint64_t* a1, const uint64_t* b1, const uint64_t* a2, const uint64_t* b2, size_t words){
+    return popcount_of(words,
+        VECTORIZED(_mm256_or_si256(_mm256_xor_si256(load(a1+w), load(a2+w)), _mm256_xor_si256(load(b1+w), load(b2+w)))),
+        [&](size_t w){return (a1[w] ^ a2[w]) | (b1[w] ^ b2[w]);});
+}
+
+MULTIVERSIONED uint64_t popcount_mismatches(const uint64_t* ones1, const uint64_t* known1, const uint64_t* ones2, const uint64_t* known2, size_t words){
+    return popcount_of(words,
+        VECTORIZED(_mm256_and_si256(_mm256_xor_si256(load(ones1+w), load(ones2+w)), _mm256_and_si256(load(known1+w), load(known2+w)))),
+        [&](size_t w){return (ones1[w] ^ ones2[w]) & known1[w] & known2[w];});
+}
+
+#undef VECTORIZED
+
+BitMatrix::BitMatrix() : m(0), n(0), words(0){
+}
+
+/**
+ * @brief Packs a matrix
+ *
+ * @param matrix row-major m x n matrix of 1, 0 and -1 (missing)
+ * @param m number of rows
+ * @param n number of columns
+ */
+BitMatrix::BitMatrix(const int8_t* matrix, int m, int n) : m(m), n(n), words((n+63)/64){
+    ones_.assign(m*words, 0);
+    known_.assign(m*words, 0);
+    for (int r = 0 ; r < m ; r++){
+        for (int c = 0 ; c < n ; c++){
+            int8_t v = matrix[(size_t) r*n+c];
+            uint64_t bit = uint64_t(1) << (c%64);
+            if (v == 1){
+                ones_[r*words+c/64] |= bit;
+            }
+            if (v != -1){
+                known_[r*words+c/64] |= bit;
+            }
+        }
+    }
+}
+
+int BitMatrix::value(int row, int col) const{
+    uint64_t bit = uint64_t(1) << (col%64);
+    if ((known(row)[col/64] & bit) == 0){
+        return -1;
+    }
+    return (ones(row)[col/64] & bit) ? 1 : 0;
+}
+
+BitMatrix BitMatrix::transposed() const{
+    BitMatrix t;
+    t.m = n;
+    t.n = m;
+    t.words = (m+63)/64;
+    t.ones_.assign(t.m*t.words, 0);
+    t.known_.assign(t.m*t.words, 0);
+    for (int r = 0 ; r < m ; r++){
+        for (size_t w = 0 ; w < words ; w++){
+            //only visit the set bits
+            for (uint64_t bits = ones(r)[w] ; bits ; bits &= bits-1){
+                int c = w*64 + __builtin_ctzll(bits);
+                t.ones_[c*t.words+r/64] |= uint64_t(1) << (r%64);
+            }
+            for (uint64_t bits = known(r)[w] ; bits ; bits &= bits-1){
+                int c = w*64 + __builtin_ctzll(bits);
+                t.known_[c*t.words+r/64] |= uint64_t(1) << (r%64);
+            }
+        }
+    }
+    return t;
+}
+
+std::vector<uint64_t> BitMatrix::mask_of(const int* indices, int nbIndices) const{
+    vector<uint64_t> mask (words, 0);
+    for (int i = 0 ; i < nbIndices ; i++){
+        mask[indices[i]/64] |= uint64_t(1) << (indices[i]%64);
+    }
+    return mask;
+}
+
+int BitMatrix::count(int row, const uint64_t* mask, int value) const{
+    if (value == 1){
+        return popcount_and(ones(row), mask, words);
+    }
+    else if (value == 0){
+        return popcount_andnot_and(ones(row), known(row), mask, words);
+    }
+    return popcount_andnot_and(known(row), mask, mask, words);
+}
+
+int BitMatrix::hamming(int row, const BitMatrix &other, int otherRow) const{
+    return popcount_difference(ones(row), known(row), other.ones(otherRow), other.known(otherRow), words);
+}
+
+/**
+ * @brief Computes the 2D prefix sums of the 1s of the reordered matrix
+ *
+ * @param matrix the matrix
+ * @param rowsOrder order of the rows, e.g. by decreasing number of 1s
+ * @param colsOrder order of the columns
+ */
+RectangleSums::RectangleSums(const BitMatrix &matrix, const std::vector<int> &rowsOrder, const std::vector<int> &colsOrder) : n(colsOrder.size()){
+    int m = rowsOrder.size();
+    prefix.assign((size_t) (m+1)*(n+1), 0);
+    for (int i = 0 ; i < m ; i++){
+        const uint64_t* ones = matrix.ones(rowsOrder[i]);
+        long long onesInRow = 0;
+        for (int j = 0 ; j < n ; j++){
+            onesInRow += (ones[colsOrder[j]/64] >> (colsOrder[j]%64)) & 1;
+            prefix[(size_t) (i+1)*(n+1)+j+1] = prefix[(size_t) i*(n+1)+j+1] + onesInRow;
+        }
+    }
+}
+
+PackedMatrix* sm_bitmatrix_new(const int8_t* matrix, int m, int n){
+    PackedMatrix* packed = new PackedMatrix();
+    packed->byRow = BitMatrix(matrix, m, n);
+    packed->byCol = packed->byRow.transposed();
+    return packed;
+}
+
+void sm_bitmatrix_free(PackedMatrix* matrix){
+    delete matrix;
+}
+
+void sm_bitmatrix_count(const PackedMatrix* matrix, const int* rows, int nbRows, const int* cols, int nbCols, int value, int axis, int* out){
+    if (axis == 1){
+        vector<uint64_t> mask = matrix->byRow.mask_of(cols, nbCols);
+        for (int r = 0 ; r < nbRows ; r++){
+            out[r] = matrix->byRow.count(rows[r], mask.data(), value);
+        }
+    }
+    else{
+        vector<uint64_t> mask = matrix->byCol.mask_of(rows, nbRows);
+        for (int c = 0 ; c < nbCols ; c++){
+            out[c] = matrix->byCol.count(cols[c], mask.data(), value);
+        }
+    }
+}
+
+void sm_bitmatrix_hamming(const PackedMatrix* reads, const PackedMatrix* centroids, int* out){
+    const BitMatrix &r = reads->byRow;
+    const BitMatrix &c = centroids->byRow;
+    for (int i = 0 ; i < r.rows() ; i++){
+        for (int j = 0 ; j < c.rows() ; j++){
+            out[(size_t) i*c.rows()+j] = r.hamming(i, c, j);
+        }
+    }
+}
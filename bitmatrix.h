@@ -0,0 +1,74 @@
+#ifndef BITMATRIX_H
+#define BITMATRIX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A matrix of 1/0/missing, stored as two bitplanes: the 1s and the known (non-missing) entries.
+ * Each line is padded to a whole number of 64-bit words, the padding bits being 0 in both planes
+ */
+class BitMatrix{
+
+public :
+    BitMatrix();
+    BitMatrix(const int8_t* matrix, int m, int n); //row-major matrix of 1, 0 and -1 (missing)
+
+    int rows() const {return m;}
+    int cols() const {return n;}
+    size_t words_per_row() const {return words;}
+    const uint64_t* ones(int row) const {return ones_.data() + row*words;}
+    const uint64_t* known(int row) const {return known_.data() + row*words;}
+    int value(int row, int col) const; //1, 0 or -1
+
+    BitMatrix transposed() const;
+    std::vector<uint64_t> mask_of(const int* indices, int nbIndices) const; //mask of a subset of the columns
+
+    int count(int row, const uint64_t* mask, int value) const; //entries of the row equal to value among the columns of the mask
+    int hamming(int row, const BitMatrix &other, int otherRow) const; //positions where the two rows differ, missing being a value of its own
+
+private :
+    int m;
+    int n;
+    size_t words;
+    std::vector<uint64_t> ones_;
+    std::vector<uint64_t> known_;
+};
+
+/**
+ * @brief Number of 1s of the top-left rectangles of a matrix whose rows and columns have been reordered, in O(1) with 2D prefix sums
+ */
+class RectangleSums{
+
+public :
+    RectangleSums(const BitMatrix &matrix, const std::vector<int> &rowsOrder, const std::vector<int> &colsOrder);
+    long long sum(int x, int y) const {return prefix[(size_t) x*(n+1)+y];} //1s in the first x rows and first y columns of the orders
+
+private :
+    int n;
+    std::vector<long long> prefix;
+};
+
+uint64_t popcount_and(const uint64_t* a, const uint64_t* b, size_t words); //popcount of a & b
+uint64_t popcount_andnot_and(const uint64_t* a, const uint64_t* b, const uint64_t* c, size_t words); //popcount of ~a & b & c
+uint64_t popcount_difference(const uint64_t* a1, const uint64_t* b1, const uint64_t* a2, const uint64_t* b2, size_t words); //popcount of (a1 ^ a2) | (b1 ^ b2)
+uint64_t popcount_mismatches(const uint64_t* ones1, const uint64_t* known1, const uint64_t* ones2, const uint64_t* known2, size_t words); //positions known in both lines where they differ
+
+//matrix handled by strainminer.py, packed by row and by column to count along both axes
+struct PackedMatrix{
+    BitMatrix byRow;
+    BitMatrix byCol;
+};
+
+//C interface, loaded with ctypes from strainminer.py. rows and cols are lists of indices of the matrix
+extern "C" {
+    PackedMatrix* sm_bitmatrix_new(const int8_t* matrix, int m, int n);
+    void sm_bitmatrix_free(PackedMatrix* matrix);
+    //entries equal to value of the submatrix rows x cols: per column if axis == 0 (out has nbCols integers), per row if axis == 1 (out has nbRows integers)
+    void sm_bitmatrix_count(const PackedMatrix* matrix, const int* rows, int nbRows, const int* cols, int nbCols, int value, int axis, int* out);
+    //number of differing positions between each row of reads and each row of centroids, out is a row-major matrix with one row per read
+    void sm_bitmatrix_hamming(const PackedMatrix* reads, const PackedMatrix* centroids, int* out);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "buffered_writer.h"
+
+#include <cstring>
+#include <charconv>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+using std::string;
+using std::string_view;
+
+BufferedWriter::BufferedWriter(string file, size_t capacity) : ok(true), buffer(capacity), used(0){
+    fd = (file == "-") ? dup(STDOUT_FILENO) : open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ok = fd >= 0;
+}
+
+BufferedWriter::~BufferedWriter(){
+    close();
+}
+
+void BufferedWriter::flush(string_view extra){
+    struct iovec pieces[2] = {{buffer.data(), used}, {const_cast<char*>(extra.data()), extra.size()}};
+    int first = 0;
+    while (ok && first < 2){
+        if (pieces[first].iov_len == 0){
+            first++;
+            continue;
+        }
+        ssize_t written = writev(fd, pieces+first, 2-first);
+        if (written < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        //advance in the pieces by what was written
+        while (written > 0 && first < 2){
+            size_t done = std::min((size_t) written, pieces[first].iov_len);
+            pieces[first].iov_base = static_cast<char*>(pieces[first].iov_base) + done;
+            pieces[first].iov_len -= done;
+            written -= done;
+            if (pieces[first].iov_len == 0){
+                first++;
+            }
+        }
+    }
+    used = 0;
+}
+
+void BufferedWriter::write(string_view text){
+    if (used + text.size() <= buffer.size()){
+        memcpy(buffer.data()+used, text.data(), text.size());
+        used += text.size();
+    }
+    else if (text.size() <= buffer.size()){
+        flush();
+        memcpy(buffer.data(), text.data(), text.size());
+        used = text.size();
+    }
+    else{
+        flush(text);
+    }
+}
+
+void BufferedWriter::write(char c){
+    if (used == buffer.size()){
+        flush();
+    }
+    buffer[used++] = c;
+}
+
+char* BufferedWriter::append(size_t size){
+    if (used + size > buffer.size()){
+        flush();
+    }
+    char* room = buffer.data()+used;
+    used += size;
+    return room;
+}
+
+bool BufferedWriter::close(){
+    if (fd >= 0){
+        flush();
+        if (::close(fd) != 0){
+            ok = false;
+        }
+        fd = -1;
+    }
+    return ok;
+}
+
+BufferedWriter& operator<<(BufferedWriter &out, string_view text){
+    out.write(text);
+    return out;
+}
+
+BufferedWriter& operator<<(BufferedWriter &out, char c){
+    out.write(c);
+    return out;
+}
+
+BufferedWriter& operator<<(BufferedWriter &out, long long number){
+    char digits[24];
+    auto end = std::to_chars(digits, digits+sizeof(digits), number).ptr;
+    out.write(string_view(digits, end-digits));
+    return out;
+}
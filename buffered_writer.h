@@ -0,0 +1,47 @@
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Output file written through a large buffer. A piece longer than the buffer is written with writev, behind what is buffered, without being copied.
+ * The file "-" is the standard output
+ */
+class BufferedWriter{
+
+public :
+    BufferedWriter(std::string file, size_t capacity = 1 << 22);
+    ~BufferedWriter();
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    bool good() const {return ok;} //false if the file could not be opened or written
+
+    void write(std::string_view text);
+    void write(char c);
+    char* append(size_t size); //room for size (at most the capacity) characters, to be filled by the caller
+    size_t capacity() const {return buffer.size();}
+
+    bool close(); //flushes the buffer, returns good()
+
+private :
+    void flush(std::string_view extra = std::string_view());
+
+    int fd;
+    bool ok;
+    std::vector<char> buffer;
+    size_t used;
+};
+
+BufferedWriter& operator<<(BufferedWriter &out, std::string_view text);
+BufferedWriter& operator<<(BufferedWriter &out, char c);
+BufferedWriter& operator<<(BufferedWriter &out, long long number);
+inline BufferedWriter& operator<<(BufferedWriter &out, const std::string &text) {return out << std::string_view(text);}
+inline BufferedWriter& operator<<(BufferedWriter &out, const char* text) {return out << std::string_view(text);}
+inline BufferedWriter& operator<<(BufferedWriter &out, int number) {return out << (long long) number;}
+inline BufferedWriter& operator<<(BufferedWriter &out, long int number) {return out << (long long) number;}
+inline BufferedWriter& operator<<(BufferedWriter &out, unsigned long int number) {return out << (long long) number;}
+
+#endif
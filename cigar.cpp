@@ -0,0 +1,114 @@
+#include "cigar.h"
+#include "bam.h"
+
+#include <stdexcept>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+//operation code of each letter of a CIGAR, -1 if the letter is not an operation
+static int cigar_op_code(char c){
+    switch (c){
+        case 'M': return BAM_CMATCH;
+        case 'I': return BAM_CINS;
+        case 'D': return BAM_CDEL;
+        case 'N': return BAM_CREF_SKIP;
+        case 'S': return BAM_CSOFT_CLIP;
+        case 'H': return BAM_CHARD_CLIP;
+        case 'P': return BAM_CPAD;
+        case '=': return BAM_CEQUAL;
+        case 'X': return BAM_CDIFF;
+        default: return -1;
+    }
+}
+
+CigarArena::CigarArena(){
+}
+
+/**
+ * @brief Packs a text CIGAR
+ *
+ * @param cigar the CIGAR, e.g. 5M1I3M. "*" gives an empty CIGAR
+ * @param ops filled with the packed operations
+ * @return number of operations
+ */
+uint32_t pack_cigar(std::string_view cigar, std::vector<uint32_t> &ops){
+    ops.clear();
+    uint32_t number = 0;
+    for (char c : cigar){
+        if (c >= '0' && c <= '9'){
+            number = 10*number + (c-'0');
+            continue;
+        }
+        int code = cigar_op_code(c);
+        if (code < 0){
+            if (c == '*'){
+                continue;
+            }
+            throw std::invalid_argument("Invalid CIGAR: " + string(cigar));
+        }
+        ops.push_back(number << 4 | code);
+        number = 0;
+    }
+    return ops.size();
+}
+
+uint64_t CigarArena::add(const uint32_t* ops, uint32_t nbOps){
+    uint64_t offset = ops_.size();
+    ops_.insert(ops_.end(), ops, ops+nbOps);
+    return offset;
+}
+
+const uint32_t* CigarArena::ops(uint64_t offset) const{
+    return ops_.data() + offset;
+}
+
+uint64_t CigarArena::size() const{
+    return ops_.size();
+}
+
+void CigarArena::shrink_to_fit(){
+    ops_.shrink_to_fit();
+}
+
+std::string CigarArena::str(uint64_t offset, uint32_t nbOps) const{
+    string res;
+    for (CigarCursor c (*this, offset, nbOps) ; !c.done() ; c.next()){
+        res += std::to_string(c.length());
+        res += c.op();
+    }
+    return res;
+}
+
+CigarCursor::CigarCursor(const uint32_t* ops, uint32_t nbOps) : current(ops), end(ops+nbOps){
+}
+
+CigarCursor::CigarCursor(const CigarArena &arena, uint64_t offset, uint32_t nbOps) : current(arena.ops(offset)), end(arena.ops(offset)+nbOps){
+}
+
+bool CigarCursor::done() const{
+    return current >= end;
+}
+
+void CigarCursor::next(){
+    current++;
+}
+
+char CigarCursor::op() const{
+    return BAM_CIGAR_CHARS[*current & 0xF];
+}
+
+uint32_t CigarCursor::length() const{
+    return *current >> 4;
+}
+
+bool CigarCursor::consumes_read() const{
+    int code = *current & 0xF;
+    return code == BAM_CMATCH || code == BAM_CINS || code == BAM_CSOFT_CLIP || code == BAM_CEQUAL || code == BAM_CDIFF;
+}
+
+bool CigarCursor::consumes_reference() const{
+    int code = *current & 0xF;
+    return code == BAM_CMATCH || code == BAM_CDEL || code == BAM_CREF_SKIP || code == BAM_CEQUAL || code == BAM_CDIFF;
+}
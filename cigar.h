@@ -0,0 +1,53 @@
+#ifndef CIGAR_H
+#define CIGAR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Stores the CIGARs of many alignments back to back, packed as in BAM files (length << 4 | operation), see BAM_C* in bam.h
+ */
+class CigarArena{
+
+public :
+    CigarArena();
+
+    uint64_t add(const uint32_t* ops, uint32_t nbOps); //returns the offset where ops are stored
+
+    const uint32_t* ops(uint64_t offset) const;
+    uint64_t size() const; //total number of operations stored
+    void shrink_to_fit();
+
+    std::string str(uint64_t offset, uint32_t nbOps) const; //text CIGAR
+
+private :
+    std::vector<uint32_t> ops_;
+};
+
+uint32_t pack_cigar(std::string_view cigar, std::vector<uint32_t> &ops); //parses a text CIGAR (e.g. 5M1I3M) into ops, returns the number of operations
+
+/**
+ * @brief Walks the operations of a packed CIGAR
+ */
+class CigarCursor{
+
+public :
+    CigarCursor(const uint32_t* ops, uint32_t nbOps);
+    CigarCursor(const CigarArena &arena, uint64_t offset, uint32_t nbOps);
+
+    bool done() const;
+    void next();
+    char op() const; //operation as a letter of MIDNSHP=X
+    uint32_t length() const;
+
+    bool consumes_read() const; //M, I, S, = and X
+    bool consumes_reference() const; //M, D, N, = and X
+
+private :
+    const uint32_t* current;
+    const uint32_t* end;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "contig_cache.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+using std::string;
+using std::string_view;
+
+ContentHash::ContentHash() : h1(0xcbf29ce484222325ULL), h2(0x9e3779b97f4a7c15ULL){
+}
+
+void ContentHash::add(const void* data, size_t size){
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0 ; i < size ; i++){
+        h1 = (h1 ^ bytes[i]) * 0x100000001b3ULL; //FNV-1a
+        h2 = (h2 + bytes[i] + 1) * 0xff51afd7ed558ccdULL;
+        h2 ^= h2 >> 29;
+    }
+}
+
+void ContentHash::add(string_view text){
+    uint64_t length = text.size();
+    add_value(length);
+    add(text.data(), text.size());
+}
+
+string ContentHash::hex() const{
+    char buffer[33];
+    snprintf(buffer, sizeof(buffer), "%016llx%016llx", (unsigned long long) h1, (unsigned long long) h2);
+    return string(buffer);
+}
+
+ContigCache::ContigCache(string folder, string extension) : folder(folder), extension(extension){
+    struct stat info;
+    isEnabled = stat(folder.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+string ContigCache::path(const string &key) const{
+    return folder + "/" + key + extension;
+}
+
+bool ContigCache::load(const string &key, string &content) const{
+    if (!isEnabled){
+        return false;
+    }
+    std::ifstream in (path(key), std::ios::binary);
+    if (!in.is_open()){
+        return false;
+    }
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+void ContigCache::store(const string &key, const string &content) const{
+    if (!isEnabled){
+        return;
+    }
+    string temporary = path(key) + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(omp_get_thread_num());
+    std::ofstream out (temporary, std::ios::binary);
+    out.write(content.data(), content.size());
+    out.close();
+    if (!out || rename(temporary.c_str(), path(key).c_str()) != 0){ //the cache is only an optimization: a failure just means the contig will be recomputed
+        remove(temporary.c_str());
+    }
+}
+
+void put_varint(string &out, uint64_t value){
+    while (value >= 0x80){
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+void put_string(string &out, string_view text){
+    put_varint(out, text.size());
+    out.append(text.data(), text.size());
+}
+
+void put_double(string &out, double value){
+    char bytes[8];
+    memcpy(bytes, &value, 8);
+    out.append(bytes, 8);
+}
+
+CacheReader::CacheReader(string_view content) : content(content), pos(0), ok(true){
+}
+
+bool CacheReader::varint(uint64_t &value){
+    value = 0;
+    for (int shift = 0 ; ok && pos < content.size() && shift < 64 ; shift += 7){
+        uint8_t byte = content[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0){
+            return true;
+        }
+    }
+    ok = false;
+    return false;
+}
+
+bool CacheReader::text(string &value){
+    uint64_t length;
+    if (!varint(length) || length > content.size()-pos){
+        ok = false;
+        return false;
+    }
+    value.assign(content.data()+pos, length);
+    pos += length;
+    return true;
+}
+
+bool CacheReader::real(double &value){
+    if (!ok || content.size()-pos < 8){
+        ok = false;
+        return false;
+    }
+    memcpy(&value, content.data()+pos, 8);
+    pos += 8;
+    return true;
+}
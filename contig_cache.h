@@ -0,0 +1,73 @@
+#ifndef CONTIG_CACHE_H
+#define CONTIG_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/**
+ * @brief 128-bit hash of a content given piece by piece, used as the name of a cache entry
+ */
+class ContentHash{
+
+public :
+    ContentHash();
+
+    void add(const void* data, size_t size);
+    void add(std::string_view text); //also hashes the length, so that consecutive strings cannot be confused
+    template <typename T> void add_value(const T &value) {add(&value, sizeof(value));}
+
+    std::string hex() const;
+
+private :
+    uint64_t h1;
+    uint64_t h2;
+};
+
+/**
+ * @brief Folder of results computed on one contig, named after the hash of everything they depend on so that a rerun
+ * only recomputes the contigs whose input or parameters changed. The cache is used only if the folder exists
+ */
+class ContigCache{
+
+public :
+    ContigCache(std::string folder, std::string extension);
+
+    bool enabled() const {return isEnabled;}
+    bool load(const std::string &key, std::string &content) const; //false if there is no entry
+    void store(const std::string &key, const std::string &content) const; //written in a temporary file then renamed, so that an interrupted run does not leave a truncated entry
+
+private :
+    std::string path(const std::string &key) const;
+
+    std::string folder;
+    std::string extension;
+    bool isEnabled;
+};
+
+//encoding of the entries: LEB128 varints, strings as a varint length followed by the characters
+void put_varint(std::string &out, uint64_t value);
+void put_string(std::string &out, std::string_view text);
+void put_double(std::string &out, double value);
+
+/**
+ * @brief Decodes an entry written with put_varint, put_string and put_double. After the first failure, everything fails
+ */
+class CacheReader{
+
+public :
+    CacheReader(std::string_view content);
+
+    bool varint(uint64_t &value);
+    bool text(std::string &value);
+    bool real(double &value);
+    bool good() const {return ok;}
+    bool done() const {return ok && pos == content.size();}
+
+private :
+    std::string_view content;
+    size_t pos;
+    bool ok;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+/**
+ * @brief MULTIVERSIONED compiles a function once for each x86-64 level (SSE4.2 and POPCNT, AVX2, AVX-512, AVX-512 with the vector popcount
+ * of Ice Lake) on top of the baseline, and the version run is chosen for the CPU when the program starts (GCC function multiversioning).
+ * It is on when the project is built with -DDISPATCH=ON, the default, see CMakeLists.txt. It is empty on other architectures: on aarch64,
+ * NEON is part of the baseline, and for builds with -DNATIVE=ON, where the whole program is compiled for the CPU of the machine
+ */
+#if defined(STRAINMINER_DISPATCH) && defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define MULTIVERSIONED __attribute__((target_clones("arch=icelake-server", "arch=x86-64-v4", "arch=x86-64-v3", "arch=x86-64-v2", "default")))
+#else
+#define MULTIVERSIONED
+#endif
+
+#endif
@@ -4,10 +4,15 @@
 #include <fstream>
 #include <omp.h>
 #include <tuple>
+#include <atomic>
+#include <numeric> //for "iota"
 #include "input_output.h"
 #include "tools.h"
+#include "aligner.h"
+#include "contig_cache.h"
+#include "read_paths.h"
+#include "buffered_writer.h"
 // #include "reassemble_unaligned_reads.h"
-#include "edlib/include/edlib.h"
 
 using std::string;
 using std::cout;
@@ -30,7 +35,7 @@ using std::get; //in tuple
 using std::ofstream;
 
 /**
- * @brief Parse the file containing the partitions of the reads
+ * @brief Parse the file containing the partitions of the reads (binary or text .gro)
  * 
  * @param file 
  * @param allreads 
@@ -41,7 +46,7 @@ void parse_split_file(
     std::string& file, 
     std::vector <Read> &allreads,
     std::vector <Overlap> &allOverlaps,
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int> > > > &partitions){
+    Partitions &partitions){
 
     robin_hood::unordered_map<std::string, int> name_of_contigs;
     for (int i = 0 ; i < allreads.size() ; i++){
@@ -49,37 +54,26 @@ void parse_split_file(
     }
 
     //open the file
-    std::ifstream infile(file);
-    if (!infile.good()){
+    SplitFileReader reader (file);
+    if (!reader.good()){
         cerr << "ERROR: could not open file " << file << endl;
         exit(1);
     }
 
     //read the file
-    string line;
     long int contig;
     
     std::unordered_map<string, int> name_of_neighbors;
-    vector<string> list_of_read_names;
-    while (std::getline(infile, line)){
-        //read the first field of the line
-        std::istringstream iss(line);
-        string category;
-        iss >> category;
-        if (category == "CONTIG"){
+    vector<int> neighbor_of_read; //for each READ of the contig, its index among the neighbors of the contig, -1 if it is not one
+    SplitRecord record;
+    while (reader.next(record)){
+        if (record.type == SPLIT_CONTIG){
             //reset the variables
             name_of_neighbors.clear();
-            list_of_read_names.clear();
+            neighbor_of_read.clear();
 
-            //parse the name of the contig
-            string contigName;
-            iss >> contigName;
-
-            contig = name_of_contigs[contigName];
-            int length;
-            double depth;
-            iss >> length >> depth;
-            allreads[contig].depth = depth;
+            contig = name_of_contigs[string(record.name)];
+            allreads[contig].depth = record.depth;
             partitions[contig] = {};
 
             //go through the neigbors and inventoriate their names
@@ -89,116 +83,346 @@ void parse_split_file(
                 name_of_neighbors[neighborName] = n;
             }
         }
-        else if (category == "READ"){
-            //parse the name of the read
-            string readName;
-            int startRead, endRead, startContig, endContig;
-            bool strand;
-            iss >> readName >> startRead >> endRead >> startContig >> endContig >> strand;
-            list_of_read_names.push_back(readName);
-            long int read = name_of_contigs[readName];
-            //add the overlap between the read and the contig (if strand != -1)
-            // if (strand != -1){
-            //     int overlap = allOverlaps.size();
-            //     Overlap o;
-            //     o.sequence1 = read;
-            //     o.sequence2 = contig;
-            //     o.position_1_1 = startRead;
-            //     o.position_1_2 = endRead;
-            //     o.position_2_1 = startContig;
-            //     o.position_2_2 = endContig;
-            //     o.strand = strand;
-
-            //     allOverlaps.push_back(o);
-
-            //     allreads[read].add_overlap(overlap);
-            //     allreads[contig].add_overlap(overlap);
-            // }
+        else if (record.type == SPLIT_READ){
+            auto neighbor = name_of_neighbors.find(string(record.name));
+            neighbor_of_read.push_back(neighbor == name_of_neighbors.end() ? -1 : neighbor->second); //reads whose overlap was discarded in read_SAM are not neighbors
         }
-        else if (category == "GROUP"){
-            //parse the coordinates of the group
-            int start, end;
-            iss >> start >> end;
-
-            //parse the index of reads present there
-            std::vector<int> readIdxs;
-            string readIdxsString;
-            string partitionString;
-            iss >> readIdxsString >> partitionString;
-            // readIdxsString is a comma-separated list of integers
-            std::istringstream iss2(readIdxsString);
-            string number;
-
-            // cout << "readIdxsString " << readIdxsString << endl;
-            // cout << "partitionString " << partitionString << endl;
-            
-            if (readIdxsString != "," && partitionString != ","){
-
-                while (std::getline(iss2, number, ',')){
-                    readIdxs.push_back(std::stoi(number));
+        else if (record.type == SPLIT_GROUP && !record.skipped){
+            //to spare memory, only the reads that are assigned are stored, all the others are -2
+            vector<pair<int,int>> labels;
+            for (auto readAndLabel : record.labels){
+                if (readAndLabel.first >= 0 && readAndLabel.first < neighbor_of_read.size() && neighbor_of_read[readAndLabel.first] != -1){
+                    labels.push_back(std::make_pair(neighbor_of_read[readAndLabel.first], readAndLabel.second));
                 }
-                
-                //now parse the partition
-                std::vector<int> partition;
+            }
+            std::stable_sort(labels.begin(), labels.end(), [](const pair<int,int> &a, const pair<int,int> &b){return a.first < b.first;});
 
-                // partitionString is a comma-separated list of integers
-                std::istringstream iss3(partitionString);
-                while (std::getline(iss3, number, ',')){
-                    partition.push_back(std::stoi(number));
+            SparsePartition partition (allreads[contig].neighbors_.size());
+            for (int l = 0 ; l < labels.size() ; l++){
+                if (l+1 < labels.size() && labels[l+1].first == labels[l].first){ //the last label given to a neighbor wins
+                    continue;
                 }
+                partition.add(labels[l].first, labels[l].second);
+            }
+            partitions[contig].push_back(std::make_pair(std::make_pair(record.start, record.end), partition));
+        }
+    }
+}
 
-                vector<int> partitions_with_the_minus_2 (allreads[contig].neighbors_.size(), -2); //to spare memory, -2 were not stored in the file, so we need to add them back
-                
-                for (int r = 0 ; r < readIdxs.size() ; r++){
-                    // cout << "list_of_reads_names " << endl;
-                    // for (auto i : list_of_read_names){
-                    //     cout << i << " ";
-                    // }
-                    if (name_of_neighbors.find(list_of_read_names[readIdxs[r]]) != name_of_neighbors.end()){ //this can happen for overlaps that are discarded in read_SAM but were not in the gro file
-                        partitions_with_the_minus_2[ name_of_neighbors[list_of_read_names[readIdxs[r]]]] = partition[r];
+/**
+ * @brief Splits the thread budget between the backbones being processed in parallel and the external tools (minimap2, racon, medaka, samtools) they call
+ * 
+ * @param num_threads total number of threads
+ * @param unfinishedBackbones number of backbones that are not finished yet
+ * @return the number of threads an external tool can use without oversubscribing the machine
+ */
+int threads_for_tools(int num_threads, int unfinishedBackbones){
+    return max(1, num_threads / max(1, min(num_threads, unfinishedBackbones)));
+}
+
+/**
+ * @brief What modify_GFA computes on one backbone in parallel, before the backbone is replaced in the graph
+ */
+struct BackboneResult{
+    bool split = false; //the backbone is replaced by new contigs
+    string log; //text of output.txt
+    vector<vector<pair<int, Read>>> newContigs; //the new contigs of each interval, with the part they come from
+    vector<vector<vector<int>>> stitchedParts; //for each new contig, the parts of the interval on its left it is stitched to
+    vector<string> intervalLogs;
+    Read rightContig; //right of the last interval
+};
+
+/**
+ * @brief Replaces a backbone by its new contigs in the graph. The backbones are replaced one after the other, in their order, so that the graph does not depend on the threads
+ * 
+ * @param allreads the new contigs are appended to it
+ * @param backbones_reads the new contigs are appended to it
+ * @param allLinks the links of the new contigs are appended to it, the links of the backbone are moved to the new contigs
+ * @param backbone the backbone
+ * @param intervals the intervals of the backbone
+ * @param result what was computed on the backbone, its log is completed with the names of the new contigs
+ */
+static void replace_backbone(
+    vector <Read> &allreads,
+    vector<unsigned long int> &backbones_reads,
+    vector<Link> &allLinks,
+    long int backbone,
+    const vector<pair<pair<int,int>, SparsePartition>> &intervals,
+    BackboneResult &result,
+    bool DEBUG){
+
+    //create hangingLinks, a list of links that are not yet connected but will soon be
+    vector<int> hangingLinks;
+    for (int linkIdx : allreads[backbone].get_links_left()){
+        if (allLinks[linkIdx].neighbor1 == backbone && allLinks[linkIdx].end1 == 0){
+            allLinks[linkIdx].end1 = -1;
+        }
+        else {
+            allLinks[linkIdx].end2 = -1;
+        }
+        allLinks[linkIdx].group = 0;
+        hangingLinks.push_back(linkIdx);
+    }
+
+    for (int n = 0 ; n < result.newContigs.size() ; n++){
+        result.log += result.intervalLogs[n];
+        vector<int> futureHangingLinks;
+        for (int c = 0 ; c < result.newContigs[n].size() ; c++){
+            int part = result.newContigs[n][c].first;
+            Read &r = result.newContigs[n][c].second;
+
+            //now create all the links IF they are compatible with "stitches"  
+            set<int> linksToKeep;
+
+            const vector<int> &stitchedParts = result.stitchedParts[n][c];
+            if (stitchedParts.size() == 0){
+                for (int h : hangingLinks){
+                    linksToKeep.emplace(allLinks[h].group);
+                }
+            }
+            else{
+                for (int l : stitchedParts){
+                    linksToKeep.emplace(l);
+                }
+            }
+    
+            //create the links
+            for (int h : hangingLinks){
+                if (linksToKeep.find(allLinks[h].group) != linksToKeep.end()){
+                    Link leftLink;
+                    leftLink.CIGAR = allLinks[h].CIGAR;
+                    if (allLinks[h].end2 == -1){
+                        leftLink.end2 = 0;
+                        leftLink.neighbor2 = allreads.size();
+                        leftLink.end1 = allLinks[h].end1;
+                        leftLink.neighbor1 = allLinks[h].neighbor1;
+                        allreads[leftLink.neighbor1].add_link(allLinks.size(), allLinks[h].end1);
+                    }
+                    else if (allLinks[h].end1 == -1) {
+                        leftLink.end1 = 0;
+                        leftLink.neighbor1 = allreads.size();
+                        leftLink.end2 = allLinks[h].end2;
+                        leftLink.neighbor2 = allLinks[h].neighbor2;
+                        allreads[leftLink.neighbor2].add_link(allLinks.size(), allLinks[h].end2);
                     }
+                    else {
+                        // cout << "WHAAAT" << endl;
+                    }
+                    r.add_link(allLinks.size(), 0);
+                    allLinks.push_back(leftLink);
                 }
-                // int index = 0;
-                // for (int r =  0 ; r < readIdxs.size() ; r++){
-                //     while (index < readIdxs[r]){
-                //         partitions_with_the_minus_2.push_back(-2);
-                //         index++;
-                //     }
-                //     partitions_with_the_minus_2.push_back(partition[r]);
-                //     index++;
-                // }
-                // while (index < allreads[contig].neighbors_.size()){
-                //     partitions_with_the_minus_2.push_back(-2);
-                //     index++;
-                // }
-                //now append to partitions[contig]
-                partitions[contig].push_back(std::make_pair(std::make_pair(start, end), partitions_with_the_minus_2));
             }
+
+            Link rightLink;
+            rightLink.CIGAR = "0M";
+            rightLink.end1 = 1;
+            rightLink.neighbor1 = allreads.size();
+            rightLink.end2 = -1;
+            rightLink.group = part;
+            allLinks.push_back(rightLink);
+            r.add_link(allLinks.size()-1, 1);
+            futureHangingLinks.push_back(allLinks.size()-1);
+
+            allreads.push_back(r);
+            backbones_reads.push_back(allreads.size()-1);
+            if (DEBUG){
+                cout << "created the contig " << r.name << endl;
+            }
+            result.log += "   - " + r.name + "\n";
         }
+        hangingLinks = futureHangingLinks;
     }
+
+    //now wrap up the right of the contig
+    int left = intervals[intervals.size()-1].first.second+1; //rightmost interval
+    Read &r = result.rightContig;
+    for (int h : hangingLinks){
+        Link leftLink;
+        leftLink.CIGAR = allLinks[h].CIGAR;
+        if (allLinks[h].end2 == -1){
+            leftLink.end2 = 0;
+            leftLink.neighbor2 = allreads.size();
+            leftLink.end1 = allLinks[h].end1;
+            leftLink.neighbor1 = allLinks[h].neighbor1;
+            allreads[leftLink.neighbor1].add_link(allLinks.size(), allLinks[h].end1);
+        }
+        else if (allLinks[h].end1 == -1) {
+            leftLink.end1 = 0;
+            leftLink.neighbor1 = allreads.size();
+            leftLink.end2 = allLinks[h].end2;
+            leftLink.neighbor2 = allLinks[h].neighbor2;
+            allreads[leftLink.neighbor2].add_link(allLinks.size(), allLinks[h].end2);
+        }
+        else {
+            // cout << "WHAAAT" << endl;
+        }
+        r.add_link(allLinks.size(), 0);
+        allLinks.push_back(leftLink);
+        
+    }
+
+    //now re-build the links right of backbone
+    for (int linkIdx : allreads[backbone].get_links_right()){
+        if (allLinks[linkIdx].neighbor1 == backbone && allLinks[linkIdx].end1 == 1){
+            allLinks[linkIdx].end1 = 1;
+            allLinks[linkIdx].neighbor1 = allreads.size() ;
+        }
+        else {
+            allLinks[linkIdx].end2 = 1;
+            allLinks[linkIdx].neighbor2 = allreads.size() ;
+        }
+        r.add_link(linkIdx, 1);
+    }
+
+    allreads.push_back(r);
+    backbones_reads.push_back(allreads.size()-1);
+    if (DEBUG){
+        cout << "now creating the different contigs : " << r.name << endl;
+    }
+    result.log += " - Between positions " + to_string(left) + " and " + to_string(allreads[backbone].sequence_.size()) + " of the contig, I've created these contigs:\n";
+    result.log +=  "   - " + r.name + "\n\n";
+
+    allreads[backbone].name = "delete_me"; //output_gfa will understand that and delete the contig
+}
+
+/**
+ * @brief Name of the cache entry of a backbone: hash of the backbone, of the alignments of its reads, of their partitions and of the parameters of the polishing
+ */
+static string backbone_key(
+    vector <Read> &allreads,
+    vector <Overlap> &allOverlaps,
+    CigarArena &allCIGARs,
+    long int backbone,
+    const vector<pair<pair<int,int>, SparsePartition>> &intervals,
+    float errorRate,
+    string &polisher,
+    bool polish,
+    string &techno){
+
+    ContentHash hash;
+    hash.add("backbone 1"); //to change when the new contigs computed from the same input change
+    hash.add(allreads[backbone].name);
+    hash.add(allreads[backbone].sequence_.str());
+    hash.add_value(allreads[backbone].depth);
+    hash.add_value(errorRate);
+    hash.add(polisher);
+    hash.add_value(polish);
+    hash.add(techno);
+    for (auto n : allreads[backbone].neighbors_){
+        const Overlap &overlap = allOverlaps[n];
+        hash.add(allreads[overlap.sequence1].name);
+        hash.add(allreads[overlap.sequence2].name);
+        hash.add_value(overlap.position_1_1);
+        hash.add_value(overlap.position_1_2);
+        hash.add_value(overlap.position_2_1);
+        hash.add_value(overlap.position_2_2);
+        hash.add_value(overlap.strand);
+        hash.add(allCIGARs.ops(overlap.CIGAROffset), overlap.CIGARLength*sizeof(uint32_t));
+    }
+    for (auto &interval : intervals){
+        hash.add_value(interval.first);
+        hash.add_value(interval.second.size());
+        uint64_t nbEntries = interval.second.entries().size();
+        hash.add_value(nbEntries);
+        hash.add(interval.second.entries().data(), nbEntries*sizeof(pair<int,int>));
+    }
+    return hash.hex();
+}
+
+static void put_read(string &out, const Read &r){
+    put_string(out, r.name);
+    put_string(out, r.sequence_.str());
+    put_double(out, r.depth);
+}
+
+static bool get_read(CacheReader &in, Read &r){
+    string name, sequence;
+    double depth;
+    if (!in.text(name) || !in.text(sequence) || !in.real(depth)){
+        return false;
+    }
+    r = Read(sequence, sequence.size());
+    r.name = name;
+    r.depth = depth;
+    return true;
+}
+
+//the new contigs of a backbone, before they are put in the graph
+static string encode_backbone_result(const BackboneResult &result){
+    string out;
+    put_varint(out, result.split);
+    put_string(out, result.log);
+    put_varint(out, result.newContigs.size());
+    for (int n = 0 ; n < result.newContigs.size() ; n++){
+        put_string(out, result.intervalLogs[n]);
+        put_varint(out, result.newContigs[n].size());
+        for (int c = 0 ; c < result.newContigs[n].size() ; c++){
+            put_varint(out, result.newContigs[n][c].first+1); //the part may be -1
+            put_read(out, result.newContigs[n][c].second);
+            put_varint(out, result.stitchedParts[n][c].size());
+            for (int part : result.stitchedParts[n][c]){
+                put_varint(out, part);
+            }
+        }
+    }
+    put_read(out, result.rightContig);
+    return out;
+}
+
+static bool decode_backbone_result(const string &content, BackboneResult &result){
+    CacheReader in (content);
+    uint64_t split, nbIntervals, nbContigs, part, nbStitched, stitched;
+    if (!in.varint(split) || !in.text(result.log) || !in.varint(nbIntervals)){
+        return false;
+    }
+    result.split = split;
+    result.intervalLogs.resize(nbIntervals);
+    result.newContigs.resize(nbIntervals);
+    result.stitchedParts.resize(nbIntervals);
+    for (int n = 0 ; n < nbIntervals && in.good() ; n++){
+        if (!in.text(result.intervalLogs[n]) || !in.varint(nbContigs)){
+            return false;
+        }
+        for (int c = 0 ; c < nbContigs && in.good() ; c++){
+            Read r;
+            if (!in.varint(part) || !get_read(in, r) || !in.varint(nbStitched)){
+                return false;
+            }
+            result.newContigs[n].push_back(make_pair(int(part)-1, r));
+            result.stitchedParts[n].push_back({});
+            for (int s = 0 ; s < nbStitched && in.varint(stitched) ; s++){
+                result.stitchedParts[n][c].push_back(stitched);
+            }
+        }
+    }
+    return get_read(in, result.rightContig) && in.done();
 }
 
 /**
  * @brief Modify the input GFA according to the way the reads have been split.
  * 
- * @param readsFile File containing all the reads
+ * @param readStore loads the sequences of the reads of each backbone from the file containing all the reads
  * @param allreads vector containing all the reads (without their actual sequence)
  * @param backbones_reads vector listing all the backbone reads
  * @param allOverlaps vector containing all the overlaps
+ * @param allCIGARs arena containing the CIGARs of all the overlaps
  * @param partitions for each backbone, contains a vector of the intervals, and for each interval, the partition of the reads
  * @param allLinks vector containing all the links of the GFA file (new one will be added)
  * @param readLimits for each backbone, contains the limits (in term of coordinates) of all its neighbors on the backbone
- * @param num_threads number of threads to use
+ * @param num_threads number of threads to use, shared between the backbones and the external tools
+ * @param profiler collects the time spent on each backbone
  * @param techno technology used to generate the reads (ont, pacbio, hifi)
  */
 void modify_GFA(
-    std::string readsFile, 
+    ReadStore &readStore, 
     vector <Read> &allreads, 
     vector<unsigned long int> &backbones_reads, 
     vector <Overlap> &allOverlaps,
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int> > > > &partitions,
+    CigarArena &allCIGARs,
+    Partitions &partitions,
     vector<Link> &allLinks,
     int num_threads,
+    Profiler &profiler,
     string &outFolder, 
     float errorRate,
     std::string &polisher,
@@ -216,169 +440,138 @@ void modify_GFA(
     int max_backbone = backbones_reads.size(); //fix that because backbones will be added to the list but not separated 
     string log_text = ""; //text that will be printed out in the output.txt
 
-    omp_set_num_threads(num_threads);
-    #pragma omp parallel for
+    //backbones_reads grows with the new contigs during the loop: keep aside the backbones to process
+    vector<unsigned long int> backbones (backbones_reads.begin(), backbones_reads.end());
+    vector<pair<pair<int,int>, SparsePartition>> noIntervals;
+
+    //the backbones with the most aligned bases go first, so that a big backbone does not start last and keep a thread busy alone
+    vector<long long> alignedBases (max_backbone, 0);
     for (int b = 0 ; b < max_backbone ; b++){
+        for (auto n : allreads[backbones[b]].neighbors_){
+            alignedBases[b] += allOverlaps[n].position_1_2 - allOverlaps[n].position_1_1;
+        }
+    }
+    vector<int> order (max_backbone);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){return alignedBases[a] > alignedBases[b];});
 
-        //first load all the reads
-        #pragma omp critical
-        {
-            parse_reads_on_contig(readsFile, backbones_reads[b], allOverlaps, allreads);
+    //the threads do not touch the graph: each backbone gets its new contigs, which are put in the graph after the parallel loop
+    vector<BackboneResult> results (max_backbone);
+
+    //when fewer backbones than threads remain, the idle threads are given to the external tools
+    std::atomic<int> unfinishedBackbones (max_backbone);
+
+    //the new contigs of the backbones already computed by a previous run with the same input and parameters
+    ContigCache cache (outFolder + "/cache", ".ctg");
+    std::atomic<int> cachedBackbones (0);
+
+    omp_set_num_threads(num_threads);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0 ; i < max_backbone ; i++){
+
+        int b = order[i];
+        BackboneResult &result = results[b];
+        StageTimer backboneTimer ("backbone", allreads[backbones[b]].name, true);
+
+        auto found = partitions.find(backbones[b]);
+        const vector<pair<pair<int,int>, SparsePartition>> &intervals = (found == partitions.end()) ? noIntervals : found->second;
+
+        string key;
+        if (cache.enabled()){
+            key = backbone_key(allreads, allOverlaps, allCIGARs, backbones[b], intervals, errorRate, polisher, polish, techno);
+            string content;
+            if (cache.load(key, content)){
+                if (decode_backbone_result(content, result)){
+                    cachedBackbones++;
+                    profiler.add(backboneTimer.stop());
+                    unfinishedBackbones--;
+                    continue;
+                }
+                result = BackboneResult(); //a corrupted entry is recomputed
+            }
         }
 
-        // if (allreads[backbones_reads[b]].name != "edge_10"){
+        //first load all the reads
+        parse_reads_on_contig(readStore, backbones[b], allOverlaps, allreads);
+
+        // if (allreads[backbones[b]].name != "edge_10"){
         //     cout << "edgge 10" << endl;
         //     continue;
         // }
 
         //then separate the contigs
 
-        string local_log_text = ""; //text that will be printed out in the output.txt generated in this thread
+        string &local_log_text = result.log; //text that will be printed out in the output.txt generated in this thread
         if (DEBUG){
-            #pragma omp critical
+            #pragma omp critical(console)
             {
-                cout << "Thread " << omp_get_thread_num() << " looking at " << allreads[backbones_reads[b]].name  << endl;
+                cout << "Thread " << omp_get_thread_num() << " looking at " << allreads[backbones[b]].name  << endl;
             }
         }
-        // if (allreads[backbones_reads[b]].name != "contig_339@0"){ //DEBUG
+        // if (allreads[backbones[b]].name != "contig_339@0"){ //DEBUG
         //     // cout << "continuuinng" << endl;
         //     continue;
         // }
 
-        local_log_text += "---- contig: " + allreads[backbones_reads[b]].name + " ----\n\n";
+        local_log_text += "---- contig: " + allreads[backbones[b]].name + " ----\n\n";
 
-        string thread_id = std::to_string(omp_get_thread_num());
-        int backbone = backbones_reads[b];
+        int backbone = backbones[b];
 
-        //if partitions[backbone].size() == 0, see if we need to repolish or not, depending on wether the coverage is coherent or not
+        //if there are no intervals, see if we need to repolish or not, depending on wether the coverage is coherent or not
         bool dont_recompute_contig = false;
-        if (partitions[backbone].size() == 0 && allreads[backbones_reads[b]].depth > 1){
-            double total_depth = 0;
-            for (auto n : allreads[backbones_reads[b]].neighbors_){
-                total_depth += allOverlaps[n].position_1_2 - allOverlaps[n].position_1_1;
-            }
-            double new_depth = total_depth / allreads[backbones_reads[b]].sequence_.size();
+        if (intervals.size() == 0 && allreads[backbone].depth > 1){
+            double new_depth = double(alignedBases[b]) / allreads[backbone].sequence_.size();
 
-            if (new_depth / allreads[backbones_reads[b]].depth > 0.7){
+            if (new_depth / allreads[backbone].depth > 0.7){
                 dont_recompute_contig = true;
             }
         }
 
-        if (partitions.find(backbone) != partitions.end() && partitions[backbone].size() > 0 && !dont_recompute_contig){
+        if (intervals.size() > 0 && !dont_recompute_contig){
             //stitch all intervals of each backbone read
-            vector<unordered_map <int,set<int>>> stitches(partitions[backbone].size()); //aggregates the information from stitchesLeft and stitchesRight to know what link to keep
-
-            // //if readLimits is not computed, provide an estimation
-            // if (readLimits[backbone].size() == 0){
-            //     for (int neighbor = 0 ; neighbor < allreads[backbone].neighbors_.size() ; neighbor++){
-            //         int overlap = allreads[backbone].neighbors_[neighbor];
-            //         readLimits[backbone].push_back(std::make_pair(allOverlaps[overlap].position_2_1, allOverlaps[overlap].position_2_2));
-            //     }
-            // }
-
-            for (int n = 0 ; n < partitions[backbone].size() ; n++){
-                //for each interval, go through the different parts and see with what part before and after they fit best
-                if (n > 0){
-                    std::unordered_map<int, std::set<int>> stitchLeft = stitch(partitions[backbone][n].second, 
-                                                                            partitions[backbone][n-1].second, 
-                                                                            partitions[backbone][n].first.first);
-                    // std::unordered_map<int, std::set<int>> stitchRight = stitch(
-                    //                                                         partitions[backbone][n-1].second.first,
-                    //                                                         partitions[backbone][n].second.first,
-                    //                                                         partitions[backbone][n].first.first, 
-                    //                                                         readLimits[backbone]);
-
-
-                    for (auto s : stitchLeft){
-                        stitches[n][s.first] = s.second;
-                    }
+            vector<StitchTable> stitches (intervals.size()); //to know what link to keep
 
-                    // for (auto s : stitchRight){
-                    //     for (int neighbor : s.second){
-                    //         stitches[n][neighbor].emplace(s.first);
-                    //     }
-                    // }
+            for (int n = 1 ; n < intervals.size() ; n++){
+                //for each interval, go through the different parts and see with what part before they fit best
+                stitch(intervals[n].second, intervals[n-1].second, intervals[n].first.first, stitches[n]);
 
-                    //make sure all contigs on the left and right are stitched
-                    set<int> all_contigs_left;
-                    for (int a : partitions[backbone][n-1].second){
-                        all_contigs_left.emplace(a);
-                    }
-                    all_contigs_left.erase(-1);
-                    all_contigs_left.erase(-2);
-
-                    set<int> all_contigs_right;
-                    for (int a : partitions[backbone][n].second){
-                        all_contigs_right.emplace(a);
-                    }
-                    all_contigs_right.erase(-1);
-                    all_contigs_right.erase(-2);
+                //make sure all contigs on the left of the junction are stitched
+                stitches[n].link_unstitched(true);
+            }
 
-                    for (auto s : stitchLeft){
-                        if (s.second.size() == 0){
-                            stitchLeft[s.first] = all_contigs_left;
-                        }
-                    }
 
-                    //check if all contigs on the left of the junction are stitched
-                    set <int> stitchedContigs;
-                    for (auto s : stitches[n]){
-                        for (int neighbor : s.second){
-                            stitchedContigs.emplace(neighbor);
-                        }
-                    }
-                    for (auto contig : all_contigs_left){
-                        if (stitchedContigs.find(contig) == stitchedContigs.end()){
-                            for (auto s : stitchLeft){
-                                stitches[n][s.first].emplace(contig);
-                            }
-                        }
-                    }
-                    // cout << "stitched contigs : "; for(auto i : stitchedContigs) {cout <<i << ";";} cout << endl;
-                    // for (auto s : stitchRight){
-                    //     if (stitchedContigs.find(s.first) == stitchedContigs.end()){
-                    //         // cout << "gluing back" << endl;
-                    //         for (auto s2 : stitchLeft){
-                    //             stitches[n][s2.first].emplace(s.first);
-                    //         }
-                    //     }
-                    // }
-
-                    // if (partitions[backbone][n].first.first > 63100 && partitions[backbone][n].first.first < 64900 ){
-                    //     cout << "stiddvtching : ";
-                    //     for (auto s: stitches[n]){
-                    //         cout << s.first << "<->" ;
-                    //         for (auto s2 : s.second) {cout << s2 << ",";}
-                    //         cout << "  ;  ";
-                    //     } 
-                    //     cout << endl;
-                    // }
-                        
-                    // }
-                }
+            //compute the depth from the number of aligning reads
+            std::pair<int,int> limitsAll= std::make_pair(0, allreads[backbone].sequence_.size()-1);
+            SparsePartition partition1 (allreads[backbone].neighbors_.size());
+            for (int r = 0 ; r < allreads[backbone].neighbors_.size() ; r++){
+                partition1.add(r, 1);
             }
+            unordered_map <int, double> newdepths = recompute_depths(limitsAll , partition1, allreads[backbone].depth);
 
-
-            //create hangingLinks, a list of links that are not yet connected but will soon be
-            vector<int> hangingLinks;
-            for (int linkIdx : allreads[backbone].get_links_left()){
-                if (allLinks[linkIdx].neighbor1 == backbone && allLinks[linkIdx].end1 == 0){
-                    allLinks[linkIdx].end1 = -1;
-                }
-                else {
-                    allLinks[linkIdx].end2 = -1;
+            //the backbone and the reads used by the intervals are decoded once, the reads in the orientation of the backbone: the intervals only take views of them
+            const string full_backbone = allreads[backbone].sequence_.str();
+            vector<string> orientedReads (allreads[backbone].neighbors_.size());
+            for (auto &interval : intervals){
+                for (auto &readAndLabel : interval.second.entries()){
+                    int r = readAndLabel.first;
+                    if (readAndLabel.second > -1 && orientedReads[r].empty()){
+                        const Overlap &overlap = allOverlaps[allreads[backbone].neighbors_[r]];
+                        const Sequence &sequence = allreads[overlap.sequence1].sequence_;
+                        orientedReads[r] = overlap.strand ? sequence.str() : sequence.reverse_complement().str();
+                    }
                 }
-                allLinks[linkIdx].group = 0;
-                hangingLinks.push_back(linkIdx);
             }
 
-            //compute the depth from the number of aligning reads
-            std::pair<int,int> limitsAll= std::make_pair(0, allreads[backbone].sequence_.size()-1);
-            vector<int> partition1 (allreads[backbone].neighbors_.size(), 1);
-            unordered_map <int, double> newdepths = recompute_depths(limitsAll , partition1, allreads[backbone].depth);
+            //the intervals are polished independently, as tasks that the idle threads can pick up, then they are linked in order
+            int nbIntervals = intervals.size();
+            vector<vector<pair<int, Read>>> &newContigs = result.newContigs;
+            vector<string> &intervalLogs = result.intervalLogs;
+            newContigs.resize(nbIntervals);
+            intervalLogs.resize(nbIntervals);
+            auto polish_interval = [&](int n){
 
-            int n = 0;
-            for (auto interval : partitions[backbone]){
+                auto interval = intervals[n];
+                string thread_id = std::to_string(omp_get_thread_num());
 
                 // if (interval.first.first == 36000){
                 //     cout  << "fdiocicui modufy_gfa" << endl;
@@ -390,8 +583,8 @@ void modify_GFA(
                 //     cout << endl;
                 // }
 
-                unordered_map<int, vector<string>> readsPerPart; //list of all reads of each part
-                unordered_map<int, vector<string>> fullReadsPerPart; //list of all reads of each part
+                unordered_map<int, vector<std::string_view>> readsPerPart; //list of all reads of each part, clipped on the interval
+                unordered_map<int, vector<std::string_view>> fullReadsPerPart; //list of all reads of each part
                 unordered_map<int, vector<pair<string, int>>> CIGARsPerPart; //list of all CIGARS of each part and the starting position
                 int overhang = 150; //margin we're taking at the ends of the contig t get a good polishing of first and last bases
                 int overhangLeft = min(interval.first.first, overhang);
@@ -401,84 +594,106 @@ void modify_GFA(
                 if (omp_get_thread_num() == 0 && DEBUG){
                     cout << "in interval " << interval.first.first << " <-> " << interval.first.second << endl;
                 }
-                local_log_text += " - Between positions " + to_string(interval.first.first) + " and " + to_string(interval.first.second) + " of the contig, I've created these contigs:\n";
+                intervalLogs[n] += " - Between positions " + to_string(interval.first.first) + " and " + to_string(interval.first.second) + " of the contig, I've created these contigs:\n";
 
                 int numberOfClusters = 0;
                 set<int> existingparts;
-                for (int r = 0 ; r < interval.second.size(); r++){
-                    if (interval.second[r] > -1){
+                for (auto &readAndLabel : interval.second.entries()){
+                    int r = readAndLabel.first;
+                    if (readAndLabel.second > -1){
 
-                        auto idxRead = allOverlaps[allreads[backbone].neighbors_[r]].sequence1;
-
-                        int clust = interval.second[r];
+                        int clust = readAndLabel.second;
                         existingparts.emplace(clust);
                         // string clippedRead = allreads[idxRead].sequence_.str();
                         //extract the part of the read that is on the interval and the part of the CIGAR that is on the interval
+                        const Overlap &overlap = allOverlaps[allreads[backbone].neighbors_[r]];
                         int posOnRead = 0;
-                        int posOnCIGAR = 0;
-                        int startPosition = allOverlaps[allreads[backbone].neighbors_[r]].position_2_1+1; //that's for the sam file
+                        int startPosition = overlap.position_2_1+1; //that's for the sam file
                         startPosition = max(1, startPosition - leftToPolish);
-                        int posOnInterval = allOverlaps[allreads[backbone].neighbors_[r]].position_2_1;
-                        // posOnInterval = 0;
+                        int posOnInterval = overlap.position_2_1;
                         int posOnReadStart = -1;
                         int posOnReadEnd = -1;
-                        int posOnCIGARStart = -1;
-                        int posOnCIGAREnd = -1;
-                        string converted_cigar = convert_cigar(allOverlaps[allreads[backbone].neighbors_[r]].CIGAR);
-                        for (char c : converted_cigar){
-
-                            posOnCIGAR++;
-                            if (c == 'S' || c == 'H'){ //get to the beginning of the read
-                                posOnRead++;
+                        string clippedCIGAR;
+                        char clippedOp = ' '; //last operation of clippedCIGAR, not written yet
+                        int clippedLength = 0;
+                        auto clip = [&](char op, int length){ //appends length x op to clippedCIGAR, merging it with the previous operation if they are the same
+                            if (length == 0){
+                                return;
+                            }
+                            if (op != clippedOp && clippedOp != ' '){
+                                clippedCIGAR += to_string(clippedLength) + clippedOp;
+                                clippedLength = 0;
+                            }
+                            clippedOp = op;
+                            clippedLength += length;
+                        };
+                        for (CigarCursor c (allCIGARs, overlap.CIGAROffset, overlap.CIGARLength) ; !c.done() ; c.next()){
+
+                            int length = c.length();
+                            if (c.op() == 'S' || c.op() == 'H'){ //get to the beginning of the read
+                                posOnRead += length;
+                                if (posOnReadStart != -1){
+                                    clip(c.op(), length);
+                                }
                                 continue;
                             }
-            
-                            if (posOnReadStart == -1 && posOnInterval >= leftToPolish){
-                                // cout << "bingo posOnReadStart " << posOnRead << " " << posOnCIGAR << " " << posOnInterval << " " << leftToPolish << endl;
-                                posOnReadStart = posOnRead;
-                                posOnCIGARStart = posOnCIGAR-1;
+                            bool onRead = c.consumes_read();
+                            bool onInterval = c.consumes_reference();
+
+                            //first base of the operation that is on the interval to polish, and base of the operation where it ends
+                            int startInOp = -1;
+                            if (posOnReadStart == -1){
+                                if (onInterval){
+                                    startInOp = max(0, leftToPolish - posOnInterval);
+                                }
+                                else if (posOnInterval >= leftToPolish){
+                                    startInOp = 0;
+                                }
+                            }
+                            int endInOp = -1;
+                            if (onInterval && rightToPolish >= posOnInterval && rightToPolish - posOnInterval < length){
+                                endInOp = rightToPolish - posOnInterval;
+                            }
+                            else if (!onInterval && posOnInterval == rightToPolish){
+                                endInOp = 0;
                             }
-                            if (posOnReadEnd == -1 && posOnInterval == rightToPolish){ 
-                                posOnReadEnd = posOnRead;
-                                posOnCIGAREnd = posOnCIGAR-1;
+
+                            if (startInOp >= length || (endInOp != -1 && startInOp > endInOp)){
+                                startInOp = -1;
+                            }
+                            if (startInOp != -1){
+                                posOnReadStart = posOnRead + (onRead ? startInOp : 0);
+                            }
+                            if (posOnReadStart != -1){
+                                int from = max(0, startInOp);
+                                int to = (endInOp == -1) ? length : endInOp;
+                                clip(c.op(), to - from);
+                            }
+                            if (endInOp != -1){
+                                posOnReadEnd = posOnRead + (onRead ? endInOp : 0);
                                 break;
                             }
       
-                            if (c == 'M'){
-                                posOnRead++;
-                                posOnInterval++;
-                            }
-                            else if (c == 'D'){
-                                posOnInterval++;
+                            if (onRead){
+                                posOnRead += length;
                             }
-                            else if (c == 'I'){
-                                posOnRead++;
+                            if (onInterval){
+                                posOnInterval += length;
                             }
                         }
 
                         if (posOnReadEnd == -1){
                             posOnReadEnd = posOnRead;
-                            posOnCIGAREnd = posOnCIGAR;
                         }
 
                         if (posOnReadStart > posOnReadEnd || posOnReadStart == -1){ //can happen when within a deletion
-                            interval.second[r] = -2;
+                            readAndLabel.second = -2;
                             continue;
                         }
-
-                        // cout << "overylap : " << allreads[idxRead].name << " " << allOverlaps[allreads[backbone].neighbors_[r]].position_1_1 << " " << allOverlaps[allreads[backbone].neighbors_[r]].position_1_2 << " " << allOverlaps[allreads[backbone].neighbors_[r]].position_2_1 << " " << allOverlaps[allreads[backbone].neighbors_[r]].position_2_2 << endl;
-                        // cout << "fsljd iid " << leftToPolish << " " << rightToPolish << endl;
-                        // cout << "foiupo q " << posOnReadStart << " " << posOnReadEnd << " " << posOnCIGARStart << " " << posOnCIGAREnd << endl;
+                        clippedCIGAR = (clippedOp == ' ') ? "*" : clippedCIGAR + to_string(clippedLength) + clippedOp;
                 
-                        string seq = allreads[idxRead].sequence_.str();
-                        if (!allOverlaps[allreads[backbone].neighbors_[r]].strand){
-                            seq = allreads[idxRead].sequence_.reverse_complement().str();
-                        }
-                        string clippedRead = seq.substr(posOnReadStart, posOnReadEnd-posOnReadStart);
-                        string clippedCIGAR = converted_cigar.substr(posOnCIGARStart, posOnCIGAREnd-posOnCIGARStart);
-
-                        clippedCIGAR = convert_cigar2(clippedCIGAR); //convert back MMMDDMM -> 3M2D2M
-                        // cout << "fjkld " << allOverlaps[allreads[backbone].neighbors_[r]].CIGAR << endl;
+                        const string &orientedRead = orientedReads[r];
+                        std::string_view clippedRead = std::string_view(orientedRead).substr(posOnReadStart, posOnReadEnd-posOnReadStart);
 
                         // int limitLeft = max(0,allOverlaps[allreads[backbone].neighbors_[r]].position_1_1-20); //the limit of the read that we should use with a little margin for a clean polish
                         // int limitRight = min(allOverlaps[allreads[backbone].neighbors_[r]].position_1_2+20, int(allreads[idxRead].sequence_.size()));
@@ -492,7 +707,7 @@ void modify_GFA(
 
                         if (readsPerPart.find(clust) == readsPerPart.end()){
                             readsPerPart[clust] = {clippedRead};
-                            fullReadsPerPart[clust] = {allreads[idxRead].sequence_.str()};
+                            fullReadsPerPart[clust] = {orientedRead};
                             CIGARsPerPart[clust] = {make_pair(clippedCIGAR, startPosition)};
                             if (clust >= 0){
                                 numberOfClusters++;
@@ -500,12 +715,12 @@ void modify_GFA(
                         }
                         else {
                             readsPerPart[clust].push_back(clippedRead);
-                            fullReadsPerPart[clust].push_back(allreads[idxRead].sequence_.str());
+                            fullReadsPerPart[clust].push_back(orientedRead);
                             CIGARsPerPart[clust].push_back(make_pair(clippedCIGAR, startPosition));
                         }
                     }
                 }
-                if (readsPerPart.size() == 0 && interval.second.size() > 0 && interval.second[0] <= -1){
+                if (readsPerPart.size() == 0 && interval.second.size() > 0 && interval.second.label(0) <= -1){
                     if (existingparts.size() == 0){
                         readsPerPart[-1] = {}; //so that it defaults back to the consensus
                         fullReadsPerPart[-1] = {};
@@ -520,18 +735,16 @@ void modify_GFA(
                     }
                 }
 
-                vector<int> futureHangingLinks;
-
                 unordered_map <int, double> newdepths = recompute_depths(interval.first, interval.second, allreads[backbone].depth);
 
-                for (auto group : readsPerPart){
-                    
-                    string full_backbone =  allreads[backbone].sequence_.str();
-                    //toPolish should be polished with a little margin on both sides to get cleanly first and last base
-                    string toPolish = full_backbone.substr(max(0, interval.first.first - overhangLeft), min(overhangLeft, interval.first.first)) 
-                        + full_backbone.substr(interval.first.first, interval.first.second-interval.first.first)
-                        + full_backbone.substr(interval.first.second, min(overhangRight+1, int(allreads[backbone].sequence_.size())-interval.first.second-1));
+                //toPolish should be polished with a little margin on both sides to get cleanly first and last base
+                string toPolish = full_backbone.substr(max(0, interval.first.first - overhangLeft), min(overhangLeft, interval.first.first)) 
+                    + full_backbone.substr(interval.first.first, interval.first.second-interval.first.first)
+                    + full_backbone.substr(interval.first.second, min(overhangRight+1, int(allreads[backbone].sequence_.size())-interval.first.second-1));
 
+                vector<pair<int, string>> groupContigs; //cluster and new contig of each group
+                vector<int> polishedGroups; //the new contigs that must be placed back on toPolish to cut the overhangs
+                for (auto group : readsPerPart){
 
                     string newcontig = "";
                     if (numberOfClusters > 1 || polish){
@@ -540,14 +753,18 @@ void modify_GFA(
                         if (group.second.size() == 0){
                             newcontig = "";
                         }
+                        int toolThreads = threads_for_tools(num_threads, unfinishedBackbones);
                         if (polisher == "medaka"){
-                            newcontig = consensus_reads_medaka(toPolish, group.second, thread_id, outFolder, MEDAKA, SAMTOOLS, path_to_python, path_src);
+                            newcontig = consensus_reads_medaka(toPolish, group.second, thread_id, outFolder, MEDAKA, SAMTOOLS, path_to_python, path_src, toolThreads);
+                        }
+                        else if (polisher == "fast"){
+                            newcontig = consensus_reads_fast(toPolish, group.second, CIGARsPerPart[group.first]);
                         }
                         else{
                             // newcontig = toPolish; //DEBUG
                             newcontig = consensus_reads(toPolish, full_backbone, 
                                 interval.first.first, interval.first.second-interval.first.first+1, group.second, fullReadsPerPart[group.first], CIGARsPerPart[group.first], 
-                                    thread_id, outFolder, techno, MINIMAP, RACON, path_to_python, path_src);
+                                    thread_id, outFolder, techno, MINIMAP, RACON, path_to_python, path_src, toolThreads);
                             // if (interval.first.first == 38000 && group.first == 1){
                             //     cout << "fqljkd uciupiou edge_111@0_38000_1" << endl;
                             //     exit(1);
@@ -562,42 +779,7 @@ void modify_GFA(
                         // string wtdbg2 = "/home/rfaure/Documents/software/wtdbg2/wtdbg2";
                         // newcontig = consensus_reads_wtdbg2(toPolish, group.second, thread_id, outFolder, techno, MINIMAP, RACON, samtools, wtdbg2 );
                         if (newcontig != ""){
-
-                            EdlibAlignResult result = edlibAlign(toPolish.c_str(), toPolish.size(),
-                                        newcontig.c_str(), newcontig.size(),
-                                        edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
-
-                            string cig = edlibAlignmentToCigar(result.alignment, result.alignmentLength, EDLIB_CIGAR_STANDARD);
-                            string cigar = convert_cigar(cig);
-                            // extract the part of newcontig that does not align to the first and last overhang bases of toPolish2
-                            int posOnToPolish = 0;
-                            int posOnNewContig = result.startLocations[0];
-                            int posStartOnNewContig = 0;
-                            int posEndOnNewContig = 0;
-                            // cout << "fqjdk " << posOnNewContig << " " << overhangLeft << " " << overhangRight << " " << toPolish.size() << endl;
-                            for (char c : cigar){
-                                if (c == 'M'){
-                                    posOnToPolish++;
-                                    posOnNewContig++;
-                                }
-                                else if (c == 'D'){
-                                    posOnNewContig++;
-                                }
-                                else if (c == 'I'){
-                                    posOnToPolish++;
-                                }
-                                if (posOnToPolish == overhangLeft+1){
-                                    posStartOnNewContig = posOnNewContig;
-                                }
-                                if (posOnToPolish == toPolish.size()-overhangRight){
-                                    posEndOnNewContig = posOnNewContig;
-                                }
-                                // cout << "indices: " << posOnToPolish << " " << posOnNewContig << endl;
-                            }
-                            
-                            newcontig = newcontig.substr(posStartOnNewContig, min(posEndOnNewContig-posStartOnNewContig+1, int(newcontig.size())-posStartOnNewContig));
-                            // cout << "kmljlkmjlkjijkl " << newcontig.substr(0,50) << endl << endl;
-                            edlibFreeAlignResult(result);
+                            polishedGroups.push_back(groupContigs.size());
                         }
                     }
                     else {
@@ -605,155 +787,90 @@ void modify_GFA(
                             newcontig = "";
                         }
                         else{
-                            newcontig = allreads[backbone].sequence_.str().substr(interval.first.first, interval.first.second-interval.first.first+1);
+                            newcontig = full_backbone.substr(interval.first.first, interval.first.second-interval.first.first+1);
                         }
                     }
 
-                    Read r(newcontig, newcontig.size());
-                    r.name = allreads[backbone].name + "_"+ to_string(interval.first.first)+ "_" + to_string(group.first);
-                    if (readsPerPart.size() > 1){
-                        r.depth = newdepths[group.first];
-                    }
-                    else {
-                        r.depth = allreads[backbone].depth;
-                    }
-
-                    // if (r.name == "s0.ctg000001l@1_84000_2"){
-                    //     cout << "oiaooeiiddz" << endl;
-                    //     exit(1);
-                    // }
-
-                    //now create all the links IF they are compatible with "stitches"  
-                    set<int> linksToKeep;
+                    groupContigs.push_back(make_pair(group.first, newcontig));
+                }
 
-        
-                    if (n == 0 || stitches[n][group.first].size() == 0){
-                        for (int h : hangingLinks){
-                            linksToKeep.emplace(allLinks[h].group);
-                        }
+                //place all the new contigs back on toPolish at once, in a band since they differ from it only by the errors and the strain
+                vector<AlignmentJob> jobs;
+                for (int g : polishedGroups){
+                    string &newcontig = groupContigs[g].second;
+                    jobs.push_back({toPolish.c_str(), int(toPolish.size()), newcontig.c_str(), int(newcontig.size()),
+                        banded_k(toPolish.size(), newcontig.size(), errorRate)});
+                }
+                Aligner &aligner = thread_aligner();
+                aligner.align_infix(jobs);
+                for (int j = 0 ; j < polishedGroups.size() ; j++){
+                    const Alignment &alignment = aligner.alignment(j);
+                    string &newcontig = groupContigs[polishedGroups[j]].second;
+                    if (alignment.editDistance < 0){
+                        continue;
                     }
-                    else{
-                        for (int l : stitches[n][group.first]){
-                            linksToKeep.emplace(l);
+                    // extract the part of newcontig that does not align to the first and last overhang bases of toPolish2
+                    int posOnToPolish = 0;
+                    int posOnNewContig = alignment.targetStart;
+                    int posStartOnNewContig = 0;
+                    int posEndOnNewContig = 0;
+                    for (unsigned char op : alignment.ops){
+                        if (op == EDLIB_EDOP_MATCH || op == EDLIB_EDOP_MISMATCH){
+                            posOnToPolish++;
+                            posOnNewContig++;
                         }
-                    }
-                    
-                    //create the links
-                    #pragma omp critical
-                    {
-                        for (int h : hangingLinks){
-                            if (linksToKeep.find(allLinks[h].group) != linksToKeep.end()){
-                                Link leftLink;
-                                leftLink.CIGAR = allLinks[h].CIGAR;
-                                if (allLinks[h].end2 == -1){
-                                    leftLink.end2 = 0;
-                                    leftLink.neighbor2 = allreads.size();
-                                    leftLink.end1 = allLinks[h].end1;
-                                    leftLink.neighbor1 = allLinks[h].neighbor1;
-                                    allreads[leftLink.neighbor1].add_link(allLinks.size(), allLinks[h].end1);
-                                }
-                                else if (allLinks[h].end1 == -1) {
-                                    leftLink.end1 = 0;
-                                    leftLink.neighbor1 = allreads.size();
-                                    leftLink.end2 = allLinks[h].end2;
-                                    leftLink.neighbor2 = allLinks[h].neighbor2;
-                                    allreads[leftLink.neighbor2].add_link(allLinks.size(), allLinks[h].end2);
-                                }
-                                else {
-                                    // cout << "WHAAAT" << endl;
-                                }
-                                r.add_link(allLinks.size(), 0);
-                                allLinks.push_back(leftLink);
-                            }
+                        else if (op == EDLIB_EDOP_DELETE){
+                            posOnNewContig++;
                         }
-                    
-                        Link rightLink;
-                        rightLink.CIGAR = "0M";
-                        rightLink.end1 = 1;
-                        rightLink.neighbor1 = allreads.size();
-                        rightLink.end2 = -1;
-                        rightLink.group = group.first;
-                        allLinks.push_back(rightLink);
-                        r.add_link(allLinks.size()-1, 1);
-                        futureHangingLinks.push_back(allLinks.size()-1);
-
-                        allreads.push_back(r);
-                        backbones_reads.push_back(allreads.size()-1);
-                        if (omp_get_thread_num() == 0 && DEBUG){
-                            cout << "created the contig " << r.name << endl;
+                        else if (op == EDLIB_EDOP_INSERT){
+                            posOnToPolish++;
+                        }
+                        if (posOnToPolish == overhangLeft+1){
+                            posStartOnNewContig = posOnNewContig;
+                        }
+                        if (posOnToPolish == toPolish.size()-overhangRight){
+                            posEndOnNewContig = posOnNewContig;
                         }
-                        local_log_text += "   - " + r.name + "\n";
-                    }
-                }
-                hangingLinks = futureHangingLinks;
-                n += 1;
-            }
-            //now wrap up the right of the contig
-            int left = partitions[backbone][partitions[backbone].size()-1].first.second+1; //rightmost interval
-            string right;
-            if (left < allreads[backbone].sequence_.size()){
-                right = allreads[backbone].sequence_.str().substr(left, allreads[backbone].sequence_.size()-left);
-            }
-            else {
-                right = "";
-            }
-            std::pair<int,int> limits= std::make_pair(left, allreads[backbone].sequence_.size()-1);
-            string contig = right;
-            
-            Read r (contig, contig.size());
-            r.name = allreads[backbone].name + "_"+ to_string(left)+ "_" + to_string(0);
-            r.depth = newdepths[1];
-            
-            #pragma omp critical
-            {
-                for (int h : hangingLinks){
-                    Link leftLink;
-                    leftLink.CIGAR = allLinks[h].CIGAR;
-                    if (allLinks[h].end2 == -1){
-                        leftLink.end2 = 0;
-                        leftLink.neighbor2 = allreads.size();
-                        leftLink.end1 = allLinks[h].end1;
-                        leftLink.neighbor1 = allLinks[h].neighbor1;
-                        allreads[leftLink.neighbor1].add_link(allLinks.size(), allLinks[h].end1);
-                    }
-                    else if (allLinks[h].end1 == -1) {
-                        leftLink.end1 = 0;
-                        leftLink.neighbor1 = allreads.size();
-                        leftLink.end2 = allLinks[h].end2;
-                        leftLink.neighbor2 = allLinks[h].neighbor2;
-                        allreads[leftLink.neighbor2].add_link(allLinks.size(), allLinks[h].end2);
-                    }
-                    else {
-                        // cout << "WHAAAT" << endl;
                     }
-                    r.add_link(allLinks.size(), 0);
-                    allLinks.push_back(leftLink);
-                    
+                    newcontig = newcontig.substr(posStartOnNewContig, min(posEndOnNewContig-posStartOnNewContig+1, int(newcontig.size())-posStartOnNewContig));
                 }
 
-                //now re-build the links right of backbone
-                for (int linkIdx : allreads[backbone].get_links_right()){
-                    if (allLinks[linkIdx].neighbor1 == backbone && allLinks[linkIdx].end1 == 1){
-                        allLinks[linkIdx].end1 = 1;
-                        allLinks[linkIdx].neighbor1 = allreads.size() ;
+                for (auto &group : groupContigs){
+                    Read r(group.second, group.second.size());
+                    r.name = allreads[backbone].name + "_"+ to_string(interval.first.first)+ "_" + to_string(group.first);
+                    if (readsPerPart.size() > 1){
+                        r.depth = newdepths[group.first];
                     }
                     else {
-                        allLinks[linkIdx].end2 = 1;
-                        allLinks[linkIdx].neighbor2 = allreads.size() ;
+                        r.depth = allreads[backbone].depth;
                     }
-                    r.add_link(linkIdx, 1);
+
+                    newContigs[n].push_back(make_pair(group.first, r));
                 }
+            };
+            for (int n = 0 ; n < nbIntervals ; n++){
+                #pragma omp task firstprivate(n)
+                polish_interval(n);
+            }
+            #pragma omp taskwait
 
-                allreads.push_back(r);
-                backbones_reads.push_back(allreads.size()-1);
-                if (omp_get_thread_num() == 0 && DEBUG){
-                    cout << "now creating the different contigs : " << r.name << endl;
+            result.stitchedParts.resize(nbIntervals);
+            for (int n = 0 ; n < nbIntervals ; n++){
+                for (auto &newContig : newContigs[n]){
+                    result.stitchedParts[n].push_back(n > 0 ? stitches[n].neighbors_of(newContig.first) : vector<int>());
                 }
-                local_log_text += " - Between positions " + to_string(left) + " and " + to_string(allreads[backbone].sequence_.size()) + " of the contig, I've created these contigs:\n";
-                local_log_text +=  "   - " + r.name + "\n\n";
+            }
 
-                allreads[backbone].name = "delete_me"; //output_gfa will understand that and delete the contig
+            //the contig right of the last interval
+            int left = intervals[intervals.size()-1].first.second+1;
+            string right;
+            if (left < allreads[backbone].sequence_.size()){
+                right = full_backbone.substr(left, allreads[backbone].sequence_.size()-left);
             }
+            result.rightContig = Read(right, right.size());
+            result.rightContig.name = allreads[backbone].name + "_"+ to_string(left)+ "_" + to_string(0);
+            result.rightContig.depth = newdepths[1];
+            result.split = true;
 
             // if (allreads[allreads.size()-1].name.substr(0,9) == "edge_13@0"){
             //     cout << "qfdklmdjlccjj " << endl;
@@ -764,123 +881,180 @@ void modify_GFA(
         else{
             local_log_text += "Nothing to do\n\n";
         }
-        #pragma omp critical
-        {
-            log_text += local_log_text;
+
+        //free up memory: the sequences of the reads used there are freed once no other backbone uses them (and the cache of the store is full)
+        free_reads_on_contig(readStore, backbone, allOverlaps, allreads);
+        if (cache.enabled()){
+            cache.store(key, encode_backbone_result(result));
         }
+        profiler.add(backboneTimer.stop());
+        unfinishedBackbones--;
+    }
 
-        //free up memory by deleting the sequence of the reads used there
-        for (auto n : allreads[backbones_reads[b]].neighbors_){
-            if (allOverlaps[n].sequence1 != backbones_reads[b]){
-                allreads[allOverlaps[n].sequence1].free_sequence();
-            }
-            else{
-                allreads[allOverlaps[n].sequence2].free_sequence();
-            }
+    if (cachedBackbones > 0){
+        cout << " - " << cachedBackbones << " of the " << max_backbone << " contigs were found in " << outFolder << "/cache" << endl;
+    }
+    cout << " - " << readStore.loaded_from_file() << " sequences of reads were read from the reads file, " << readStore.reused() << " were still in memory when another contig needed them" << endl;
+
+    //now replace the backbones by their new contigs, in the order of the backbones so that the output does not depend on the threads
+    for (int b = 0 ; b < max_backbone ; b++){
+        if (results[b].split){
+            replace_backbone(allreads, backbones_reads, allLinks, backbones[b], partitions.find(backbones[b])->second, results[b], DEBUG);
         }
+        log_text += results[b].log;
+        results[b] = BackboneResult(); //free the new contigs, they are in allreads now
     }
 
+    cout << " - Load of the threads while creating the new contigs:" << endl;
+    profiler.print_thread_load();
+
     std::ofstream o("output.txt");
     o << log_text << endl;
 }
 
+StitchTable::StitchTable() : nbParts(0){
+}
+
+void StitchTable::reset(int nbParts){
+    this->nbParts = nbParts;
+    counts.assign(nbParts*nbParts, 0);
+    links.assign(nbParts*nbParts, 0);
+    clusterSize.assign(nbParts, 0);
+    inPar.assign(nbParts, 0);
+    inNeighbor.assign(nbParts, 0);
+}
+
+bool StitchTable::has(int part) const{
+    return part >= 0 && part < nbParts && clusterSize[part] > 0;
+}
+
+void StitchTable::mark(int part, bool ofPar){
+    if (ofPar){
+        inPar[part] = 1;
+    }
+    else{
+        inNeighbor[part] = 1;
+    }
+}
+
+/**
+ * @brief Makes sure that all the parts on one side of the junction are stitched to something
+ * 
+ * @param ofNeighbor if true, the parts of neighbor that no part of par is stitched to are stitched to all the parts of par. If false, the same is done with the ids of the parts of par
+ */
+void StitchTable::link_unstitched(bool ofNeighbor){
+    for (int contig = 0 ; contig < nbParts ; contig++){
+        if (!(ofNeighbor ? inNeighbor[contig] : inPar[contig])){
+            continue;
+        }
+        bool stitched = false;
+        for (int part = 0 ; part < nbParts && !stitched ; part++){
+            stitched = has(part) && linked(part, contig);
+        }
+        if (!stitched){
+            for (int part = 0 ; part < nbParts ; part++){
+                if (has(part)){
+                    link(part, contig);
+                }
+            }
+        }
+    }
+}
+
+std::vector<int> StitchTable::neighbors_of(int part) const{
+    vector<int> neighbors;
+    if (!has(part)){
+        return neighbors;
+    }
+    for (int neighborPart = 0 ; neighborPart < nbParts ; neighborPart++){
+        if (linked(part, neighborPart)){
+            neighbors.push_back(neighborPart);
+        }
+    }
+    return neighbors;
+}
+
 /**
  * @brief Tells to which parts of neighbor each part of par should be linked
  * 
  * @param par partitions on the partition
  * @param neighbor partitions on the neighbor
  * @param position position of the stitch in the backbone
- * @param readLimits limits of the reads in the backbone (so that reads that are not on the position of the stitch are not considered)
- * @return unordered_map<int, set<int>> map associating a set of partitions of neighbor matching each partition of par
+ * @param table filled with the number of reads shared by each pair of parts and the stitches: each part of par is stitched to the parts of neighbor it shares most of its reads with
  */
-unordered_map<int, set<int>> stitch(vector<int> &par, vector<int> &neighbor, int position){
-
-    unordered_map<int, unordered_map<int,int>> fit_left; //each parts maps to what left part ?
-    unordered_map<int, unordered_map<int,int>> fit_right; //each parts maps to what right part ?
-    unordered_map<int, int> cluster_size; 
-    unordered_map<int,set<int>> stitch;
-
-    for (auto r = 0 ; r < par.size() ; r++){
-        // if (par[r] == 1 && position == 64000){
-        //     cout << "parttiion " << par[r] << " neighbor " << neighbor[r] << endl;
-        // }
-        if (par[r] > -1 && neighbor[r] > -1){
-            if (fit_left.find(par[r]) != fit_left.end()){
-                if (fit_left[par[r]].find(neighbor[r]) != fit_left[par[r]].end()){
-                    fit_left[par[r]][neighbor[r]] += 1;
-                }
-                else{
-                    fit_left[par[r]][neighbor[r]] = 1;
-                }
-                cluster_size[par[r]] += 1;
-            }
-            else{
-                fit_left[par[r]][neighbor[r]] = 1;
-                cluster_size[par[r]] = 1;
-                stitch[par[r]] = {};
-            }
-
-            if (fit_right.find(neighbor[r]) != fit_right.end()){
-                if (fit_right[neighbor[r]].find(par[r]) != fit_right[neighbor[r]].end()){
-                    fit_right[neighbor[r]][par[r]] += 1;
-                }
-                else{
-                    fit_right[neighbor[r]][par[r]] = 1;
-                }
-            }
-            else{
-                fit_right[neighbor[r]][par[r]] = 1;
-            }
+void stitch(const SparsePartition &par, const SparsePartition &neighbor, int position, StitchTable &table){
 
+    int nbParts = 0;
+    for (auto &entry : par.entries()){
+        nbParts = max(nbParts, entry.second+1);
+    }
+    for (auto &entry : neighbor.entries()){
+        nbParts = max(nbParts, entry.second+1);
+    }
+    table.reset(nbParts);
+    for (auto &entry : par.entries()){
+        if (entry.second > -1){
+            table.mark(entry.second, true);
+        }
+    }
+    for (auto &entry : neighbor.entries()){
+        if (entry.second > -1){
+            table.mark(entry.second, false);
         }
     }
-    // if (position == 64000){
-    //     cout << "here isss the fit_left" << endl;
-    //     for (auto fit : fit_left){
-    //         cout << fit.first << " : " << endl;
-    //         for (auto candidate : fit.second){
-    //             cout << "   " << candidate.first << " : " << candidate.second << endl;
-    //         }
-    //     }
-    // }
 
-    //now give all associations
-    for (auto fit : fit_left){
-        for (auto candidate : fit.second){
-            if (candidate.second >= min(5.0, 0.7*cluster_size[fit.first])){ //good compatibility
-                stitch[fit.first].emplace(candidate.first);
+    //contingency table of the reads assigned on both sides: walk the two lists of reads together
+    auto left = par.entries().begin();
+    auto right = neighbor.entries().begin();
+    while (left != par.entries().end() && right != neighbor.entries().end()){
+        if (left->first < right->first){
+            left++;
+        }
+        else if (right->first < left->first){
+            right++;
+        }
+        else{
+            if (left->second > -1 && right->second > -1){
+                table.shared(left->second, right->second) += 1;
+                table.shared_with_neighbor(left->second) += 1;
             }
+            left++;
+            right++;
         }
     }
 
-    for (auto fit : fit_right){
-        //find all the good fits
-        for (auto candidate : fit.second){
-            if (candidate.second >= min(5.0, 0.7*cluster_size[candidate.first])){
-                stitch[candidate.first].emplace(fit.first);
+    //now give all associations
+    for (int part = 0 ; part < nbParts ; part++){
+        for (int candidate = 0 ; candidate < nbParts ; candidate++){
+            int shared = table.shared(part, candidate);
+            if (shared > 0 && shared >= min(5.0, 0.7*table.shared_with_neighbor(part))){ //good compatibility
+                table.link(part, candidate);
             }
         }
     }
-
-    return stitch;
 }
 
 //input : an interval, the list of the limits of the reads on the backbone, the depth of the contig of origin
 //output : the recomputed read coverage for each of the new contigs, (scaled so that the total is the original depth)
-std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, std::vector<int> &partition, double originalDepth){
+std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, const SparsePartition &partition, double originalDepth){
 
     unordered_map <int, double> newCoverage;
     int lengthOfInterval = limits.second-limits.first+1; //+1 to make sure we do not divide by 0
 
-    for (auto c = 0 ; c < partition.size() ; c++){
+    for (auto c : partition.entries()){
 
-        if (newCoverage.find(partition[c]) == newCoverage.end()){
-            newCoverage[partition[c]] = 0;
+        if (newCoverage.find(c.second) == newCoverage.end()){
+            newCoverage[c.second] = 0;
         }
 
-        newCoverage[partition[c]] += max(0.0, double(limits.second-limits.first)/lengthOfInterval );
+        newCoverage[c.second] += max(0.0, double(limits.second-limits.first)/lengthOfInterval );
 
     }
+    //the reads that are not stored are -2
+    int unassigned = partition.size() - partition.entries().size();
+    if (unassigned > 0){
+        newCoverage[-2] += unassigned * max(0.0, double(limits.second-limits.first)/lengthOfInterval );
+    }
 
     //now scale all the coverages to obtain exactly the original coverage
     // if (originalDepth != -1){ //that would mean we do not know anything about the original depth
@@ -904,6 +1078,17 @@ std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, std
 
 }
 
+//a path of a read on a backbone, before its contigs are named: they are the elements firstContig to firstContig+nbContigs of a list of (start of the interval, part)
+struct CompactPath{
+    uint32_t read;
+    int start; //position on the read
+    uint32_t backbone;
+    size_t firstContig;
+    uint32_t nbContigs;
+    bool strand;
+    char marker; //'&', '+' or '-' if the read does not extend to the ends of the backbone (see merge_read_paths), 0 otherwise
+};
+
 /**
  * @brief Creates the GAF corresponding to the mapping of the reads on the new GFA
  * 
@@ -913,80 +1098,58 @@ std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, std
  * @param allOverlaps vector of all overlaps between backbone reads and normal reads
  * @param partitions contains all the conclusions of the separate_reads algorithm
  * @param outputGAF name of the output file
+ * @param fragments if true, the paths are output before being merged across contigs (see output_GAF_fragment), for merge_shards
  */
-typedef std::tuple<int, vector<pair<string, bool>>, long int> Path; //a path is a starting position on a read, a list of contigs and their orientation relative to the read, and the index of the contig on which it aligns
 void output_GAF(
     std::vector <Read> &allreads, 
     std::vector<unsigned long int> &backbone_reads, 
     std::vector<Link> &allLinks, 
     std::vector <Overlap> &allOverlaps,
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int>  > >> &partitions,
-    std::string outputGAF){
+    Partitions &partitions,
+    std::string outputGAF,
+    bool fragments){
 
-    vector<vector<Path>> readPaths (allreads.size()); //to each read we associate a path on the graph
+    //the paths of all the reads, in the order of the backbones. They are named and merged one read at a time
+    vector<CompactPath> compactPaths;
+    vector<pair<int,int>> contigsOfPaths; //(start of the interval, part) of the contigs of the paths, (-1, -1) for a backbone that is not split
 
     int max_backbone = backbone_reads.size(); 
     for (int b = 0 ; b < max_backbone ; b++){
 
-        // cout << "here are the intervals of the partioin" << endl;
-        // for (auto i : partitions[backbone_reads[b]]){
-        //     cout << i.first.first << " " << i.first.second << " : ";
-        //     for (auto j : i.second){
-        //         cout << j << " ";
-        //     }
-        //     cout << endl;
-        // }
-
         long int backbone = backbone_reads[b];
 
         if (partitions.find(backbone) != partitions.end() && partitions[backbone].size() > 0){
             for (int n = 0 ; n < allreads[backbone].neighbors_.size() ; n++){
 
-                auto ov = allOverlaps[allreads[backbone].neighbors_[n]];
+                const Overlap &ov = allOverlaps[allreads[backbone].neighbors_[n]];
 
                 long int read;
-                long int end;
                 int start = -1;
 
                 if (ov.sequence1 != backbone){
                     read = ov.sequence1;
                     start = ov.position_1_1;
-                    end = ov.position_1_2;
                 }
                 else{
                     read = ov.sequence2;
                     start = min(ov.position_2_1, ov.position_2_2);
-                    end = max(ov.position_2_1, ov.position_2_2);
                 }
 
                 //go through all the intervals and see through which version this read passes
-                vector<pair<string, bool>> sequence_of_traversed_contigs; //string corresponds to the name of the contig, bool is true if the contig is traversed in the same orientation as the read
+                CompactPath path = {uint32_t(read), start, uint32_t(backbone), contigsOfPaths.size(), 0, ov.strand, 0};
                 short stop = 0;
                 bool firsthere = false;
                 bool lasthere = false;
                 int inter = 0;
-                for (auto interval : partitions[backbone]){
-
-                    if (interval.second[n] > -1 && stop < 2){
-                        // if (allreads[read].name == ">0_read4" || allreads[read].name.substr(0,6) == "@fa270"){
-                        //     // cout << "read " << allreads[read].name << " passes input_output yyu through " << interval.first.first << " " << interval.first.second << " " << interval.second[n] << endl;
-                        //     // for (auto i : interval.second.first){
-                        //     //     if (i != -2){
-                        //     //         cout << i << " ";
-                        //     //     }
-                        //     // }
-                        //     // cout << endl;
-                        // }
-                        sequence_of_traversed_contigs.push_back(make_pair(allreads[backbone].name+"_"+std::to_string(interval.first.first)+"_"+std::to_string(interval.second[n])
-                            , ov.strand));
+                for (auto &interval : partitions[backbone]){
+
+                    int label = interval.second.label(n);
+                    if (label > -1 && stop < 2){
+                        contigsOfPaths.push_back(make_pair(interval.first.first, label));
                         if (inter == 0){
                             firsthere = true;
                         }
                         stop = 1;
-
-                        // if (stop){ //you have one read that was lost just before !
-                        //     cout << "WHOUOU: revival here of reads " << ov.sequence1 << endl;
-                        // }
                     }
                     else if (stop == 1){
                         stop = 2;
@@ -997,43 +1160,32 @@ void output_GAF(
                 if (stop < 2){
                     lasthere = true;
                     int right = partitions[backbone][partitions[backbone].size()-1].first.second+1;
-                    sequence_of_traversed_contigs.push_back(make_pair(allreads[backbone].name+"_"+std::to_string(right)+"_0"
-                            , ov.strand));
+                    contigsOfPaths.push_back(make_pair(right, 0));
                 }
+                path.nbContigs = contigsOfPaths.size()-path.firstContig;
 
-                if (!ov.strand){ //then mirror the vector
-                    std::reverse(sequence_of_traversed_contigs.begin(), sequence_of_traversed_contigs.end());
+                if (!ov.strand){ //then mirror the contigs
+                    std::reverse(contigsOfPaths.begin()+path.firstContig, contigsOfPaths.end());
                 }
 
                 if (((ov.strand && !lasthere) || (!ov.strand && !firsthere)) && ((ov.strand && !firsthere) || (!ov.strand && !lasthere))){ //mark if the read does not extend to either end
-                    sequence_of_traversed_contigs.push_back(make_pair("&", ov.strand));
+                    path.marker = '&';
                 }
                 else if ((ov.strand && !lasthere) || (!ov.strand && !firsthere)){ //mark if the read does not extend to the end
-                    sequence_of_traversed_contigs.push_back(make_pair("+", ov.strand));
+                    path.marker = '+';
                 }
                 else if ((ov.strand && !firsthere) || (!ov.strand && !lasthere)){ //mark if the read does not extend to the beginning
-                    sequence_of_traversed_contigs.push_back(make_pair("-", ov.strand));
+                    path.marker = '-';
                 }
                 
-                if (sequence_of_traversed_contigs.size()>0){ //this should almost always be true, but it's still safer to test
-                    Path path = make_tuple(start,sequence_of_traversed_contigs, backbone);
-                    // if (allreads[read].name.substr(0,6) == "@d5282"){
-                    //     cout << "d5282 is a readdd, path :: "<< endl;
-                    //     for (auto p : get<1>(path)){
-                    //         cout << p.first << " " << p.second << endl;
-                    //     }
-
-                    // }
-                    readPaths[read].push_back(path);
+                if (path.nbContigs > 0 || path.marker != 0){ //this should almost always be true, but it's still safer to test
+                    compactPaths.push_back(path);
                 }
-                // if ("edge_4" == allreads[backbone_reads[b]].name){// && allreads[read].name.substr(0,19) == ">SRR14289618.827569"){
-                //     cout << "on backbone qdsfj is aligned " << allreads[read].name.substr(0, 19) << " " <<  << endl;
-                // }
             }
         }
         else{
             for (int n = 0 ; n < allreads[backbone].neighbors_.size() ; n++){
-                auto ov = allOverlaps[allreads[backbone].neighbors_[n]];
+                const Overlap &ov = allOverlaps[allreads[backbone].neighbors_[n]];
                 long int read;
                 int start = -1;
                 int end = -1;
@@ -1058,277 +1210,266 @@ void output_GAF(
                     lasthere = true;
                 }
                 
-                vector<pair<string, bool>> v = {make_pair(allreads[backbone].name, ov.strand)};
+                CompactPath path = {uint32_t(read), start, uint32_t(backbone), contigsOfPaths.size(), 1, ov.strand, 0};
+                contigsOfPaths.push_back(make_pair(-1, -1));
                 if (((ov.strand && !lasthere) || (!ov.strand && !firsthere)) && ((ov.strand && !firsthere) || (!ov.strand && !lasthere))){ //mark if the read does not extend to either end
-                    v.push_back(make_pair("&", ov.strand));
+                    path.marker = '&';
                 }
                 else if ((ov.strand && !lasthere) || (!ov.strand && !firsthere)){ //mark if the read does not extend to the end
-                    v.push_back(make_pair("+", ov.strand));
+                    path.marker = '+';
                 }
                 else if ((ov.strand && !firsthere) || (!ov.strand && !lasthere)){ //mark if the read does not extend to the beginning
-                    v.push_back(make_pair("-", ov.strand));
+                    path.marker = '-';
                 }
-                Path contigpath = make_tuple(start,v, backbone);
-                readPaths[read].push_back(contigpath);
-
-                // cout << "bbb ds " << allreads[backbone_reads[b]].name << endl;
-                // if ("edge_4" == allreads[backbone_reads[b]].name){// && allreads[read].name.substr(0,19) == ">SRR14289618.827569"){
-                //     cout << "on backbone qdsfj is aligned " << allreads[read].name.substr(0, 19) << endl;
-                // }
+                compactPaths.push_back(path);
             }
         }
     }
 
-
-    //now merge the paths that were on different contigs
-    for (auto r = 0 ; r < readPaths.size() ; r++){
-
-        if (readPaths[r].size() > 0){
-
-            std::sort(readPaths[r].begin(), readPaths[r].end(),[] (const auto &x, const auto &y) { return get<0>(x) < get<0>(y); }); //gets the list sorted on first element of pair, i.e. position of contig on read
-            
-            // if (allreads[r].name.substr(0,19) == ">SRR14289618.827569"){
-
-            //     cout << "on backbone 228 is feed aligned " << allreads[r].name.substr(0, 19) << endl;
-            //     for (auto p = 0 ; p < readPaths[r].size() ; p++){
-            //         Path path = readPaths[r][p];
-            //         cout << "path " << p << " : ";
-            //         auto contigs = get<1>(path);
-            //         for (auto c : contigs){
-            //             cout << c.first << " ";
-            //         }
-            //         cout << ", beginning on read : " << get<0>(path) << endl;
-            //     }
-            //     // exit(1);
-            // }
-
-            vector<Path> mergedPaths;
-            Path currentPath = readPaths[r][0];
-            //check if each path can be merged with next path
-            for (auto p = 0 ; p<readPaths[r].size()-1 ; p++){
-
-                long int contig = get<2> (currentPath);
-                bool orientation = get<1>(currentPath)[get<1>(currentPath).size()-1].second;
-                long int nextContig = get<2> (readPaths[r][p+1]);
-
-                if (contig != nextContig){
-
-                    vector<size_t> links;
-                    if (orientation){
-                        links = allreads[contig].get_links_right();
-                    }
-                    else{
-                        links = allreads[contig].get_links_left();
-                    }
-
-
-                    bool merge = false;
-                    for (auto li : links){
-                        Link l = allLinks[li];
-                        if (l.neighbor1 == nextContig || l.neighbor2 == nextContig){ //then merge
-                            if ((l.end1==l.end2 && get<1>(readPaths[r][p+1])[0].second != orientation) 
-                                || (l.end1!=l.end2 && get<1>(readPaths[r][p+1])[0].second == orientation)){
-                                merge = true;
-                            }
-                        }
-                    }
-
-                    //if & in name, there is a cut there
-                    char lastchar = get<1>(currentPath)[get<1>(currentPath).size()-1].first[get<1>(currentPath)[get<1>(currentPath).size()-1].first.size()-1];
-                    char firstnextchar = get<1>(readPaths[r][p+1])[get<1>(readPaths[r][p+1]).size()-1].first[get<1>(readPaths[r][p+1])[get<1>(readPaths[r][p+1]).size()-1].first.size()-1];
-                    if (lastchar == '&' || lastchar == '+' || firstnextchar == '-'){
-                        merge = false;
-                    }
-                    if (lastchar == '&' || lastchar == '+' || lastchar == '-'){
-                        get<1>(currentPath).erase(get<1>(currentPath).end()-1);
-                    }
-
-                    if (merge){
-                        // if (get<1>(currentPath)[0].first.substr(0,12) == "edge_235@0@0" || get<1>(currentPath)[0].first.substr(0,12) == "edge_510@0@0"){
-                        //     cout << "current path : " << endl;
-                        //     for (auto p : get<1>(currentPath)){
-                        //         cout << p.first << " " << p.second << endl;
-                        //     }
-                        //     cout << "merging 235 with path : in read " << r << endl;
-                        //     for (auto p : get<1>(readPaths[r][p+1])){
-                        //         cout << p.first << " " << p.second << endl;
-                        //     }
-                        // }
-                        get<1>(currentPath).insert(get<1>(currentPath).end(), get<1> (readPaths[r][p+1]).begin(), get<1> (readPaths[r][p+1]).end());
-                        get<2>(currentPath) = get<2> (readPaths[r][p+1]);
-                    }
-                    else{
-                        mergedPaths.push_back(currentPath);
-                        currentPath = readPaths[r][p+1];
-                    }
-
-                }
-                else{
-                    char lastchar = get<1>(currentPath)[get<1>(currentPath).size()-1].first[get<1>(currentPath)[get<1>(currentPath).size()-1].first.size()-1];
-                    if (lastchar == '&' || lastchar == '+' || lastchar == '-'){
-                        get<1>(currentPath).erase(get<1>(currentPath).end()-1);
-                    }
-                    mergedPaths.push_back(currentPath);
-                    currentPath = readPaths[r][p+1];
-                }
+    //the paths of each read, still in the order of the backbones
+    std::stable_sort(compactPaths.begin(), compactPaths.end(), [](const CompactPath &a, const CompactPath &b){return a.read < b.read;});
+
+    //names the contigs of a path, as the new contigs are named in modify_GFA
+    auto name_path = [&](const CompactPath &compact){
+        Path path;
+        get<0>(path) = compact.start;
+        get<2>(path) = compact.backbone;
+        const string &backbone = allreads[compact.backbone].name;
+        for (size_t c = compact.firstContig ; c < compact.firstContig+compact.nbContigs ; c++){
+            if (contigsOfPaths[c].first == -1){
+                get<1>(path).push_back(make_pair(backbone, compact.strand));
             }
-            //if & in name, delete it
-            char lastchar = get<1>(currentPath)[get<1>(currentPath).size()-1].first[get<1>(currentPath)[get<1>(currentPath).size()-1].first.size()-1];
-            if (lastchar == '&' || lastchar == '+' || lastchar == '-'){
-                get<1>(currentPath).erase(get<1>(currentPath).end()-1);
+            else{
+                get<1>(path).push_back(make_pair(backbone+"_"+std::to_string(contigsOfPaths[c].first)+"_"+std::to_string(contigsOfPaths[c].second), compact.strand));
             }
+        }
+        if (compact.marker != 0){
+            get<1>(path).push_back(make_pair(string(1, compact.marker), compact.strand));
+        }
+        return path;
+    };
 
-            mergedPaths.push_back(currentPath);
+    BufferedWriter out(outputGAF);
 
-            readPaths[r] = mergedPaths;
+    //in a shard, the paths are merged by merge_shards with the paths of the other shards
+    if (fragments){
+        for (const CompactPath &compact : compactPaths){
+            output_GAF_fragment(out, allreads[compact.read].name, allreads[compact.read].get_position_in_file(), name_path(compact), allreads[compact.backbone].name);
         }
-
     }
-
-    //now the paths have been determined, output the file
-    ofstream out(outputGAF);
-    for (auto p = 0 ; p < readPaths.size() ; p++){
-        for (Path path : readPaths[p]){
-            if (get<1>(path).size() > 0){
-                //output the path
-                out << allreads[p].name << "\t-1\t"<< get<0>(path) <<"\t-1\t+\t";
-                for (auto contig : get<1>(path)){
-                    if (contig.second){
-                        out << ">";
+    else{
+        //now merge the paths that were on different contigs
+        PathLinks linked = [&](long int contig, bool rightEnd, long int nextContig, bool nextOrientation){
+            vector<size_t> links;
+            if (rightEnd){
+                links = allreads[contig].get_links_right();
+            }
+            else{
+                links = allreads[contig].get_links_left();
+            }
+            bool merge = false;
+            for (auto li : links){
+                const Link &l = allLinks[li];
+                if (l.neighbor1 == nextContig || l.neighbor2 == nextContig){ //then merge
+                    if ((l.end1==l.end2 && nextOrientation != rightEnd) 
+                        || (l.end1!=l.end2 && nextOrientation == rightEnd)){
+                        merge = true;
                     }
-                    else{
-                        out << "<";
+                }
+            }
+            return merge;
+        };
+
+        vector<Path> paths;
+        for (size_t p = 0 ; p < compactPaths.size() ; p++){
+            paths.push_back(name_path(compactPaths[p]));
+            if (p+1 == compactPaths.size() || compactPaths[p+1].read != compactPaths[p].read){ //all the paths of the read are there
+                merge_read_paths(paths, linked);
+                for (const Path &path : paths){
+                    if (get<1>(path).size() > 0){
+                        output_GAF_path(out, allreads[compactPaths[p].read].name, path);
                     }
-                    out << contig.first;
                 }
-                out << "\t-1\t-1\t-1\t-1\t-1\t255\n";
+                paths.clear();
             }
         }
     }
-
+    if (!out.close()){
+        cout << "ERROR: could not write " << outputGAF << endl;
+        exit(1);
+    }
 }
 
 /**
  * @brief Merges the intervals that can be easily merged to reduce the number of intervals
  * 
  * @param partitions 
+ * @param num_threads the contigs are merged in parallel
  */
-void merge_intervals(std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int>  > >> &partitions){
+void merge_intervals(Partitions &partitions, int num_threads){
 
-    //create a new partitions
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int>  > >> new_partitions;
+    vector<vector<pair<pair<int,int>, SparsePartition>>*> contigs;
+    for (auto &contig : partitions){
+        contigs.push_back(&contig.second);
+    }
 
-    // #pragma omp parallel for
-    for (auto contig : partitions){
-        
-        vector <pair <pair<int,int>, vector<int>>> new_intervals;
-        if (contig.second.size() > 0){
+    #pragma omp parallel num_threads(num_threads)
+    {
+        //buffers of the thread, reused from one junction to the next
+        StitchTable stitches;
+        vector<int> conversion;
+        vector<char> alreadySeen;
+        SparsePartition merged;
+
+        #pragma omp for schedule(dynamic)
+        for (int c = 0 ; c < contigs.size() ; c++){
+
+            vector<pair<pair<int,int>, SparsePartition>> &intervals = *contigs[c];
+            if (intervals.size() < 2){
+                continue;
+            }
 
-            vector <int> group = contig.second[0].second;
-            int coordinate_start = contig.second[0].first.first;
-            int coordinate_end = contig.second[0].first.second;
-            for (int interval = 1 ; interval < contig.second.size() ; interval ++){
+            vector <pair <pair<int,int>, SparsePartition>> new_intervals;
+            SparsePartition group = std::move(intervals[0].second);
+            int coordinate_start = intervals[0].first.first;
+            int coordinate_end = intervals[0].first.second;
+            for (int interval = 1 ; interval < intervals.size() ; interval ++){
                 //check if this interval can be merged with the previous one
-                vector<int> groupThere = contig.second[interval].second;
+                SparsePartition &groupThere = intervals[interval].second;
 
-                unordered_map<int, set<int>> stitchLeft = stitch(group, groupThere, contig.second[interval].first.first);
-                unordered_map <int,set<int>> stitches;
-                for (auto s : stitchLeft){
-                    stitches[s.first] = s.second;
-                }
+                stitch(group, groupThere, intervals[interval].first.first, stitches);
 
-                //make sure all contigs on the left and right are stitched
-                set<int> all_contigs_left;
-                for (int a : group){
-                    all_contigs_left.emplace(a);
-                }
-                all_contigs_left.erase(-1);
-                all_contigs_left.erase(-2);
+                //make sure all contigs on the left of the junction are stitched
+                stitches.link_unstitched(false);
 
-                set<int> all_contigs_right;
-                for (int a : groupThere){
-                    all_contigs_right.emplace(a);
-                }
-                all_contigs_right.erase(-1);
-                all_contigs_right.erase(-2);
-
-                for (auto s : stitchLeft){
-                    if (s.second.size() == 0){
-                        stitchLeft[s.first] = all_contigs_left;
-                    }
-                }
-
-                //check if all contigs on the left of the junction are stitched
-                set <int> stitchedContigs;
-                for (auto s : stitches){
-                    for (int neighbor : s.second){
-                        stitchedContigs.emplace(neighbor);
+                //check if all the stitches are trivial: each part of the left is stitched to its own part of the right
+                int nbParts = stitches.parts();
+                bool trivial = true;
+                conversion.assign(nbParts, 0);
+                alreadySeen.assign(nbParts, 0);
+                int nbSeen = 0;
+                int all_contigs_left = 0;
+                int all_contigs_right = 0;
+                for (int part = 0 ; part < nbParts ; part++){
+                    all_contigs_left += stitches.in_par(part);
+                    all_contigs_right += stitches.in_neighbor(part);
+                    if (!stitches.has(part)){
+                        continue;
                     }
-                }
-                for (auto contig : all_contigs_left){
-                    if (stitchedContigs.find(contig) == stitchedContigs.end()){
-                        for (auto s : stitchLeft){
-                            stitches[s.first].emplace(contig);
+                    int nbStitched = 0;
+                    int stitchedTo = -1;
+                    for (int neighborPart = 0 ; neighborPart < nbParts ; neighborPart++){
+                        if (stitches.linked(part, neighborPart)){
+                            nbStitched++;
+                            stitchedTo = neighborPart;
                         }
                     }
-                }
-
-                //check if all the stitches are trivial
-                bool trivial = true;
-                unordered_map<int, int> conversion;
-                set<int> alreadySeen;
-                for (auto s : stitches){
-                    if (s.second.size() > 1){
+                    if (nbStitched != 1){
                         trivial = false;
                     }
                     else{
-                        if (alreadySeen.find(*s.second.begin()) != alreadySeen.end()){
+                        if (alreadySeen[stitchedTo]){
                             trivial = false;
                         }
                         else{
-                            alreadySeen.emplace(*s.second.begin());
+                            alreadySeen[stitchedTo] = 1;
+                            nbSeen++;
                         }
-                        conversion[*s.second.begin()] = s.first;
+                        conversion[stitchedTo] = part;
                     }
                 }
-                if (alreadySeen.size() < all_contigs_left.size() || all_contigs_left.size() != all_contigs_right.size()){
+                if (nbSeen < all_contigs_left || all_contigs_left != all_contigs_right){
                     trivial = false;
                 }
 
                 if (!trivial){
-                    new_intervals.push_back(make_pair(make_pair(coordinate_start, coordinate_end), group));
-                    group = groupThere;
-                    coordinate_start = contig.second[interval].first.first;
-                    coordinate_end = contig.second[interval].first.second;
+                    new_intervals.push_back(make_pair(make_pair(coordinate_start, coordinate_end), std::move(group)));
+                    group = std::move(groupThere);
+                    coordinate_start = intervals[interval].first.first;
+                    coordinate_end = intervals[interval].first.second;
                 }
                 else{
-                    coordinate_end = contig.second[interval].first.second;
-                    for (auto read = 0 ; read < group.size() ; read  ++){
-                        if (group[read] < 0 && groupThere[read] > -1){
-                            group[read] = conversion[groupThere[read]];
+                    coordinate_end = intervals[interval].first.second;
+                    //the reads that are not assigned in group take the label of groupThere: merge the two lists of reads
+                    merged.reset(group.size());
+                    auto left = group.entries().begin();
+                    auto right = groupThere.entries().begin();
+                    while (left != group.entries().end() || right != groupThere.entries().end()){
+                        if (right == groupThere.entries().end() || (left != group.entries().end() && left->first < right->first)){
+                            merged.add(left->first, left->second);
+                            left++;
+                        }
+                        else if (left == group.entries().end() || right->first < left->first){
+                            if (right->second > -1){
+                                merged.add(right->first, conversion[right->second]);
+                            }
+                            right++;
+                        }
+                        else{
+                            merged.add(left->first, (left->second < 0 && right->second > -1) ? conversion[right->second] : left->second);
+                            left++;
+                            right++;
                         }
                     }
+                    std::swap(group, merged);
                 }
 
             }
-            new_intervals.push_back(make_pair(make_pair(coordinate_start, coordinate_end), group));
-        }
-        else {
-            new_intervals = contig.second;
+            new_intervals.push_back(make_pair(make_pair(coordinate_start, coordinate_end), std::move(group)));
+            intervals = std::move(new_intervals);
         }
-        new_partitions[contig.first] = new_intervals;
     }
-    partitions = new_partitions;
 }
 
 
+/**
+ * @brief Finds the original contig of a contig of the new assembly, the new contigs being named <original>_<start>_<part>
+ * 
+ * @param name name of the contig
+ * @param originalNames names of the contigs of the original assembly
+ * @return the name of the original contig (name itself if it was not modified)
+ */
+static string original_contig(const string &name, const robin_hood::unordered_set<string> &originalNames){
+    if (originalNames.find(name) != originalNames.end()){
+        return name;
+    }
+    string original = name;
+    for (int suffix = 0 ; suffix < 2 ; suffix++){
+        original = original.substr(0, original.rfind('_'));
+    }
+    if (originalNames.find(original) == originalNames.end()){
+        cerr << "ERROR: could not find the original contig of " << name << endl;
+        exit(1);
+    }
+    return original;
+}
+
+#ifndef CREATE_NEW_CONTIGS_NO_MAIN //the benchmarks link the functions of this file with their own main
 int main(int argc, char *argv[])
 {
     //parse the command line arguments
-    if (argc != 19){
-        std::cout << "Usage: ./create_new_contigs <original_assembly> <reads_file> <error_rate> <gro_file> <sam_file> "
-                <<"<tmpfolder> <num_threads> <technology> <output_graph> <output_gaf> <polisher> <polish_everything> <path_to_minimap> <path-to-racon> <path-to-medaka> <path-to-samtools> "
-                << "<path-to-python> <debug>" << std::endl;
+    //options after the positional arguments
+    string contigs_file = "";
+    size_t read_cache = 512; //MiB
+    bool goodOptions = argc >= 19 && (argc-19)%2 == 0;
+    for (int o = 19 ; goodOptions && o+1 < argc ; o += 2){
+        if (string(argv[o]) == "--contigs"){
+            contigs_file = argv[o+1];
+        }
+        else if (string(argv[o]) == "--read-cache"){
+            read_cache = std::stoul(argv[o+1]);
+        }
+        else{
+            goodOptions = false;
+        }
+    }
+    if (!goodOptions){
+        std::cout << "Usage: ./create_new_contigs <original_assembly> <reads_file> <error_rate> <gro_file> <sam_or_bam_file> "
+                <<"<tmpfolder> <num_threads> <technology> <output_graph> <output_gaf> <polisher (fast, racon or medaka)> <polish_everything> <path_to_minimap> <path-to-racon> <path-to-medaka> <path-to-samtools> "
+                << "<path-to-python> <debug> [--contigs <file>] [--read-cache <MiB>]" << std::endl;
+        std::cout << "The new contigs of each backbone are cached in <tmpfolder>/cache if this folder exists" << std::endl;
+        std::cout << "With --contigs, only the contigs listed in the file (one name per line) are processed, and the output is a shard to be merged with merge_shards" << std::endl;
+        std::cout << "--read-cache is the memory kept for the sequences of the reads that no backbone uses anymore, in case another backbone needs them [512]" << std::endl;
         cout << argc << endl;
         return 1;
     }
@@ -1350,6 +1491,19 @@ int main(int argc, char *argv[])
     string SAMTOOLS = argv[16];
     string path_to_python = argv[17];
     bool DEBUG = stoi(argv[18]);
+    bool shard = contigs_file != "";
+    robin_hood::unordered_set<string> selectedContigs;
+    if (shard){
+        std::ifstream in(contigs_file);
+        if (!in){
+            cerr << "ERROR: could not open " << contigs_file << endl;
+            return 1;
+        }
+        string name;
+        while (in >> name){
+            selectedContigs.insert(name);
+        }
+    }
 
 
     string argv0 = argv[0];
@@ -1358,32 +1512,83 @@ int main(int argc, char *argv[])
 
     vector <Link> allLinks;
     std::vector <Overlap> allOverlaps;
+    CigarArena allCIGARs;
     std::vector <Read> allreads; 
     robin_hood::unordered_map<std::string, unsigned long int> indices;
     vector<unsigned long int> backbone_reads;
 
-    parse_reads(reads_file, allreads, indices);
+    Profiler profiler;
+
+    StageTimer timer ("parse_reads");
+    ReadsIndex readsIndex(reads_file);
+    robin_hood::unordered_set<string> selectedReads;
+    if (shard){ //only the reads that align on the contigs of the shard
+        selectedReads = read_names_on_contigs(sam_file, selectedContigs, num_threads);
+    }
+    parse_reads(readsIndex, allreads, indices, shard ? &selectedReads : nullptr);
+    profiler.add(timer.stop());
+
+    timer = StageTimer("parse_assembly");
     parse_assembly(original_assembly, allreads, indices, backbone_reads, allLinks);
-    parse_SAM(sam_file, allOverlaps, allreads, indices);
+    profiler.add(timer.stop());
+
+    //in a shard, all the contigs are known (to keep the links towards the other shards) but only the selected ones are processed
+    vector<unsigned long int> shardBackbones;
+    robin_hood::unordered_set<string> originalNames;
+    if (shard){
+        for (auto b : backbone_reads){
+            if (selectedContigs.find(allreads[b].name) != selectedContigs.end()){
+                shardBackbones.push_back(b);
+                originalNames.insert(allreads[b].name);
+            }
+        }
+        if (shardBackbones.size() != selectedContigs.size()){
+            cerr << "ERROR: some contigs of " << contigs_file << " are not in " << original_assembly << endl;
+            return 1;
+        }
+        cout << " - Processing " << shardBackbones.size() << " of the " << backbone_reads.size() << " contigs, aligned with " << allreads.size()-backbone_reads.size() << " reads" << endl;
+    }
+    vector<unsigned long int> &backbones = shard ? shardBackbones : backbone_reads;
+
+    timer = StageTimer("parse_SAM");
+    parse_SAM(sam_file, allOverlaps, allCIGARs, allreads, indices, num_threads, shard ? &selectedContigs : nullptr);
+    profiler.add(timer.stop());
 
     //now parse the split file
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int> > > > partitions;
+    timer = StageTimer("parse_split_file");
+    Partitions partitions;
     parse_split_file(split_file, allreads, allOverlaps, partitions);
 
     //first merge the intervals that can be merged
-    merge_intervals(partitions);
+    merge_intervals(partitions, num_threads);
+    profiler.add(timer.stop());
 
     cout << " - Creating the .gaf file describing how the reads align on the new contigs" << endl;
-    output_GAF(allreads, backbone_reads, allLinks, allOverlaps, partitions, outputGAF);
+    timer = StageTimer("output_GAF");
+    output_GAF(allreads, backbones, allLinks, allOverlaps, partitions, outputGAF, shard);
+    profiler.add(timer.stop());
 
     cout << " - Creating the new contigs" << endl;
-    modify_GFA(reads_file, allreads, backbone_reads, allOverlaps, partitions, allLinks, num_threads, 
+    timer = StageTimer("modify_GFA");
+    ReadStore readStore (readsIndex, allreads, read_cache << 20);
+    modify_GFA(readStore, allreads, backbones, allOverlaps, allCIGARs, partitions, allLinks, num_threads, profiler,
         tmpFolder, error_rate, polisher, polish, technology, MINIMAP, RACON, MEDAKA, SAMTOOLS, path_to_python, path_to_src, DEBUG);
+    profiler.add(timer.stop());
+
+    timer = StageTimer("output_GFA");
+    vector<string> origins; //in a shard, the contig of the original assembly from which each contig comes, for merge_shards
+    for (auto b : shardBackbones){
+        origins.push_back(allreads[b].name == "delete_me" ? "" : original_contig(allreads[b].name, originalNames));
+    }
+    output_GFA(allreads, backbones, output_graph, allLinks, origins);
+    profiler.add(timer.stop());
 
-    output_GFA(allreads, backbone_reads, output_graph, allLinks);
+    //time, memory and I/O of each stage and of each backbone, in the temporary folder
+    profiler.write(tmpFolder + "/profile_create_new_contigs.json");
 
     return 0;
 }
+#endif
 
 
 
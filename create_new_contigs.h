@@ -9,21 +9,28 @@
 #include <unordered_map>
 #include "Partition.h"
 #include "read.h"
+#include "reads_index.h"
+#include "read_store.h"
+#include "cigar.h"
+#include "profiling.h"
+#include "split_file.h"
 
 void parse_split_file(
     std::string& file, 
     std::vector <Read> &allreads,
     std::vector <Overlap> &allOverlaps,
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int> > > > &partitions);
+    Partitions &partitions);
 
 void modify_GFA(
-    std::string readsFile, 
+    ReadStore &readStore, 
     std::vector <Read> &allreads, 
     std::vector<unsigned long int> &backbones_reads,
     std::vector <Overlap> &allOverlaps, 
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int> > > > &partitions,
+    CigarArena &allCIGARs,
+    Partitions &partitions,
     std::vector<Link> &allLinks,
     int num_threads,
+    Profiler &profiler,
     std::string &outFolder,
     float errorRate,
     std::string &polisher,
@@ -37,8 +44,41 @@ void modify_GFA(
     std::string &path_src,
     bool DEBUG);
 
-std::unordered_map<int, std::set<int>> stitch(std::vector<int> &par, std::vector<int> &neighbor, int position);
-std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, std::vector<int> &partition, double originalDepth);
+/**
+ * @brief Stitches between the parts of two adjacent intervals, as dense tables indexed by cluster id (the ids of a window are small integers).
+ * The buffers are kept from one stitch to the next, so that stitching all the intervals of a contig does not allocate
+ */
+class StitchTable{
+
+public :
+    StitchTable();
+
+    void reset(int nbParts); //ids from 0 to nbParts-1, nothing stitched
+    int parts() const {return nbParts;}
+
+    int& shared(int part, int neighborPart) {return counts[part*nbParts+neighborPart];} //reads in part of par and neighborPart of neighbor
+    int& shared_with_neighbor(int part) {return clusterSize[part];} //reads of part that are assigned in neighbor
+    bool has(int part) const; //part shares reads with neighbor
+    bool in_par(int part) const {return inPar[part];}
+    bool in_neighbor(int part) const {return inNeighbor[part];}
+    void mark(int part, bool ofPar); //part exists in par or in neighbor
+
+    bool linked(int part, int neighborPart) const {return links[part*nbParts+neighborPart];}
+    void link(int part, int neighborPart) {links[part*nbParts+neighborPart] = 1;}
+    void link_unstitched(bool ofNeighbor); //the parts of neighbor (or of par) that no part is stitched to are stitched to all the parts
+    std::vector<int> neighbors_of(int part) const; //sorted, empty if part is not in the table
+
+private :
+    int nbParts;
+    std::vector<int> counts;
+    std::vector<int> clusterSize;
+    std::vector<char> links;
+    std::vector<char> inPar;
+    std::vector<char> inNeighbor;
+};
+
+void stitch(const SparsePartition &par, const SparsePartition &neighbor, int position, StitchTable &table);
+std::unordered_map<int, double> recompute_depths(std::pair<int,int> &limits, const SparsePartition &partition, double originalDepth);
 
 
 void output_GAF(
@@ -46,10 +86,11 @@ void output_GAF(
     std::vector<unsigned long int> &backbone_reads, 
     std::vector<Link> &allLinks, 
     std::vector <Overlap> &allOverlaps, 
-    std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int>  > >> &partitions,
-    std::string outputGAF);
+    Partitions &partitions,
+    std::string outputGAF,
+    bool fragments = false);
 
-void merge_intervals(std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::vector<int>  > >> &partitions);
+void merge_intervals(Partitions &partitions, int num_threads);
 
 #endif
 
@@ -8,6 +8,8 @@
 #include <string>
 #include <iostream>
 
+#include "../../cpu_dispatch.h" //the bit-vector core is compiled for several instruction sets, see MULTIVERSIONED
+
 using namespace std;
 
 typedef uint64_t Word;
@@ -91,13 +93,13 @@ public:
     }
 };
 
-static int myersCalcEditDistanceSemiGlobal(const Word* Peq, int W, int maxNumBlocks,
+MULTIVERSIONED static int myersCalcEditDistanceSemiGlobal(const Word* Peq, int W, int maxNumBlocks,
                                            int queryLength,
                                            const unsigned char* target, int targetLength,
                                            int k, EdlibAlignMode mode,
                                            int* bestScore_, int** positions_, int* numPositions_);
 
-static int myersCalcEditDistanceNW(const Word* Peq, int W, int maxNumBlocks,
+MULTIVERSIONED static int myersCalcEditDistanceNW(const Word* Peq, int W, int maxNumBlocks,
                                    int queryLength,
                                    const unsigned char* target, int targetLength,
                                    int k, int* bestScore_,
@@ -546,7 +548,7 @@ static inline bool allBlockCellsLarger(const Block block, const int k) {
  * @param [out] numPositions_  Number of positions in the positions_ array.
  * @return Status.
  */
-static int myersCalcEditDistanceSemiGlobal(
+MULTIVERSIONED static int myersCalcEditDistanceSemiGlobal(
         const Word* const Peq, const int W, const int maxNumBlocks,
         const int queryLength,
         const unsigned char* const target, const int targetLength,
@@ -729,7 +731,7 @@ static int myersCalcEditDistanceSemiGlobal(
  *         and column p is returned as the only column in alignData.
  * @return Status.
  */
-static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int maxNumBlocks,
+MULTIVERSIONED static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int maxNumBlocks,
                                    const int queryLength,
                                    const unsigned char* const target, const int targetLength,
                                    int k, int* const bestScore_,
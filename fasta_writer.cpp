@@ -0,0 +1,193 @@
+#include "fasta_writer.h"
+
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+FastaWriter::FastaWriter(string file) : file(file), offset(0), sequenceOffset(0), sequenceLength(0), closed(false), ok(true){
+    if (file == "-"){
+        plain.reset(new BufferedWriter(file));
+        return;
+    }
+    if (file.size() > 3 && file.compare(file.size()-3, 3, ".gz") == 0){
+        compressed.reset(new BgzfWriter(file));
+    }
+    else{
+        plain.reset(new BufferedWriter(file));
+    }
+    fai.reset(new BufferedWriter(file + ".fai", 1 << 16));
+}
+
+FastaWriter::~FastaWriter(){
+    close();
+}
+
+bool FastaWriter::good() const{
+    return ok && (plain ? plain->good() : compressed->good()) && (!fai || fai->good());
+}
+
+void FastaWriter::output(string_view text){
+    if (plain){
+        plain->write(text);
+    }
+    else{
+        compressed->write(text);
+    }
+    offset += text.size();
+}
+
+void FastaWriter::write(string_view name, string_view sequence){
+    begin(name);
+    append(sequence);
+    end();
+}
+
+void FastaWriter::begin(string_view name){
+    this->name = name;
+    output(">");
+    output(name);
+    output("\n");
+    sequenceOffset = offset;
+    sequenceLength = 0;
+}
+
+void FastaWriter::append(string_view sequence){
+    output(sequence);
+    sequenceLength += sequence.size();
+}
+
+//the whole sequence is on one line, so that the line length of the index is the length of the sequence
+void FastaWriter::end(){
+    output("\n");
+    if (fai){
+        *fai << name << '\t' << sequenceLength << '\t' << sequenceOffset << '\t' << sequenceLength << '\t' << sequenceLength+1 << '\n';
+    }
+}
+
+bool FastaWriter::close(){
+    if (closed){
+        return ok;
+    }
+    closed = true;
+    if (plain){
+        ok = plain->close() && ok;
+    }
+    else{
+        ok = compressed->close() && compressed->write_gzi(file + ".gzi") && ok;
+    }
+    if (fai){
+        ok = fai->close() && ok;
+    }
+    return ok;
+}
+
+bool gfa_to_fasta(string gfaFile, FastaWriter &fasta){
+
+    int fd = (gfaFile == "-") ? STDIN_FILENO : open(gfaFile.c_str(), O_RDONLY);
+    if (fd < 0){
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    //the line being read is cut in fields as the pieces of the file come: the type of the line, then for S lines the name and the sequence.
+    //The sequence is written as it is read, except a first '*', which is the whole sequence of the lines without sequence
+    enum State {TYPE, NAME, SEQUENCE, SKIP};
+    State state = TYPE;
+    string type;
+    string name;
+    bool started = false; //the sequence being read is written
+    bool star = false; //the first character of the sequence is a '*', not written yet
+    auto write_sequence = [&](string_view piece){
+        if (!started && !star && !piece.empty() && piece[0] == '*'){
+            star = true;
+            piece.remove_prefix(1);
+        }
+        if (!piece.empty()){
+            if (!started){
+                fasta.begin(name);
+                if (star){
+                    fasta.append("*");
+                }
+                started = true;
+            }
+            fasta.append(piece);
+        }
+    };
+
+    vector<char> buffer (1 << 20);
+    bool ok = true;
+    while (true){
+        ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            ok = n == 0;
+            break;
+        }
+        string_view chunk (buffer.data(), n);
+        while (!chunk.empty()){
+            if (state == TYPE || state == NAME){
+                size_t end = chunk.find_first_of("\t\n");
+                string &field = (state == TYPE) ? type : name;
+                field.append(chunk.substr(0, end));
+                if (end == string_view::npos){
+                    break;
+                }
+                if (chunk[end] == '\n'){
+                    state = TYPE;
+                }
+                else if (state == TYPE){
+                    state = (type == "S") ? NAME : SKIP;
+                }
+                else{
+                    name = name.substr(0, name.find(' '));
+                    state = SEQUENCE;
+                    started = false;
+                    star = false;
+                }
+                if (state == TYPE){
+                    type.clear();
+                    name.clear();
+                }
+                chunk.remove_prefix(end+1);
+            }
+            else if (state == SEQUENCE){
+                size_t end = chunk.find_first_of("\t\r\n");
+                write_sequence(chunk.substr(0, end));
+                if (end == string_view::npos){
+                    break;
+                }
+                if (started){
+                    fasta.end();
+                }
+                state = (chunk[end] == '\n') ? TYPE : SKIP;
+                type.clear();
+                name.clear();
+                chunk.remove_prefix(end+1);
+            }
+            else{
+                size_t end = chunk.find('\n');
+                if (end == string_view::npos){
+                    break;
+                }
+                state = TYPE;
+                type.clear();
+                name.clear();
+                chunk.remove_prefix(end+1);
+            }
+        }
+    }
+    if (state == SEQUENCE && started){
+        fasta.end();
+    }
+    if (fd != STDIN_FILENO){
+        close(fd);
+    }
+    return ok;
+}
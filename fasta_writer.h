@@ -0,0 +1,58 @@
+#ifndef FASTA_WRITER_H
+#define FASTA_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+#include "buffered_writer.h"
+#include "bgzf.h"
+
+/**
+ * @brief Writes a FASTA file and its .fai index as it goes, each sequence on one line. A file ending in .gz is compressed with BGZF and
+ * also indexed in a .gzi, so that samtools faidx reads it as a bgzipped FASTA. Nothing is indexed when the file is "-" (the standard output)
+ */
+class FastaWriter{
+
+public :
+    FastaWriter(std::string file);
+    ~FastaWriter();
+    FastaWriter(const FastaWriter&) = delete;
+    FastaWriter& operator=(const FastaWriter&) = delete;
+
+    bool good() const;
+
+    //a sequence is written either at once, or in pieces between begin and end, for sequences that are not held in memory
+    void write(std::string_view name, std::string_view sequence);
+    void begin(std::string_view name);
+    void append(std::string_view sequence);
+    void end();
+
+    bool close(); //writes the indexes, returns good()
+
+private :
+    void output(std::string_view text);
+
+    std::string file;
+    std::unique_ptr<BufferedWriter> plain;
+    std::unique_ptr<BgzfWriter> compressed;
+    std::unique_ptr<BufferedWriter> fai;
+    uint64_t offset; //uncompressed offset of the next byte
+    std::string name; //of the sequence being written
+    uint64_t sequenceOffset;
+    uint64_t sequenceLength;
+    bool closed;
+    bool ok;
+};
+
+/**
+ * @brief Writes the sequences of the S lines of a GFA file in a FASTA file (the names are cut at the first space, the lines without sequence are
+ * skipped). The GFA is read by pieces, so that the memory used does not depend on the size of the file or of its sequences
+ *
+ * @param gfaFile the GFA, "-" for the standard input
+ * @param fasta
+ * @return false if the GFA cannot be read
+ */
+bool gfa_to_fasta(std::string gfaFile, FastaWriter &fasta);
+
+#endif
@@ -1,38 +1,32 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 
+#include "fasta_writer.h"
+
 using std::cout;
+using std::cerr;
+using std::endl;
 using std::string;
 
 int main(int argc, char *argv[])
-{  
-    //in a streaming fashion, convert a gfa file to a fasta file
-    //the gfa file is given as an argument
-    //the fasta file is written to stdout
-
-    std::string gfafile = argv[1];
-    std::ifstream infile(gfafile);
-    std::string line;
-    std::string name;
-    std::string sequence;
-    int i = 0;
-    while (std::getline(infile, line))
-    {
-        if (line[0] == 'S'){
-
-            //the name is the second field
-            string name = line.substr(2, line.find('\t', 2) - 2);
-            name = name.substr(0, name.find(' '));
-
-            //the sequence is the third field
-            string seq = line.substr(line.find('\t', 2) + 1, line.find('\t', line.find('\t', 2) + 1) - line.find('\t', 2) - 1);
-            if (seq.size() == 0){
-                continue;
-            }
-            cout << ">" << name << "\n";
-            cout << seq << "\n";
-        }
+{
+    //in a streaming fashion, convert a gfa file to a fasta file, written to stdout or to the file given (indexed, and bgzipped if it ends in .gz)
+    if (argc < 2 || argc > 3){
+        cout << "Usage: ./gfa2fa <graph.gfa> [<output.fasta>|<output.fasta.gz>]" << endl;
+        cout << "Writes the sequences of graph.gfa (- for the standard input) on the standard output, or in output.fasta with its .fai index" << endl;
+        return 1;
     }
 
-}
\ No newline at end of file
+    string gfaFile = argv[1];
+    string fastaFile = (argc == 3) ? argv[2] : "-";
+    FastaWriter fasta (fastaFile);
+    if (!gfa_to_fasta(gfaFile, fasta)){
+        cerr << "ERROR: could not read " << gfaFile << endl;
+        return 1;
+    }
+    if (!fasta.close()){
+        cerr << "ERROR: could not write " << fastaFile << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,975 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <functional>
+
+#include "tokenizer.h"
+#include "buffered_writer.h"
+#include "fasta_writer.h"
+#include "robin_hood.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::pair;
+
+/*
+Unzips the graph of create_new_contigs with the paths of the reads on its contigs, as "GraphUnzip/graphunzip.py unzip -l paths.gaf -g graph.gfa
+-o output.gfa" does (the simple_unzip of GraphUnzip, followed by the merging of the contigs and the trimming of the overlaps):
+    - the links that no read goes through are deleted
+    - a contig with several links at one end is duplicated if at least 3 reads go through it with the same pair of neighbors: one copy is
+      made for each pair of links supported by the reads, and the original contig is deleted
+    - the short dead ends that branch off long contigs are detached
+    - the chains of contigs without branching are merged, the overlaps at the ends of the links are trimmed, and the merged contigs are output
+      longest first as supercontig_0, supercontig_1... The contigs of each supercontig are listed in supercontigs.txt, next to the output,
+      and their length, depth and number of contigs and links in supercontigs_stats.tsv. The sequences can also be written in a FASTA file as
+      they are output, which replaces running gfa2fa on the output
+*/
+
+//a contig of the input GFA
+struct Contig{
+    string_view name;
+    string_view sequence; //empty if the sequence is *
+    long int length; //length used to compare the contigs, at least 1
+    bool hasDepth;
+    double depth;
+};
+
+//end of a link, stored on the segment at the other end of the link
+struct LinkEnd{
+    long int neighbor;
+    short end; //end of the neighbor: 0 for the left end, 1 for the right end
+    string CIGAR;
+};
+
+//a chain of contigs of the GFA (the Segment of GraphUnzip). A segment is identified by its index in the graph, which is also its rank of creation
+struct Segment{
+    vector<long int> contigs;
+    vector<char> orientations; //1 for +, 0 for -
+    vector<string> insideCIGARs; //CIGARs of the links between consecutive contigs
+    long int length = 0; //sum of the lengths of the contigs
+    std::array<vector<LinkEnd>, 2> links; //at the left and right ends, sorted by neighbor and end of the neighbor
+    std::array<long int, 2> trim = {0, 0}; //bases removed at each end when the segment is output
+    bool deleted = false;
+};
+
+//a read path, as a list of contigs that are linked in the graph
+struct Path{
+    vector<long int> contigs;
+    vector<char> orientations;
+};
+
+static bool before(const LinkEnd &link, const pair<long int, short> &key){
+    return link.neighbor < key.first || (link.neighbor == key.first && link.end < key.second);
+}
+
+//index of the first link towards this end of neighbor, -1 if there is none
+static long int find_link(const vector<LinkEnd> &links, long int neighbor, short end){
+    auto it = std::lower_bound(links.begin(), links.end(), std::make_pair(neighbor, end), before);
+    if (it != links.end() && it->neighbor == neighbor && it->end == end){
+        return it - links.begin();
+    }
+    return -1;
+}
+
+//adds the end of a link on one segment only, after the links towards the same end of neighbor
+static void add_end_of_link(vector<Segment> &segments, long int segment, short end, long int neighbor, short neighborEnd, const string &CIGAR){
+    vector<LinkEnd> &links = segments[segment].links[end];
+    auto key = std::make_pair(neighbor, neighborEnd);
+    auto it = std::upper_bound(links.begin(), links.end(), key, [](const pair<long int, short> &k, const LinkEnd &link){
+        return k.first < link.neighbor || (k.first == link.neighbor && k.second < link.end);
+    });
+    links.insert(it, LinkEnd{neighbor, neighborEnd, CIGAR});
+}
+
+static bool remove_end_of_link(vector<Segment> &segments, long int segment, short end, long int neighbor, short neighborEnd){
+    vector<LinkEnd> &links = segments[segment].links[end];
+    long int index = find_link(links, neighbor, neighborEnd);
+    if (index == -1){
+        return false;
+    }
+    links.erase(links.begin()+index);
+    return true;
+}
+
+static void add_link(vector<Segment> &segments, long int segment1, short end1, long int segment2, short end2, const string &CIGAR){
+    add_end_of_link(segments, segment1, end1, segment2, end2, CIGAR);
+    add_end_of_link(segments, segment2, end2, segment1, end1, CIGAR);
+}
+
+static void delete_link(vector<Segment> &segments, long int segment1, short end1, long int segment2, short end2){
+    remove_end_of_link(segments, segment1, end1, segment2, end2);
+    remove_end_of_link(segments, segment2, end2, segment1, end1);
+}
+
+//deletes all the links of a segment, on both sides
+static void cut_all_links(vector<Segment> &segments, long int segment){
+    std::array<vector<LinkEnd>, 2> links = std::move(segments[segment].links);
+    segments[segment].links = {};
+    for (short end = 0 ; end < 2 ; end++){
+        for (auto &link : links[end]){
+            if (link.neighbor != segment){
+                remove_end_of_link(segments, link.neighbor, link.end, segment, end);
+            }
+        }
+    }
+}
+
+//deletes the links that are given twice (e.g. by two lines of the GFA), except the links of an end with itself, which are always stored twice
+static void delete_links_present_twice(vector<Segment> &segments){
+    for (long int s = 0 ; s < segments.size() ; s++){
+        vector<pair<short, LinkEnd>> duplicates;
+        for (short end = 0 ; end < 2 ; end++){
+            const vector<LinkEnd> &links = segments[s].links[end];
+            for (long int l = 1 ; l < links.size() ; l++){
+                if (links[l].neighbor == links[l-1].neighbor && links[l].end == links[l-1].end && links[l].neighbor != s){
+                    duplicates.push_back(std::make_pair(end, links[l]));
+                }
+            }
+        }
+        for (auto &duplicate : duplicates){
+            remove_end_of_link(segments, duplicate.second.neighbor, duplicate.second.end, s, duplicate.first);
+            remove_end_of_link(segments, s, duplicate.first, duplicate.second.neighbor, duplicate.second.end);
+        }
+    }
+}
+
+/**
+ * @brief Parses the contigs and links of the GFA: each contig is a segment, with the same index
+ *
+ * @param file the GFA file, only used in the error messages
+ * @param text content of the GFA, which must outlive contigs
+ * @param contigs filled with the contigs of the GFA
+ * @param indices index of each contig, by name
+ * @param segments filled with one segment per contig
+ * @return false if a line cannot be read or if a link is towards a contig that is not in the GFA
+ */
+static bool load_gfa(string file, string_view text, vector<Contig> &contigs, robin_hood::unordered_map<string, long int> &indices, vector<Segment> &segments){
+    LineTokenizer lines(text);
+    string_view line;
+    vector<string_view> linkLines;
+    while (lines.next_line(line)){
+        if (line.substr(0, 2) == "S\t"){
+            string_view rest = line.substr(2);
+            string_view name, sequence, tags;
+            next_field(rest, name);
+            next_field(rest, sequence);
+            Contig contig {name, sequence == "*" ? string_view() : sequence, std::max((long int) sequence.size(), 1L), false, 0};
+            //the depth is a tag dp, DP, KC or RC of the fourth field, where the tags may be separated by spaces
+            next_field(rest, tags);
+            string_view tag;
+            while (next_field(tags, tag, ' ')){
+                if (tag.find("dp") != string_view::npos || tag.find("DP") != string_view::npos || tag.find("KC") != string_view::npos || tag.find("RC") != string_view::npos){
+                    contig.hasDepth = true;
+                    contig.depth = std::atof(string(tag.substr(tag.rfind(':')+1)).c_str());
+                }
+            }
+            indices[string(name)] = contigs.size();
+            contigs.push_back(contig);
+            Segment segment;
+            segment.contigs = {(long int) segments.size()};
+            segment.orientations = {1};
+            segment.length = contig.length;
+            segments.push_back(segment);
+        }
+        else if (line.substr(0, 2) == "L\t"){
+            linkLines.push_back(line);
+        }
+    }
+
+    for (auto linkLine : linkLines){
+        string_view rest = linkLine.substr(2);
+        string_view name1, orientation1, name2, orientation2, CIGAR;
+        if (!next_field(rest, name1) || !next_field(rest, orientation1) || !next_field(rest, name2) || !next_field(rest, orientation2)
+            || (orientation1 != "+" && orientation1 != "-") || (orientation2 != "+" && orientation2 != "-")){
+            cerr << "ERROR: could not read the link " << linkLine << " of " << file << endl;
+            return false;
+        }
+        if (!next_field(rest, CIGAR)){
+            CIGAR = "*";
+        }
+        auto contig1 = indices.find(string(name1));
+        auto contig2 = indices.find(string(name2));
+        if (contig1 == indices.end() || contig2 == indices.end()){
+            cerr << "ERROR: the link " << linkLine << " of " << file << " is between contigs that are not in the file" << endl;
+            return false;
+        }
+        long int s1 = contig1->second;
+        long int s2 = contig2->second;
+        short end1 = (orientation1 == "+") ? 1 : 0;
+        short end2 = (orientation2 == "+") ? 0 : 1;
+        //a link given by several lines is added once, but a link between an end and itself is stored on both sides of the link, i.e. twice on this end
+        if (find_link(segments[s1].links[end1], s2, end2) == -1 || (s1 == s2 && end1 == end2)){
+            add_end_of_link(segments, s1, end1, s2, end2, string(CIGAR));
+        }
+        if (find_link(segments[s2].links[end2], s1, end1) == -1 || (s1 == s2 && end1 == end2)){
+            add_end_of_link(segments, s2, end2, s1, end1, string(CIGAR));
+        }
+    }
+
+    delete_links_present_twice(segments);
+    return true;
+}
+
+//the paths of the reads going through more than one contig. The paths through contigs that are not in the GFA are ignored
+static vector<Path> read_gaf(string_view text, const robin_hood::unordered_map<string, long int> &indices){
+    vector<Path> paths;
+    LineTokenizer lines(text);
+    string_view line;
+    string name;
+    while (lines.next_line(line)){
+        string_view rest = line;
+        string_view field;
+        int nbFields = 0;
+        while (nbFields < 6 && next_field(rest, field)){
+            nbFields++;
+        }
+        string_view pathField = field;
+        if (nbFields < 6 || std::count_if(pathField.begin(), pathField.end(), [](char c){return c == '>' || c == '<';}) < 2){
+            continue;
+        }
+        Path path;
+        bool known = true;
+        size_t start = pathField.find_first_of("><");
+        while (known && start != string_view::npos){
+            size_t end = pathField.find_first_of("><", start+1);
+            name = pathField.substr(start+1, (end == string_view::npos ? pathField.size() : end)-start-1);
+            auto contig = indices.find(name);
+            if (contig == indices.end()){
+                known = false;
+            }
+            else{
+                path.contigs.push_back(contig->second);
+                path.orientations.push_back(pathField[start] == '>');
+            }
+            start = end;
+        }
+        if (known){
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
+static long int number_of_dead_ends(const vector<Segment> &segments){
+    long int deadEnds = 0;
+    for (auto &segment : segments){
+        if (!segment.deleted){
+            deadEnds += segment.links[0].empty() + segment.links[1].empty();
+        }
+    }
+    return deadEnds;
+}
+
+//deletes the links between two contigs that are not consecutive in any path
+static void remove_unsupported_links(vector<Segment> &segments, const vector<Path> &paths){
+    vector<std::array<long int, 4>> supported; //segment, end, neighbor, end of the neighbor
+    for (auto &path : paths){
+        for (long int c = 0 ; c+1 < path.contigs.size() ; c++){
+            supported.push_back({path.contigs[c], path.orientations[c], path.contigs[c+1], 1-path.orientations[c+1]});
+            supported.push_back({path.contigs[c+1], 1-path.orientations[c+1], path.contigs[c], path.orientations[c]});
+        }
+    }
+    std::sort(supported.begin(), supported.end());
+
+    vector<std::array<long int, 4>> toRemove;
+    for (long int s = 0 ; s < segments.size() ; s++){
+        for (short end = 0 ; end < 2 ; end++){
+            for (auto &link : segments[s].links[end]){
+                std::array<long int, 4> key = {s, end, link.neighbor, link.end};
+                if (!std::binary_search(supported.begin(), supported.end(), key)){
+                    toRemove.push_back(key);
+                }
+            }
+        }
+    }
+    std::sort(toRemove.begin(), toRemove.end());
+    toRemove.erase(std::unique(toRemove.begin(), toRemove.end()), toRemove.end());
+    for (auto &link : toRemove){
+        delete_link(segments, link[0], link[1], link[2], link[3]);
+    }
+}
+
+//cuts a path where two consecutive contigs are not linked in the graph
+static vector<Path> split_if_invalid(const Path &path, const vector<Segment> &segments){
+    vector<Path> subpaths;
+    long int first = 0;
+    for (long int c = 0 ; c < path.contigs.size() ; c++){
+        bool last = c+1 == path.contigs.size();
+        if (last || find_link(segments[path.contigs[c]].links[path.orientations[c]], path.contigs[c+1], 1-path.orientations[c+1]) == -1){
+            Path subpath;
+            subpath.contigs.assign(path.contigs.begin()+first, path.contigs.begin()+c+1);
+            subpath.orientations.assign(path.orientations.begin()+first, path.orientations.begin()+c+1);
+            subpaths.push_back(subpath);
+            first = c+1;
+        }
+    }
+    return subpaths;
+}
+
+//removes the ends of a path that go along a straight line, where they cannot tell anything about how to unzip the graph
+static void trim_path(Path &path, const vector<Segment> &segments){
+    const vector<long int> &contigs = path.contigs;
+    const vector<char> &orientations = path.orientations;
+    long int n = contigs.size();
+    long int trimBeginning = 0;
+    while (trimBeginning < n-1 && segments[contigs[trimBeginning]].links[orientations[trimBeginning]].size() == 1
+        && segments[contigs[trimBeginning+1]].links[1-orientations[trimBeginning+1]].size() == 1){
+        trimBeginning++;
+    }
+    long int trimEnd = 0;
+    while (trimEnd < n-1-trimBeginning && segments[contigs[n-1-trimEnd]].links[1-orientations[n-1-trimEnd]].size() == 1
+        && segments[contigs[n-2-trimEnd]].links[orientations[n-2-trimEnd]].size() == 1){
+        trimEnd++;
+    }
+    path.contigs = vector<long int>(contigs.begin()+trimBeginning, contigs.begin()+n-trimEnd);
+    path.orientations = vector<char>(orientations.begin()+trimBeginning, orientations.begin()+n-trimEnd);
+}
+
+typedef std::map<std::tuple<long int, short, long int, int>, long int> ExtendedLengths;
+
+//the longest chain of neighbors of neighbors... starting from this end of segment, up to thresholdLength bases or thresholdContigs segments.
+//The chains through loops are exponentially many: the lengths already computed are kept in memo
+static long int extended_length(const vector<Segment> &segments, long int segment, short end, long int thresholdLength, int thresholdContigs, ExtendedLengths &memo){
+    const Segment &s = segments[segment];
+    if (thresholdContigs == 0 || thresholdLength <= 0){
+        return s.length;
+    }
+    auto key = std::make_tuple(segment, end, thresholdLength, thresholdContigs);
+    auto known = memo.find(key);
+    if (known != memo.end()){
+        return known->second;
+    }
+    long int maxLength = 0;
+    for (auto &link : s.links[1-end]){
+        maxLength = std::max(maxLength, extended_length(segments, link.neighbor, link.end, thresholdLength-s.length, thresholdContigs-1, memo));
+    }
+    memo[key] = maxLength + s.length;
+    return maxLength + s.length;
+}
+
+//deletes the links towards branches that are much shorter than the longest branch at the same end
+static void detach_tips(vector<Segment> &segments){
+    const long int maxTipLength = 20000;
+    bool changes = true;
+    while (changes){
+        changes = false;
+        for (long int s = 0 ; s < segments.size() ; s++){
+            for (short end = 0 ; end < 2 ; end++){
+                const vector<LinkEnd> &links = segments[s].links[end];
+                if (segments[s].deleted || links.size() < 2){
+                    continue;
+                }
+                vector<long int> lengths;
+                ExtendedLengths memo;
+                for (auto &link : links){
+                    lengths.push_back(extended_length(segments, link.neighbor, link.end, maxTipLength*5, 100, memo));
+                }
+                long int maxLength = *std::max_element(lengths.begin(), lengths.end());
+                vector<pair<long int, short>> toDelete;
+                for (long int l = 0 ; l < links.size() ; l++){
+                    if (5*lengths[l] < maxLength && maxLength > 10000){
+                        toDelete.push_back(std::make_pair(links[l].neighbor, links[l].end));
+                    }
+                }
+                toDelete.erase(std::unique(toDelete.begin(), toDelete.end()), toDelete.end());
+                for (auto &link : toDelete){
+                    delete_link(segments, s, end, link.first, link.second);
+                    changes = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Duplicates the segments through which the reads take distinct pairs of neighbors (simple_unzip of GraphUnzip)
+ *
+ * @param segments the graph, modified
+ * @param readPaths the paths of the reads on the graph
+ */
+static void simple_unzip(vector<Segment> &segments, const vector<Path> &readPaths){
+
+    long int deadEnds = number_of_dead_ends(segments);
+    remove_unsupported_links(segments, readPaths);
+    long int deadEndsNow = number_of_dead_ends(segments);
+    //if too many dead ends were created, the graph cannot be untangled
+    if (deadEndsNow > segments.size()/2.0 && deadEndsNow > deadEnds*2){
+        cout << "WARNING: the graph cannot be untangled properly. That is probably because the reads are too short. The result remains valid, albeit less contiguous." << endl;
+        return;
+    }
+
+    vector<Path> paths;
+    for (auto &path : readPaths){
+        for (auto &subpath : split_if_invalid(path, segments)){
+            trim_path(subpath, segments);
+            paths.push_back(subpath);
+        }
+    }
+    vector<vector<pair<long int, long int>>> pathsOfSegment (segments.size()); //path and position in the path
+    for (long int p = 0 ; p < paths.size() ; p++){
+        for (long int c = 0 ; c < paths[p].contigs.size() ; c++){
+            pathsOfSegment[paths[p].contigs[c]].push_back(std::make_pair(p, c));
+        }
+    }
+
+    //the path starts or ends on a dead end of the segment at position
+    auto dead_end = [&](const Path &path, long int position, const Segment &segment, bool start){
+        short o = path.orientations[position];
+        if (start){
+            return position == 0 && segment.links[1-o].empty();
+        }
+        return position+1 == path.contigs.size() && segment.links[o].empty();
+    };
+
+    bool goOn = true;
+    while (goOn){
+        goOn = false;
+        for (long int s = 0 ; s < segments.size() ; s++){
+            if (segments[s].links[0].size() < 2 && segments[s].links[1].size() < 2){
+                continue;
+            }
+
+            //pairs of links (at the left end, at the right end, -2 at a dead end) taken by the paths that go through the segment, in the order they are found
+            vector<pair<long int, long int>> pairs;
+            vector<int> counts;
+            vector<vector<pair<long int, long int>>> pathsOfPairs;
+            std::map<pair<long int, long int>, long int> indexOfPair;
+            //GraphUnzip cancels the paths with the dead end flags of the last path looked at, computed without the position for one end
+            bool lastDeadEndLeft = false;
+            bool lastDeadEndRight = false;
+            for (auto &p : pathsOfSegment[s]){
+                const Path &path = paths[p.first];
+                long int position = p.second;
+                const Segment &segment = segments[s];
+                if (path.contigs.empty()){
+                    continue;
+                }
+                bool deadEndLeft = dead_end(path, position, segment, true);
+                bool deadEndRight = dead_end(path, position, segment, false);
+                short o = path.orientations[position];
+                lastDeadEndLeft = (position == 0 && segment.links[0].empty() && o == 1) || (segment.links[1].empty() && o == 0);
+                lastDeadEndRight = (position+1 == path.contigs.size() && segment.links[0].empty() && o == 0) || (segment.links[1].empty() && o == 1);
+                if ((position == 0 && !deadEndLeft) || (position+1 == path.contigs.size() && !deadEndRight)){
+                    continue;
+                }
+                long int indexLeft = -2;
+                if (position > 0){
+                    indexLeft = find_link(segment.links[1-o], path.contigs[position-1], path.orientations[position-1]);
+                    if (indexLeft == -1){
+                        continue;
+                    }
+                }
+                long int indexRight = -2;
+                if (position+1 < path.contigs.size()){
+                    indexRight = find_link(segment.links[o], path.contigs[position+1], 1-path.orientations[position+1]);
+                }
+                auto pair = (o == 1) ? std::make_pair(indexLeft, indexRight) : std::make_pair(indexRight, indexLeft);
+                auto found = indexOfPair.find(pair);
+                if (found == indexOfPair.end()){
+                    found = indexOfPair.emplace(pair, pairs.size()).first;
+                    pairs.push_back(pair);
+                    counts.push_back(0);
+                    pathsOfPairs.push_back({});
+                }
+                counts[found->second]++;
+                pathsOfPairs[found->second].push_back(p);
+            }
+
+            //the pairs kept are the ones taken by at least 3 reads, and the best pair of each link
+            std::array<vector<pair<int, long int>>, 2> bestPairOfLink = {vector<pair<int, long int>>(segments[s].links[0].size(), {-1, -1}),
+                vector<pair<int, long int>>(segments[s].links[1].size(), {-1, -1})};
+            for (long int p = 0 ; p < pairs.size() ; p++){
+                if (pairs[p].first > -1 && bestPairOfLink[0][pairs[p].first].first < counts[p]){
+                    bestPairOfLink[0][pairs[p].first] = std::make_pair(counts[p], p);
+                }
+                if (pairs[p].second > -1 && bestPairOfLink[1][pairs[p].second].first < counts[p]){
+                    bestPairOfLink[1][pairs[p].second] = std::make_pair(counts[p], p);
+                }
+            }
+            vector<long int> kept;
+            vector<bool> isKept (pairs.size(), false);
+            bool duplicate = false;
+            for (long int p = 0 ; p < pairs.size() ; p++){
+                if (counts[p] >= 3){
+                    kept.push_back(p);
+                    isKept[p] = true;
+                    duplicate = true;
+                }
+            }
+            for (short end = 0 ; end < 2 ; end++){
+                for (auto &best : bestPairOfLink[end]){
+                    if (best.first > 0 && !isKept[best.second]){
+                        kept.push_back(best.second);
+                        isKept[best.second] = true;
+                    }
+                }
+            }
+            if (!duplicate){
+                continue;
+            }
+
+            //one copy of the segment per pair, which replaces the segment in the paths of the pair
+            for (long int p : kept){
+                long int copy = segments.size();
+                Segment newSegment;
+                newSegment.contigs = segments[s].contigs;
+                newSegment.orientations = segments[s].orientations;
+                newSegment.insideCIGARs = segments[s].insideCIGARs;
+                newSegment.length = segments[s].length;
+                segments.push_back(newSegment);
+                for (short end = 0 ; end < 2 ; end++){
+                    long int index = (end == 0) ? pairs[p].first : pairs[p].second;
+                    if (index >= 0){
+                        //copy of the link: adding the link may move the links of the segment, if it is linked with itself
+                        LinkEnd link = segments[s].links[end][index];
+                        add_link(segments, link.neighbor, link.end, copy, end, link.CIGAR);
+                    }
+                }
+                for (auto &pathOfPair : pathsOfPairs[p]){
+                    std::replace(paths[pathOfPair.first].contigs.begin(), paths[pathOfPair.first].contigs.end(), s, copy);
+                }
+                pathsOfSegment.push_back(pathsOfPairs[p]);
+            }
+
+            //the other paths through the segment are not used anymore
+            for (auto &p : pathsOfSegment[s]){
+                Path &path = paths[p.first];
+                if (path.contigs.empty() || (p.second == 0 && lastDeadEndLeft) || (p.second+1 == path.contigs.size() && lastDeadEndRight)){
+                    continue;
+                }
+                if (std::find(path.contigs.begin(), path.contigs.end(), s) != path.contigs.end()){
+                    path.contigs.clear();
+                    path.orientations.clear();
+                }
+            }
+
+            cut_all_links(segments, s);
+            segments[s].deleted = true;
+            pathsOfSegment[s].clear();
+            goOn = true;
+        }
+    }
+
+    detach_tips(segments);
+}
+
+//merges segment with its only neighbor at end, the merged segment being added at the end of the graph
+static void merge_two_segments(vector<Segment> &segments, long int segment1, short end1){
+    const Segment &s1 = segments[segment1];
+    long int segment2 = s1.links[end1][0].neighbor;
+    short end2 = s1.links[end1][0].end;
+    const Segment &s2 = segments[segment2];
+
+    Segment merged;
+    //s1 is reversed if it is merged by its left end, s2 if it is merged by its right end
+    for (long int c = 0 ; c < s1.contigs.size() ; c++){
+        long int i = (end1 == 1) ? c : s1.contigs.size()-1-c;
+        merged.contigs.push_back(s1.contigs[i]);
+        merged.orientations.push_back(end1 == 1 ? s1.orientations[i] : 1-s1.orientations[i]);
+        if (c+1 < s1.contigs.size()){
+            merged.insideCIGARs.push_back(s1.insideCIGARs[end1 == 1 ? c : s1.insideCIGARs.size()-1-c]);
+        }
+    }
+    merged.insideCIGARs.push_back(s1.links[end1][0].CIGAR);
+    for (long int c = 0 ; c < s2.contigs.size() ; c++){
+        long int i = (end2 == 0) ? c : s2.contigs.size()-1-c;
+        merged.contigs.push_back(s2.contigs[i]);
+        merged.orientations.push_back(end2 == 0 ? s2.orientations[i] : 1-s2.orientations[i]);
+        if (c+1 < s2.contigs.size()){
+            merged.insideCIGARs.push_back(s2.insideCIGARs[end2 == 0 ? c : s2.insideCIGARs.size()-1-c]);
+        }
+    }
+    merged.length = s1.length + s2.length;
+    merged.links[0] = s1.links[1-end1];
+    merged.links[1] = s2.links[1-end2];
+
+    long int m = segments.size();
+    segments.push_back(merged);
+    string selfLoopCIGAR;
+    bool selfLoop = false;
+    for (short end = 0 ; end < 2 ; end++){
+        vector<LinkEnd> links = segments[m].links[end];
+        for (auto &link : links){
+            add_end_of_link(segments, link.neighbor, link.end, m, end, link.CIGAR);
+            //the far end of s1 linked with the far end of s2: the merged segment loops on itself
+            if (end == 0 && link.neighbor == segment2 && link.end == 1-end2){
+                selfLoop = true;
+                selfLoopCIGAR = link.CIGAR;
+            }
+        }
+    }
+    if (selfLoop){
+        add_link(segments, m, 0, m, 1, selfLoopCIGAR);
+    }
+
+    //the links that pointed towards the two merged segments now point towards the merged segment only
+    for (short side = 0 ; side < 2 ; side++){
+        long int segment = (side == 0) ? segment1 : segment2;
+        short farEnd = (side == 0) ? 1-end1 : 1-end2;
+        vector<LinkEnd> links = segments[segment].links[farEnd];
+        for (auto &link : links){
+            remove_end_of_link(segments, link.neighbor, link.end, segment, farEnd);
+        }
+    }
+    segments[segment1].deleted = true;
+    segments[segment2].deleted = true;
+}
+
+//the segments that are not deleted, in the order of creation, accessed by rank (Fenwick tree of the segments)
+class SegmentList{
+
+public :
+    SegmentList(long int capacity) : tree(capacity+1, 0), nbSegments(0) {}
+
+    void insert(long int segment) {update(segment, 1);}
+    void erase(long int segment) {update(segment, -1);}
+    long int size() const {return nbSegments;}
+
+    //the segment at this rank
+    long int at(long int rank) const{
+        long int position = 0;
+        long int step = 1;
+        while (step*2 < tree.size()){
+            step *= 2;
+        }
+        for ( ; step > 0 ; step /= 2){
+            if (position+step < tree.size() && tree[position+step] <= rank){
+                position += step;
+                rank -= tree[position];
+            }
+        }
+        return position;
+    }
+
+private :
+    void update(long int segment, int delta){
+        nbSegments += delta;
+        for (long int i = segment+1 ; i < tree.size() ; i += i & -i){
+            tree[i] += delta;
+        }
+    }
+
+    vector<long int> tree;
+    long int nbSegments;
+};
+
+//merges all the pairs of segments linked only with each other
+static void merge_adjacent_contigs(vector<Segment> &segments){
+    //GraphUnzip goes through its list of segments while it removes the merged segments from the list and appends the new ones, thus skipping
+    //the segments that follow a removed one. The segments are merged in the same order, so that e.g. the circular contigs start at the same contig
+    SegmentList list (2*segments.size());
+    for (long int s = 0 ; s < segments.size() ; s++){
+        if (!segments[s].deleted){
+            list.insert(s);
+        }
+    }
+    bool goOn = true;
+    while (goOn){
+        goOn = false;
+        for (long int rank = 0 ; rank < list.size() ; rank++){
+            long int s = list.at(rank);
+            for (short end = 0 ; end < 2 ; end++){
+                const vector<LinkEnd> &links = segments[s].links[end];
+                if (links.size() == 1 && segments[links[0].neighbor].links[links[0].end].size() == 1){
+                    long int neighbor = links[0].neighbor;
+                    if (neighbor != s){
+                        merge_two_segments(segments, s, end);
+                        list.erase(s);
+                        list.erase(neighbor);
+                        list.insert(segments.size()-1);
+                        goOn = true;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+//true if the CIGAR has only matches, e.g. 120M
+static bool only_matches(const string &CIGAR){
+    return std::all_of(CIGAR.begin(), CIGAR.end(), [](char c){return (c >= '0' && c <= '9') || c == 'M';});
+}
+
+static void set_CIGAR(vector<Segment> &segments, long int segment, short end, long int neighbor, short neighborEnd, const string &CIGAR){
+    vector<LinkEnd> &links = segments[segment].links[end];
+    long int index = find_link(links, neighbor, neighborEnd);
+    if (index != -1){
+        links[index].CIGAR = CIGAR;
+    }
+}
+
+//removes from the ends of the segments the overlaps they have with all their neighbors, and shortens the overlaps of the links accordingly
+static void trim_overlaps(vector<Segment> &segments){
+    bool changes = true;
+    while (changes){
+        changes = false;
+        for (long int s = 0 ; s < segments.size() ; s++){
+            if (segments[s].deleted){
+                continue;
+            }
+            std::array<long int, 2> minOverlap = {0, 0};
+            std::array<long int, 2> maxOverlap = {0, 0};
+            std::array<bool, 2> onlyM = {false, false};
+            for (short end = 0 ; end < 2 ; end++){
+                const vector<LinkEnd> &links = segments[s].links[end];
+                onlyM[end] = !links.empty() && std::all_of(links.begin(), links.end(), [](const LinkEnd &link){return only_matches(link.CIGAR);});
+                if (onlyM[end]){
+                    minOverlap[end] = std::atol(links[0].CIGAR.c_str());
+                    for (auto &link : links){
+                        minOverlap[end] = std::min(minOverlap[end], std::atol(link.CIGAR.c_str()));
+                        maxOverlap[end] = std::max(maxOverlap[end], std::atol(link.CIGAR.c_str()));
+                    }
+                }
+            }
+            std::array<long int, 2> trim = {std::min(minOverlap[0], segments[s].length-maxOverlap[1]), std::min(minOverlap[1], segments[s].length-maxOverlap[0])};
+            segments[s].trim[0] += trim[0];
+            segments[s].trim[1] += trim[1];
+            changes = changes || trim[0] > 0 || trim[1] > 0;
+
+            for (short end = 0 ; end < 2 ; end++){
+                if (!onlyM[end]){
+                    continue;
+                }
+                vector<LinkEnd> links = segments[s].links[end];
+                for (auto &link : links){
+                    string CIGAR = std::to_string(std::atol(link.CIGAR.c_str())-trim[end]) + "M";
+                    set_CIGAR(segments, link.neighbor, link.end, s, end, CIGAR);
+                    set_CIGAR(segments, s, end, link.neighbor, link.end, CIGAR);
+                }
+            }
+        }
+    }
+}
+
+static string reverse_complement(string_view sequence){
+    string rc (sequence.rbegin(), sequence.rend());
+    for (char &c : rc){
+        switch (c){
+            case 'A' : c = 'T'; break;
+            case 'C' : c = 'G'; break;
+            case 'G' : c = 'C'; break;
+            case 'T' : c = 'A'; break;
+            case 'a' : c = 't'; break;
+            case 'c' : c = 'g'; break;
+            case 'g' : c = 'c'; break;
+            case 't' : c = 'a'; break;
+        }
+    }
+    return rc;
+}
+
+//sum of the lengths of the operations of a CIGAR, 0 for *
+static long int CIGAR_length(string_view CIGAR){
+    long int length = 0;
+    long int number = 0;
+    for (char c : CIGAR){
+        if (c >= '0' && c <= '9'){
+            number = number*10 + (c-'0');
+        }
+        else{
+            length += number;
+            number = 0;
+        }
+    }
+    return length + number;
+}
+
+//the shortest decimal representation of value that reads back as value, as Python prints its floats (e.g. 15.0 or 7.333333333333333)
+static string python_float(double value){
+    char buffer[400];
+    double magnitude = std::fabs(value);
+    bool scientific = magnitude != 0 && (magnitude < 1e-4 || magnitude >= 1e16);
+    auto result = std::to_chars(buffer, buffer+sizeof(buffer), value, scientific ? std::chars_format::scientific : std::chars_format::fixed);
+    string text (buffer, result.ptr);
+    if (!scientific && text.find('.') == string::npos){
+        text += ".0";
+    }
+    return text;
+}
+
+/**
+ * @brief Writes the segments as supercontigs, longest first, the list of the contigs of each supercontig in supercontigs.txt next to the GFA
+ * and the statistics of the supercontigs in supercontigs_stats.tsv
+ *
+ * @param segments the graph
+ * @param contigs the contigs of the input GFA
+ * @param file the output GFA
+ * @param fasta if not null, the sequences of the supercontigs are also written there
+ * @return false if a file cannot be written
+ */
+static bool export_to_GFA(const vector<Segment> &segments, const vector<Contig> &contigs, string file, FastaWriter *fasta){
+    vector<long int> order;
+    for (long int s = 0 ; s < segments.size() ; s++){
+        if (!segments[s].deleted){
+            order.push_back(s);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](long int a, long int b){return segments[a].length > segments[b].length;});
+    vector<long int> rank (segments.size(), -1);
+    for (long int r = 0 ; r < order.size() ; r++){
+        rank[order[r]] = r;
+    }
+    //the copies of a contig are numbered in the order of the supercontigs, and the depth of the contig is shared between its copies
+    vector<long int> copies (contigs.size(), 0);
+    vector<vector<long int>> copyOfContigs (segments.size());
+    for (long int s : order){
+        for (long int contig : segments[s].contigs){
+            copyOfContigs[s].push_back(copies[contig]++);
+        }
+    }
+
+    size_t slash = file.rfind('/');
+    string folder = (slash == string::npos) ? "" : file.substr(0, slash+1);
+    string supercontigsFile = folder + "supercontigs.txt";
+    string statsFile = folder + "supercontigs_stats.tsv";
+    BufferedWriter out (file);
+    BufferedWriter supercontigs (supercontigsFile);
+    BufferedWriter stats (statsFile, 1 << 16);
+    stats << "name\tlength\tdepth\tcontigs\tlinks\n";
+    vector<long int> lengths;
+    string sequence;
+    for (long int r = 0 ; r < order.size() ; r++){
+        const Segment &segment = segments[order[r]];
+        string name = "supercontig_" + std::to_string(r);
+        supercontigs << name << "\t";
+        for (long int c = 0 ; c < segment.contigs.size() ; c++){
+            supercontigs << (c > 0 ? "_" : "") << contigs[segment.contigs[c]].name << "-" << copyOfContigs[order[r]][c];
+        }
+        supercontigs << "\n";
+
+        sequence.clear();
+        double depth = 0;
+        for (long int c = 0 ; c < segment.contigs.size() ; c++){
+            const Contig &contig = contigs[segment.contigs[c]];
+            string piece = segment.orientations[c] ? string(contig.sequence) : reverse_complement(contig.sequence);
+            if (c > 0){
+                piece.erase(0, std::min((size_t) CIGAR_length(segment.insideCIGARs[c-1]), piece.size()));
+            }
+            if (contig.hasDepth){
+                depth += contig.depth / copies[segment.contigs[c]] * piece.size();
+            }
+            sequence += piece;
+        }
+        long int start = std::clamp(segment.trim[0], 0L, (long int) sequence.size());
+        long int end = std::clamp((long int) sequence.size()-segment.trim[1], start, (long int) sequence.size());
+        string_view trimmed = string_view(sequence).substr(start, end-start);
+
+        string depthText = (depth != 0 && !trimmed.empty()) ? python_float(depth/trimmed.size()) : "";
+        out << "S\t" << name << "\t" << trimmed;
+        if (!depthText.empty()){
+            out << "\tDP:f:" << depthText;
+        }
+        out << "\n";
+        if (fasta != nullptr && !trimmed.empty()){
+            fasta->write(name, trimmed);
+        }
+        stats << name << "\t" << trimmed.size() << "\t" << (depthText.empty() ? "0.0" : depthText) << "\t" << segment.contigs.size() << "\t"
+            << segment.links[0].size() + segment.links[1].size() << "\n";
+        lengths.push_back(trimmed.size());
+        //each link is written once, by the segment created first
+        for (short end = 0 ; end < 2 ; end++){
+            for (auto &link : segment.links[end]){
+                if (order[r] < link.neighbor){
+                    out << "L\t" << name << "\t" << (end == 0 ? "-" : "+") << "\tsupercontig_" << rank[link.neighbor] << "\t" << (link.end == 1 ? "-" : "+")
+                        << "\t" << link.CIGAR << "\n";
+                }
+            }
+        }
+    }
+    if (!out.close()){
+        cerr << "ERROR: could not write " << file << endl;
+        return false;
+    }
+    if (!supercontigs.close()){
+        cerr << "ERROR: could not write " << supercontigsFile << endl;
+        return false;
+    }
+    if (!stats.close()){
+        cerr << "ERROR: could not write " << statsFile << endl;
+        return false;
+    }
+
+    //N50 of the trimmed supercontigs, which are ordered on their length before the trimming
+    std::sort(lengths.begin(), lengths.end(), std::greater<long int>());
+    long int total = 0;
+    for (long int length : lengths){
+        total += length;
+    }
+    long int N50 = 0;
+    long int cumulated = 0;
+    for (long int length : lengths){
+        cumulated += length;
+        if (2*cumulated >= total){
+            N50 = length;
+            break;
+        }
+    }
+    cout << "Wrote " << lengths.size() << " supercontigs of " << total << " bases in total, N50 " << N50 << endl;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4 && argc != 5){
+        cout << "Usage: ./graph_unzip <graph.gfa> <paths.gaf> <output.gfa> [<output.fasta>|<output.fasta.gz>]" << endl;
+        cout << "Unzips the graph with the paths of the reads, as GraphUnzip/graphunzip.py unzip -g graph.gfa -l paths.gaf -o output.gfa does" << endl;
+        cout << "The sequences are also written in output.fasta with its .fai index (bgzipped if it ends in .gz), as gfa2fa would write them" << endl;
+        return 1;
+    }
+
+    MappedFile gfa (argv[1]);
+    if (!gfa.good()){
+        cerr << "ERROR: could not open " << argv[1] << endl;
+        return 1;
+    }
+    vector<Contig> contigs;
+    robin_hood::unordered_map<string, long int> indices;
+    vector<Segment> segments;
+    if (!load_gfa(argv[1], gfa.view(), contigs, indices, segments)){
+        return 1;
+    }
+    if (segments.empty()){
+        cerr << "ERROR: could not read any contig in " << argv[1] << endl;
+        return 1;
+    }
+
+    MappedFile gaf (argv[2]);
+    if (!gaf.good()){
+        cerr << "ERROR: could not open " << argv[2] << endl;
+        return 1;
+    }
+    vector<Path> paths = read_gaf(gaf.view(), indices);
+    cout << "Unzipping the graph of " << contigs.size() << " contigs with " << paths.size() << " read paths" << endl;
+
+    simple_unzip(segments, paths);
+    merge_adjacent_contigs(segments);
+    delete_links_present_twice(segments);
+    trim_overlaps(segments);
+
+    std::unique_ptr<FastaWriter> fasta;
+    if (argc == 5){
+        fasta.reset(new FastaWriter(argv[4]));
+    }
+    if (!export_to_GFA(segments, contigs, argv[3], fasta.get())){
+        return 1;
+    }
+    if (fasta && !fasta->close()){
+        cerr << "ERROR: could not write " << argv[4] << endl;
+        return 1;
+    }
+    return 0;
+}
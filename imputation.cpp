@@ -0,0 +1,122 @@
+#include "imputation.h"
+#include "bitmatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using std::vector;
+using std::pair;
+
+//first and last known columns of each row, -1 for the rows without any known value
+static void known_spans(const BitMatrix &matrix, vector<int> &first, vector<int> &last){
+    first.assign(matrix.rows(), -1);
+    last.assign(matrix.rows(), -1);
+    for (int r = 0 ; r < matrix.rows() ; r++){
+        const uint64_t* known = matrix.known(r);
+        for (size_t w = 0 ; w < matrix.words_per_row() ; w++){
+            if (known[w] != 0){
+                if (first[r] < 0){
+                    first[r] = w*64 + __builtin_ctzll(known[w]);
+                }
+                last[r] = w*64 + 63 - __builtin_clzll(known[w]);
+            }
+        }
+    }
+}
+
+void knn_impute(const BitMatrix &matrix, int nNeighbors, int minShared, int numThreads, double* out){
+
+    int m = matrix.rows();
+    int n = matrix.cols();
+    minShared = std::max(1, minShared);
+
+    //means of the columns, used for the reads that have no neighbour knowing the column
+    vector<int> onesInCol (n, 0);
+    vector<int> knownInCol (n, 0);
+    for (int r = 0 ; r < m ; r++){
+        for (int c = 0 ; c < n ; c++){
+            int v = matrix.value(r, c);
+            knownInCol[c] += (v != -1);
+            onesInCol[c] += (v == 1);
+        }
+    }
+
+    //reads sorted by the first column they know: the reads overlapping a read are in a prefix of this order
+    vector<int> first, last;
+    known_spans(matrix, first, last);
+    vector<int> order;
+    for (int r = 0 ; r < m ; r++){
+        if (first[r] >= 0){
+            order.push_back(r);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){return first[a] < first[b];});
+    vector<int> sortedFirsts;
+    for (int r : order){
+        sortedFirsts.push_back(first[r]);
+    }
+
+    #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for (int r = 0 ; r < m ; r++){
+
+        vector<int> missing;
+        for (int c = 0 ; c < n ; c++){
+            int v = matrix.value(r, c);
+            out[(size_t) r*n+c] = v;
+            if (v == -1){
+                missing.push_back(c);
+            }
+        }
+        if (missing.empty()){
+            continue;
+        }
+
+        //neighbours sorted by distance: the squared nan-euclidean distance is proportional to the proportion of mismatches on the shared columns
+        vector<pair<double,int>> neighbours;
+        if (first[r] >= 0){
+            size_t end = std::upper_bound(sortedFirsts.begin(), sortedFirsts.end(), last[r]) - sortedFirsts.begin();
+            for (size_t i = 0 ; i < end ; i++){
+                int d = order[i];
+                if (d == r || last[d] < first[r]){
+                    continue;
+                }
+                //only the words of the overlap of the two reads
+                size_t w0 = std::max(first[r], first[d])/64;
+                size_t w1 = std::min(last[r], last[d])/64 + 1;
+                int shared = popcount_and(matrix.known(r)+w0, matrix.known(d)+w0, w1-w0);
+                if (shared >= minShared){
+                    int mismatches = popcount_mismatches(matrix.ones(r)+w0, matrix.known(r)+w0, matrix.ones(d)+w0, matrix.known(d)+w0, w1-w0);
+                    neighbours.push_back({double(mismatches)/shared, d});
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+        }
+
+        for (int c : missing){
+            int taken = 0;
+            int ones = 0;
+            for (size_t i = 0 ; i < neighbours.size() && taken < nNeighbors ; i++){
+                int v = matrix.value(neighbours[i].second, c);
+                if (v != -1){
+                    taken++;
+                    ones += v;
+                }
+            }
+            if (taken > 0){
+                out[(size_t) r*n+c] = double(ones)/taken;
+            }
+            else if (knownInCol[c] > 0){
+                out[(size_t) r*n+c] = double(onesInCol[c])/knownInCol[c];
+            }
+            else{
+                out[(size_t) r*n+c] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+}
+
+void sm_knn_impute(const PackedMatrix* matrix, int nNeighbors, int minShared, int numThreads, double* out){
+    knn_impute(matrix->byRow, nNeighbors, minShared, numThreads, out);
+}
@@ -0,0 +1,28 @@
+#ifndef IMPUTATION_H
+#define IMPUTATION_H
+
+#include <vector>
+#include <cstdint>
+
+class BitMatrix;
+struct PackedMatrix;
+
+/**
+ * @brief Fills the missing values of a 1/0/missing matrix as sklearn's KNNImputer(n_neighbors) with uniform weights: each missing value
+ * is the mean of the column over the nearest reads (nan-euclidean distance) that know it, or the mean of the column if no read is near.
+ * Only the reads whose spans of known columns overlap are compared, on the bitplanes of the matrix
+ *
+ * @param matrix the packed matrix
+ * @param nNeighbors number of neighbours averaged
+ * @param minShared minimum number of columns known in both reads for them to be neighbours
+ * @param numThreads number of threads
+ * @param out filled with the row-major imputed matrix, NaN in the columns without any known value
+ */
+void knn_impute(const BitMatrix &matrix, int nNeighbors, int minShared, int numThreads, double* out);
+
+//C interface, loaded with ctypes from strainminer.py
+extern "C" {
+    void sm_knn_impute(const PackedMatrix* matrix, int nNeighbors, int minShared, int numThreads, double* out);
+}
+
+#endif
@@ -8,6 +8,9 @@
 
 #include "input_output.h"
 #include "tools.h"
+#include "tokenizer.h"
+#include "bam.h"
+#include "buffered_writer.h"
 
 using std::cout;
 using std::endl;
@@ -19,6 +22,7 @@ using std::make_tuple;
 using std::get;
 using std::make_pair;
 using std::string;
+using std::string_view;
 using std::ofstream;
 using std::ifstream;
 using std::array;
@@ -30,78 +34,33 @@ using robin_hood::unordered_map;
 
 
 /**
- * @brief Parses a fasta or fastq file and stores the reads in allreads
+ * @brief Stores the reads of a fasta or fastq file in allreads, without their sequences
  * 
- * @param fileReads file containing all reads in fastq or fasta format
+ * @param readsIndex index of the file containing all reads in fastq or fasta format
  * @param allreads vector to store the reads
  * @param indices maps the name of a read to its index in allreads
+ * @param selectedReads if not null, only these reads are stored (they keep their position in the file)
  */
-void parse_reads(std::string fileReads, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices){
+void parse_reads(ReadsIndex &readsIndex, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices,
+    const robin_hood::unordered_set<std::string>* selectedReads){
 
-    char format = '@'; //a character to keep track of whether the input file is a fasta or a fastq
-    if ((fileReads.size()>6 && fileReads.substr(fileReads.size()-6,6) == ".fasta") || fileReads.substr(fileReads.size()-3,3) == ".fa"){
-        format = '>';
-    }
-
-    ifstream in(fileReads);
-    if (!in){
-        cout << "problem reading files in index_reads, while trying to read " << fileReads << endl;
-        throw std::invalid_argument( "Input file could not be read" );
-    }
-
-    long int sequenceID = 0; //counting the number of sequences we have already seen 
-
-    string line;
-    vector<string> buffer;
-    long int linecount = 0;
-    long int lastoffset = 0;
-    long int offset = 0;
-
-    while(getline(in, line)){
-
-        if (line[0] == format && (buffer.size() == 4 && format == '@' || buffer.size() == 2 && format == '>')){
-            //then first we append the last read we saw
-
-            ///parse the name of the sequence as it will appear in minimap (i.e. up to the first blank space)
-            string nameOfSequence = "";
-            std::stringstream line2(buffer[0].substr(1)); //exclude the first character (either @ or >)
-            std::getline(line2, nameOfSequence, ' ');
-
-            Read r("", buffer[1].size()); //append the read without the sequence to be light on memory. The sequences are only needed when they are needed
-            r.name = nameOfSequence;
-            r.set_position_in_file(lastoffset+buffer[0].size()+1);
-            lastoffset = offset;
-            allreads.push_back(r);
+    long int sequenceID = allreads.size(); //counting the number of sequences we have already seen 
 
-            ///link the minimap name to the index in allreads
-            indices[nameOfSequence] = sequenceID;
-            sequenceID++;
+    for (size_t record = 0 ; record < readsIndex.size() ; record++){
 
-            //then we reset the buffer
-            buffer = {line};
-        }
-        else {
-            buffer.push_back(line);
+        const FaiEntry &entry = readsIndex.entry(record);
+        if (selectedReads != nullptr && selectedReads->find(entry.name) == selectedReads->end()){
+            continue;
         }
-
-        linecount++;
-        offset += 1+line.size();
+        Read r("", entry.length); //append the read without the sequence to be light on memory. The sequences are only needed when they are needed
+        r.name = entry.name;
+        r.set_position_in_file(record);
+        allreads.push_back(r);
+
+        ///link the minimap name to the index in allreads
+        indices[entry.name] = sequenceID;
+        sequenceID++;
     }
-
-    //now append the last read
-    string nameOfSequence = "";
-    std::stringstream line2(buffer[0].substr(1)); //exclude the first character (either @ or >)
-    std::getline(line2, nameOfSequence, ' ');
-
-    Read r("", buffer[1].size());//append the read without the sequence to be light on memory. The sequences are only needed when they are needed
-    r.set_position_in_file(lastoffset+buffer[0].size()+1);
-    r.name = nameOfSequence;
-    allreads.push_back(r);
-
-    ///link the minimap name to the index in allreads
-    indices[nameOfSequence] = sequenceID;
-    sequenceID++;
-
 }
 
 /**
@@ -116,36 +75,39 @@ void parse_reads(std::string fileReads, std::vector <Read> &allreads, robin_hood
 void parse_assembly(std::string fileAssembly, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices
     , vector<unsigned long int> &backbone_reads, vector<Link> &allLinks){
 
-    ifstream in(fileAssembly);
-    if (!in){
+    MappedFile in(fileAssembly);
+    if (!in.good()){
         cout << "problem reading files in index_reads, while trying to read " << fileAssembly << endl;
         throw std::invalid_argument( "Input file could not be read" );
     }
 
     long int sequenceID = allreads.size(); //counting the number of sequences we have already seen 
 
-    string line;
+    LineTokenizer lines(in.view());
+    string_view line;
     string nameOfSequence = "";
-    string comments = "";
+    string key; //to look up the names in indices without allocating at each line
 
+    while(lines.next_line(line)){
 
-    while(getline(in, line)){
+        if (line.empty()){
+            continue;
+        }
 
         if (line[0] == 'S'){
             
-            string field;
-            std::istringstream line2(line);
+            string_view field;
+            string_view rest = line;
             int fieldNb = 0;
-            unsigned int chunk = 0; //corresponds to lengthOfContig/MAX_SIZE_OF_CONTIGS
-            while(getline(line2, field, '\t')){
+            while(next_field(rest, field)){
                 if (fieldNb == 1){ // name of the sequence
                     //name of sequence as is in minimap file is field up to the first blank space
-                    std::stringstream line3(field);
-                    std::getline(line3, nameOfSequence, ' ');                    
+                    nameOfSequence = string(first_word(field));
                 }
                 else if (fieldNb == 2){ //here is the sequence
 
-                    Read r(field, field.size());
+                    string sequence (field);
+                    Read r(sequence, field.size());
                     r.name = nameOfSequence;
                     backbone_reads.push_back(sequenceID);
                     allreads.push_back(r);
@@ -155,12 +117,15 @@ void parse_assembly(std::string fileAssembly, std::vector <Read> &allreads, robi
                     sequenceID++;
                 }
                 else if (field.substr(0,2) == "dp" || field.substr(0,2) == "DP"){
-                    auto depth = std::atoi(field.substr(5, field.size()-5).c_str());
+                    int depth = 0;
+                    if (field.size() > 5){
+                        parse_number(field.substr(5), depth);
+                    }
                     //set the depth of all contigs that were created from this sequence
                     allreads[backbone_reads.back()].depth = depth;
                 }
                 else if (fieldNb > 2){
-                    allreads[backbone_reads.back()].comments += "\t"+field;
+                    allreads[backbone_reads.back()].comments += "\t"+string(field);
                 }
 
                 fieldNb += 1;
@@ -170,67 +135,39 @@ void parse_assembly(std::string fileAssembly, std::vector <Read> &allreads, robi
 
         if (line[0] == 'L'){
             
-            string field;
-            std::istringstream line2(line);
+            string_view field;
+            string_view rest = line;
             int fieldNb = 0;
             Link link;
             
             try{
-                string name1 = "";
-                string name2 = "";
-                while(getline(line2, field, '\t')){
+                string_view name1;
+                string_view name2;
+                while(next_field(rest, field)){
                     if (fieldNb == 1){ // name of the sequence1
                         name1 = field;
                     }
-                    else if (fieldNb == 2){ //here is the sequence
-                        if (field == "+"){
-                            if (indices.find(name1) == indices.end()){
-                                cout << "Problem in reading the link : " << line << endl;
-                                throw std::invalid_argument( "Problem in file formatting" );
-                            }
-                            link.neighbor1 = indices[name1];
-                            link.end1 = 1;
-                        }
-                        else if (field == "-"){
-                            if (indices.find(name1) == indices.end()){
-                                cout << "Problem in reading the link : " << line << endl;
-                                throw std::invalid_argument( "Problem in file formatting" );
-                            }
-                            link.neighbor1 = indices[name1];
-                            link.end1 = 0;
-                        }
-                        else{
-                            cout << "Problem in reading the link : " << line << endl;
-                            throw std::invalid_argument( "Problem in file formatting" );
-                        }
-                    }
-                    else if (fieldNb == 3){ // name of the sequence1
+                    else if (fieldNb == 3){ // name of the sequence2
                         name2 = field;
                     }
-                    else if (fieldNb == 4){ //here is the sequence
-                        if (field == "+"){
-                            if (indices.find(name2) == indices.end()){
-                                cout << "Problem in reading the link : " << line << endl;
-                                throw std::invalid_argument( "Problem in file formatting" );
-                            }
-                            link.neighbor2 = indices[name2];
-                            link.end2 = 0;
+                    else if (fieldNb == 2 || fieldNb == 4){ //orientation of the sequence
+                        key = (fieldNb == 2) ? name1 : name2;
+                        auto index = indices.find(key);
+                        if ((field != "+" && field != "-") || index == indices.end()){
+                            cout << "Problem in reading the link : " << line << endl;
+                            throw std::invalid_argument( "Problem in file formatting" );
                         }
-                        else if (field == "-"){
-                            if (indices.find(name2) == indices.end()){
-                                cout << "Problem in reading the link : " << line << endl;
-                                throw std::invalid_argument( "Problem in file formatting" );
-                            }
-                            link.neighbor2 = indices[name2];
-                            link.end2 = 1;
+                        if (fieldNb == 2){
+                            link.neighbor1 = index->second;
+                            link.end1 = (field == "+") ? 1 : 0;
                         }
                         else{
-                            cout << "Problem in reading the link : " << line << endl;
-                            throw std::invalid_argument( "Problem in file formatting" );
+                            link.neighbor2 = index->second;
+                            link.end2 = (field == "+") ? 0 : 1;
                         }
                     }
                     else if (fieldNb == 5){
-                        link.CIGAR = field;
+                        link.CIGAR = string(field);
                     }
 
                     fieldNb += 1;
@@ -239,9 +176,6 @@ void parse_assembly(std::string fileAssembly, std::vector <Read> &allreads, robi
                 allLinks.push_back(link);
                 allreads[link.neighbor1].add_link(allLinks.size()-1, link.end1);
                 allreads[link.neighbor2].add_link(allLinks.size()-1, link.end2);
-                // cout << line << endl;
-                // cout << "Link beddtween " << name1 << " " << name2 << endl;
-                // cout << "Link beddtween " << allreads[link.neighbor1].name << " and " << allreads[link.neighbor2].name << endl;
             }
             catch(...){
                 cout << "Problem while reading GFA file " + fileAssembly + ". Ensure that all the contigs described in 'L' lines are present in 'S' lines." << endl;
@@ -250,308 +184,466 @@ void parse_assembly(std::string fileAssembly, std::vector <Read> &allreads, robi
         }
 
     }
+}
+
+/**
+ * @brief Turns an alignment of a read on a contig into an Overlap, filtering the alignments that should not be used
+ * 
+ * @param sequence1 index of the read in allreads
+ * @param sequence2 index of the contig in allreads
+ * @param flag SAM flag of the alignment
+ * @param pos2_1 1-based leftmost position of the alignment on the contig
+ * @param cigar packed CIGAR of the alignment
+ * @param nbOps number of operations of the CIGAR
+ * @param length1 length of the sequence stored with the alignment
+ * @param overlap filled with the alignment
+ * @return true if the alignment should be kept
+ */
+static bool alignment_to_overlap(unsigned long int sequence1, unsigned long int sequence2, int flag, int pos2_1, const uint32_t* cigar, uint32_t nbOps, int length1, Overlap &overlap){
+
+    if (sequence2 == sequence1){
+        return false;
+    }
+    bool positiveStrand = (flag%32 < 16);
+    bool allgood = true;
+
+    //walk the CIGAR once: length of the chunk of contig and of the chunk of read that is aligned, and clips at both ends
+    int length_read = 0;
+    int length_contig = 0;
+    int nbH_start = 0;
+    int nbH_end = 0;
+    int nbS_start = 0;
+    int nbS_end = 0;
+    bool firstOp = true;
+    for (CigarCursor c (cigar, nbOps) ; !c.done() ; c.next()){
+        if (c.op() == 'M' || c.op() == '=' || c.op() == 'X'){
+            length_read += c.length();
+            length_contig += c.length();
+        }
+        else if (c.op() == 'I'){
+            length_read += c.length();
+        }
+        else if (c.op() == 'D'){
+            length_contig += c.length();
+        }
+        //only the 'H' and 'S' at the very ends of the cigar string count as clips
+        if (firstOp){
+            nbH_start = (c.op() == 'H') ? c.length() : 0;
+            nbS_start = (c.op() == 'S') ? c.length() : 0;
+            firstOp = false;
+        }
+        nbH_end = (c.op() == 'H') ? c.length() : 0;
+        nbS_end = (c.op() == 'S') ? c.length() : 0;
+    }
+
+    if (!positiveStrand){
+        std::swap(nbH_start, nbH_end);
+        std::swap(nbS_start, nbS_end);
+    }
 
-    for (auto l : allLinks){
-        int neighbor1 = l.neighbor1;
-        int neighbor2 = l.neighbor2;
-        //check if the neighbors are in the backbone
+    if (nbH_start+nbH_end > 0.2*length1 && flag < 2048){ //flag>=2048 means it is a supplementary alignment, in which case H can generally be changed in S. S alignments can be tolerated, if the read does not align elsewhere )
+        allgood = false;
+    }
+    else if(flag%512 >= 256 || flag >= 2048){ //i.e. secondary alignment
+        allgood=false;
     }
 
+    if (allgood){
+        overlap.sequence1 = sequence1;
+        overlap.sequence2 = sequence2;
+        overlap.position_1_1 = nbS_start + nbH_start; //the whole read is used
+        overlap.position_1_2 = nbS_start + nbH_start + length_read;
+        overlap.position_2_1 = pos2_1-1; //-1 because the SAM file is 1-based
+        overlap.position_2_2 = pos2_1+length_contig;
+        overlap.strand = positiveStrand;
+        overlap.CIGARLength = nbOps;
+    }
+    return allgood;
 }
 
 /**
- * @brief Parses the SAM files of all the reads aligned on the assembly
+ * @brief Parses one alignment line of a SAM file
  * 
- * @param fileSAM Name of SAM file
+ * @param line the line, without the end of line
+ * @param indices maps the name of the reads to their index in allreads
+ * @param selectedContigs if not null, only the alignments on these contigs are kept
+ * @param overlap filled with the alignment
+ * @param key buffer reused to look up the names in indices
+ * @param cigar filled with the packed CIGAR of the alignment
+ * @return true if the alignment should be kept
+ */
+static bool parse_SAM_line(std::string_view line, robin_hood::unordered_map<std::string, unsigned long int> &indices, const robin_hood::unordered_set<std::string>* selectedContigs,
+    Overlap &overlap, std::string &key, std::vector<uint32_t> &cigar){
+
+    unsigned long int sequence1 = -1;
+    int length1 = 0;
+    unsigned long int sequence2= -2;
+    int pos2_1= -1;
+    int flag = 0;
+    string_view readName;
+
+    //now go through the fields of the line
+    short fieldnumber = 0;
+    string_view field;
+    while (next_field(line, field))
+    {
+        if (fieldnumber == 0){
+            readName = field; //looked up once the contig is known to be kept, since the reads that only align on other contigs may not be loaded
+        }
+        else if (fieldnumber == 1){ //this is the flag
+            parse_number(field, flag);
+            if (flag%8 >= 4){ //this means that 1) the reads does not map well 
+                return false;
+            }
+        }
+        else if (fieldnumber == 2){
+            key = field;
+            if (selectedContigs != nullptr && selectedContigs->find(key) == selectedContigs->end()){
+                return false;
+            }
+            auto index = indices.find(key);
+            if (index == indices.end()){
+                #pragma omp critical
+                {
+                    cout << "There is a sequence in the SAM I did not find in the fasta/q:" << field << ":" << endl;
+                }
+                return false;
+            }
+            sequence2 = index->second;
+
+            key = readName;
+            index = indices.find(key);
+            if (index == indices.end()){
+                #pragma omp critical
+                {
+                    cout << "WARNING: read in the sam file not found in reads file, ignoring: " << readName << endl; // m54081_181221_163846/4391584/9445_12374 for example
+                }
+                return false;
+            }
+            sequence1 = index->second;
+        }
+        else if (fieldnumber == 3){
+            parse_number(field, pos2_1);
+        }
+        else if (fieldnumber == 5){
+            pack_cigar(field, cigar);
+        }
+        else if (fieldnumber == 9){
+            length1 = field.size();
+        }
+        fieldnumber++;
+    }
+
+    if (fieldnumber <= 10){
+        return false;
+    }
+    return alignment_to_overlap(sequence1, sequence2, flag, pos2_1, cigar.data(), cigar.size(), length1, overlap);
+}
+
+//overlaps parsed from one chunk of the alignment file. The CIGAR offsets refer to the arena of the chunk
+struct OverlapsChunk{
+    vector<Overlap> overlaps;
+    CigarArena CIGARs;
+
+    void add(Overlap &overlap, const uint32_t* cigar, uint32_t nbOps){
+        overlap.CIGAROffset = CIGARs.add(cigar, nbOps);
+        overlaps.push_back(overlap);
+    }
+};
+
+/**
+ * @brief Stores the overlaps parsed in chunks, in the order of the chunks
+ * 
+ * @param chunks overlaps parsed in each chunk, emptied
  * @param allOverlaps vector containing all the overlaps
+ * @param allCIGARs arena containing the CIGARs of all the overlaps
  * @param allreads vector containing all the reads as well as the contigs
- * @param indices maps the name of the reads to their index in allreads (comes from parse_reads)
- * @param backbonesReads indicates which of the reads are actually contigs in allreads
  */
-void parse_SAM(std::string fileSAM, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices){
+static void add_overlaps(std::vector<OverlapsChunk> &chunks, std::vector <Overlap>& allOverlaps, CigarArena &allCIGARs, std::vector <Read> &allreads){
+    for (auto &chunk : chunks){
+        uint64_t shift = allCIGARs.add(chunk.CIGARs.ops(0), chunk.CIGARs.size());
+        for (auto &overlap : chunk.overlaps){
+            overlap.CIGAROffset += shift;
+            allreads[overlap.sequence1].add_overlap(allOverlaps.size());
+            if (overlap.sequence1 != overlap.sequence2){
+                allreads[overlap.sequence2].add_overlap(allOverlaps.size());
+            }
+            allOverlaps.push_back(overlap);
+        }
+        chunk = OverlapsChunk();
+    }
+    allOverlaps.shrink_to_fit();
+    allCIGARs.shrink_to_fit();
+}
 
-    ifstream in(fileSAM);
-    if (!in){
+/**
+ * @brief Parses the alignments of a text SAM file
+ * 
+ * @param fileSAM Name of SAM file
+ * @param overlapsOfChunks filled with the overlaps, one per chunk of the file
+ * @param indices maps the name of the reads to their index in allreads
+ * @param selectedContigs if not null, only the alignments on these contigs are kept
+ * @param num_threads number of threads used to parse the file
+ */
+static void parse_SAM_text(std::string fileSAM, std::vector<OverlapsChunk> &overlapsOfChunks, robin_hood::unordered_map<std::string, unsigned long int> &indices,
+    const robin_hood::unordered_set<std::string>* selectedContigs, int num_threads){
+
+    MappedFile in(fileSAM);
+    if (!in.good()){
         cout << "problem reading SAM file " << fileSAM << endl;
         throw std::invalid_argument( "Input file '"+fileSAM +"' could not be read" );
     }
 
-    int extensionRight = -1; //that is to deal with circular contigs, for which a second alignment could be valid
-    int extensionLeft = -1;
-    string line;
-    long int linenumber = 0;
-    while(getline(in, line)){
-
-        if (line[0] != '@'){
-            string field;
-            std::istringstream line2(line);
-
-            unsigned long int sequence1 = -1;
-            string name1;
-            int length1 = 0;
-            unsigned long int sequence2= -2;
-            string name2;
-            int pos2_1= -1;
-            bool positiveStrand = true;
-            int flag;
-
-            string cigar;
+    //each chunk of whole lines is parsed independently, indices is only read
+    vector<string_view> chunks = split_in_chunks(in.view(), max(1, num_threads));
+    overlapsOfChunks.assign(chunks.size(), OverlapsChunk());
+
+    #pragma omp parallel for num_threads(max(1, num_threads)) schedule(static, 1)
+    for (int c = 0 ; c < chunks.size() ; c++){
+        LineTokenizer lines(chunks[c]);
+        string_view line;
+        string key;
+        vector<uint32_t> cigar;
+        Overlap overlap;
+        while(lines.next_line(line)){
+            if (!line.empty() && line[0] != '@' && parse_SAM_line(line, indices, selectedContigs, overlap, key, cigar)){
+                overlapsOfChunks[c].add(overlap, cigar.data(), cigar.size());
+            }
+        }
+    }
+}
 
-            bool allgood = true;
-            //now go through the fields of the line
-            short fieldnumber = 0;
+/**
+ * @brief Parses the alignments of a BAM file. If the BAM is indexed, the references are loaded in parallel from their span in the .bai
+ * 
+ * @param fileBAM Name of BAM file
+ * @param overlapsOfChunks filled with the overlaps, one per reference of the BAM (or a single one without index)
+ * @param indices maps the name of the reads to their index in allreads
+ * @param selectedContigs if not null, only the alignments on these contigs are kept
+ * @param num_threads number of threads used to parse the file
+ */
+static void parse_BAM(std::string fileBAM, std::vector<OverlapsChunk> &overlapsOfChunks, robin_hood::unordered_map<std::string, unsigned long int> &indices,
+    const robin_hood::unordered_set<std::string>* selectedContigs, int num_threads){
 
-            //print all keys of indices
-            // for (auto i : indices){
-            //     cout << "flkdjs : fqdsjf input output " <<  i.first << "\n";
-            // }
+    BamReader header(fileBAM);
+    BamIndex index(fileBAM);
 
-            while (getline(line2, field, '\t'))
-            {
-                if (fieldnumber == 0){
-                    try{
-                        if (indices.find(field)==indices.end()){
-                            cout << "WARNING: read in the sam file not found in reads file, ignoring: " << field << endl; // m54081_181221_163846/4391584/9445_12374 for example
-                            allgood = false;
-                        }
-                        
-                        sequence1 = indices[field];     
+    //index in allreads of each reference of the BAM, -1 if it is not in the assembly (or not selected)
+    vector<long int> references (header.reference_names.size(), -1);
+    for (int r = 0 ; r < references.size() ; r++){
+        if (selectedContigs != nullptr && selectedContigs->find(header.reference_names[r]) == selectedContigs->end()){
+            continue;
+        }
+        auto found = indices.find(header.reference_names[r]);
+        if (found != indices.end()){
+            references[r] = found->second;
+        }
+        else{
+            cout << "There is a sequence in the BAM I did not find in the fasta/q:" << header.reference_names[r] << ":" << endl;
+        }
+    }
 
-                    }
-                    catch(...){
-                        cout << "There is a sequence in the SAM I did not find in the fasta: " << field << endl;
-                        allgood = false;
-                    }
-                }
-                else if (fieldnumber == 1){ //this is the flag
-                    flag = stoi(field);
-                    if (flag%8 >= 4){ //this means that 1) the reads does not map well 
-                        allgood = false;
-                    }
-                    if (flag%32 >= 16){
-                        positiveStrand = false;
-                    }
-                }
-                else if (fieldnumber == 2){
-                    try{
-                        sequence2 = indices[field];
-                        std::istringstream line3(field);
-                        string unit;
-                        while(getline(line3, unit, ' ')){
-                            name2 = unit;
-                            break;
-                        }
-                    }
-                    catch(...){
-                        cout << "There is a sequence in the SAM I did not find in the fasta/q:" << field << ":" << endl;
-                        allgood = false;
-                    }
-                }
-                else if (fieldnumber == 3){
-                    pos2_1 = stoi(field);
-                }
-                else if (fieldnumber == 5){
-                    cigar = field;
-                }
-                else if (fieldnumber == 9){
-                    length1 = field.size();
+    //reads the alignments from the current position of reader up to the end of the span (or of the file), all on refID if refID >= 0
+    auto parse_alignments = [&](BamReader &reader, int32_t refID, uint64_t end, OverlapsChunk &overlaps){
+        BamRecord record;
+        string key;
+        Overlap overlap;
+        while ((refID < 0 || reader.tell() < end) && reader.next(record)){
+            if (refID >= 0 && record.refID != refID){
+                break;
+            }
+            if ((record.flag & BAM_FUNMAP) || record.refID < 0 || references[record.refID] < 0){
+                continue;
+            }
+            key = record.name();
+            auto read = indices.find(key);
+            if (read == indices.end()){
+                #pragma omp critical
+                {
+                    cout << "WARNING: read in the bam file not found in reads file, ignoring: " << key << endl;
                 }
-                //std::cout << "my field is : " << field << std::endl;
-                fieldnumber++;
+                continue;
             }
+            if (alignment_to_overlap(read->second, references[record.refID], record.flag, record.pos+1, record.cigar(), record.n_cigar_op, record.l_seq, overlap)){
+                overlaps.add(overlap, record.cigar(), record.n_cigar_op);
+            }
+        }
+    };
 
+    if (!index.good()){
+        if (num_threads > 1){
+            cout << "No .bai index found for " << fileBAM << ", reading it on one thread" << endl;
+        }
+        overlapsOfChunks.assign(1, OverlapsChunk());
+        parse_alignments(header, -1, 0, overlapsOfChunks[0]);
+        return;
+    }
 
-            if (allgood && fieldnumber > 10 && sequence2 != sequence1){
+    overlapsOfChunks.assign(references.size(), OverlapsChunk());
+    #pragma omp parallel num_threads(max(1, num_threads))
+    {
+        BamReader reader(fileBAM);
+        #pragma omp for schedule(dynamic)
+        for (int r = 0 ; r < references.size() ; r++){
+            uint64_t begin, end;
+            if (references[r] >= 0 && index.reference_span(r, begin, end)){
+                reader.seek(begin);
+                parse_alignments(reader, r, end, overlapsOfChunks[r]);
+            }
+        }
+    }
+}
 
-                int length_alignment = 0;
-                string alignment = convert_cigar(cigar);
-                for (auto a : alignment){
-                    if (a == 'M' || a == 'D' || a == '=' || a == 'X'){
-                        length_alignment++;
-                    }
-                }
-                auto pos2_2 = pos2_1 + length_alignment;
-
-                //do not store the 'H' and 'S' at the ends of the cigar string
-                int nbH_start = 0;
-                int nbH_end = 0;
-                string string_nbH_start = "";
-                //find the first letter in the CIGAR
-                int firstH = 0;
-                for (int i = 0 ; i < cigar.size() ; i++){
-                    if (cigar[i] > '9' || cigar[i] < '0'){
-                        if (cigar[i] != 'H') {
-                            string_nbH_start = "";
-                        }
-                        firstH = i;
-                        break;
-                    }
-                    string_nbH_start += cigar[i];
-                }
-                nbH_start = 0;
-                if (string_nbH_start != ""){
-                    nbH_start = stoi(string_nbH_start);
-                }
+//throws if the alignment file cannot be read, or is a CRAM file
+static void check_alignment_file(std::string fileSAM){
+    char magic[4] = {0,0,0,0};
+    ifstream in(fileSAM, std::ios::binary);
+    if (!in){
+        cout << "problem reading SAM file " << fileSAM << endl;
+        throw std::invalid_argument( "Input file '"+fileSAM +"' could not be read" );
+    }
+    in.read(magic, 4);
+    in.close();
+    if (string(magic, 4) == "CRAM"){
+        cout << "ERROR: " << fileSAM << " is a CRAM file, which create_new_contigs cannot decode. Please convert it to BAM first (samtools view -b)" << endl;
+        throw std::invalid_argument( "Input file '"+fileSAM +"' is a CRAM file" );
+    }
+}
 
-                string string_nbH_end = "";
-                int lastH = 0;
-                //find the last letter in the CIGAR
-                for (int i = cigar.size()-1 ; i >= 0 ; i--){
-                    if ((cigar[i] > '9' || cigar[i] < '0') && cigar[i] != 'H'){
-                        lastH = i;
-                        break;
-                    }
-                    string_nbH_end = cigar[i] + string_nbH_end;
-                }
-                nbH_end = 0;
-                if (string_nbH_end != ""){
-                    //strip last character
-                    string_nbH_end = string_nbH_end.substr(0, string_nbH_end.size()-1);
-                    nbH_end = stoi(string_nbH_end);
-                }
+/**
+ * @brief Parses the alignments of all the reads on the assembly, from a SAM or a BAM file
+ * 
+ * @param fileSAM Name of SAM or BAM file
+ * @param allOverlaps vector containing all the overlaps
+ * @param allCIGARs arena containing the CIGARs of all the overlaps
+ * @param allreads vector containing all the reads as well as the contigs
+ * @param indices maps the name of the reads to their index in allreads (comes from parse_reads)
+ * @param num_threads number of threads used to parse the file. The overlaps are stored in the order of the file whatever the number of threads
+ * @param selectedContigs if not null, only the alignments on these contigs are parsed
+ */
+void parse_SAM(std::string fileSAM, std::vector <Overlap>& allOverlaps, CigarArena &allCIGARs, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices, int num_threads,
+    const robin_hood::unordered_set<std::string>* selectedContigs){
 
-                if (!positiveStrand){
-                    auto tmp = nbH_start;
-                    nbH_start = nbH_end;
-                    nbH_end = tmp;
-                }
+    check_alignment_file(fileSAM);
 
-                int nbS_start = 0;
-                int nbS_end = 0;
-                string string_nbS_start = "";
-                //find the first letter in the CIGAR
-                int firstS = 0;
-                for (int i = 0 ; i < cigar.size() ; i++){
-                    if (cigar[i] > '9' || cigar[i] < '0'){
-                        if (cigar[i] != 'S') {
-                            string_nbS_start = "";
-                        }
-                        firstS = i;
-                        break;
-                    }
-                    string_nbS_start += cigar[i];
-                }
-                nbS_start = 0;
-                if (string_nbS_start != ""){
-                    nbS_start = stoi(string_nbS_start);
-                }
+    vector<OverlapsChunk> overlapsOfChunks;
+    if (is_bgzf(fileSAM)){
+        parse_BAM(fileSAM, overlapsOfChunks, indices, selectedContigs, num_threads);
+    }
+    else{
+        parse_SAM_text(fileSAM, overlapsOfChunks, indices, selectedContigs, num_threads);
+    }
+    add_overlaps(overlapsOfChunks, allOverlaps, allCIGARs, allreads);
+}
 
-                string string_nbS_end = "";
-                int lastS = 0;
-                //find the last letter in the CIGAR
-                for (int i = cigar.size()-1 ; i >= 0 ; i--){
-                    if ((cigar[i] > '9' || cigar[i] < '0') && cigar[i] != 'S'){
-                        lastS = i;
-                        break;
-                    }
-                    string_nbS_end = cigar[i] + string_nbS_end;
-                }
-                nbS_end = 0;
-                if (string_nbS_end != ""){
-                    //strip last character
-                    string_nbS_end = string_nbS_end.substr(0, string_nbS_end.size()-1);
-                    nbS_end = stoi(string_nbS_end);
-                }
+/**
+ * @brief Lists the reads that align on some contigs, so that only them are loaded when working on a subset of the assembly
+ * 
+ * @param fileSAM Name of SAM or BAM file
+ * @param selectedContigs names of the contigs
+ * @param num_threads number of threads used to read a text SAM file
+ * @return the names of the reads that have a mapped alignment on one of the contigs
+ */
+robin_hood::unordered_set<std::string> read_names_on_contigs(std::string fileSAM, const robin_hood::unordered_set<std::string> &selectedContigs, int num_threads){
 
-                if (!positiveStrand){
-                    auto tmp = nbS_start;
-                    nbS_start = nbS_end;
-                    nbS_end = tmp;
-                }
+    check_alignment_file(fileSAM);
 
-                if (nbH_start+nbH_end > 0.2*length1 && flag < 2048){ //flag>=2048 means it is a supplementary alignment, in which case H can generally be changed in S. S alignments can be tolerated, if the read does not align elsewhere )
-                    allgood = false;
-                    //cout << "inpout outpout qkdldkj c " << line << endl;
+    robin_hood::unordered_set<string> names;
+    if (is_bgzf(fileSAM)){
+        BamReader reader(fileSAM);
+        BamIndex index(fileSAM);
+        vector<bool> selected (reader.reference_names.size(), false);
+        for (int r = 0 ; r < selected.size() ; r++){
+            selected[r] = selectedContigs.find(reader.reference_names[r]) != selectedContigs.end();
+        }
+        BamRecord record;
+        auto add_alignments = [&](int32_t refID, uint64_t end){ //all the alignments up to the end of the span (or of the file), on refID if refID >= 0
+            while ((refID < 0 || reader.tell() < end) && reader.next(record)){
+                if (refID >= 0 && record.refID != refID){
+                    break;
                 }
-                else if(flag%512 >= 256 || flag >= 2048){ //i.e. secondary alignment
-                    allgood=false;
+                if (!(record.flag & BAM_FUNMAP) && record.refID >= 0 && selected[record.refID]){
+                    names.insert(string(record.name()));
                 }
+            }
+        };
+        if (!index.good()){
+            add_alignments(-1, 0);
+            return names;
+        }
+        for (int r = 0 ; r < selected.size() ; r++){
+            uint64_t begin, end;
+            if (selected[r] && index.reference_span(r, begin, end)){
+                reader.seek(begin);
+                add_alignments(r, end);
+            }
+        }
+        return names;
+    }
 
-                if (allgood){
-
-                    //compute the length of the chunk of contig and the chunk of read that is aligned
-                    string cigar_dev = convert_cigar(cigar);
-                    int length_read = 0;
-                    int length_contig = 0;
-                    for (auto c : cigar_dev){
-                        if (c == 'M' || c == '=' || c == 'X'){
-                            length_read++;
-                            length_contig++;
-                        }
-                        else if (c == 'I'){
-                            length_read++;
-                        }
-                        else if (c == 'D'){
-                            length_contig++;
-                        }
-                    }
-
-                    Overlap overlap;
-                    overlap.sequence1 = sequence1;
-                    overlap.sequence2 = sequence2;
-                    overlap.position_1_1 = nbS_start + nbH_start; //the whole read is used
-                    overlap.position_1_2 = nbS_start + nbH_start + length_read;
-                    overlap.position_2_1 = pos2_1-1; //-1 because the SAM file is 1-based
-                    overlap.position_2_2 = pos2_1+length_contig;
-                    overlap.strand = positiveStrand;
-                    overlap.CIGAR = cigar;
-
-                    // if (allreads[sequence1].name.substr(0,19) == ">SRR14289618.827569"){
-                    //     cout << "heereei is the overlap from " << allreads[overlap.sequence1].name << " on " << allreads[overlap.sequence2].name
-                    //         << " " << overlap.position_1_1 << " " << overlap.position_1_2 << " " << overlap.position_2_1 << " " << overlap.position_2_2 << " " << overlap.strand << endl;
-                    //     cout << cigar.substr(0,30) << endl;
-                    // }
-
-                    // cout << "The overlap I'm adding looks like this: " << overlap.sequence1 << " " << overlap.sequence2 << " " << overlap.strand << endl;
-
-                    allreads[sequence1].add_overlap(allOverlaps.size());
-                    if (sequence1 != sequence2){
-                        allreads[sequence2].add_overlap(allOverlaps.size());
-                    }
-                    // if (sequence1 == 0){
-                    //     cout << "DEBUG added edge bnbnb " << endl; 
-                    // }
-                    allOverlaps.push_back(overlap);
-                }
+    MappedFile in(fileSAM);
+    vector<string_view> chunks = split_in_chunks(in.view(), max(1, num_threads));
+    vector<vector<string>> namesOfChunks (chunks.size());
+    #pragma omp parallel for num_threads(max(1, num_threads)) schedule(static, 1)
+    for (int c = 0 ; c < chunks.size() ; c++){
+        LineTokenizer lines(chunks[c]);
+        string_view line;
+        string key;
+        while(lines.next_line(line)){
+            string_view name, flagField, contig;
+            int flag = 4;
+            if (line.empty() || line[0] == '@' || !next_field(line, name) || !next_field(line, flagField) || !next_field(line, contig)){
+                continue;
+            }
+            parse_number(flagField, flag);
+            key = contig;
+            if (flag%8 < 4 && selectedContigs.find(key) != selectedContigs.end()){
+                namesOfChunks[c].push_back(string(name));
             }
-            linenumber++;
         }
     }
+    for (auto &chunk : namesOfChunks){
+        names.insert(chunk.begin(), chunk.end());
+    }
+    return names;
+}
 
-    in.close();
+//the reads aligned on backbone, once per alignment
+static vector<long int> reads_on_contig(long int backbone, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads){
+    vector<long int> reads;
+    for (long int n: allreads[backbone].neighbors_){
+        if (allOverlaps[n].sequence1 != backbone){
+            reads.push_back(allOverlaps[n].sequence1);
+        }
+        else{
+            reads.push_back(allOverlaps[n].sequence2);
+        }
+    }
+    return reads;
 }
 
 /**
  * @brief Uploads the sequence of the reads that align on backbone in allreads
  * 
- * @param fileReads file containing the reads
+ * @param readStore loads the reads, which can be shared with other backbones
  * @param backbone index of the backbone read in allreads
  * @param allOverlaps vector of all overlaps between backbone reads and normal reads
  * @param allreads vector of all the reads (including backbone)
  */
-void parse_reads_on_contig(std::string fileReads, long int backbone, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads){
- 
-    ifstream in(fileReads);
-    string line;
-
-    //cout << "Loading reads that align on " << allreads[backbone].name << " " << allreads[backbone].neighbors_.size() << endl;
-
-    for (long int n: allreads[backbone].neighbors_){
-        long int read;
-        if (allOverlaps[n].sequence1 != backbone){
-            read = allOverlaps[n].sequence1;
-        }
-        else{
-            read = allOverlaps[n].sequence2;
-        }
-
-        in.seekg(allreads[read].get_position_in_file());
-        getline(in, line);
+void parse_reads_on_contig(ReadStore &readStore, long int backbone, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads){
+    readStore.acquire(reads_on_contig(backbone, allOverlaps, allreads));
+}
 
-        allreads[read].upload_sequence(line);
-        // cout << "sequence of read " << allreads[read].name << " is recovered " << line.size() << " " << allreads[read].sequence_.size() << endl;// << line << endl;
-    }
-    in.close();
+/**
+ * @brief Releases the sequences loaded by parse_reads_on_contig, once the backbone is done
+ * 
+ * @param readStore the store that loaded the reads
+ * @param backbone index of the backbone read in allreads
+ * @param allOverlaps vector of all overlaps between backbone reads and normal reads
+ * @param allreads vector of all the reads (including backbone)
+ */
+void free_reads_on_contig(ReadStore &readStore, long int backbone, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads){
+    readStore.release(reads_on_contig(backbone, allOverlaps, allreads));
 }
 
 
@@ -560,6 +652,7 @@ void parse_reads_on_contig(std::string fileReads, long int backbone, std::vector
  * 
  * @param fileSAM Name of SAM file
  * @param allOverlaps vector containing all the overlaps
+ * @param allCIGARs arena containing the CIGARs of all the overlaps
  * @param allreads vector containing all the reads as well as the contigs. This is updated with all the overlaps
  * @param indices maps the name of the reads to their index in allreads (comes from parse_reads)
  * @param backbones_reads indicates which of the reads are actually contigs in allreads
@@ -567,23 +660,26 @@ void parse_reads_on_contig(std::string fileReads, long int backbone, std::vector
  */
 void parse_PAF(std::string filePAF, 
     std::vector <Overlap> &allOverlaps, 
+    CigarArena &allCIGARs,
     std::vector <Read> &allreads, 
     robin_hood::unordered_map<std::string, unsigned long int> &indices,
     vector<unsigned long int> &backbones_reads, 
     bool computeBackbones,
     bool filterUncompleteAlignments){
 
-    ifstream in(filePAF);
-    if (!in){
+    MappedFile in(filePAF);
+    if (!in.good()){
         cout << "problem reading PAF file " << filePAF << endl;
         throw std::invalid_argument( "Input file '"+filePAF +"' could not be read" );
     }
 
     vector<bool> backbonesReads (allreads.size(), true); //for now all reads can be backbones read, they will be filtered afterward
 
-    string line;
+    LineTokenizer lines(in.view());
+    string_view line;
+    string key; //to look up the names in indices without allocating at each line
     long int linenumber = 0;
-    while(getline(in, line)){
+    while(lines.next_line(line)){
 
         string name1;
         int pos1_1= -1;
@@ -598,88 +694,56 @@ void parse_PAF(std::string filePAF,
 
         int mapq_quality = 255;
 
-        // cout << "fqdio indice " << endl;
-        // for (auto i : indices){
-        //     cout << i.first << " " << i.second << endl;
-        // }
-        // exit(0);
-
-        string cigar;
+        vector<uint32_t> cigar;
 
         bool allgood = true;
         //now go through the fields of the line
         short fieldnumber = 0;
-        string field;
-        std::istringstream line2(line);
-        while (getline(line2, field, '\t'))
+        string_view field;
+        string_view rest = line;
+        while (next_field(rest, field))
         {
             if (fieldnumber == 0){
-                try{
-                    if (indices.find(field)==indices.end()){
-                        cout << "Read in PAF not found in FASTA: " << field << endl; // m54081_181221_163846/4391584/9445_12374 for example
-                        exit(0);
-                        allgood = false;
-                    }
-                    
-                    std::istringstream line3(field);
-                    string unit;
-                    while(getline(line3, unit, ' ')){
-                        name1 = unit;
-                        break;
-                    }
-
-                }
-                catch(...){
-                    cout << "There is a sequence in the PAF I did not find in the fasta: " << field << endl;
-                    allgood = false;
+                key = field;
+                if (indices.find(key)==indices.end()){
+                    cout << "Read in PAF not found in FASTA: " << field << endl; // m54081_181221_163846/4391584/9445_12374 for example
+                    exit(0);
                 }
+                name1 = string(first_word(field));
             }
             else if (fieldnumber == 1){
-                length1 = stoi(field);
+                parse_number(field, length1);
             }
             else if (fieldnumber == 2){
-                pos1_1 =  stoi(field);
+                parse_number(field, pos1_1);
             }
             else if (fieldnumber == 3){
-                pos1_2 = stoi(field);
+                parse_number(field, pos1_2);
             }
             else if (fieldnumber == 4){
                 positiveStrand = (field == "+");
             }
             else if (fieldnumber == 5){
-                try{
-                    std::istringstream line3(field);
-                    string unit;
-                    while(getline(line3, unit, ' ')){
-                        name2 = unit;
-                        break;
-                    }
-                }
-                catch(...){
-                    cout << "There is a sequence in the PAF I did not find in the fasta/q:" << field << ":" << endl;
-                    allgood = false;
-                }
+                name2 = string(first_word(field));
             }
             else if (fieldnumber == 6){
-                length2 = stoi(field);
+                parse_number(field, length2);
             }
             else if (fieldnumber == 7){
-                pos2_1 =  stoi(field);
+                parse_number(field, pos2_1);
             }
             else if (fieldnumber == 8){
-                pos2_2 = stoi(field);
+                parse_number(field, pos2_2);
             }
             else if (fieldnumber == 11){
-                mapq_quality = stoi(field);
+                parse_number(field, mapq_quality);
             }
             else if (field.substr(0,5) == "cg:Z:"){
-                cigar = field.substr(5, field.size()-5);
-                cigar = convert_cigar(cigar);
+                pack_cigar(field.substr(5), cigar);
             }
             else if (field.substr(0,5) == "dv:f:"){
-                diff = std::atof(field.substr(5, field.size()-5).c_str());
+                diff = std::atof(string(field.substr(5)).c_str());
             }
-            //std::cout << "my field is : " << field << std::endl;
             fieldnumber++;
         }
 
@@ -745,7 +809,8 @@ void parse_PAF(std::string filePAF,
                 overlap.position_1_2 = pos1_2;
 
                 overlap.strand = positiveStrand;
-                overlap.CIGAR = cigar;
+                overlap.CIGAROffset = allCIGARs.add(cigar.data(), cigar.size());
+                overlap.CIGARLength = cigar.size();
                 overlap.diff = diff;
 
                 allreads[overlap.sequence1].add_overlap(allOverlaps.size());
@@ -995,6 +1060,15 @@ void output_filtered_PAF(std::string fileOut, std::string fileIn, std::vector <R
     // cout << "number of non-common overlaps : " << numberOfNotBb << endl;
 }
 
+//writes the bases of a sequence through the buffer of the file, a piece at a time, without decoding the whole sequence
+static void write_sequence(BufferedWriter &out, const Sequence &sequence){
+    size_t piece = out.capacity()/2;
+    for (size_t start = 0 ; start < sequence.size() ; start += piece){
+        size_t length = min(piece, sequence.size()-start);
+        sequence.str(start, length, out.append(length));
+    }
+}
+
 /**
  * @brief Outputs the fasta file
  * 
@@ -1003,41 +1077,74 @@ void output_filtered_PAF(std::string fileOut, std::string fileIn, std::vector <R
  * @param fileOut output file
  */
 void output_FASTA(std::vector <Read> &allreads, std::vector<unsigned long int> &backbone_reads, std::string fileOut){
-    ofstream out(fileOut);
+    BufferedWriter out(fileOut);
     for (auto r : backbone_reads){
-        if (allreads[r].name != "delete_me" && allreads[r].sequence_.size() > 0){
-            Read read = allreads[r];
-            out << ">" << read.name << " "<< read.comments << "\n" << read.sequence_.str() << "\n" ;    
+        const Read &read = allreads[r];
+        if (read.name != "delete_me" && read.sequence_.size() > 0){
+            out << ">" << read.name << " "<< read.comments << "\n";
+            write_sequence(out, read.sequence_);
+            out << "\n";
         }
     }
+    if (!out.close()){
+        cout << "ERROR: could not write " << fileOut << endl;
+        throw std::runtime_error("Output file '"+fileOut+"' could not be written");
+    }
 }
 
 //input : the list of all reads. Among those, backbone reads are actually contigs
 //output : a new gfa file with all contigs splitted
-void output_GFA(vector <Read> &allreads, vector<unsigned long int> &backbone_reads, string fileOut, vector<Link> &allLinks)
+/**
+ * @brief Outputs the GFA file
+ * 
+ * @param allreads vector of all reads (including backbone reads which can be contigs)
+ * @param backbone_reads vector of all the indices of the backbone reads in allreads
+ * @param fileOut output file
+ * @param allLinks all the links of the graph
+ * @param origins if not empty (in a shard), the original contig of each backbone read, output as a tag. Only the links that touch these contigs are then output
+ * The sequences of the contigs are freed once written
+ */
+void output_GFA(vector <Read> &allreads, vector<unsigned long int> &backbone_reads, string fileOut, vector<Link> &allLinks, const vector<string> &origins)
 {
 
-    ofstream out(fileOut);
-    for (auto r : backbone_reads){
-        if (allreads[r].name != "delete_me"){
-            Read read = allreads[r];
-            out << "S\t"<< read.name << "\t" << read.sequence_.str() << "\t";// << read.comments; // the comments may not be compatible with the new contigs
+    BufferedWriter out(fileOut);
+    robin_hood::unordered_set<unsigned long int> output;
+    for (size_t b = 0 ; b < backbone_reads.size() ; b++){
+        auto r = backbone_reads[b];
+        Read &read = allreads[r];
+        if (read.name != "delete_me"){
+            out << "S\t"<< read.name << "\t";
+            write_sequence(out, read.sequence_);
+            out << "\t";// << read.comments; // the comments may not be compatible with the new contigs
             if (read.depth != -1){
                 out << "DP:f:" << std::to_string(read.depth);
             }
-            out << " LN:i:" << std::to_string(read.sequence_.size()) << "\n";
+            out << " LN:i:" << read.sequence_.size();
+            if (origins.size() > 0){
+                out << "\toc:Z:" << origins[b];
+                output.insert(r);
+            }
+            out << "\n";
+            read.sequence_ = Sequence();
         }
     }
-    for (auto l : allLinks){
+    for (const Link &l : allLinks){
+        if (origins.size() > 0 && output.find(l.neighbor1) == output.end() && output.find(l.neighbor2) == output.end()){ //a link between two contigs of other shards
+            continue;
+        }
         if (l.end1 != -1 && l.end2 != -1){
-            string end1 = "-";
-            if (l.end1 == 1) {end1 = "+";}
-            string end2 = "-";
-            if (l.end2 == 0) {end2 = "+";}
+            char end1 = '-';
+            if (l.end1 == 1) {end1 = '+';}
+            char end2 = '-';
+            if (l.end2 == 0) {end2 = '+';}
             out << "L\t" << allreads[l.neighbor1].name << "\t" << end1 << "\t" << allreads[l.neighbor2].name 
                 << "\t" << end2 << "\t" << l.CIGAR << "\n";
         }
     }
+    if (!out.close()){
+        cout << "ERROR: could not write " << fileOut << endl;
+        throw std::runtime_error("Output file '"+fileOut+"' could not be written");
+    }
 }
 
 /**
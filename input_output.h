@@ -5,12 +5,16 @@
 #include <vector>
 #include "robin_hood.h"
 #include "read.h"
+#include "reads_index.h"
+#include "read_store.h"
+#include "cigar.h"
 //#include "Variant.h"
 
 void parse_reads(
-    std::string fileReads, 
+    ReadsIndex &readsIndex, 
     std::vector <Read> &allreads, 
-    robin_hood::unordered_map<std::string, unsigned long int> &indices);
+    robin_hood::unordered_map<std::string, unsigned long int> &indices,
+    const robin_hood::unordered_set<std::string>* selectedReads = nullptr);
 
 void parse_assembly(
     std::string fileAssembly, 
@@ -22,24 +26,39 @@ void parse_assembly(
 void parse_SAM(
     std::string fileSAM, 
     std::vector <Overlap>& allOverlaps, 
+    CigarArena &allCIGARs,
     std::vector <Read> &allreads, 
-    robin_hood::unordered_map<std::string, unsigned long int> &indices);
+    robin_hood::unordered_map<std::string, unsigned long int> &indices,
+    int num_threads = 1,
+    const robin_hood::unordered_set<std::string>* selectedContigs = nullptr);
+
+robin_hood::unordered_set<std::string> read_names_on_contigs(
+    std::string fileSAM,
+    const robin_hood::unordered_set<std::string> &selectedContigs,
+    int num_threads = 1);
 
 
 void parse_reads_on_contig(
-    std::string fileReads, 
+    ReadStore &readStore, 
+    long int backbone, 
+    std::vector <Overlap>& allOverlaps, 
+    std::vector <Read> &allreads);
+
+void free_reads_on_contig(
+    ReadStore &readStore, 
     long int backbone, 
     std::vector <Overlap>& allOverlaps, 
     std::vector <Read> &allreads);
 
-void parse_PAF(std::string filePAF, std::vector <Overlap>& allOverlaps, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices, 
+void parse_PAF(std::string filePAF, std::vector <Overlap>& allOverlaps, CigarArena &allCIGARs, std::vector <Read> &allreads, robin_hood::unordered_map<std::string, unsigned long int> &indices, 
     std::vector<unsigned long int> &backbones_reads, bool computeBackbones, bool filterUncompleteAlignments);
 
 // void parse_VCF(std::string fileVCF, robin_hood::unordered_map<std::string, std::vector <Variant>> &allVariants);
 // void parseSAM(std::string fileSAM , robin_hood::unordered_map<std::string, std::vector <Variant>> &allVariants);
 
 void output_FASTA(std::vector <Read> &allreads, std::vector<unsigned long int> &backbone_reads, std::string fileOut);
-void output_GFA(std::vector <Read> &allreads, std::vector<unsigned long int> &backbone_reads, std::string fileOut, std::vector<Link> &allLinks);
+void output_GFA(std::vector <Read> &allreads, std::vector<unsigned long int> &backbone_reads, std::string fileOut, std::vector<Link> &allLinks,
+    const std::vector<std::string> &origins = {});
 void output_filtered_PAF(std::string fileOut, std::string fileIn, std::vector <Read> &allreads, std::vector<std::vector<int>> &partitions, robin_hood::unordered_map<std::string, unsigned long int> &indices);
 void output_readGroups(std::string readGroupsFile, std::vector <Read> &allreads, std::vector<unsigned long int> &backbone_reads, 
     std::unordered_map<unsigned long int ,std::vector< std::pair<std::pair<int,int>, std::pair<std::vector<int>, std::unordered_map<int, std::string>>  > >> &partitions, std::vector <Overlap> &allOverlaps);
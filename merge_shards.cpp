@@ -0,0 +1,318 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <set>
+#include <tuple>
+#include <algorithm>
+
+#include "tokenizer.h"
+#include "read_paths.h"
+#include "robin_hood.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::pair;
+using std::tuple;
+using std::get;
+
+/*
+Merges the outputs of create_new_contigs run on disjoint subsets of the contigs (create_new_contigs --contigs), as if create_new_contigs had
+been run on the whole assembly:
+    - the contigs of all the shards are output, without the oc tag that tells from which contig of the original assembly they come
+    - the links between two contigs of the same shard are output as is. A link towards a contig of another shard is given by each of the two
+      shards, with the original contig on the side of the other shard: the new link is then created between all the contigs of both sides
+    - the paths of the reads, output before being merged across contigs, are merged as output_GAF does once the paths of all the shards are known
+*/
+
+//a link of the original assembly, as in parse_assembly
+struct OriginalLink{
+    long int neighbor1;
+    short end1;
+    long int neighbor2;
+    short end2;
+};
+
+//the contigs and links of the original assembly
+struct OriginalAssembly{
+    robin_hood::unordered_map<string, long int> indices;
+    vector<OriginalLink> links;
+    vector<vector<size_t>> linksLeft;
+    vector<vector<size_t>> linksRight;
+};
+
+/**
+ * @brief Parses the contigs and links of the original assembly
+ *
+ * @param file the GFA file
+ * @param assembly filled with the contigs and links
+ * @return false if the file cannot be read or has a link towards a contig that it does not contain
+ */
+static bool parse_original_assembly(string file, OriginalAssembly &assembly){
+    MappedFile in(file);
+    if (!in.good()){
+        cerr << "ERROR: could not open " << file << endl;
+        return false;
+    }
+    LineTokenizer lines(in.view());
+    string_view line;
+    string key;
+    vector<string_view> linkLines;
+    while (lines.next_line(line)){
+        string_view field;
+        string_view rest = line;
+        if (line.substr(0, 2) == "S\t" && next_field(rest, field) && next_field(rest, field)){
+            key = first_word(field);
+            long int index = assembly.indices.size();
+            assembly.indices[key] = index;
+        }
+        else if (line.substr(0, 2) == "L\t"){
+            linkLines.push_back(line);
+        }
+    }
+    assembly.linksLeft.resize(assembly.indices.size());
+    assembly.linksRight.resize(assembly.indices.size());
+    for (auto linkLine : linkLines){
+        string_view rest = linkLine;
+        string_view type, name1, orientation1, name2, orientation2;
+        next_field(rest, type);
+        if (!next_field(rest, name1) || !next_field(rest, orientation1) || !next_field(rest, name2) || !next_field(rest, orientation2)){
+            cerr << "ERROR: could not read the link " << linkLine << " of " << file << endl;
+            return false;
+        }
+        key = name1;
+        auto contig1 = assembly.indices.find(key);
+        key = name2;
+        auto contig2 = assembly.indices.find(key);
+        if (contig1 == assembly.indices.end() || contig2 == assembly.indices.end()){
+            cerr << "ERROR: the link " << linkLine << " of " << file << " is between contigs that are not in the file" << endl;
+            return false;
+        }
+        OriginalLink link;
+        link.neighbor1 = contig1->second;
+        link.end1 = (orientation1 == "+") ? 1 : 0;
+        link.neighbor2 = contig2->second;
+        link.end2 = (orientation2 == "+") ? 0 : 1;
+        assembly.links.push_back(link);
+        for (auto end : {std::make_pair(link.neighbor1, link.end1), std::make_pair(link.neighbor2, link.end2)}){
+            if (end.second == 0){
+                assembly.linksLeft[end.first].push_back(assembly.links.size()-1);
+            }
+            else{
+                assembly.linksRight[end.first].push_back(assembly.links.size()-1);
+            }
+        }
+    }
+    return true;
+}
+
+//value of the tag of a line (e.g. "oc:Z:"), empty if the line does not have it
+static string_view tag_value(string_view line, string_view tag){
+    string_view field;
+    while (next_field(line, field)){
+        if (field.substr(0, tag.size()) == tag){
+            return field.substr(tag.size());
+        }
+    }
+    return string_view();
+}
+
+//a path of a read, with what is needed to put it back among the paths of the other shards
+struct Fragment{
+    long int contig; //index of the contig in the original assembly
+    Path path;
+    string readName;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 6 || (argc-4)%2 != 0){
+        cout << "Usage: ./merge_shards <original_assembly.gfa> <output.gfa> <output.gaf> <shard1.gfa> <shard1.gaf> [<shard2.gfa> <shard2.gaf> ...]" << endl;
+        cout << "Merges the outputs of create_new_contigs --contigs run on disjoint subsets of the contigs of the assembly" << endl;
+        return 1;
+    }
+
+    OriginalAssembly assembly;
+    if (!parse_original_assembly(argv[1], assembly)){
+        return 1;
+    }
+
+    BufferedWriter outGFA(argv[2]);
+    robin_hood::unordered_set<string> contigs; //contigs of all the shards
+    robin_hood::unordered_set<string> covered; //original contigs processed in a shard
+    vector<string> localLinks;
+    //links towards another shard, by the original link (contig, orientation, contig, orientation, CIGAR): the contigs of both sides of the link
+    std::map<tuple<string, string, string, string, string>, std::array<std::set<string>, 2>> crossLinks;
+
+    for (int s = 4 ; s < argc ; s += 2){
+        MappedFile in(argv[s]);
+        if (!in.good()){
+            cerr << "ERROR: could not open " << argv[s] << endl;
+            return 1;
+        }
+        robin_hood::unordered_map<string, string> originOfContig;
+        LineTokenizer lines(in.view());
+        string_view line;
+        vector<string_view> linkLines;
+        while (lines.next_line(line)){
+            if (line.substr(0, 2) == "S\t"){
+                string_view rest = line.substr(2);
+                string_view name;
+                next_field(rest, name);
+                string origin (tag_value(line, "oc:Z:"));
+                if (origin.empty() || assembly.indices.find(origin) == assembly.indices.end()){
+                    cerr << "ERROR: the contig " << name << " of " << argv[s] << " does not come from a contig of " << argv[1] << ", is it the output of create_new_contigs --contigs?" << endl;
+                    return 1;
+                }
+                if (!contigs.insert(string(name)).second){
+                    cerr << "ERROR: the contig " << name << " is in several shards" << endl;
+                    return 1;
+                }
+                originOfContig[string(name)] = origin;
+                covered.insert(origin);
+                outGFA << line.substr(0, line.rfind("\toc:Z:")) << "\n";
+            }
+            else if (line.substr(0, 2) == "L\t"){
+                linkLines.push_back(line);
+            }
+        }
+        for (auto linkLine : linkLines){
+            string_view rest = linkLine;
+            string_view type, name1, orientation1, name2, orientation2, CIGAR;
+            next_field(rest, type);
+            next_field(rest, name1);
+            next_field(rest, orientation1);
+            next_field(rest, name2);
+            next_field(rest, orientation2);
+            next_field(rest, CIGAR);
+            auto origin1 = originOfContig.find(string(name1));
+            auto origin2 = originOfContig.find(string(name2));
+            if (origin1 != originOfContig.end() && origin2 != originOfContig.end()){
+                localLinks.push_back(string(linkLine));
+            }
+            else if (origin1 != originOfContig.end()){
+                auto &sides = crossLinks[std::make_tuple(origin1->second, string(orientation1), string(name2), string(orientation2), string(CIGAR))];
+                sides[0].insert(string(name1));
+            }
+            else if (origin2 != originOfContig.end()){
+                auto &sides = crossLinks[std::make_tuple(string(name1), string(orientation1), origin2->second, string(orientation2), string(CIGAR))];
+                sides[1].insert(string(name2));
+            }
+        }
+    }
+
+    for (auto &link : localLinks){
+        outGFA << link << "\n";
+    }
+    for (auto &crossLink : crossLinks){
+        const auto &key = crossLink.first;
+        for (int side = 0 ; side < 2 ; side++){
+            const string &original = side == 0 ? get<0>(key) : get<2>(key);
+            if (covered.find(original) == covered.end()){
+                cerr << "ERROR: the contig " << original << " is linked to the contigs of a shard but is in none of the shards" << endl;
+                return 1;
+            }
+        }
+        for (auto &contig1 : crossLink.second[0]){
+            for (auto &contig2 : crossLink.second[1]){
+                outGFA << "L\t" << contig1 << "\t" << get<1>(key) << "\t" << contig2 << "\t" << get<3>(key) << "\t" << get<4>(key) << "\n";
+            }
+        }
+    }
+    if (!outGFA.close()){
+        cerr << "ERROR: could not write " << argv[2] << endl;
+        return 1;
+    }
+
+    //now the paths of the reads, by index of the read in the reads file
+    std::map<long int, vector<Fragment>> fragmentsOfReads;
+    for (int s = 5 ; s < argc ; s += 2){
+        MappedFile in(argv[s]);
+        if (!in.good()){
+            cerr << "ERROR: could not open " << argv[s] << endl;
+            return 1;
+        }
+        LineTokenizer lines(in.view());
+        string_view line;
+        while (lines.next_line(line)){
+            if (line.empty()){
+                continue;
+            }
+            string_view rest = line;
+            vector<string_view> fields;
+            string_view field;
+            while (fields.size() < 6 && next_field(rest, field)){
+                fields.push_back(field);
+            }
+            string origin (tag_value(line, "oc:Z:"));
+            string_view record = tag_value(line, "ri:i:");
+            string_view marker = tag_value(line, "ma:Z:");
+            Fragment fragment;
+            long int read = -1;
+            auto contig = assembly.indices.find(origin);
+            if (fields.size() < 6 || contig == assembly.indices.end() || !parse_number(record, read) || !parse_number(fields[2], get<0>(fragment.path))
+                || (!marker.empty() && marker.size() != 2)){
+                cerr << "ERROR: could not read the line " << line << " of " << argv[s] << ", is it the output of create_new_contigs --contigs?" << endl;
+                return 1;
+            }
+            fragment.contig = contig->second;
+            fragment.readName = fields[0];
+            get<2>(fragment.path) = fragment.contig;
+            string_view path = fields[5];
+            size_t start = 0;
+            while (start < path.size()){
+                size_t end = path.find_first_of("><", start+1);
+                end = (end == string_view::npos) ? path.size() : end;
+                get<1>(fragment.path).push_back(std::make_pair(string(path.substr(start+1, end-start-1)), path[start] == '>'));
+                start = end;
+            }
+            if (!marker.empty()){
+                get<1>(fragment.path).push_back(std::make_pair(string(marker.substr(1)), marker[0] == '>'));
+            }
+            fragmentsOfReads[read].push_back(fragment);
+        }
+    }
+
+    PathLinks linked = [&](long int contig, bool rightEnd, long int nextContig, bool nextOrientation){
+        const vector<size_t> &links = rightEnd ? assembly.linksRight[contig] : assembly.linksLeft[contig];
+        bool merge = false;
+        for (auto li : links){
+            const OriginalLink &l = assembly.links[li];
+            if (l.neighbor1 == nextContig || l.neighbor2 == nextContig){
+                if ((l.end1==l.end2 && nextOrientation != rightEnd)
+                    || (l.end1!=l.end2 && nextOrientation == rightEnd)){
+                    merge = true;
+                }
+            }
+        }
+        return merge;
+    };
+
+    BufferedWriter outGAF(argv[3]);
+    for (auto &read : fragmentsOfReads){
+        //in the order in which create_new_contigs would have computed them on the whole assembly
+        vector<Fragment> &fragments = read.second;
+        std::stable_sort(fragments.begin(), fragments.end(), [](const Fragment &a, const Fragment &b){return a.contig < b.contig;});
+        vector<Path> paths;
+        for (auto &fragment : fragments){
+            paths.push_back(fragment.path);
+        }
+        merge_read_paths(paths, linked);
+        for (auto &path : paths){
+            if (get<1>(path).size() > 0){
+                output_GAF_path(outGAF, fragments[0].readName, path);
+            }
+        }
+    }
+    if (!outGAF.close()){
+        cerr << "ERROR: could not write " << argv[3] << endl;
+        return 1;
+    }
+
+    return 0;
+}
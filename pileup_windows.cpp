@@ -0,0 +1,525 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+
+#include "bam.h"
+#include "robin_hood.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::min;
+using std::max;
+
+/*
+Output format (.smpu), all integers are little-endian uint32 unless stated otherwise:
+    "SMPU" version
+    number_of_contigs, then for each contig: length_of_name name length_of_contig
+    then for each window of each contig, in the order of the BAM header and of the positions:
+        contig_index start end number_of_reads number_of_suspicious_columns
+        for each read: length_of_name name
+        for each column: position on the contig
+        number_of_reads*number_of_columns int8 (row-major): 1 = major allele, 0 = second allele, -1 = missing/other
+*/
+
+static const uint32_t SMPU_VERSION = 1;
+static const uint8_t NOT_A_BASE = 255; //deletion, reference skip or low-quality base
+
+/**
+ * @brief A read overlapping the current window, with a cursor on its alignment so that it is walked only once
+ */
+struct ActiveRead{
+    BamRecord record;
+    string name;
+    int32_t end;
+    //cursor on the alignment
+    uint32_t cigarIdx;
+    uint32_t offsetInOp;
+    int32_t posOnRef;
+    int32_t posOnRead;
+    //what the read shows in the current window
+    int32_t firstColumn;
+    vector<uint8_t> observations; //one base code per column of the window starting at firstColumn, NOT_A_BASE if deletion or low quality
+};
+
+void write_u32(std::ofstream &out, uint32_t x){
+    out.write(reinterpret_cast<const char*>(&x), 4);
+}
+
+void write_string(std::ofstream &out, const string &s){
+    write_u32(out, s.size());
+    out.write(s.data(), s.size());
+}
+
+/**
+ * @brief Advances the cursor of the read through the window [start, end), recording the base shown at each column
+ *
+ * @param read
+ * @param start first position of the window
+ * @param end position right after the window
+ * @param minBaseQuality bases of lower quality are not considered
+ */
+void walk_read(ActiveRead &read, int start, int end, int minBaseQuality){
+
+    read.observations.clear();
+    read.firstColumn = max(start, read.posOnRef);
+    const uint32_t* cigar = read.record.cigar();
+
+    while (read.cigarIdx < read.record.n_cigar_op && read.posOnRef < end){
+        int op = cigar[read.cigarIdx] & 0xF;
+        uint32_t length = cigar[read.cigarIdx] >> 4;
+        if (read.offsetInOp >= length){
+            read.cigarIdx++;
+            read.offsetInOp = 0;
+            continue;
+        }
+        if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF){
+            if (read.posOnRef >= start){
+                uint8_t code = NOT_A_BASE;
+                if (read.record.quality(read.posOnRead) >= minBaseQuality){
+                    code = read.record.base_code(read.posOnRead);
+                }
+                read.observations.push_back(code);
+            }
+            read.posOnRef++;
+            read.posOnRead++;
+        }
+        else if (op == BAM_CDEL || op == BAM_CREF_SKIP){
+            if (read.posOnRef >= start){
+                read.observations.push_back(NOT_A_BASE);
+            }
+            read.posOnRef++;
+        }
+        else if (op == BAM_CINS || op == BAM_CSOFT_CLIP){
+            read.posOnRead += length - read.offsetInOp;
+            read.offsetInOp = length;
+            continue;
+        }
+        else { //hard clip and padding do not consume anything
+            read.offsetInOp = length;
+            continue;
+        }
+        read.offsetInOp++;
+    }
+}
+
+/**
+ * @brief Reproduces pysam's default pileup filter (stepper "all")
+ */
+bool keep_in_pileup(const BamRecord &record){
+    if (record.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP)){
+        return false;
+    }
+    if ((record.flag & BAM_FPAIRED) && !(record.flag & BAM_FPROPER_PAIR)){ //orphan mates
+        return false;
+    }
+    return record.n_cigar_op > 0;
+}
+
+/**
+ * @brief Selects the suspicious positions of a window, as get_data in strainminer.py
+ *
+ * @param active reads overlapping the window, already walked through the window
+ * @param start
+ * @param end
+ * @param positions filled with the suspicious positions
+ * @param majorBase filled with the most frequent base at each suspicious position
+ * @param secondBase filled with the second most frequent base
+ */
+void suspicious_positions(const vector<ActiveRead*> &active, int start, int end, vector<uint32_t> &positions, vector<uint8_t> &majorBase, vector<uint8_t> &secondBase){
+
+    int length = end-start;
+    vector<uint32_t> depth (length, 0); //number of reads covering the position, deletions included (pysam's nsegments)
+    vector<uint32_t> counts (length*16, 0);
+    for (ActiveRead* read : active){
+        int offset = read->firstColumn - start;
+        for (size_t i = 0 ; i < read->observations.size() ; i++){
+            depth[offset+i]++;
+            if (read->observations[i] != NOT_A_BASE){
+                counts[(offset+i)*16 + read->observations[i]]++;
+            }
+        }
+    }
+
+    //the bases are ordered alphabetically, as np.unique does, so that ties are broken the same way as in get_data
+    static vector<int> alphabetical_codes;
+    if (alphabetical_codes.empty()){
+        for (int c = 0 ; c < 16 ; c++){
+            alphabetical_codes.push_back(c);
+        }
+        std::sort(alphabetical_codes.begin(), alphabetical_codes.end(), [](int a, int b){return BAM_SEQ_CHARS[a] < BAM_SEQ_CHARS[b];});
+    }
+
+    positions.clear();
+    majorBase.clear();
+    secondBase.clear();
+    for (int col = 0 ; col < length ; col++){
+        if (depth[col] < 5){
+            continue;
+        }
+        uint32_t total = 0;
+        int major = -1;
+        int second = -1;
+        for (int c : alphabetical_codes){
+            uint32_t count = counts[col*16+c];
+            if (count == 0){
+                continue;
+            }
+            total += count;
+            if (major == -1 || count >= counts[col*16+major]){
+                second = major;
+                major = c;
+            }
+            else if (second == -1 || count >= counts[col*16+second]){
+                second = c;
+            }
+        }
+        if (total > 0 && counts[col*16+major] < 0.95*total){
+            positions.push_back(start+col);
+            majorBase.push_back(major);
+            secondBase.push_back(second);
+        }
+    }
+}
+
+/**
+ * @brief Writes the read x position matrix of a window on its suspicious positions
+ *
+ * @param active reads overlapping the window, already walked through the window
+ * @param contigIdx index of the contig in the BAM header
+ * @param start
+ * @param end
+ * @param out
+ */
+void output_window(vector<ActiveRead*> &active, int contigIdx, int start, int end, std::ofstream &out){
+
+    vector<uint32_t> positions;
+    vector<uint8_t> majorBase;
+    vector<uint8_t> secondBase;
+    suspicious_positions(active, start, end, positions, majorBase, secondBase);
+
+    //list the reads that show something at the suspicious positions, in order of first appearance
+    robin_hood::unordered_map<string, uint32_t> rowOfRead;
+    vector<string> readNames;
+    vector<int8_t> matrix;
+    for (size_t p = 0 ; p < positions.size() ; p++){
+        int col = positions[p]-start;
+        for (ActiveRead* read : active){
+            int idx = col - (read->firstColumn - start);
+            if (idx < 0 || idx >= (int)read->observations.size() || read->observations[idx] == NOT_A_BASE){
+                continue;
+            }
+            const string &name = read->name;
+            auto row = rowOfRead.find(name);
+            uint32_t r;
+            if (row == rowOfRead.end()){
+                r = readNames.size();
+                rowOfRead[name] = r;
+                readNames.push_back(name);
+                matrix.resize(readNames.size()*positions.size(), -1);
+            }
+            else {
+                r = row->second;
+            }
+            int8_t value = -1;
+            if (read->observations[idx] == majorBase[p]){
+                value = 1;
+            }
+            else if (read->observations[idx] == secondBase[p]){
+                value = 0;
+            }
+            matrix[r*positions.size()+p] = value;
+        }
+    }
+
+    write_u32(out, contigIdx);
+    write_u32(out, start);
+    write_u32(out, end);
+    write_u32(out, readNames.size());
+    write_u32(out, positions.size());
+    for (const string &name : readNames){
+        write_string(out, name);
+    }
+    out.write(reinterpret_cast<const char*>(positions.data()), 4*positions.size());
+    out.write(reinterpret_cast<const char*>(matrix.data()), matrix.size());
+}
+
+typedef vector<vector<std::pair<int,int>>> Windows; //[start, end) of the windows of each contig
+
+/**
+ * @brief Walks the reads of each contig window by window
+ *
+ * @param bamFile sorted BAM file
+ * @param windows windows of each contig, consecutive and covering the contig
+ * @param minBaseQuality bases of lower quality are not considered
+ * @param process called on each window with the reads overlapping it, walked through it
+ * @return false if the BAM is not sorted
+ */
+template <class Process>
+bool pileup(const string &bamFile, const Windows &windows, int minBaseQuality, Process process){
+
+    BamReader bam(bamFile);
+    BamIndex index(bamFile);
+    //when some contigs are not selected and the BAM is indexed, only the spans of the selected contigs are read
+    bool seekContigs = index.good() && std::any_of(windows.begin(), windows.end(), [](const vector<std::pair<int,int>> &w){return w.empty();});
+    BamRecord pending;
+    bool morePending = seekContigs ? false : bam.next(pending);
+    for (int contig = 0 ; contig < (int)bam.reference_names.size() ; contig++){
+
+        if (seekContigs){
+            if (windows[contig].empty()){
+                continue;
+            }
+            uint64_t begin, end;
+            morePending = false;
+            if (index.reference_span(contig, begin, end)){
+                bam.seek(begin);
+                morePending = bam.next(pending);
+            }
+        }
+
+        vector<ActiveRead*> active;
+        for (auto &window : windows[contig]){
+            int start = window.first;
+            int end = window.second;
+
+            //add the reads starting in the window
+            while (morePending && pending.refID == contig && pending.pos < end){
+                if (keep_in_pileup(pending)){
+                    ActiveRead* read = new ActiveRead();
+                    read->end = pending.end();
+                    read->name = pending.name();
+                    read->record = std::move(pending);
+                    read->cigarIdx = 0;
+                    read->offsetInOp = 0;
+                    read->posOnRef = read->record.pos;
+                    read->posOnRead = 0;
+                    active.push_back(read);
+                }
+                morePending = bam.next(pending);
+            }
+            if (morePending && pending.refID >= 0 && pending.refID < contig){
+                cerr << "ERROR: the BAM file " << bamFile << " is not sorted by coordinates" << endl;
+                return false;
+            }
+
+            //remove the reads that ended before the window
+            vector<ActiveRead*> stillActive;
+            for (ActiveRead* read : active){
+                if (read->end > start){
+                    walk_read(*read, start, end, minBaseQuality);
+                    stillActive.push_back(read);
+                }
+                else {
+                    delete read;
+                }
+            }
+            active = stillActive;
+
+            process(active, contig, start, end);
+        }
+        for (ActiveRead* read : active){
+            delete read;
+        }
+        //skip what remains of this contig (alignments beyond its length)
+        while (morePending && pending.refID == contig){
+            morePending = bam.next(pending);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Chooses the windows of a contig from its suspicious positions: windows of the given size, cut shorter where there are more than
+ * maxColumns suspicious positions, and merged (up to 10 windows) where there is none
+ *
+ * @param positions sorted suspicious positions of the contig
+ * @param contigLength
+ * @param window size of the windows
+ * @param maxColumns maximum number of suspicious positions in a window
+ * @return the windows
+ */
+vector<std::pair<int,int>> adaptive_windows(const vector<uint32_t> &positions, int contigLength, int window, int maxColumns){
+
+    vector<std::pair<int,int>> windows;
+    int minLength = max(1, window/10);
+    const int maxDesert = 10; //the pileup of a window takes memory proportional to its length
+    size_t p = 0; //first suspicious position after the start of the window
+    int start = 0;
+    while (start < contigLength){
+        int end = min(start+window, contigLength);
+        size_t q = p;
+        while (q < positions.size() && (int)positions[q] < end){
+            q++;
+        }
+        if (q - p > (size_t) maxColumns){
+            //dense region: stop right before the suspicious position that would exceed the maximum
+            end = max(start+minLength, (int)positions[p+maxColumns]);
+            end = min(end, contigLength);
+        }
+        else if (q == p){
+            //desert: a single window up to the next suspicious position, within the limit of maxDesert windows
+            end = (q < positions.size()) ? max(end, (int)positions[q]) : contigLength;
+            end = min(end, start + maxDesert*window);
+            end = min(end, contigLength);
+        }
+        windows.push_back({start, end});
+        start = end;
+        while (p < positions.size() && (int)positions[p] < start){
+            p++;
+        }
+    }
+    return windows;
+}
+
+/**
+ * @brief Reads the regions to pile up: one per line, a contig name alone or followed by a 0-based start and end (tab-separated)
+ *
+ * @param file the file of regions
+ * @param names names of the contigs of the BAM
+ * @param lengths lengths of the contigs of the BAM
+ * @param regions filled with the [start, end) region of each contig, (0, 0) for the contigs that are not selected
+ * @return false if the file cannot be read or names a contig that is not in the BAM
+ */
+bool read_regions(const string &file, const vector<string> &names, const vector<int32_t> &lengths, vector<std::pair<int,int>> &regions){
+    std::ifstream in(file);
+    if (!in){
+        cerr << "ERROR: could not open " << file << endl;
+        return false;
+    }
+    robin_hood::unordered_map<string, int> contigOfName;
+    for (size_t c = 0 ; c < names.size() ; c++){
+        contigOfName[names[c]] = c;
+    }
+    regions.assign(names.size(), {0, 0});
+    string line;
+    while (std::getline(in, line)){
+        std::istringstream fields(line);
+        string name;
+        if (!(fields >> name)){
+            continue;
+        }
+        auto found = contigOfName.find(name);
+        if (found == contigOfName.end()){
+            cerr << "ERROR: the contig " << name << " of " << file << " is not in the BAM file" << endl;
+            return false;
+        }
+        int c = found->second;
+        int start, end;
+        if (fields >> start >> end){
+            regions[c] = {max(0, start), min(end, (int)lengths[c])};
+        }
+        else{
+            regions[c] = {0, lengths[c]};
+        }
+    }
+    return true;
+}
+
+//keeps only the windows that overlap the region of each contig
+void restrict_windows(Windows &windows, const vector<std::pair<int,int>> &regions){
+    for (size_t c = 0 ; c < windows.size() ; c++){
+        vector<std::pair<int,int>> kept;
+        for (auto &window : windows[c]){
+            if (window.first < regions[c].second && window.second > regions[c].first){
+                kept.push_back(window);
+            }
+        }
+        windows[c] = kept;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 7){
+        cout << "Usage: ./pileup_windows <sorted_bam> <window> <output.smpu> [min_base_quality (10)] [max_columns (0)] [regions]" << endl;
+        cout << "Extracts, for each window of each contig, the matrix of the reads on the suspicious positions" << endl;
+        cout << "With max_columns > 0, the windows are cut shorter where they would have more than max_columns suspicious positions and merged where they have none" << endl;
+        cout << "With a file of regions (one per line: contig, or contig<TAB>start<TAB>end, 0-based), only the windows overlapping them are extracted" << endl;
+        return 1;
+    }
+    string bamFile = argv[1];
+    int window = std::stoi(argv[2]);
+    string outputFile = argv[3];
+    int minBaseQuality = 10;
+    if (argc >= 5){
+        minBaseQuality = std::stoi(argv[4]);
+    }
+    int maxColumns = 0;
+    if (argc >= 6){
+        maxColumns = std::stoi(argv[5]);
+    }
+
+    BamReader bam(bamFile);
+    vector<std::pair<int,int>> regions;
+    for (size_t c = 0 ; c < bam.reference_names.size() ; c++){
+        regions.push_back({0, bam.reference_lengths[c]});
+    }
+    if (argc == 7 && !read_regions(argv[6], bam.reference_names, bam.reference_lengths, regions)){
+        return 1;
+    }
+
+    std::ofstream out(outputFile, std::ios::binary);
+    if (!out){
+        cerr << "ERROR: could not open " << outputFile << endl;
+        return 1;
+    }
+
+    out.write("SMPU", 4);
+    write_u32(out, SMPU_VERSION);
+    write_u32(out, bam.reference_names.size());
+    for (size_t c = 0 ; c < bam.reference_names.size() ; c++){
+        write_string(out, bam.reference_names[c]);
+        write_u32(out, bam.reference_lengths[c]);
+    }
+
+    //windows of fixed size, or chosen from a first pass over the pileup that only looks for the suspicious positions
+    Windows windows (bam.reference_names.size());
+    for (size_t c = 0 ; c < bam.reference_names.size() ; c++){
+        for (int start = 0 ; start < (int)bam.reference_lengths[c] ; start += window){
+            windows[c].push_back({start, min(start+window, (int)bam.reference_lengths[c])});
+        }
+    }
+    restrict_windows(windows, regions);
+    if (maxColumns > 0){
+        vector<vector<uint32_t>> positionsOfContig (bam.reference_names.size());
+        bool sorted = pileup(bamFile, windows, minBaseQuality, [&](vector<ActiveRead*> &active, int contig, int start, int end){
+            vector<uint32_t> positions;
+            vector<uint8_t> majorBase, secondBase;
+            suspicious_positions(active, start, end, positions, majorBase, secondBase);
+            positionsOfContig[contig].insert(positionsOfContig[contig].end(), positions.begin(), positions.end());
+        });
+        if (!sorted){
+            return 1;
+        }
+        size_t fixedWindows = 0;
+        size_t adaptiveWindows = 0;
+        for (size_t c = 0 ; c < bam.reference_names.size() ; c++){
+            fixedWindows += windows[c].size();
+            if (!windows[c].empty()){
+                windows[c] = adaptive_windows(positionsOfContig[c], bam.reference_lengths[c], window, maxColumns);
+            }
+        }
+        restrict_windows(windows, regions);
+        for (size_t c = 0 ; c < bam.reference_names.size() ; c++){
+            adaptiveWindows += windows[c].size();
+        }
+        cout << "Adaptive windows: " << adaptiveWindows << " windows instead of " << fixedWindows << endl;
+    }
+
+    bool sorted = pileup(bamFile, windows, minBaseQuality, [&](vector<ActiveRead*> &active, int contig, int start, int end){
+        output_window(active, contig, start, end, out);
+    });
+    if (!sorted){
+        return 1;
+    }
+
+    out.close();
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "profiling.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <sys/resource.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::string;
+using std::vector;
+using std::map;
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::ifstream;
+
+static std::atomic<int> processesSpawned (0);
+static thread_local int processesSpawnedByThread = 0;
+
+/**
+ * @brief Runs a shell command with system(), counting it in the profile
+ *
+ * @param command the command
+ * @return the value returned by system()
+ */
+int run_command(const std::string &command){
+    processesSpawned++;
+    processesSpawnedByThread++;
+    return system(command.c_str());
+}
+
+static double wall_time(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//CPU time of the calling thread, or of the whole process and of its finished children
+static double cpu_time(bool perThread){
+    if (perThread){
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec*1e-9;
+    }
+    double total = 0;
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN}){
+        rusage usage;
+        getrusage(who, &usage);
+        total += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+    }
+    return total;
+}
+
+static long peak_rss(){
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+//bytes read and written by the process so far (0 if /proc/self/io is not available)
+static void io_counters(uint64_t &read, uint64_t &written){
+    read = 0;
+    written = 0;
+    ifstream in("/proc/self/io");
+    string key;
+    uint64_t value;
+    while (in >> key >> value){
+        if (key == "rchar:"){
+            read = value;
+        }
+        else if (key == "wchar:"){
+            written = value;
+        }
+    }
+}
+
+/**
+ * @brief Starts measuring a stage
+ *
+ * @param stage name of the stage
+ * @param contig contig on which the stage is run, if any
+ * @param perThread true to measure only the calling thread (e.g. one backbone in the parallel loop of modify_GFA)
+ */
+StageTimer::StageTimer(std::string stage, std::string contig, bool perThread){
+    record.stage = stage;
+    record.contig = contig;
+    record.thread = -1;
+    if (perThread){
+        record.thread = 0;
+#ifdef _OPENMP
+        record.thread = omp_get_thread_num();
+#endif
+    }
+    startWall = wall_time();
+    startCPU = cpu_time(perThread);
+    startRead = 0;
+    startWritten = 0;
+    if (!perThread){
+        io_counters(startRead, startWritten);
+    }
+    startSpawned = perThread ? processesSpawnedByThread : processesSpawned.load();
+}
+
+StageRecord StageTimer::stop(){
+    bool perThread = record.thread >= 0;
+    record.wall = wall_time() - startWall;
+    record.cpu = cpu_time(perThread) - startCPU;
+    record.peakRSS = peak_rss();
+    record.bytesRead = 0;
+    record.bytesWritten = 0;
+    if (!perThread){
+        io_counters(record.bytesRead, record.bytesWritten);
+        record.bytesRead -= startRead;
+        record.bytesWritten -= startWritten;
+    }
+    record.processesSpawned = (perThread ? processesSpawnedByThread : processesSpawned.load()) - startSpawned;
+    return record;
+}
+
+void Profiler::add(const StageRecord &record){
+    std::lock_guard<std::mutex> lock(mutex);
+    records.push_back(record);
+}
+
+std::vector<StageRecord> Profiler::get_records(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+//load of each thread, from the "backbone" records
+struct ThreadLoad{
+    int backbones = 0;
+    double wall = 0;
+    double cpu = 0;
+    int processesSpawned = 0;
+};
+static map<int, ThreadLoad> thread_loads(const vector<StageRecord> &records){
+    map<int, ThreadLoad> loads;
+    for (auto &r : records){
+        if (r.stage == "backbone"){
+            loads[r.thread].backbones++;
+            loads[r.thread].wall += r.wall;
+            loads[r.thread].cpu += r.cpu;
+            loads[r.thread].processesSpawned += r.processesSpawned;
+        }
+    }
+    return loads;
+}
+
+static string json_string(const string &s){
+    string res = "\"";
+    for (char c : s){
+        if (c == '"' || c == '\\'){
+            res += '\\';
+        }
+        if ((unsigned char) c >= 32){
+            res += c;
+        }
+    }
+    return res + "\"";
+}
+
+/**
+ * @brief Writes all the records, followed by the load of each thread
+ *
+ * @param file output file, JSON unless its name ends with .tsv
+ */
+void Profiler::write(std::string file){
+
+    vector<StageRecord> all = get_records();
+    ofstream out(file);
+    if (!out){
+        cout << "WARNING: could not write the profile to " << file << endl;
+        return;
+    }
+
+    if (file.size() > 4 && file.substr(file.size()-4) == ".tsv"){
+        out << "stage\tcontig\tthread\twall_s\tcpu_s\tpeak_rss_kb\tbytes_read\tbytes_written\tprocesses\n";
+        for (auto &r : all){
+            out << r.stage << "\t" << r.contig << "\t" << r.thread << "\t" << r.wall << "\t" << r.cpu << "\t" << r.peakRSS
+                << "\t" << r.bytesRead << "\t" << r.bytesWritten << "\t" << r.processesSpawned << "\n";
+        }
+        return;
+    }
+
+    out << "{\n  \"stages\": [";
+    for (size_t i = 0 ; i < all.size() ; i++){
+        auto &r = all[i];
+        out << (i > 0 ? ",\n" : "\n") << "    {\"stage\": " << json_string(r.stage) << ", \"contig\": " << json_string(r.contig)
+            << ", \"thread\": " << r.thread << ", \"wall_s\": " << r.wall << ", \"cpu_s\": " << r.cpu
+            << ", \"peak_rss_kb\": " << r.peakRSS << ", \"bytes_read\": " << r.bytesRead << ", \"bytes_written\": " << r.bytesWritten
+            << ", \"processes\": " << r.processesSpawned << "}";
+    }
+    out << "\n  ],\n  \"threads\": [";
+    bool first = true;
+    for (auto &t : thread_loads(all)){
+        out << (first ? "\n" : ",\n") << "    {\"thread\": " << t.first << ", \"backbones\": " << t.second.backbones
+            << ", \"busy_s\": " << t.second.wall << ", \"cpu_s\": " << t.second.cpu << ", \"processes\": " << t.second.processesSpawned << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Prints how the backbones were spread between the threads
+ */
+void Profiler::print_thread_load(){
+    auto loads = thread_loads(get_records());
+    double maxBusy = 0;
+    for (auto &t : loads){
+        maxBusy = std::max(maxBusy, t.second.wall);
+    }
+    for (auto &t : loads){
+        cout << "   thread " << t.first << ": " << t.second.backbones << " backbones, busy " << t.second.wall << "s ("
+            << (maxBusy > 0 ? int(100*t.second.wall/maxBusy) : 100) << "% of the busiest thread), cpu " << t.second.cpu << "s, "
+            << t.second.processesSpawned << " external processes" << endl;
+    }
+}
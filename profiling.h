@@ -0,0 +1,62 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * @brief Resources used by one stage of the pipeline (or by one backbone, for the stages that are run per contig)
+ */
+struct StageRecord{
+    std::string stage;
+    std::string contig; //empty for the stages that are not run per contig
+    int thread; //thread that ran the stage, -1 for the stages run on the whole process
+    double wall; //seconds
+    double cpu; //seconds, of the thread if thread >= 0, else of the process and of its children
+    long peakRSS; //kB, peak resident size of the process at the end of the stage
+    uint64_t bytesRead; //of the process if thread == -1, else 0
+    uint64_t bytesWritten;
+    int processesSpawned; //external processes launched through run_command
+};
+
+/**
+ * @brief Measures the resources used between its construction and stop()
+ */
+class StageTimer{
+
+public :
+    StageTimer(std::string stage, std::string contig = "", bool perThread = false);
+    StageRecord stop();
+
+private :
+    StageRecord record;
+    double startWall;
+    double startCPU;
+    uint64_t startRead;
+    uint64_t startWritten;
+    int startSpawned;
+};
+
+/**
+ * @brief Collects the records of the stages, from any thread, and writes them as JSON or TSV
+ */
+class Profiler{
+
+public :
+    void add(const StageRecord &record);
+
+    void write(std::string file); //JSON, or TSV if file ends with .tsv
+    void print_thread_load(); //summary of the "backbone" records, to spot the stragglers
+
+    std::vector<StageRecord> get_records();
+
+private :
+    std::mutex mutex;
+    std::vector<StageRecord> records;
+};
+
+int run_command(const std::string &command); //system(), counting the processes spawned
+
+#endif
@@ -0,0 +1,139 @@
+#include "quasibiclique.h"
+#include "bitmatrix.h"
+
+#include <algorithm>
+#include <numeric>
+
+using std::vector;
+
+/**
+ * @brief Chooses the best lines when the other dimension of the quasi-biclique is fixed: the lines with the fewest 0s, as many as the error rate allows
+ *
+ * @param lines bit-packed lines
+ * @param other lines of the other dimension, which are fixed
+ * @param errorRate maximum proportion of 0s
+ * @param chosen filled with the chosen lines, sorted
+ * @return number of 1s in the quasi-biclique
+ */
+static long long best_lines(const BitMatrix &lines, const vector<int> &other, double errorRate, vector<int> &chosen){
+
+    chosen.clear();
+    if (other.size() == 0){
+        return 0;
+    }
+    vector<uint64_t> mask = lines.mask_of(other.data(), other.size());
+    vector<int> zeros (lines.rows());
+    for (int l = 0 ; l < lines.rows() ; l++){
+        zeros[l] = other.size() - lines.count(l, mask.data(), 1);
+    }
+    vector<int> order (lines.rows());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){return zeros[a] < zeros[b];});
+
+    //the average number of 0s grows along order, so the lines that can be taken are a prefix of order
+    long long sumOfZeros = 0;
+    size_t k = 0;
+    while (k < order.size() && sumOfZeros + zeros[order[k]] <= errorRate * (k+1) * other.size()){
+        sumOfZeros += zeros[order[k]];
+        k++;
+    }
+    chosen.assign(order.begin(), order.begin()+k);
+    std::sort(chosen.begin(), chosen.end());
+    return (long long) k * other.size() - sumOfZeros;
+}
+
+//lines sorted by decreasing number of 1s, as np.argsort(...)[::-1]
+static void sort_by_ones(const BitMatrix &lines, vector<int> &sorted){
+    vector<uint64_t> all (lines.words_per_row(), ~uint64_t(0));
+    vector<int> ones (lines.rows());
+    for (int l = 0 ; l < lines.rows() ; l++){
+        ones[l] = lines.count(l, all.data(), 1);
+    }
+    sorted.resize(lines.rows());
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::stable_sort(sorted.begin(), sorted.end(), [&](int a, int b){return ones[a] < ones[b];});
+    std::reverse(sorted.begin(), sorted.end());
+}
+
+/**
+ * @brief Finds the seed of the quasi-biclique: the largest top-left rectangle of the sorted matrix that is almost only 1s
+ *
+ * @param matrix the matrix
+ * @param rowsSorted rows by decreasing number of 1s
+ * @param colsSorted columns by decreasing number of 1s
+ * @param seedRows filled with the number of rows of the seed
+ * @param seedCols filled with the number of columns of the seed
+ */
+void seed_rectangle(const BitMatrix &matrix, const std::vector<int> &rowsSorted, const std::vector<int> &colsSorted, int &seedRows, int &seedCols){
+    int m = rowsSorted.size();
+    int n = colsSorted.size();
+    RectangleSums sums (matrix, rowsSorted, colsSorted);
+    seedRows = std::max(1, m/3);
+    seedCols = std::max(1, n/3);
+    int stepCols = (n > 50) ? 10 : 2;
+    for (int x = std::max(1, m/3) ; x < m ; x += 10){
+        for (int y = std::max(1, n/3) ; y < n ; y += stepCols){
+            double ratioOf1 = double(sums.sum(x, y)) / (x*y);
+            if (ratioOf1 > 0.99 && x*y > seedRows*seedCols){
+                seedRows = x;
+                seedCols = y;
+            }
+        }
+    }
+}
+
+bool find_quasibiclique(const int8_t* matrix, int m, int n, double errorRate, std::vector<int> &rows, std::vector<int> &cols){
+
+    rows.clear();
+    cols.clear();
+    if (m == 0 || n == 0){
+        return false;
+    }
+
+    BitMatrix rowBits (matrix, m, n);
+    BitMatrix colBits = rowBits.transposed();
+    vector<int> rowsSorted, colsSorted;
+    sort_by_ones(rowBits, rowsSorted);
+    sort_by_ones(colBits, colsSorted);
+
+    int seedRows, seedCols;
+    seed_rectangle(rowBits, rowsSorted, colsSorted, seedRows, seedCols);
+
+    //extend: alternately choose the best rows for the columns and the best columns for the rows, as long as the number of 1s grows
+    vector<int> currentRows;
+    vector<int> currentCols (colsSorted.begin(), colsSorted.begin()+seedCols);
+    std::sort(currentCols.begin(), currentCols.end());
+    long long best = -1;
+    for (int iteration = 0 ; iteration < 100 ; iteration++){
+        long long ones = best_lines(rowBits, currentCols, errorRate, currentRows);
+        if (ones <= best){
+            break;
+        }
+        best = ones;
+        rows = currentRows;
+        cols = currentCols;
+
+        ones = best_lines(colBits, currentRows, errorRate, currentCols);
+        if (ones <= best){
+            break;
+        }
+        best = ones;
+        rows = currentRows;
+        cols = currentCols;
+    }
+    return true;
+}
+
+int sm_quasibiclique(const int8_t* matrix, int m, int n, double errorRate, int* rows, int* nbRows, int* cols, int* nbCols){
+    vector<int> r, c;
+    bool found = find_quasibiclique(matrix, m, n, errorRate, r, c);
+    std::copy(r.begin(), r.end(), rows);
+    std::copy(c.begin(), c.end(), cols);
+    *nbRows = r.size();
+    *nbCols = c.size();
+    return found ? 1 : 0;
+}
+
+void sm_seed_rectangle(const PackedMatrix* matrix, const int* rowsSorted, int m, const int* colsSorted, int n, int* seedRows, int* seedCols){
+    seed_rectangle(matrix->byRow, vector<int>(rowsSorted, rowsSorted+m), vector<int>(colsSorted, colsSorted+n), *seedRows, *seedCols);
+}
@@ -0,0 +1,35 @@
+#ifndef QUASIBICLIQUE_H
+#define QUASIBICLIQUE_H
+
+#include <vector>
+#include <cstdint>
+
+class BitMatrix;
+struct PackedMatrix;
+
+/**
+ * @brief Heuristic for the maximum quasi-biclique of 1s of a binary matrix: finds the rows and the columns
+ * maximizing the number of 1s of the submatrix while keeping its proportion of 0s below an error rate.
+ * Same problem as the ILP of quasibiclique() in strainminer.py, solved by seed-and-extend on bit-packed rows and columns
+ *
+ * @param matrix row-major m x n matrix of 0/1
+ * @param m number of rows
+ * @param n number of columns
+ * @param errorRate maximum proportion of 0s in the submatrix
+ * @param rows filled with the rows of the quasi-biclique
+ * @param cols filled with the columns of the quasi-biclique
+ * @return false if the matrix is empty
+ */
+bool find_quasibiclique(const int8_t* matrix, int m, int n, double errorRate, std::vector<int> &rows, std::vector<int> &cols);
+
+void seed_rectangle(const BitMatrix &matrix, const std::vector<int> &rowsSorted, const std::vector<int> &colsSorted, int &seedRows, int &seedCols);
+
+//C interface, loaded with ctypes from strainminer.py
+extern "C" {
+    //rows and cols must have room for m and n integers, their sizes are written in nbRows and nbCols. Returns 0 if the matrix is empty, 1 otherwise
+    int sm_quasibiclique(const int8_t* matrix, int m, int n, double errorRate, int* rows, int* nbRows, int* cols, int* nbCols);
+    //seed of the ILP of quasibiclique() in strainminer.py, on the 1s of a matrix packed by sm_bitmatrix_new
+    void sm_seed_rectangle(const PackedMatrix* matrix, const int* rowsSorted, int m, const int* colsSorted, int n, int* seedRows, int* seedCols);
+}
+
+#endif
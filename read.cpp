@@ -8,7 +8,6 @@ Read::Read()
 {
     sequence_ = Sequence();
     name = "";
-    number_of_threads_in_which_it_is_loaded = 0;
     size_ = 0;
 }
 
@@ -17,21 +16,16 @@ Read::Read(std::string s, size_t size)
     sequence_ = Sequence(s);
     name = "";
     depth = -1;
-    number_of_threads_in_which_it_is_loaded = 0;
     size_ = size;
 }
 
 void Read::upload_sequence(std::string s){
     sequence_ = Sequence(s);
     size_ = s.size();
-    number_of_threads_in_which_it_is_loaded += 1;
 }
 
 void Read::free_sequence(){
-    number_of_threads_in_which_it_is_loaded -= 1;
-    if (number_of_threads_in_which_it_is_loaded == 0){
-        sequence_ = Sequence();
-    }
+    sequence_ = Sequence();
 }
 
 void Read::add_overlap(long int o){
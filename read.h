@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <list>
+#include <cstdint>
 //#include <thread>
 //#include <mutex>
 
@@ -11,16 +12,16 @@
 
 struct Overlap
 {
-    unsigned long int sequence1;
-    unsigned long int sequence2;
+    uint32_t sequence1;
+    uint32_t sequence2;
     int position_1_1;
     int position_1_2;
     int position_2_1;
     int position_2_2;
-    bool strand; //false if the two reads are on different strands
     float diff; //indicative edit distance
-
-    std::string CIGAR;
+    uint32_t CIGARLength; //number of operations of the CIGAR
+    uint64_t CIGAROffset; //position of the CIGAR in the CigarArena of all the overlaps
+    bool strand; //false if the two reads are on different strands
 };
 
 struct Link{
@@ -40,7 +41,7 @@ public:
     Read();
     Read(std::string s, size_t size); //size is the size of the sequence but sometimes we don't upload the actual sequence to be light on memory 
 
-    void upload_sequence(std::string s);
+    void upload_sequence(std::string s); //the reads shared between backbones are loaded and freed through a ReadStore
     void free_sequence();
     Sequence sequence_;
 
@@ -68,8 +69,6 @@ private : //when reads are actually contigs
     std::vector<size_t> links_right;
     size_t size_; //size of the sequence (the sequence won't be stored in memory, only its size)
 
-    int number_of_threads_in_which_it_is_loaded;
-
     long int positionInFile_;
 };
 
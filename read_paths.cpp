@@ -0,0 +1,104 @@
+#include "read_paths.h"
+
+#include <algorithm>
+
+using std::string;
+using std::vector;
+using std::get;
+
+//true if the last element of the path is a marker, or a contig whose name ends like one (it is then treated as a marker as well)
+static bool ends_with_marker(const Path &path){
+    const string &last = get<1>(path)[get<1>(path).size()-1].first;
+    char lastchar = last[last.size()-1];
+    return lastchar == '&' || lastchar == '+' || lastchar == '-';
+}
+
+void merge_read_paths(vector<Path> &paths, const PathLinks &linked){
+
+    if (paths.size() == 0){
+        return;
+    }
+
+    std::sort(paths.begin(), paths.end(),[] (const auto &x, const auto &y) { return get<0>(x) < get<0>(y); }); //gets the list sorted on first element of pair, i.e. position of contig on read
+
+    vector<Path> mergedPaths;
+    Path currentPath = paths[0];
+    //check if each path can be merged with next path
+    for (auto p = 0 ; p<paths.size()-1 ; p++){
+
+        long int contig = get<2> (currentPath);
+        bool orientation = get<1>(currentPath)[get<1>(currentPath).size()-1].second;
+        long int nextContig = get<2> (paths[p+1]);
+
+        if (contig != nextContig){
+
+            bool merge = linked(contig, orientation, nextContig, get<1>(paths[p+1])[0].second);
+
+            //if & in name, there is a cut there
+            char lastchar = get<1>(currentPath)[get<1>(currentPath).size()-1].first[get<1>(currentPath)[get<1>(currentPath).size()-1].first.size()-1];
+            char firstnextchar = get<1>(paths[p+1])[get<1>(paths[p+1]).size()-1].first[get<1>(paths[p+1])[get<1>(paths[p+1]).size()-1].first.size()-1];
+            if (lastchar == '&' || lastchar == '+' || firstnextchar == '-'){
+                merge = false;
+            }
+            if (ends_with_marker(currentPath)){
+                get<1>(currentPath).erase(get<1>(currentPath).end()-1);
+            }
+
+            if (merge){
+                get<1>(currentPath).insert(get<1>(currentPath).end(), get<1> (paths[p+1]).begin(), get<1> (paths[p+1]).end());
+                get<2>(currentPath) = get<2> (paths[p+1]);
+            }
+            else{
+                mergedPaths.push_back(currentPath);
+                currentPath = paths[p+1];
+            }
+        }
+        else{
+            if (ends_with_marker(currentPath)){
+                get<1>(currentPath).erase(get<1>(currentPath).end()-1);
+            }
+            mergedPaths.push_back(currentPath);
+            currentPath = paths[p+1];
+        }
+    }
+    //if & in name, delete it
+    if (ends_with_marker(currentPath)){
+        get<1>(currentPath).erase(get<1>(currentPath).end()-1);
+    }
+
+    mergedPaths.push_back(currentPath);
+
+    paths = mergedPaths;
+}
+
+//the contigs of the path in the GAF syntax (>contig or <contig), from the element first to the element last (excluded)
+static void output_contigs(BufferedWriter &out, const Path &path, size_t first, size_t last){
+    for (size_t c = first ; c < last ; c++){
+        if (get<1>(path)[c].second){
+            out << ">";
+        }
+        else{
+            out << "<";
+        }
+        out << get<1>(path)[c].first;
+    }
+}
+
+void output_GAF_path(BufferedWriter &out, const string &readName, const Path &path){
+    out << readName << "\t-1\t"<< get<0>(path) <<"\t-1\t+\t";
+    output_contigs(out, path, 0, get<1>(path).size());
+    out << "\t-1\t-1\t-1\t-1\t-1\t255\n";
+}
+
+void output_GAF_fragment(BufferedWriter &out, const string &readName, long int readRecord, const Path &path, const string &contig){
+    const vector<std::pair<string, bool>> &contigs = get<1>(path);
+    const string &last = contigs[contigs.size()-1].first;
+    bool marker = contigs.size() > 1 && (last == "&" || last == "+" || last == "-");
+    out << readName << "\t-1\t"<< get<0>(path) <<"\t-1\t+\t";
+    output_contigs(out, path, 0, contigs.size() - marker);
+    out << "\t-1\t-1\t-1\t-1\t-1\t255\toc:Z:" << contig << "\tri:i:" << readRecord;
+    if (marker){
+        out << "\tma:Z:" << (contigs[contigs.size()-1].second ? ">" : "<") << last;
+    }
+    out << "\n";
+}
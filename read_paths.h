@@ -0,0 +1,37 @@
+#ifndef READ_PATHS_H
+#define READ_PATHS_H
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <functional>
+
+#include "buffered_writer.h"
+
+typedef std::tuple<int, std::vector<std::pair<std::string, bool>>, long int> Path; //a path is a starting position on a read, a list of contigs and their orientation relative to the read, and the index of the contig on which it aligns
+
+/**
+ * @brief Tells if a path ending on a contig can continue on the next contig. linked(contig, rightEnd, nextContig, nextOrientation) is true
+ * if a link at the right (or left) end of contig leads to nextContig traversed in nextOrientation
+ */
+typedef std::function<bool(long int, bool, long int, bool)> PathLinks;
+
+/**
+ * @brief Merges the paths of a read that go from one contig to the next through a link of the graph. The last element of a path may be a
+ * marker telling that the read does not extend to the end (+), to the beginning (-) or to either end (&) of the contig: the path is then not
+ * merged on this side. The markers are removed from the merged paths
+ *
+ * @param paths paths of the read, in the order of the contigs on which they were computed. Replaced by the merged paths
+ * @param linked links of the graph
+ */
+void merge_read_paths(std::vector<Path> &paths, const PathLinks &linked);
+
+void output_GAF_path(BufferedWriter &out, const std::string &readName, const Path &path); //one line of the .gaf file
+
+/**
+ * @brief One line of the .gaf file of a shard, for a path that is not merged yet: the contig of the path (oc), the index of the read in the
+ * reads file (ri) and the marker (ma) are given as tags, so that merge_shards can merge the paths of all the shards as output_GAF does
+ */
+void output_GAF_fragment(BufferedWriter &out, const std::string &readName, long int readRecord, const Path &path, const std::string &contig);
+
+#endif
@@ -0,0 +1,85 @@
+#include "read_store.h"
+
+#include <string>
+
+using std::vector;
+using std::string;
+
+ReadStore::ReadStore(ReadsIndex &readsIndex, vector<Read> &allreads, size_t memoryCap) : readsIndex(readsIndex), allreads(allreads), memoryCap(memoryCap),
+    users(allreads.size(), 0), positionInReleased(allreads.size()), isReleased(allreads.size(), 0), releasedBytes(0), loads(0), reuses(0){
+}
+
+size_t ReadStore::bytes(const Read &read){
+    return (read.sequence_.size()+31)/32*8 + sizeof(Sequence); //2 bits per base
+}
+
+void ReadStore::acquire(const vector<long int> &reads){
+
+    //the reads already in memory are taken right away, the others are fetched without locking: the index can be read concurrently
+    vector<long int> toLoad;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (long int read : reads){
+            if (users[read] == 0 && isReleased[read]){
+                released.erase(positionInReleased[read]);
+                isReleased[read] = 0;
+                releasedBytes -= bytes(allreads[read]);
+                reuses++;
+            }
+            else if (users[read] == 0){
+                toLoad.push_back(read);
+                continue;
+            }
+            users[read]++;
+        }
+    }
+
+    vector<string> sequences (toLoad.size());
+    for (size_t r = 0 ; r < toLoad.size() ; r++){
+        readsIndex.fetch(allreads[toLoad[r]].get_position_in_file(), sequences[r]);
+    }
+
+    //another thread may have loaded some of these reads in the meantime: never replace a sequence under its feet
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t r = 0 ; r < toLoad.size() ; r++){
+        long int read = toLoad[r];
+        if (users[read] == 0 && isReleased[read]){
+            released.erase(positionInReleased[read]);
+            isReleased[read] = 0;
+            releasedBytes -= bytes(allreads[read]);
+        }
+        else if (users[read] == 0){
+            allreads[read].upload_sequence(sequences[r]);
+            loads++;
+        }
+        users[read]++;
+        string().swap(sequences[r]);
+    }
+}
+
+void ReadStore::release(const vector<long int> &reads){
+    std::lock_guard<std::mutex> lock(mutex);
+    for (long int read : reads){
+        if (users[read] == 0){ //not acquired
+            continue;
+        }
+        users[read]--;
+        if (users[read] == 0){
+            released.push_front(read);
+            positionInReleased[read] = released.begin();
+            isReleased[read] = 1;
+            releasedBytes += bytes(allreads[read]);
+        }
+    }
+    evict();
+}
+
+void ReadStore::evict(){
+    while (releasedBytes > memoryCap && !released.empty()){
+        long int read = released.back();
+        released.pop_back();
+        isReleased[read] = 0;
+        releasedBytes -= bytes(allreads[read]);
+        allreads[read].free_sequence();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef READ_STORE_H
+#define READ_STORE_H
+
+#include <vector>
+#include <list>
+#include <mutex>
+#include <cstdint>
+
+#include "read.h"
+#include "reads_index.h"
+
+/**
+ * @brief Loads the sequences of the reads in allreads when a backbone needs them, and frees them when no backbone uses them anymore.
+ * A read can align on several backbones processed at the same time: each backbone acquires and releases its reads, and a sequence is only
+ * freed when the last backbone releases it. The released sequences are kept, least recently used first out, up to a memory cap, in case
+ * another backbone needs them again. All the functions can be called concurrently
+ */
+class ReadStore{
+
+public :
+    ReadStore(ReadsIndex &readsIndex, std::vector<Read> &allreads, size_t memoryCap);
+
+    void acquire(const std::vector<long int> &reads); //loads the sequences that are not in memory. A read may be given several times, it must then be released as many times
+    void release(const std::vector<long int> &reads);
+
+    size_t loaded_from_file() const {return loads;} //number of sequences read from the file
+    size_t reused() const {return reuses;} //number of sequences found among the released ones
+
+private :
+    ReadsIndex &readsIndex;
+    std::vector<Read> &allreads;
+    size_t memoryCap; //bytes of released sequences that can be kept
+
+    std::mutex mutex;
+    std::vector<uint32_t> users; //number of acquisitions not released yet, for each read
+    std::list<long int> released; //sequences in memory that nobody uses, most recently released first
+    std::vector<std::list<long int>::iterator> positionInReleased;
+    std::vector<char> isReleased;
+    size_t releasedBytes;
+    size_t loads;
+    size_t reuses;
+
+    static size_t bytes(const Read &read);
+    void evict(); //frees the least recently used released sequences, down to the memory cap
+};
+
+#endif
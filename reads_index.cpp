@@ -0,0 +1,443 @@
+#include "reads_index.h"
+#include "bgzf.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::cout;
+using std::endl;
+
+/**
+ * @brief Inflating state of one thread, so that the BGZF blocks can be decompressed concurrently
+ */
+struct ThreadInflater{
+    z_stream strm;
+    vector<unsigned char> compressed;
+    vector<unsigned char> block;
+    uint64_t blockAddress; //address of the block currently in block, to avoid inflating it twice in a row
+    int fd;
+
+    ThreadInflater(){
+        memset(&strm, 0, sizeof(strm));
+        inflateInit2(&strm, -15);
+        compressed.resize(65536);
+        blockAddress = 0;
+        fd = -1;
+    }
+    ~ThreadInflater(){
+        inflateEnd(&strm);
+    }
+};
+
+//last modification time of a file, -1 if it does not exist
+static long int modification_time(string file){
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0){
+        return -1;
+    }
+    return st.st_mtime;
+}
+
+/**
+ * @brief Opens the file of reads and loads its index, building it if it does not exist or is older than the reads
+ *
+ * @param fileReads FASTA or FASTQ file, possibly compressed with bgzip or gzip
+ */
+ReadsIndex::ReadsIndex(std::string fileReads){
+
+    file = fileReads;
+    fastq = false;
+    fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0){
+        cout << "problem reading files in index_reads, while trying to read " << fileReads << endl;
+        throw std::invalid_argument( "Input file could not be read" );
+    }
+
+    unsigned char magic[2] = {0,0};
+    pread(fd, magic, 2, 0);
+    compression = PLAIN;
+    if (magic[0] == 31 && magic[1] == 139){
+        compression = is_bgzf(file) ? BGZF : GZIP;
+    }
+
+    if (compression == GZIP){
+        cout << "WARNING: " << file << " is compressed with gzip, not bgzip: it is entirely decompressed in memory. Compress it with bgzip to spare memory" << endl;
+        gzFile gz = gzopen(file.c_str(), "rb");
+        vector<char> buffer (1<<20);
+        int n;
+        while ((n = gzread(gz, buffer.data(), buffer.size())) > 0){
+            inMemory.append(buffer.data(), n);
+        }
+        gzclose(gz);
+        if (n < 0){
+            cout << "ERROR: " << file << " is not a valid gzip file" << endl;
+            throw std::runtime_error("Corrupted gzip file");
+        }
+        build_index(); //the offsets refer to the decompressed file, which is not on the disk: the index is not saved
+        return;
+    }
+
+    string indexFile = file + ".fai";
+    long int readsTime = modification_time(file);
+    if (compression == BGZF){
+        string gziFile = file + ".gzi";
+        if (modification_time(gziFile) < readsTime || !load_gzi(gziFile)){
+            build_gzi();
+            write_gzi(gziFile);
+        }
+    }
+    if (modification_time(indexFile) < readsTime || !load_index(indexFile)){
+        build_index();
+        write_index(indexFile);
+    }
+}
+
+ReadsIndex::~ReadsIndex(){
+    if (fd >= 0){
+        close(fd);
+    }
+}
+
+size_t ReadsIndex::size() const{
+    return entries.size();
+}
+
+const FaiEntry& ReadsIndex::entry(size_t record) const{
+    return entries[record];
+}
+
+bool ReadsIndex::is_fastq() const{
+    return fastq;
+}
+
+/**
+ * @brief Goes through the whole (decompressed) file and records the position of every sequence
+ */
+void ReadsIndex::build_index(){
+
+    entries.clear();
+
+    //sequential reading of the uncompressed content
+    std::function<size_t(char*, size_t)> read;
+    BgzfReader* bgzf = nullptr;
+    uint64_t plainOffset = 0;
+    if (compression == PLAIN){
+        read = [&](char* dest, size_t length){
+            ssize_t n = pread(fd, dest, length, plainOffset);
+            n = std::max(ssize_t(0), n);
+            plainOffset += n;
+            return size_t(n);
+        };
+    }
+    else if (compression == BGZF){
+        bgzf = new BgzfReader(file);
+        read = [&](char* dest, size_t length){
+            return bgzf->read(dest, length);
+        };
+    }
+    else{
+        read = [&](char* dest, size_t length){
+            size_t n = std::min(length, inMemory.size()-plainOffset);
+            memcpy(dest, inMemory.data()+plainOffset, n);
+            plainOffset += n;
+            return n;
+        };
+    }
+
+    vector<char> buffer (1<<20);
+    size_t bufferSize = 0;
+    size_t posInBuffer = 0;
+    uint64_t offset = 0; //offset in the uncompressed file of the next line
+    //reads the next line, returns its offset and its length end of line included
+    auto next_line = [&](string &line, uint64_t &lineOffset, size_t &rawLength){
+        line.clear();
+        lineOffset = offset;
+        rawLength = 0;
+        while (true){
+            if (posInBuffer == bufferSize){
+                bufferSize = read(buffer.data(), buffer.size());
+                posInBuffer = 0;
+                if (bufferSize == 0){
+                    return rawLength > 0;
+                }
+            }
+            char* start = buffer.data()+posInBuffer;
+            char* eol = (char*) memchr(start, '\n', bufferSize-posInBuffer);
+            size_t n = (eol == nullptr) ? bufferSize-posInBuffer : eol-start;
+            line.append(start, n);
+            posInBuffer += n;
+            rawLength += n;
+            offset += n;
+            if (eol != nullptr){
+                posInBuffer++;
+                rawLength++;
+                offset++;
+                return true;
+            }
+        }
+    };
+
+    string line;
+    uint64_t lineOffset;
+    size_t rawLength;
+    FaiEntry current;
+    int state = 0; //0: expecting a header, 1: in the sequence, 2: in the qualities (FASTQ)
+    uint64_t qualitiesRead = 0;
+    bool firstLine = true;
+    while (next_line(line, lineOffset, rawLength)){
+        size_t lineLength = line.size();
+        if (lineLength > 0 && line[lineLength-1] == '\r'){
+            lineLength--;
+        }
+        if (firstLine && lineLength > 0){
+            fastq = (line[0] == '@');
+            firstLine = false;
+        }
+
+        if (state == 2){
+            if (qualitiesRead == 0){
+                current.qualOffset = lineOffset;
+            }
+            qualitiesRead += lineLength;
+            if (qualitiesRead >= current.length){
+                entries.push_back(current);
+                state = 0;
+            }
+            continue;
+        }
+        if (lineLength == 0){
+            continue;
+        }
+        if (fastq && state == 1 && line[0] == '+'){
+            qualitiesRead = 0;
+            state = 2;
+            if (current.length == 0){
+                entries.push_back(current);
+                state = 0;
+            }
+            continue;
+        }
+        if ((!fastq && line[0] == '>') || (fastq && state == 0 && line[0] == '@')){
+            if (!fastq && state == 1){
+                entries.push_back(current);
+            }
+            //the name of the sequence as it will appear in minimap, i.e. up to the first blank space
+            size_t endOfName = line.find_first_of(" \t\r", 1);
+            current.name = line.substr(1, endOfName == string::npos ? string::npos : endOfName-1);
+            current.length = 0;
+            current.offset = lineOffset + rawLength;
+            current.lineBases = 0;
+            current.lineWidth = 0;
+            current.qualOffset = 0;
+            state = 1;
+            continue;
+        }
+        if (state == 1){
+            if (current.lineBases == 0){
+                current.lineBases = lineLength;
+                current.lineWidth = rawLength;
+            }
+            current.length += lineLength;
+        }
+    }
+    if (!fastq && state == 1){
+        entries.push_back(current);
+    }
+    if (state == 2){
+        cout << "ERROR: the qualities of the last read of " << file << " are truncated" << endl;
+        throw std::runtime_error("Truncated FASTQ file");
+    }
+    delete bgzf;
+}
+
+/**
+ * @brief Loads an existing .fai file
+ *
+ * @param indexFile
+ * @return false if the index could not be read
+ */
+bool ReadsIndex::load_index(std::string indexFile){
+
+    std::ifstream in(indexFile);
+    if (!in){
+        return false;
+    }
+    entries.clear();
+    string line;
+    while (getline(in, line)){
+        std::istringstream iss(line);
+        FaiEntry e;
+        e.qualOffset = 0;
+        if (!(iss >> e.name >> e.length >> e.offset >> e.lineBases >> e.lineWidth)){
+            entries.clear();
+            return false;
+        }
+        fastq = bool(iss >> e.qualOffset);
+        entries.push_back(e);
+    }
+    return entries.size() > 0;
+}
+
+void ReadsIndex::write_index(std::string indexFile){
+
+    std::ofstream out(indexFile);
+    if (!out){
+        cout << "WARNING: could not write the index " << indexFile << ", it will be rebuilt at each run" << endl;
+        return;
+    }
+    for (const FaiEntry &e : entries){
+        out << e.name << "\t" << e.length << "\t" << e.offset << "\t" << e.lineBases << "\t" << e.lineWidth;
+        if (fastq){
+            out << "\t" << e.qualOffset;
+        }
+        out << "\n";
+    }
+}
+
+/**
+ * @brief Lists the BGZF blocks of the file from their headers and footers, without inflating them
+ */
+void ReadsIndex::build_gzi(){
+
+    gzi.clear();
+    uint64_t address = 0;
+    uint64_t uncompressed = 0;
+    unsigned char header[18];
+    while (pread(fd, header, 18, address) == 18){
+        size_t size = bgzf_block_size(header, 18);
+        unsigned char isize[4];
+        if (size == 0 || pread(fd, isize, 4, address+size-4) != 4){
+            cout << "ERROR: corrupted BGZF block at offset " << address << " in " << file << endl;
+            throw std::runtime_error("Corrupted BGZF file");
+        }
+        gzi.push_back(std::make_pair(address, uncompressed));
+        address += size;
+        uncompressed += isize[0] | (isize[1] << 8) | (isize[2] << 16) | (uint64_t(isize[3]) << 24);
+    }
+}
+
+/**
+ * @brief Loads a .gzi file, as written by bgzip -i
+ */
+bool ReadsIndex::load_gzi(std::string gziFile){
+
+    std::ifstream in(gziFile, std::ios::binary);
+    if (!in){
+        return false;
+    }
+    uint64_t n = 0;
+    in.read(reinterpret_cast<char*>(&n), 8);
+    gzi = {std::make_pair(0,0)}; //the first block is not written in the file
+    for (uint64_t i = 0 ; i < n && in ; i++){
+        uint64_t compressedOffset = 0, uncompressedOffset = 0;
+        in.read(reinterpret_cast<char*>(&compressedOffset), 8);
+        in.read(reinterpret_cast<char*>(&uncompressedOffset), 8);
+        gzi.push_back(std::make_pair(compressedOffset, uncompressedOffset));
+    }
+    return bool(in);
+}
+
+void ReadsIndex::write_gzi(std::string gziFile){
+
+    std::ofstream out(gziFile, std::ios::binary);
+    if (!out){
+        return;
+    }
+    uint64_t n = gzi.size()-1;
+    out.write(reinterpret_cast<const char*>(&n), 8);
+    for (size_t i = 1 ; i < gzi.size() ; i++){
+        out.write(reinterpret_cast<const char*>(&gzi[i].first), 8);
+        out.write(reinterpret_cast<const char*>(&gzi[i].second), 8);
+    }
+}
+
+/**
+ * @brief Reads a range of the uncompressed content of the file. Does not lock: each thread inflates with its own buffers
+ *
+ * @param offset position in the uncompressed file
+ * @param length number of bytes
+ * @param out filled with the bytes
+ */
+void ReadsIndex::read_uncompressed(uint64_t offset, size_t length, std::string &out) const{
+
+    out.resize(length);
+    if (compression == PLAIN){
+        size_t done = 0;
+        while (done < length){
+            ssize_t n = pread(fd, &out[done], length-done, offset+done);
+            if (n <= 0){
+                cout << "ERROR: " << file << " is shorter than its index says, the index " << file << ".fai should be deleted" << endl;
+                throw std::runtime_error("Truncated file of reads");
+            }
+            done += n;
+        }
+        return;
+    }
+    if (compression == GZIP){
+        memcpy(&out[0], inMemory.data()+offset, length);
+        return;
+    }
+
+    static thread_local ThreadInflater inflater;
+    //the last block starting before offset
+    size_t b = std::upper_bound(gzi.begin(), gzi.end(), std::make_pair(UINT64_MAX, offset),
+        [](const pair<uint64_t,uint64_t> &a, const pair<uint64_t,uint64_t> &c){return a.second < c.second;}) - gzi.begin() - 1;
+    size_t done = 0;
+    while (done < length){
+        if (b >= gzi.size()){
+            cout << "ERROR: " << file << " is shorter than its index says, the indexes " << file << ".fai and .gzi should be deleted" << endl;
+            throw std::runtime_error("Truncated file of reads");
+        }
+        uint64_t address = gzi[b].first;
+        if (inflater.fd != fd || inflater.blockAddress != address || inflater.block.empty()){
+            ssize_t n = pread(fd, inflater.compressed.data(), inflater.compressed.size(), address);
+            size_t size = n > 0 ? bgzf_block_size(inflater.compressed.data(), n) : 0;
+            if (size == 0 || size > size_t(n) || !inflate_bgzf_block(inflater.strm, inflater.compressed.data(), size, inflater.block)){
+                cout << "ERROR: corrupted BGZF block at offset " << address << " in " << file << endl;
+                throw std::runtime_error("Corrupted BGZF file");
+            }
+            inflater.fd = fd;
+            inflater.blockAddress = address;
+        }
+        uint64_t posInBlock = offset + done - gzi[b].second;
+        size_t chunk = std::min(length-done, size_t(inflater.block.size()-posInBlock));
+        memcpy(&out[done], inflater.block.data()+posInBlock, chunk);
+        done += chunk;
+        b++;
+    }
+}
+
+/**
+ * @brief Gets the sequence of a read
+ *
+ * @param record index of the read in the file
+ * @param sequence filled with the sequence, without the ends of lines
+ */
+void ReadsIndex::fetch(size_t record, std::string &sequence) const{
+
+    const FaiEntry &e = entries[record];
+    if (e.length == 0 || e.lineBases == 0){
+        sequence.clear();
+        return;
+    }
+    uint64_t nbBytes = (e.length / e.lineBases)*e.lineWidth + e.length % e.lineBases;
+    if (e.length % e.lineBases == 0){ //do not read the end of the last line
+        nbBytes -= e.lineWidth - e.lineBases;
+    }
+    read_uncompressed(e.offset, nbBytes, sequence);
+    if (nbBytes != e.length){ //multi-line sequence
+        sequence.erase(std::remove_if(sequence.begin(), sequence.end(), [](char c){return c == '\n' || c == '\r';}), sequence.end());
+    }
+}
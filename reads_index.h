@@ -0,0 +1,58 @@
+#ifndef READS_INDEX_H
+#define READS_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief One line of a .fai index (samtools faidx/fqidx format)
+ */
+struct FaiEntry{
+    std::string name;
+    uint64_t length; //number of bases
+    uint64_t offset; //offset of the first base in the uncompressed file
+    uint32_t lineBases; //number of bases per line
+    uint32_t lineWidth; //number of bytes per line, end of line included
+    uint64_t qualOffset; //offset of the first quality (FASTQ only)
+};
+
+/**
+ * @brief Random access to the reads of a FASTA/FASTQ file, plain, bgzipped or gzipped.
+ * The .fai (and .gzi for bgzipped files) is built once next to the reads and reused by the next runs.
+ * fetch can be called concurrently from several threads without locking.
+ */
+class ReadsIndex{
+
+public :
+    ReadsIndex(std::string fileReads);
+    ~ReadsIndex();
+
+    size_t size() const; //number of reads
+    const FaiEntry& entry(size_t record) const;
+    bool is_fastq() const;
+
+    void fetch(size_t record, std::string &sequence) const; //sequence of the record-th read of the file
+
+private :
+    enum Compression {PLAIN, BGZF, GZIP};
+
+    std::string file;
+    Compression compression;
+    bool fastq;
+    int fd;
+    std::vector<FaiEntry> entries;
+    std::vector<std::pair<uint64_t,uint64_t>> gzi; //for BGZF: (compressed offset, uncompressed offset) of the start of each block
+    std::string inMemory; //for plain gzip: the whole decompressed file
+
+    void build_index();
+    bool load_index(std::string indexFile);
+    void write_index(std::string indexFile);
+    void build_gzi();
+    bool load_gzi(std::string gziFile);
+    void write_gzi(std::string gziFile);
+
+    void read_uncompressed(uint64_t offset, size_t length, std::string &out) const;
+};
+
+#endif
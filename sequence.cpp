@@ -1,4 +1,9 @@
 #include "sequence.h"
+#include "cpu_dispatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 
 using std::cout;
 using std::endl;
@@ -6,92 +11,203 @@ using std::vector;
 using std::pair;
 using std::string;
 
-Sequence::Sequence(){
+/**
+ * @brief Lookup tables used to encode and decode the sequences
+ */
+struct SequenceTables{
+
+    uint8_t code[256]; //2-bit code of each character
+    char decode[256][4]; //the 4 bases packed in a byte
+    char complement[256];
+
+    SequenceTables(){
+        for (int c = 0 ; c < 256 ; c++){
+            code[c] = 3; //anything that is not A, C or G is stored as a T, as it always was
+            complement[c] = c;
+        }
+        code[(unsigned char)'A'] = 0;
+        code[(unsigned char)'C'] = 1;
+        code[(unsigned char)'G'] = 2;
+        complement[(unsigned char)'A'] = 'T';
+        complement[(unsigned char)'C'] = 'G';
+        complement[(unsigned char)'G'] = 'C';
+        complement[(unsigned char)'T'] = 'A';
+        for (int byte = 0 ; byte < 256 ; byte++){
+            for (int b = 0 ; b < 4 ; b++){
+                decode[byte][b] = "ACGT"[(byte >> (2*b)) & 3];
+            }
+        }
+    }
+};
+
+static const SequenceTables tables;
 
+/**
+ * @brief Reverses the order of the 32 2-bit bases of a word
+ */
+static inline uint64_t reverse_bases(uint64_t x){
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x);
 }
 
-Sequence::Sequence(string& inputSequence){
+Sequence::Sequence(){
+    length = 0;
+}
 
-    for(uint i(0);i<inputSequence.size();i++){
-        switch (inputSequence[i]){
-          case 'A': s.push_back(false); s.push_back(false);break;
-          case 'C': s.push_back(false); s.push_back(true);break;
-          case 'G': s.push_back(true); s.push_back(false);break;
-          default: s.push_back(true); s.push_back(true);break;
+//the MULTIVERSIONED kernels are static functions: constructors cannot be cloned, and the clones of members would have to be declared in sequence.h
+
+//packs the bases of the sequence in the words, 32 per word
+MULTIVERSIONED static void encode(const string &sequence, vector<uint64_t> &words){
+    size_t length = sequence.size();
+    for (size_t w = 0 ; w < words.size() ; w++){
+        uint64_t word = 0;
+        size_t end = std::min(length, 32*w+32);
+        for (size_t i = end ; i > 32*w ; i--){
+            word = (word << 2) | tables.code[(unsigned char) sequence[i-1]];
         }
+        words[w] = word;
     }
 }
 
+Sequence::Sequence(string& inputSequence){
+
+    length = inputSequence.size();
+    words = vector<uint64_t> ((length+31)/32, 0);
+    encode(inputSequence, words);
+}
+
+//the vector<bool> contains two bits per base, the high bit first
 Sequence::Sequence(vector<bool> &inputVector){
 
-    s = inputVector;
+    length = inputVector.size()/2;
+    words = vector<uint64_t> ((length+31)/32, 0);
+    for (size_t i = 0 ; i < length ; i++){
+        uint64_t b = (inputVector[2*i] << 1) | inputVector[2*i+1];
+        words[i/32] |= b << (2*(i%32));
+    }
+}
+
+uint8_t Sequence::base(size_t i) const{
+    return (words[i/32] >> (2*(i%32))) & 3;
+}
+
+bool Sequence::bit(size_t i) const{
+    if (i%2 == 0){
+        return base(i/2) >> 1;
+    }
+    return base(i/2) & 1;
+}
+
+//the 32 bases starting at position pos
+static inline uint64_t word_at(const vector<uint64_t> &words, size_t pos){
+    size_t w = pos/32;
+    int shift = 2*(pos%32);
+    uint64_t res = words[w] >> shift;
+    if (shift > 0 && w+1 < words.size()){
+        res |= words[w+1] << (64-shift);
+    }
+    return res;
+}
+
+uint64_t Sequence::word_at(size_t pos) const{
+    return ::word_at(words, pos);
 }
 
 string Sequence::str() const{
+    return str(0, length);
+}
+
+//as std::string::substr, the substring is cut at the end of the sequence
+string Sequence::str(int start, int length) const{
 
-    string str(s.size()/2, 'N');
-    uint j = 0;
-    for(uint i(0);i<s.size();i+=2){
-        if(s[i]){
-          if(s[i+1]){
-              str[j] = 'T';
-          }else{
-            str[j] = 'G';
-          }
-        }else{
-          if(s[i+1]){
-            str[j] = 'C';
-          }else{
-            str[j] = 'A';
-          }
+    length = std::max(0, std::min(length, int(this->length)-start));
+    string res(length, 'N');
+    str(start, length, res.data());
+    return res;
+}
+
+//writes the bases from start to start+length in out
+MULTIVERSIONED static void decode(const vector<uint64_t> &words, size_t start, size_t length, char* out){
+    for (size_t k = 0 ; k < length ; k += 32){
+        uint64_t word = word_at(words, start+k);
+        int n = std::min(size_t(32), length-k);
+        int j = 0;
+        for ( ; j+4 <= n ; j += 4){
+            memcpy(out+k+j, tables.decode[word & 0xFF], 4);
+            word >>= 8;
+        }
+        for ( ; j < n ; j++){
+            out[k+j] = "ACGT"[word & 3];
+            word >>= 2;
         }
-        j++;
-  }
-  return str;
+    }
+}
 
+void Sequence::str(size_t start, size_t length, char* out) const{
+    decode(words, start, length, out);
 }
 
-Sequence Sequence::reverse_complement() const{
+string Sequence::reverse_complement_str(int start, int length) const{
 
-    std::vector<bool> res;
+    length = std::max(0, std::min(length, int(this->length)-start));
+    string res = str(this->length-start-length, length);
+    std::reverse(res.begin(), res.end());
+    for (char &c : res){
+        c = tables.complement[(unsigned char) c];
+    }
+    return res;
+}
 
-    for (int i = s.size()-1 ; i>0 ; i-=2){
-        res.push_back(not s[i-1]);
-        res.push_back(not s[i]);
+//words of the reverse complement of the sequence of length bases packed in words
+MULTIVERSIONED static void reverse_complement_words(const vector<uint64_t> &words, size_t length, vector<uint64_t> &res){
+    size_t n = words.size();
+    for (size_t w = 0 ; w < n ; w++){
+        res[n-1-w] = reverse_bases(~words[w]); //complementing a base is flipping its two bits
+    }
+    //the padding of the last word is now at the beginning: shift everything back
+    int shift = 2*(32*n - length);
+    if (shift > 0){
+        for (size_t w = 0 ; w < n ; w++){
+            res[w] >>= shift;
+            if (w+1 < n){
+                res[w] |= res[w+1] << (64-shift);
+            }
+        }
     }
+}
 
-    Sequence r (res);
-    return r;
+Sequence Sequence::reverse_complement() const{
+
+    Sequence res;
+    res.length = length;
+    res.words = vector<uint64_t> (words.size());
+    reverse_complement_words(words, length, res.words);
+    return res;
 }
 
 //takes a subset of a sequence, with argument the position on the sequence and the number of nucleotides
-Sequence Sequence::subseq(int start, int length){
-
-    // if (DEBUG){
-    //     //this verification might be useful for debugging, but it slows down the program
-    //     if (start*2+length*2 >  s.size()*2){
-    //         cout << "ERROR in subseq, the sequence is too short " << s.size()*2 << " " << start << " " << length << endl;
-    //         throw "Problem in subseq function";
-    //     }
-    //     if (length < 0){
-    //         cout << "ERROR in subseq, asking me to do a negative length" << endl;
-    //     }
-    // }
-    vector<bool>::const_iterator st = s.begin() + 2*start;
-    vector<bool>::const_iterator f = s.begin() + 2*length+2*start;
-    vector<bool> res(st, f);
-
-    //auto s = seq.begin();
-    return Sequence(res);
+Sequence Sequence::subseq(int start, int length) const{
+
+    Sequence res;
+    res.length = length;
+    res.words = vector<uint64_t> ((length+31)/32);
+    for (size_t w = 0 ; w < res.words.size() ; w++){
+        res.words[w] = word_at(start+32*w);
+    }
+    if (length%32 != 0){
+        res.words.back() &= (uint64_t(1) << (2*(length%32))) - 1;
+    }
+    return res;
 }
 
 bool operator==(Sequence const &a , Sequence const &b){
-    return a.s == b.s;
+    return a.length == b.length && a.words == b.words;
 }
 
 
-size_t Sequence::size(){
-    return size_t(s.size()/2);
+size_t Sequence::size() const{
+    return length;
 }
 
 //returns in a deterministic fashion at least one read in all windows w, on average 1 / 2^hardness read in total
@@ -99,7 +215,6 @@ void Sequence::minimisers(int hardness, int k, int w, vector<vector<int>> &minis
 
     int num_threads = minis.size();
 
-    std::hash<vector<bool>> h;
     vector<bool> criterion (hardness, false);
     vector <bool> emptyWindows (this->size()-w+1, true);
     bool cont;
@@ -120,7 +235,7 @@ void Sequence::minimisers(int hardness, int k, int w, vector<vector<int>> &minis
                 bool good = true;
                 short index = 0;
                 while (good && index < hardness){
-                    good = good && (s[i*2+index]==criterion[index]);
+                    good = good && (bit(i*2+index)==criterion[index]);
                     index ++;
                 }
 
@@ -164,7 +279,7 @@ void Sequence::minimisers(int hardness, int k, int w, vector<vector<int>> &minis
 
 }
 
-size_t Sequence::hash(){
-    std::hash<vector<bool>> h;
-    return h(s);
+size_t Sequence::hash() const{
+    std::hash<std::string_view> h;
+    return h(std::string_view(reinterpret_cast<const char*>(words.data()), 8*words.size())) ^ length;
 }
@@ -4,39 +4,51 @@
 #include <string>
 #include <vector>
 #include <iostream>
- 
+#include <cstdint>
+
+/**
+ * @brief DNA sequence packed on 2 bits per base (A=0, C=1, G=2, T=3), 32 bases per 64-bit word, first base in the lowest bits.
+ * The unused bits of the last word are always 0.
+ */
 class Sequence{
-	
+
 public :
-	
+
 	Sequence();
 	Sequence(std::string &inputSequence);
 	Sequence(std::vector<bool> &inputVector);
-	
+
 	Sequence reverse_complement() const; //returns a reverse complement sequence
-	Sequence subseq(int start, int length);
+	Sequence subseq(int start, int length) const;
 	std::string str() const; //returns a string of ACGT
-	size_t size();
-		
+	std::string str(int start, int length) const; //returns the substring of ACGT starting at start, without decoding the rest of the sequence
+	void str(size_t start, size_t length, char* out) const; //writes the bases from start to start+length (within the sequence) in out, e.g. in the buffer of a file
+	std::string reverse_complement_str(int start, int length) const; //returns the substring of the reverse complement starting at start, without building the reverse complement
+	size_t size() const;
+
     void minimisers(int hardness, int k, int w, std::vector<std::vector<int>> &minis);
-	
+
 	struct HashFunction
 	{
 		size_t operator()(const Sequence& seq) const
 		{
-			std::hash<std::vector<bool>> h;
-			return h(seq.s);
+			return seq.hash();
 		}
 	};
-    size_t hash();
-		
+    size_t hash() const;
+
 private :
-	
-	std::vector<bool> s;
-	
+
+	std::vector<uint64_t> words;
+	size_t length;
+
+	uint8_t base(size_t i) const;
+	bool bit(size_t i) const; //bits in the order of the former vector<bool> representation: high bit of base 0, low bit of base 0, high bit of base 1...
+	uint64_t word_at(size_t pos) const; //the 32 bases starting at position pos
+
 //    friend std::ostream& operator<< (std::ostream& stream, Sequence const& sequence);
 	friend bool operator==(Sequence const &a , Sequence const &b);
 
-}; 
+};
 
 #endif
@@ -0,0 +1,208 @@
+#include "split_file.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+using std::string;
+using std::string_view;
+using std::vector;
+using std::pair;
+using std::cerr;
+using std::endl;
+
+/*
+Binary format of the split file (.gro), written by strainminer.py:
+    "SGRO" version (little-endian uint32)
+    then records, each starting with one byte:
+        'C' name length depth : a contig, followed by its READ and GROUP records
+        'R' name : a read of the current contig
+        'G' start end number_of_labels, then for each label: index of the read (among the READ records of the contig) minus the index of the previous label, label
+    integers are LEB128 varints, labels are zigzag-encoded, names are a varint length followed by the characters and depth is a little-endian double.
+The text format has the same records as tab-separated lines, the reads and the labels of a GROUP being comma-separated lists
+*/
+
+static const uint32_t SGRO_VERSION = 1;
+
+SparsePartition::SparsePartition() : nbReads(0){
+}
+
+SparsePartition::SparsePartition(int nbReads) : nbReads(nbReads){
+}
+
+int SparsePartition::label(int read) const{
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), read, [](const pair<int,int> &entry, int r){return entry.first < r;});
+    if (it == entries_.end() || it->first != read){
+        return -2;
+    }
+    return it->second;
+}
+
+void SparsePartition::add(int read, int label){
+    entries_.push_back(std::make_pair(read, label));
+}
+
+void SparsePartition::reset(int nbReads){
+    this->nbReads = nbReads;
+    entries_.clear();
+}
+
+SplitFileReader::SplitFileReader(std::string file) : file(file), data(this->file.view()), isBinary(false), pos(0), lines(data){
+    if (data.size() >= 8 && data.substr(0, 4) == "SGRO"){
+        uint32_t version;
+        memcpy(&version, data.data()+4, 4);
+        if (version != SGRO_VERSION){
+            cerr << "ERROR: " << file << " is a split file of version " << version << ", version " << SGRO_VERSION << " was expected" << endl;
+            exit(1);
+        }
+        isBinary = true;
+        pos = 8;
+    }
+}
+
+bool SplitFileReader::good() const{
+    return file.good();
+}
+
+bool SplitFileReader::next(SplitRecord &record){
+    record.labels.clear();
+    record.skipped = false;
+    return isBinary ? next_binary(record) : next_text(record);
+}
+
+bool SplitFileReader::next_text(SplitRecord &record){
+    string_view line;
+    while (lines.next_line(line)){
+        string_view category;
+        if (!next_field(line, category)){
+            continue;
+        }
+        if (category == "CONTIG"){
+            string_view field;
+            record.type = SPLIT_CONTIG;
+            next_field(line, record.name);
+            record.length = 0;
+            record.depth = 0;
+            if (next_field(line, field)){
+                parse_number(field, record.length);
+            }
+            if (next_field(line, field)){
+                parse_number(field, record.depth);
+            }
+            return true;
+        }
+        else if (category == "READ"){
+            record.type = SPLIT_READ;
+            next_field(line, record.name);
+            return true;
+        }
+        else if (category == "GROUP"){
+            record.type = SPLIT_GROUP;
+            string_view field, readIdxsString, partitionString;
+            record.start = 0;
+            record.end = 0;
+            if (next_field(line, field)){
+                parse_number(field, record.start);
+            }
+            if (next_field(line, field)){
+                parse_number(field, record.end);
+            }
+            next_field(line, readIdxsString);
+            next_field(line, partitionString);
+            if (readIdxsString == "," || partitionString == ","){
+                record.skipped = true;
+                return true;
+            }
+            //two comma-separated lists of the same length
+            string_view idx, label;
+            while (next_field(readIdxsString, idx, ',') && next_field(partitionString, label, ',')){
+                int r, l;
+                if (!parse_number(idx, r) || !parse_number(label, l)){
+                    cerr << "ERROR: could not parse the GROUP " << record.start << " " << record.end << " of the split file" << endl;
+                    exit(1);
+                }
+                record.labels.push_back(std::make_pair(r, l));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes a LEB128 varint
+ *
+ * @param data the buffer
+ * @param pos position in the buffer, advanced after the varint
+ * @param value the value
+ * @return false if the buffer ends before the varint
+ */
+static bool read_varint(string_view data, size_t &pos, uint64_t &value){
+    value = 0;
+    for (int shift = 0 ; pos < data.size() && shift < 64 ; shift += 7){
+        uint8_t byte = data[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_name(string_view data, size_t &pos, string_view &name){
+    uint64_t length;
+    if (!read_varint(data, pos, length) || length > data.size()-pos){
+        return false;
+    }
+    name = data.substr(pos, length);
+    pos += length;
+    return true;
+}
+
+bool SplitFileReader::next_binary(SplitRecord &record){
+    if (pos >= data.size()){
+        return false;
+    }
+    char tag = data[pos++];
+    bool ok = true;
+    uint64_t v;
+    if (tag == 'C'){
+        record.type = SPLIT_CONTIG;
+        ok = read_name(data, pos, record.name) && read_varint(data, pos, v) && pos+8 <= data.size();
+        if (ok){
+            record.length = v;
+            memcpy(&record.depth, data.data()+pos, 8);
+            pos += 8;
+        }
+    }
+    else if (tag == 'R'){
+        record.type = SPLIT_READ;
+        ok = read_name(data, pos, record.name);
+    }
+    else if (tag == 'G'){
+        record.type = SPLIT_GROUP;
+        uint64_t start, end, nbLabels;
+        ok = read_varint(data, pos, start) && read_varint(data, pos, end) && read_varint(data, pos, nbLabels) && nbLabels <= data.size()-pos;
+        if (ok){
+            record.start = start;
+            record.end = end;
+            record.labels.reserve(nbLabels);
+            long long read = 0;
+            for (uint64_t l = 0 ; l < nbLabels && ok ; l++){
+                uint64_t delta, zigzag;
+                ok = read_varint(data, pos, delta) && read_varint(data, pos, zigzag);
+                read += delta;
+                record.labels.push_back(std::make_pair(int(read), int(zigzag >> 1) ^ -int(zigzag & 1)));
+            }
+        }
+    }
+    else{
+        ok = false;
+    }
+    if (!ok){
+        cerr << "ERROR: the split file is corrupted near byte " << pos << endl;
+        exit(1);
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef SPLIT_FILE_H
+#define SPLIT_FILE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include "tokenizer.h"
+
+/**
+ * @brief Partition of the neighbors of a backbone on one interval. Only the reads that were assigned (to a cluster, or -1) are stored,
+ * sorted by index of neighbor, all the others are -2
+ */
+class SparsePartition{
+
+public :
+    SparsePartition();
+    SparsePartition(int nbReads);
+
+    int size() const {return nbReads;} //number of neighbors of the backbone, stored or not
+    int label(int read) const; //-2 if the read is not stored
+    void add(int read, int label); //the reads must be added by increasing index
+    void reset(int nbReads); //no read stored, keeping the memory
+
+    //the (read, label) stored, by increasing read
+    std::vector<std::pair<int,int>>& entries() {return entries_;}
+    const std::vector<std::pair<int,int>>& entries() const {return entries_;}
+
+private :
+    int nbReads;
+    std::vector<std::pair<int,int>> entries_;
+};
+
+//for each backbone, the intervals (start, end) and the partition of the reads on each of them
+typedef std::unordered_map<unsigned long int, std::vector<std::pair<std::pair<int,int>, SparsePartition>>> Partitions;
+
+enum SplitRecordType {SPLIT_CONTIG, SPLIT_READ, SPLIT_GROUP};
+
+/**
+ * @brief One CONTIG, READ or GROUP record of a split file
+ */
+struct SplitRecord{
+    SplitRecordType type;
+    std::string_view name; //of the contig or of the read
+    int length; //of the contig
+    double depth; //of the contig
+    int start; //of the group
+    int end; //of the group
+    std::vector<std::pair<int,int>> labels; //of the group: index of the read among the READ records of the contig, label
+    bool skipped; //the group was written with "," as list of reads, it does not create an interval
+};
+
+/**
+ * @brief Streams the records of a split file (.gro), mapped in memory. Reads the binary format written by strainminer.py
+ * as well as the text format, which is kept for debugging
+ */
+class SplitFileReader{
+
+public :
+    SplitFileReader(std::string file);
+
+    bool good() const;
+    bool binary() const {return isBinary;}
+    bool next(SplitRecord &record); //false at the end of the file
+
+private :
+    bool next_text(SplitRecord &record);
+    bool next_binary(SplitRecord &record);
+
+    MappedFile file;
+    std::string_view data;
+    bool isBinary;
+    size_t pos;
+    LineTokenizer lines;
+};
+
+#endif
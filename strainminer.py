@@ -9,8 +9,9 @@ import pandas as pd
 import numpy as np
 import sys
 import os
+import multiprocessing
+import ctypes
 
-import gurobipy as grb
 import pysam as ps
 
 from sklearn.cluster import FeatureAgglomeration
@@ -30,9 +31,95 @@ options = {
 	"LICENSEID":000000
 }
 
+#state of the current process, set by init_worker: each worker of the pool has its own handles
+worker_bam = None
+worker_pileup = None
+worker_env = None
+worker_gurobi_threads = 0 #0 lets gurobi choose
+worker_native_threads = 1 #threads of the compiled kernels
+worker_solver = 'native' #solver of the quasi-bicliques: native or gurobi
+native_library = None #build/libstrainminer_native.so, loaded at its first use
+native_kernels_missing = False #True if the library could not be loaded: the matrix kernels then fall back on numpy
+grb = None #gurobipy, imported only if the gurobi solver is used
+worker_stats = {} #time spent in each step of the window being processed, reset by process_window
+
 import time
+import struct
+import json
+import resource
+import hashlib
+import pickle
+import shutil
 from argparse import ArgumentParser
 
+def resources_used():
+    #OUTPUT: wall time, CPU time, peak RSS (kB) and bytes read/written so far, by this process and by its finished children
+    me = resource.getrusage(resource.RUSAGE_SELF)
+    children = resource.getrusage(resource.RUSAGE_CHILDREN)
+    read, written = 0, 0
+    try:
+        with open('/proc/self/io') as io:
+            for line in io:
+                key, value = line.split(':')
+                if key == 'rchar':
+                    read = int(value)
+                elif key == 'wchar':
+                    written = int(value)
+    except OSError:
+        pass
+    #the children are only accounted for their block I/O
+    return {'wall_s': time.time(),
+            'cpu_s': me.ru_utime + me.ru_stime + children.ru_utime + children.ru_stime,
+            'peak_rss_kb': me.ru_maxrss,
+            'children_peak_rss_kb': children.ru_maxrss,
+            'bytes_read': read + 512*children.ru_inblock,
+            'bytes_written': written + 512*children.ru_oublock}
+
+class Profiler:
+    #records the time, memory and I/O of each stage of the pipeline, and of the clustering of each contig
+
+    def __init__(self):
+        self.records = []
+        self.processes = 0
+
+    def start(self, stage):
+        #OUTPUT: what stop needs to record the stage
+        return (stage, resources_used(), self.processes)
+
+    def stop(self, started):
+        stage, before, processes = started
+        after = resources_used()
+        record = {'stage': stage, 'contig': ''}
+        for key in ('wall_s', 'cpu_s', 'bytes_read', 'bytes_written'):
+            record[key] = after[key] - before[key]
+        record['peak_rss_kb'] = max(after['peak_rss_kb'], after['children_peak_rss_kb'])
+        record['processes'] = self.processes - processes
+        self.records.append(record)
+
+    def add(self, record):
+        self.records.append(record)
+
+    def run(self, command):
+        #os.system, counting the processes spawned
+        self.processes += 1
+        return os.system(command)
+
+    def write(self, file, create_new_contigs_profile):
+        #INPUT: output file (JSON, or TSV if it ends with .tsv) and the profile written by create_new_contigs
+        native = {'stages': [], 'threads': []}
+        if os.path.exists(create_new_contigs_profile):
+            with open(create_new_contigs_profile) as f:
+                native = json.load(f)
+        if file.endswith('.tsv'):
+            keys = ['stage', 'contig', 'wall_s', 'cpu_s', 'peak_rss_kb', 'bytes_read', 'bytes_written', 'processes', 'windows', 'gurobi_solves', 'gurobi_s', 'native_solves', 'imputation_s', 'monomorphic', 'direct_split', 'solver']
+            with open(file, 'w') as out:
+                out.write('\t'.join(keys) + '\n')
+                for record in self.records + [dict(r, stage='create_new_contigs/'+r['stage']) for r in native['stages']]:
+                    out.write('\t'.join(str(record.get(k, '')) for k in keys) + '\n')
+        else:
+            with open(file, 'w') as out:
+                json.dump({'stages': self.records, 'create_new_contigs': native}, out, indent = 2)
+
 def get_data(file, contig_name,start_pos,stop_pos):
     #INPUT: a SORTED and INDEXED Bam file
     # Go through a window w on a contig and select suspicious positions
@@ -69,12 +156,60 @@ def get_data(file, contig_name,start_pos,stop_pos):
                     list_of_sus_pos[pileupcolumn.reference_pos] = tmp_dict        
     return list_of_sus_pos
 
+def index_native_pileup(pileup_file):
+    #INPUT: a file written by build/pileup_windows (same selection of suspicious positions as get_data)
+    #OUTPUT: the list of contigs of the BAM header and, for each contig, its windows (start, stop, offset in the file) in the order of the file
+    f = open(pileup_file, 'rb')
+    magic, version = struct.unpack('<4sI', f.read(8))
+    if magic != b'SMPU' or version != 1:
+        print('ERROR: ', pileup_file, ' is not a pileup file of a compatible version')
+        sys.exit(1)
+    nb_contigs, = struct.unpack('<I', f.read(4))
+    contigs = []
+    for c in range(nb_contigs):
+        length_of_name, = struct.unpack('<I', f.read(4))
+        name = f.read(length_of_name).decode()
+        length, = struct.unpack('<I', f.read(4))
+        contigs.append({'SN' : name, 'LN' : length})
+
+    #skim through the windows without decoding them
+    windows = [[] for c in contigs]
+    while True:
+        offset = f.tell()
+        header = f.read(20)
+        if len(header) < 20:
+            break
+        contig_idx, start_pos, stop_pos, nb_reads, nb_cols = struct.unpack('<5I', header)
+        for r in range(nb_reads):
+            length_of_name, = struct.unpack('<I', f.read(4))
+            f.seek(length_of_name, 1)
+        f.seek(4*nb_cols + nb_reads*nb_cols, 1)
+        windows[contig_idx].append((start_pos, stop_pos, offset))
+    f.close()
+
+    return contigs, windows
+
+def read_native_window(f, offset):
+    #INPUT: a pileup file opened in binary mode and the offset of a window given by index_native_pileup
+    #OUTPUT: DataFrame of the reads x suspicious positions of the window, with values 1/0/NaN as in get_data
+    f.seek(offset)
+    contig_idx, start_pos, stop_pos, nb_reads, nb_cols = struct.unpack('<5I', f.read(20))
+    reads = []
+    for r in range(nb_reads):
+        length_of_name, = struct.unpack('<I', f.read(4))
+        reads.append(f.read(length_of_name).decode())
+    positions = np.frombuffer(f.read(4*nb_cols), dtype='<u4').astype(int)
+    matrix = np.frombuffer(f.read(nb_reads*nb_cols), dtype=np.int8).reshape(nb_reads, nb_cols).astype(float)
+    matrix[matrix == -1] = np.nan
+    return pd.DataFrame(matrix, index = reads, columns = positions)
+
 def pre_processing(X_matrix, min_col_quality = 3):
     ###Filling the missing values using KNN
     m,n = X_matrix.shape
     if m>1 and n>1:
-        imputer = KNNImputer(n_neighbors= 10)
-        matrix = imputer.fit_transform(X_matrix)
+        start_imputation = time.perf_counter()
+        matrix = knn_impute(X_matrix, 10)
+        worker_stats['imputation_s'] = worker_stats.get('imputation_s', 0) + time.perf_counter() - start_imputation
         upper,lower = 0.7,0.3
         matrix[(matrix>=upper)] = 1
         matrix[(matrix<=lower)] = 0
@@ -123,12 +258,14 @@ def pre_processing(X_matrix, min_col_quality = 3):
             elif len(cols)>=min_col_quality:
                 regions.append(cols)
                 
-        inhomogenious_regions = []        
+        inhomogenious_regions = []
+        packed = PackedMatrix(matrix)
+        all_rows = list(range(m))
         for region in regions:
             thres = (min_col_quality/len(region))
             matrix_reg = matrix[:,region].copy()
             matrix_reg[matrix_reg==-1] = 0
-            x_matrix = (matrix_reg.sum(axis = 1))/len(region)
+            x_matrix = packed.count(all_rows, region, 1, axis = 1)/len(region)
             if len(x_matrix[(x_matrix>=thres)*(x_matrix<=1-thres)]) > 10:
                 inhomogenious_regions.append(region)
             else:
@@ -142,170 +279,280 @@ def pre_processing(X_matrix, min_col_quality = 3):
                         cluster0.append(idx)
                     else:
                         cluster1.append(idx)
-                mat_cl1 = matrix_reg[cluster1,:].sum()/(len(cluster1)*len(region))
-                mat_cl0 = matrix_reg[cluster0,:].sum()/(len(cluster0)*len(region))
+                mat_cl1 = packed.count(cluster1, region, 1, axis = 1).sum()/(len(cluster1)*len(region))
+                mat_cl0 = packed.count(cluster0, region, 1, axis = 1).sum()/(len(cluster0)*len(region))
 
                 if (mat_cl0 > 0.9 or mat_cl0<0.1) and (mat_cl1 > 0.9 or mat_cl1<0.1):
                     steps.append((cluster1,cluster0,region))
             
     return matrix, inhomogenious_regions, steps
 
+def import_gurobi():
+    #gurobipy (and its license) is only needed with --solver gurobi
+    global grb
+    if grb is None:
+        import gurobipy
+        grb = gurobipy
+    return grb
+
+def get_gurobi_env():
+    #the environment is created once per process, at its first use (a gurobi environment cannot be shared between processes)
+    global worker_env
+    if worker_env is None:
+        worker_env = import_gurobi().Env(params=options)
+    return worker_env
+
+def get_native_library():
+    #the compiled kernels, loaded once per process
+    global native_library
+    if native_library is None:
+        library = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'build', 'libstrainminer_native.so'))
+        library.sm_quasibiclique.restype = ctypes.c_int
+        library.sm_quasibiclique.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_double,
+                                             ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_void_p, ctypes.POINTER(ctypes.c_int)]
+        library.sm_bitmatrix_new.restype = ctypes.c_void_p
+        library.sm_bitmatrix_new.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        library.sm_bitmatrix_free.restype = None
+        library.sm_bitmatrix_free.argtypes = [ctypes.c_void_p]
+        library.sm_bitmatrix_count.restype = None
+        library.sm_bitmatrix_count.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+        library.sm_bitmatrix_hamming.restype = None
+        library.sm_bitmatrix_hamming.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+        library.sm_knn_impute.restype = None
+        library.sm_knn_impute.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+        library.sm_seed_rectangle.restype = None
+        library.sm_seed_rectangle.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int,
+                                              ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int)]
+        native_library = library
+    return native_library
+
+def get_native_kernels():
+    #the compiled library if it can be loaded, None otherwise (the matrix kernels then use numpy)
+    global native_kernels_missing
+    if native_kernels_missing:
+        return None
+    try:
+        return get_native_library()
+    except OSError:
+        native_kernels_missing = True
+        return None
+
+def indices(lines):
+    return np.ascontiguousarray(lines, dtype=np.intc)
+
+class PackedMatrix:
+    #A matrix of 1, 0 and -1 (missing) packed in two bitplanes by bitmatrix.cpp, or kept as a numpy array without the compiled library
+    def __init__(self, X_matrix):
+        self.matrix = np.ascontiguousarray(X_matrix, dtype=np.int8)
+        self.handle = None
+        self.library = get_native_kernels()
+        if self.library is not None:
+            m, n = self.matrix.shape
+            self.handle = self.library.sm_bitmatrix_new(self.matrix.ctypes.data, m, n)
+
+    def __del__(self):
+        if self.handle is not None:
+            self.library.sm_bitmatrix_free(self.handle)
+
+    def count(self, rows, cols, value, axis):
+        #number of entries equal to value in the submatrix rows x cols, per column (axis 0) or per row (axis 1)
+        if self.handle is None:
+            return (self.matrix[np.ix_(rows, cols)] == value).sum(axis = axis)
+        rows, cols = indices(rows), indices(cols)
+        out = np.zeros(len(cols) if axis == 0 else len(rows), dtype=np.intc)
+        self.library.sm_bitmatrix_count(self.handle, rows.ctypes.data, len(rows), cols.ctypes.data, len(cols), value, axis, out.ctypes.data)
+        return out
+
+    def hamming(self, centroids):
+        #proportion of the positions where each row differs from each row of centroids, as pairwise_distances(metric = "hamming")
+        m, n = self.matrix.shape
+        if self.handle is None:
+            return (self.matrix[:,None,:] != centroids.matrix[None,:,:]).sum(axis = 2)/n
+        out = np.zeros((m, centroids.matrix.shape[0]), dtype=np.intc)
+        self.library.sm_bitmatrix_hamming(self.handle, centroids.handle, out.ctypes.data)
+        return out/n
+
+    def seed_rectangle(self, rows_sorted, cols_sorted):
+        #numbers of rows and columns of the largest top-left rectangle of the sorted matrix with more than 99% of 1s, searched by steps
+        m, n = len(rows_sorted), len(cols_sorted)
+        if self.handle is not None:
+            rows_sorted, cols_sorted = indices(rows_sorted), indices(cols_sorted)
+            seed_rows, seed_cols = ctypes.c_int(0), ctypes.c_int(0)
+            self.library.sm_seed_rectangle(self.handle, rows_sorted.ctypes.data, m, cols_sorted.ctypes.data, n, ctypes.byref(seed_rows), ctypes.byref(seed_cols))
+            return seed_rows.value, seed_cols.value
+        #2D prefix sums of the 1s of the sorted matrix
+        sums = np.zeros((m+1, n+1), dtype=np.int64)
+        sums[1:,1:] = (self.matrix[np.ix_(rows_sorted, cols_sorted)] == 1).cumsum(axis = 0).cumsum(axis = 1)
+        seed_rows, seed_cols = max(1, m//3), max(1, n//3)
+        step_n = 10 if n>50 else 2
+        for x in range(max(1, m//3),m,10):
+            for y in range(max(1, n//3),n,step_n):
+                if sums[x,y]/(x*y) > 0.99 and x*y>seed_rows*seed_cols:
+                    seed_rows, seed_cols = x, y
+        return seed_rows, seed_cols
+
+def knn_impute(X_matrix, n_neighbors):
+    #KNNImputer(n_neighbors) of sklearn on a matrix of 1/0/NaN, computed by the banded kernel of imputation.cpp when the library is available
+    library = get_native_kernels()
+    if library is None:
+        return KNNImputer(n_neighbors = n_neighbors).fit_transform(X_matrix)
+    packed = PackedMatrix(np.where(np.isnan(X_matrix), -1, X_matrix))
+    out = np.zeros(X_matrix.shape, dtype=np.float64)
+    library.sm_knn_impute(packed.handle, n_neighbors, 1, worker_native_threads, out.ctypes.data)
+    #as KNNImputer, drop the columns without any known value
+    return out[:, ~np.isnan(out).all(axis = 0)]
+
+def ternary(X_matrix):
+    #True if the matrix only has 1, 0 and -1, i.e. can be packed
+    return np.isin(X_matrix, (-1, 0, 1)).all()
+
+def native_quasibiclique(X_matrix, error_rate = 0.025):
+    #Same problem as quasibiclique, solved by the seed-and-extend heuristic of quasibiclique.cpp
+    matrix = np.ascontiguousarray(X_matrix, dtype=np.int8)
+    m, n = matrix.shape
+    rows = np.zeros(max(m,1), dtype=np.intc)
+    cols = np.zeros(max(n,1), dtype=np.intc)
+    nb_rows = ctypes.c_int(0)
+    nb_cols = ctypes.c_int(0)
+    found = get_native_library().sm_quasibiclique(matrix.ctypes.data, m, n, error_rate, rows.ctypes.data, ctypes.byref(nb_rows), cols.ctypes.data, ctypes.byref(nb_cols))
+    worker_stats['native_solves'] = worker_stats.get('native_solves', 0) + 1
+    return ([int(r) for r in rows[:nb_rows.value]], [int(c) for c in cols[:nb_cols.value]], found == 1)
+
+class QuasibicliqueModel:
+    #The ILP of quasibiclique on the whole binary matrix of binary_clustering_step, kept from one call to the next:
+    #rows and columns outside of the current submatrix are fixed out of the quasi-biclique instead of rebuilding the model,
+    #constraints are added only for the new variables and each solve starts from the previous solution
+    #(a variable rw[r], cl[c] or ce[r,c] is 0 when its row, column or cell is in the quasi-biclique)
+    def __init__(self, X_problem, error_rate):
+        grb = import_gurobi()
+        self.X = X_problem
+        self.error_rate = error_rate
+        self.model = grb.Model('max_model', env=get_gurobi_env())
+        self.model.Params.OutputFlag = 0
+        self.model.Params.Threads = worker_gurobi_threads
+        self.model.Params.MIPGAP = 0.05
+        self.model.Params.TimeLimit = 20
+        self.model.ModelSense = grb.GRB.MAXIMIZE
+        self.rows = {}
+        self.cols = {}
+        self.cells = {} #(row,col) -> variable, 1 if the row and the column are in the quasi-biclique
+        self.error_constraints = [] #error rate constraints of the current call of solve
+        self.start = None #variables and values of the last solution
+
+    def add_lines(self, lines, variables, name):
+        for l in lines:
+            if l not in variables:
+                variables[l] = self.model.addVar(lb=0, ub=1, vtype=grb.GRB.INTEGER, name=f'{name}[{l}]')
+
+    def add_cells(self, rows, cols):
+        #the objective counts the 1s of the cells
+        for r in rows:
+            for c in cols:
+                if (r,c) not in self.cells:
+                    cell = self.model.addVar(lb=0, ub=1, obj=self.X[r][c], vtype=grb.GRB.INTEGER, name=f'ce[{r},{c}]')
+                    self.model.addConstr(1 - self.rows[r] >= cell, f'({r}, {c})_cr')
+                    self.model.addConstr(1 - self.cols[c] >= cell, f'({r}, {c})_cc')
+                    self.model.addConstr(1 - self.rows[r] - self.cols[c] <= cell, f'({r}, {c})_ccr')
+                    self.cells[(r,c)] = cell
+
+    def optimize(self, free_rows, free_cols):
+        #solves with only free_rows and free_cols allowed in the quasi-biclique, adding an error rate constraint on their cells
+        free_rows, free_cols = set(free_rows), set(free_cols)
+        for variables, free in ((self.rows, free_rows), (self.cols, free_cols)):
+            for l, var in variables.items():
+                var.LB = 0 if l in free else 1
+        cells = [(coord, cell) for coord, cell in self.cells.items() if coord[0] in free_rows and coord[1] in free_cols]
+        self.error_constraints.append(self.model.addLConstr(grb.LinExpr([self.error_rate - 1 + self.X[r][c] for (r,c),_ in cells], [cell for _,cell in cells]),
+                                                            grb.GRB.GREATER_EQUAL, 0, 'err_thrshld'))
+        if self.start is not None:
+            self.model.setAttr('Start', self.start[0], self.start[1])
+
+        self.model.optimize()
+        worker_stats['gurobi_solves'] = worker_stats.get('gurobi_solves', 0) + 1
+        worker_stats['gurobi_s'] = worker_stats.get('gurobi_s', 0) + self.model.Runtime
+        if self.model.SolCount > 0:
+            variables = self.model.getVars()
+            self.start = (variables, self.model.getAttr('X', variables))
+
+    def selected(self, lines, variables):
+        if self.model.SolCount == 0:
+            return []
+        return [l for l in lines if variables[l].X < 0.5]
+
+    def solve(self, rows, cols):
+        #INPUT: the rows and the columns of X_problem on which to look for the quasi-biclique
+        #OUTPUT: its rows and columns, and False if the solver failed
+        rows, cols = np.array(rows, dtype=int), np.array(cols, dtype=int)
+        m, n = len(rows), len(cols)
+        if m==0 or n==0:
+            return ([],[],False)
+        X_sub = self.X[np.ix_(rows, cols)]
+        rows_order = np.argsort(X_sub.sum(axis = 1))[::-1]
+        cols_order = np.argsort(X_sub.sum(axis = 0))[::-1]
+        rows_sorted = [int(r) for r in rows[rows_order]]
+        cols_sorted = [int(c) for c in cols[cols_order]]
+
+        #the previous constraints on the error rate only held on the previous submatrix
+        self.model.remove(self.error_constraints)
+        self.error_constraints = []
+
+        #SEEDING on a mostly 1 region
+        seed_rows, seed_cols = PackedMatrix(X_sub).seed_rectangle(rows_order, cols_order)
+        call_rows = rows_sorted[:seed_rows]
+        call_cols = cols_sorted[:seed_cols]
+        self.add_lines(call_rows, self.rows, 'rw')
+        self.add_lines(call_cols, self.cols, 'cl')
+        self.add_cells(call_rows, call_cols)
+        self.optimize(call_rows, call_cols)
+
+        ##EXTEND BY ROW
+        cl = self.selected(call_cols, self.cols)
+        in_call = set(call_rows)
+        rem_rows = [r for r in rows_sorted if r not in in_call]
+        rem_rows_sum = self.X[rem_rows][:,cl].sum(axis=1)
+        potential_rows = [r for idx,r in enumerate(rem_rows) if rem_rows_sum[idx]>0.5*len(cl)]
+        call_rows = call_rows + potential_rows
+        self.add_lines(potential_rows, self.rows, 'rw')
+        self.add_cells(potential_rows, cl)
+        self.optimize(call_rows, call_cols)
+
+        ##EXTEND BY COLUMN
+        rw = self.selected(call_rows, self.rows)
+        cl = self.selected(call_cols, self.cols)
+        in_call = set(call_cols)
+        rem_cols = [c for c in cols_sorted if c not in in_call]
+        rem_cols_sum = self.X[rw][:,rem_cols].sum(axis=0)
+        potential_cols = [c for idx,c in enumerate(rem_cols) if rem_cols_sum[idx]>0.9*len(cl)]
+        call_cols = call_cols + potential_cols
+        self.add_lines(potential_cols, self.cols, 'cl')
+        self.add_cells(rw, potential_cols)
+        self.optimize(call_rows, call_cols)
+
+        rw = self.selected(call_rows, self.rows)
+        cl = self.selected(call_cols, self.cols)
+
+        # status check
+        status = self.model.Status
+        if status in (grb.GRB.INF_OR_UNBD, grb.GRB.INFEASIBLE, grb.GRB.UNBOUNDED):
+            return (rw,cl,False)
+        elif status == grb.GRB.TIME_LIMIT:
+            return (rw,cl,True)
+        elif status != grb.GRB.OPTIMAL:
+            return (rw,cl,False)
+        return rw,cl,True
+
+    def dispose(self):
+        self.model.dispose()
+
 def quasibiclique(X_matrix, error_rate = 0.025):
     #Finding quasibiclique of a binary matrix
-    X_problem = X_matrix.copy()
-    
-    cols_sorted = np.argsort(X_problem.sum(axis = 0))[::-1]
-    rows_sorted = np.argsort(X_problem.sum(axis = 1))[::-1]
-    
-    m = len(rows_sorted)
-    n = len(cols_sorted)
-    if m==0 or n==0:
-        return ([],[],False)
-    #SELECTING MOSTLY 1 REGION FOR SEEDING
-    seed_rows = m//3
-    seed_cols = n//3
-    if n>50:
-        step_n = 10
-    else:
-        step_n = 2
-    for x in range(m//3,m,10):
-        for y in range(n//3,n,step_n):
-            nb_of_1_in_seed = 0
-            for i in rows_sorted[:x]:
-                for j in cols_sorted[:y]:
-                    nb_of_1_in_seed = nb_of_1_in_seed + X_problem[i][j]
-            ratio_of_1 = nb_of_1_in_seed/(x*y)
-            
-            if ratio_of_1 > 0.99 and x*y>seed_rows*seed_cols:
-                seed_rows = x
-                seed_cols = y
-
-    env = grb.Env(params=options)      
-    model = grb.Model('max_model', env=env)          
-    model.Params.OutputFlag = 0
-    model.Params.MIPGAP = 0.05
-    model.Params.TimeLimit = 20
-    
-    #SEEDING
-    #VARS
-    #print('seeding')
-    
-    lpRows = model.addVars(rows_sorted[:seed_rows], lb=0, ub=1, vtype=grb.GRB.INTEGER, name='rw')
-    lpCols = model.addVars(cols_sorted[:seed_cols], lb=0, ub=1, vtype=grb.GRB.INTEGER, name='cl')
-    lpCells = model.addVars([(r, c) for r in rows_sorted[:seed_rows] for c in cols_sorted[:seed_cols]], lb=0, ub=1, vtype=grb.GRB.INTEGER, name='ce')
-    #print('size current problem', len(lpRows),len(lpCols))
-    #OBJ FCT
-    model.setObjective(grb.quicksum([(X_problem[c[0]][c[1]]) * lpCells[c] for c in lpCells]), grb.GRB.MAXIMIZE)
-    
-    #print()
-    #print('Seeding', len(lpRows),len(lpCols))
-    #print()
-    
-    #CONSTRAINTS
-    for cell in lpCells:
-        model.addConstr(1 - lpRows[cell[0]] >= lpCells[cell], f'{cell}_cr')
-        model.addConstr(1 - lpCols[cell[1]] >= lpCells[cell], f'{cell}_cc')
-        model.addConstr(1 - lpRows[cell[0]] - lpCols[cell[1]]<= lpCells[cell], f'{cell}_ccr')
-        
-    model.addConstr(error_rate*grb.quicksum(lpCells) >= grb.quicksum(
-            [lpCells[coord]*(1-X_problem[coord[0]][coord[1]]) for coord in lpCells]), 'err_thrshld')
-    
-    model.optimize()
-    
-    ##EXTEND BY ROW
-    #print('row extend')
-    rw = []
-    cl = []
-    for var in model.getVars():
-        if var.X == 0:
-            name = var.VarName
-            if name[0:2] == 'rw':
-                rw += [int(name[3:-1])]
-            elif name[0:2] == 'cl':
-                cl += [int(name[3:-1])]        
-    
-    rem_rows = [r for r in rows_sorted if r not in lpRows.keys()]
-    rem_rows_sum = X_problem[rem_rows][:,cl].sum(axis=1)
-    potential_rows = [r for idx,r in enumerate(rem_rows) if rem_rows_sum[idx]>0.5*len(cl)]
-    
-    lpRows.update(model.addVars(potential_rows, lb=0, ub=1, vtype=grb.GRB.INTEGER, name='rw'))
-    
-    new_cells = model.addVars([(r, c) for r in potential_rows for c in cl], lb=0, ub=1, vtype=grb.GRB.INTEGER, name='ce')
-    lpCells.update(new_cells)
-    
-    #print()
-    #print('ROW', len(lpRows),len(lpCols))
-    #print()
-    
-    model.setObjective(grb.quicksum([(X_problem[c[0]][c[1]]) * lpCells[c] for c in lpCells]), grb.GRB.MAXIMIZE)
-    
-    for cell in new_cells:
-        model.addConstr(1 - lpRows[cell[0]] >= lpCells[cell], f'{cell}_cr')
-        model.addConstr(1 - lpCols[cell[1]] >= lpCells[cell], f'{cell}_cc')
-        model.addConstr(1 - lpRows[cell[0]] - lpCols[cell[1]]<= lpCells[cell], f'{cell}_ccr')
-        
-    model.addConstr(error_rate*grb.quicksum(lpCells) >= grb.quicksum(
-            [lpCells[coord]*(1-X_problem[coord[0]][coord[1]]) for coord in lpCells]), 'err_thrshld')
-    
-    model.optimize()
-    
-    rw = []
-    cl = []
-    for var in model.getVars():
-        if var.X == 0:
-            name = var.VarName
-            if name[0:2] == 'rw':
-                rw += [int(name[3:-1])]
-            elif name[0:2] == 'cl':
-                cl += [int(name[3:-1])]
-                
-    rem_cols = [c for c in cols_sorted if c not in lpCols.keys()]
-    rem_cols_sum = X_problem[rw][:,rem_cols].sum(axis=0)
-    potential_cols = [c for idx,c in enumerate(rem_cols) if rem_cols_sum[idx]>0.9*len(cl)]
-    
-    lpCols.update(model.addVars(potential_cols, lb=0, ub=1, vtype=grb.GRB.INTEGER, name='cl'))
-    
-    new_cells = model.addVars([(r, c) for r in rw for c in potential_cols], lb=0, ub=1, vtype=grb.GRB.INTEGER, name='ce')
-    lpCells.update(new_cells)
-    
-    #print()
-    #print('COL', len(lpRows),len(lpCols))
-    #print()
-    
-    model.setObjective(grb.quicksum([(X_problem[c[0]][c[1]]) * lpCells[c] for c in lpCells]), grb.GRB.MAXIMIZE)
-    
-    for cell in new_cells:
-        model.addConstr(1 - lpRows[cell[0]] >= lpCells[cell], f'{cell}_cr')
-        model.addConstr(1 - lpCols[cell[1]] >= lpCells[cell], f'{cell}_cc')
-        model.addConstr(1 - lpRows[cell[0]] - lpCols[cell[1]]<= lpCells[cell], f'{cell}_ccr')
-    
-    model.addConstr(error_rate*grb.quicksum(lpCells) >= grb.quicksum(
-            [lpCells[coord]*(1-X_problem[coord[0]][coord[1]]) for coord in lpCells]), 'err_thrshld')
-    
-    
-    model.optimize()
-    
-    rw = []
-    cl = []
-    for var in model.getVars():
-        if var.X == 0:
-            name = var.VarName
-            if name[0:2] == 'rw':
-                rw += [int(name[3:-1])]
-            elif name[0:2] == 'cl':
-                cl += [int(name[3:-1])]  
-    
-    # status check
-    status = model.Status
-    
-    if status in (grb.GRB.INF_OR_UNBD, grb.GRB.INFEASIBLE, grb.GRB.UNBOUNDED):
-        return (rw,cl,False)
-    elif status == grb.GRB.TIME_LIMIT:
-        return (rw,cl,True)
-    elif status != grb.GRB.OPTIMAL:
-        return (rw,cl,False)
-               
-    return rw,cl,True
+    if worker_solver == 'native':
+        return native_quasibiclique(X_matrix, error_rate)
+    model = QuasibicliqueModel(X_matrix.copy(), error_rate)
+    m,n = X_matrix.shape
+    result = model.solve(range(m), range(n))
+    model.dispose()
+    return result
 
 def binary_clustering_step(X_matrix, error_rate = 0.025, min_row_quality = 5, min_col_quality = 3):
     
@@ -318,30 +565,37 @@ def binary_clustering_step(X_matrix, error_rate = 0.025, min_row_quality = 5, mi
     X_problem_0[X_problem_0 == -1] = 1
     X_problem_0 = (X_problem_0-1)*-1
     
+    packed = None #packed at the first homogeneity check
     remain_rows = range(X_problem_1.shape[0])
     current_cols = range(X_problem_1.shape[1])
     clustering_1 = True
     status = True
     rw1,rw0 = [],[]
     
+    models = {} #with gurobi, one model for the 1s and one for the 0s, updated from one iteration to the next
+
     while len(remain_rows)>=min_row_quality and len(current_cols)>=min_col_quality and status:
-        if clustering_1:
-            rw,cl,status = quasibiclique(X_problem_1[remain_rows][:,current_cols],error_rate)
+        if worker_solver == 'gurobi':
+            if clustering_1 not in models:
+                models[clustering_1] = QuasibicliqueModel(X_problem_1 if clustering_1 else X_problem_0, error_rate)
+            rw,cl,status = models[clustering_1].solve(remain_rows, current_cols)
         else:
-            rw,cl,status = quasibiclique(X_problem_0[remain_rows][:,current_cols],error_rate)
-             
-        rw = [remain_rows[r] for r in rw]
-        cl = [current_cols[c] for c in cl]
+            if clustering_1:
+                rw,cl,status = quasibiclique(X_problem_1[remain_rows][:,current_cols],error_rate)
+            else:
+                rw,cl,status = quasibiclique(X_problem_0[remain_rows][:,current_cols],error_rate)
+            rw = [remain_rows[r] for r in rw]
+            cl = [current_cols[c] for c in cl]
         
         if len(cl)>0:
             #filter out extremely noisy columns
             if len(rw) == 0 :
                 current_cols = []
             else :
-                if clustering_1:
-                    col_homogeneity = X_problem_1[rw][:,cl].sum(axis=0)/len(rw)
-                else:
-                    col_homogeneity = X_problem_0[rw][:,cl].sum(axis=0)/len(rw)
+                #proportion of 1s (or of 0s) of each column of the quasi-biclique
+                if packed is None:
+                    packed = PackedMatrix(X_problem)
+                col_homogeneity = packed.count(rw, cl, 1 if clustering_1 else 0, axis = 0)/len(rw)
                 current_cols = [c for idx,c in enumerate(cl) if col_homogeneity[idx] > 5*error_rate]
         else:
             status = False   
@@ -355,7 +609,9 @@ def binary_clustering_step(X_matrix, error_rate = 0.025, min_row_quality = 5, mi
         remain_rows = [r for r in remain_rows if r not in rw]
         
         clustering_1 = not clustering_1
-    
+
+    for model in models.values():
+        model.dispose()
     return rw1,rw0,current_cols
 
 def biclustering_full_matrix(X_matrix, regions, steps, min_row_quality = 5, min_col_quality = 3,error_rate = 0.025):
@@ -431,9 +687,16 @@ def post_processing(X_matrix, steps, read_names,distance_thresh = 0.1):
             rem_.append(read)
     
     if len(rem_) > 0:
-        for r in rem_:
+        #the distances of all the remaining reads to the clusters at once, on the packed matrices when they only have 1, 0 and -1
+        distances = None
+        if X_matrix.shape[1] > 0 and len(mean_of_clusters) > 0 and ternary(X_matrix) and ternary(np.array(mean_of_clusters)):
+            distances = PackedMatrix(X_matrix[rem_]).hamming(PackedMatrix(np.array(mean_of_clusters)))
+        for idx_r,r in enumerate(rem_):
             if len(X_matrix[r]) > 0:
-                dist = pairwise_distances([X_matrix[r]]+mean_of_clusters, metric = "hamming")[0][1:len(mean_of_clusters)+1]
+                if distances is not None:
+                    dist = distances[idx_r]
+                else:
+                    dist = pairwise_distances([X_matrix[r]]+mean_of_clusters, metric = "hamming")[0][1:len(mean_of_clusters)+1]
                 if len(dist)>0:
                     idx_most_similar = np.argmin(dist)
                     if dist[idx_most_similar] < 0.1:
@@ -464,6 +727,317 @@ def post_processing(X_matrix, steps, read_names,distance_thresh = 0.1):
     
     return result_clusters
 
+def screen_window(X_matrix, min_row_quality = 5, min_col_quality = 3, distance_thresh = 0.05, tolerance = 0.1):
+    #Linear-time screening of a window, before the imputation and the clustering
+    #INPUT: the reads x suspicious positions matrix of 1/0/NaN
+    #OUTPUT: 'monomorphic' if too few columns have a minor allele that could make a group, 'split' if all these columns agree
+    #with a single bipartition of the reads (the matrix is then rank 1 up to the errors), 'solver' otherwise. For 'split', also the two groups of rows
+    m, n = X_matrix.shape
+    if m == 0 or n == 0:
+        return 'monomorphic', None
+    packed = PackedMatrix(np.where(np.isnan(X_matrix), -1, X_matrix))
+    all_rows, all_cols = list(range(m)), list(range(n))
+    ones = packed.count(all_rows, all_cols, 1, axis = 0)
+    zeros = packed.count(all_rows, all_cols, 0, axis = 0)
+    missing = m - ones - zeros
+
+    #a column can only separate a group of min_row_quality reads if its minor allele, or the missing values, can cover them
+    informative = [c for c in all_cols if min(ones[c], zeros[c]) + missing[c] >= min_row_quality]
+    if len(informative) < min_col_quality:
+        return 'monomorphic', None
+    #the groups would be merged by post_processing if they differed on too few positions
+    if len(informative) < distance_thresh*n:
+        return 'solver', None
+
+    def agreement(group1, group0, cols):
+        #per column, the reads agreeing and disagreeing with "1 in group1, 0 in group0"
+        agree = packed.count(group1, cols, 1, axis = 0) + packed.count(group0, cols, 0, axis = 0)
+        disagree = packed.count(group1, cols, 0, axis = 0) + packed.count(group0, cols, 1, axis = 0)
+        return agree, disagree
+
+    #bipartition given by the most balanced column, then each column is oriented along it
+    pivot = max(informative, key = lambda c: min(ones[c], zeros[c]))
+    one_on_pivot = packed.count(all_rows, [pivot], 1, axis = 1)
+    zero_on_pivot = packed.count(all_rows, [pivot], 0, axis = 1)
+    group1 = [r for r in all_rows if one_on_pivot[r] == 1]
+    group0 = [r for r in all_rows if zero_on_pivot[r] == 1]
+    agree, disagree = agreement(group1, group0, informative)
+    direct = [c for idx,c in enumerate(informative) if agree[idx] >= disagree[idx]]
+    flipped = [c for idx,c in enumerate(informative) if agree[idx] < disagree[idx]]
+
+    #each read goes to the side its oriented columns vote for, and must be clearly on one side
+    votes1 = packed.count(all_rows, direct, 1, axis = 1) + packed.count(all_rows, flipped, 0, axis = 1)
+    votes0 = packed.count(all_rows, direct, 0, axis = 1) + packed.count(all_rows, flipped, 1, axis = 1)
+    known = votes1 + votes0
+    if (known < min_col_quality).any():
+        return 'solver', None
+    ratio = votes1/known
+    if ((ratio > tolerance) & (ratio < 1-tolerance)).any():
+        return 'solver', None
+    group1 = [r for r in all_rows if ratio[r] >= 0.5]
+    group0 = [r for r in all_rows if ratio[r] < 0.5]
+    if len(group1) <= min_row_quality or len(group0) <= min_row_quality:
+        return 'solver', None
+
+    #and each column must agree with the bipartition
+    direct_agree, direct_disagree = agreement(group1, group0, direct)
+    flipped_agree, flipped_disagree = agreement(group0, group1, flipped)
+    errors = np.concatenate((direct_disagree, flipped_disagree))
+    known = np.concatenate((direct_agree + direct_disagree, flipped_agree + flipped_disagree))
+    if (errors > tolerance*known).any():
+        return 'solver', None
+    return 'split', (group1, group0)
+
+def init_worker(file_path, pileup_file, gurobi_threads, native_threads, solver):
+    #INPUT: the BAM file, the file written by pileup_windows (None if the pileup is done with pysam), the number of threads of each gurobi model
+    #and of the compiled kernels, and the solver of the quasi-bicliques
+    #open the files of the process once and for all
+    global worker_bam, worker_pileup, worker_env, worker_gurobi_threads, worker_native_threads, worker_solver
+    if pileup_file is None:
+        worker_bam = ps.AlignmentFile(file_path,'rb')
+    else:
+        worker_pileup = open(pileup_file, 'rb')
+    worker_env = None
+    worker_gurobi_threads = gurobi_threads
+    worker_native_threads = native_threads
+    worker_solver = solver
+
+def process_window(task):
+    #INPUT: (contig_name, start_pos, stop_pos, offset of the window in the pileup file or None if the pileup is done with pysam)
+    #OUTPUT: the reads of the window with their group, -1 if no haplotypes were found, and the time spent on the window
+    global worker_stats
+    worker_stats = {'gurobi_solves': 0, 'gurobi_s': 0, 'native_solves': 0, 'imputation_s': 0, 'monomorphic': 0, 'direct_split': 0, 'solver': 0}
+    start_wall = time.time()
+    start_cpu = time.process_time()
+    contig_name, start_pos, stop_pos, offset = task
+    filtered_col_threshold = 0.6
+    min_row_quality = 5
+    min_col_quality = 3
+
+    print(f'Parsing data on contig {contig_name} {start_pos}<->{stop_pos}')
+    if offset is not None:
+        df = read_native_window(worker_pileup, offset)
+    else:
+        dict_of_sus_pos = get_data(worker_bam, contig_name,start_pos,stop_pos)
+        df = pd.DataFrame(dict_of_sus_pos)
+    nb_sus_pos = len(df.columns)
+
+    ###create a matrix from the columns
+    # select the reads spanning the whole window
+    tmp_idx = df.iloc[:,:len(df.columns)//3].dropna(axis=0, how = 'all')
+    df = df.loc[tmp_idx.index,:]
+    tmp_idx = df.iloc[:,2*len(df.columns)//3:].dropna(axis=0, how = 'all')
+    df = df.loc[tmp_idx.index,:]
+    df = df.dropna(axis = 1, thresh = filtered_col_threshold*(len(df.index)))
+    reads = list(df.index)
+
+    ###clustering, only for the windows that the screening cannot settle
+    path = 'monomorphic'
+    if nb_sus_pos > 0 :
+        X_matrix = df.to_numpy()
+        print(X_matrix.shape)
+        path, split = screen_window(X_matrix, min_row_quality, min_col_quality, distance_thresh = 0.05)
+    if path == 'monomorphic':
+        clusters = []
+    elif path == 'split':
+        clusters = [np.sort(np.array([reads[r] for r in group])) for group in split]
+    else:
+        matrix,regions,steps = pre_processing(X_matrix,min_col_quality)
+        steps = biclustering_full_matrix(matrix, regions, steps, min_row_quality, min_col_quality,error_rate=0.025)
+        clusters = post_processing(matrix, steps, reads,distance_thresh = 0.05)
+    worker_stats['direct_split' if path == 'split' else path] = 1
+
+    reads_ = []
+    labels_ = []
+    if len(clusters) > 1 :
+        for idx,cluster in enumerate(clusters):
+            for read in cluster:
+                reads_.append(read)
+                labels_.append(idx)
+        print('Found', len(clusters), 'groups on contig', contig_name, start_pos)
+    else:
+        print('No haplotypes found on contig', contig_name, start_pos)
+        for read in df.index:
+            reads_.append(read)
+            labels_.append(-1)
+
+    worker_stats['wall_s'] = time.time() - start_wall
+    worker_stats['cpu_s'] = time.process_time() - start_cpu
+    worker_stats['peak_rss_kb'] = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return reads_, labels_, worker_stats
+
+def varint(value):
+    #LEB128 encoding of a non-negative integer
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+def write_split_contig(sol_file, binary, contig_name, contig_length, list_of_reads, haplotypes):
+    #INPUT: the split file, opened in binary mode if binary, a contig, its reads and for each window (start, stop, {index of read: label})
+    #OUTPUT: writes the CONTIG, READ and GROUP records of the contig, in the binary format "SGRO" read by create_new_contigs or in text (for debugging)
+    if binary :
+        name = contig_name.encode()
+        sol_file.write(b'C' + varint(len(name)) + name + varint(contig_length) + struct.pack('<d', 1))
+        for r in list_of_reads :
+            name = r.encode()
+            sol_file.write(b'R' + varint(len(name)) + name)
+        for start_pos, stop_pos, haplotypes_here in haplotypes:
+            #the reads by increasing index, delta-encoded, and their labels zigzag-encoded; the reads that are not in the window are not written
+            record = bytearray(b'G' + varint(start_pos) + varint(stop_pos) + varint(len(haplotypes_here)))
+            previous = 0
+            for r in sorted(haplotypes_here.keys()):
+                label = int(haplotypes_here[r])
+                record += varint(r - previous) + varint((label << 1) ^ (label >> 63))
+                previous = r
+            sol_file.write(bytes(record))
+        return
+
+    sol_file.write(f'CONTIG\t{contig_name}\t{contig_length}\t1\n')
+    for r in list_of_reads :
+        sol_file.write(f'READ\t{r}\t-1\t-1\t-1\t-1\t-1\n')
+    for start_pos, stop_pos, haplotypes_here in haplotypes:
+        sol_file.write(f'GROUP\t{start_pos}\t{stop_pos}\t')
+        haplotypes_list = [-2 for i in range(len(list_of_reads))]
+        for r in haplotypes_here.keys():
+            haplotypes_list[r] = haplotypes_here[r]
+        haplo_str = ""
+        for h in range(len(haplotypes_list)):
+            if haplotypes_list[h] != -2:
+                sol_file.write(f'{h},')
+                haplo_str = haplo_str + str(haplotypes_list[h]) + ','
+        sol_file.write(f'\t{haplo_str}\n')
+
+CACHE_VERSION = 1 #to change whenever the clusters computed from the same input change
+
+def file_checksum(path):
+    #OUTPUT: checksum of the whole content of the file
+    h = hashlib.sha1()
+    with open(path, 'rb') as f:
+        for block in iter(lambda: f.read(1 << 20), b''):
+            h.update(block)
+    return h.hexdigest()
+
+def contig_checksums(assembly):
+    #INPUT: the assembly in gfa format
+    #OUTPUT: checksum of the sequence of each contig, by name
+    checksums = {}
+    with open(assembly) as f:
+        for line in f:
+            if line.startswith('S\t'):
+                fields = line.rstrip('\n').split('\t', 3)
+                checksums[fields[1]] = hashlib.sha1(fields[2].encode()).hexdigest()
+    return checksums
+
+def bam_region_checksums(bam_file, nb_contigs):
+    #INPUT: the sorted BAM file and the number of contigs of its header
+    #OUTPUT: for each contig, a checksum of the compressed blocks of the BAM holding its alignments, found with the pseudo-bin of the .bai.
+    #Without a .bai (e.g. a cram file) or without pseudo-bin, the contigs get the checksum of the whole file
+    index = None
+    for candidate in (bam_file + '.bai', os.path.splitext(bam_file)[0] + '.bai'):
+        if os.path.exists(candidate):
+            index = candidate
+            break
+    whole = None
+    regions = None
+    if bam_file.endswith('.bam') and index is not None:
+        with open(index, 'rb') as f:
+            data = f.read()
+        magic, n_ref = struct.unpack_from('<4si', data, 0)
+        if magic == b'BAI\1' and n_ref == nb_contigs:
+            pos = 8
+            regions = []
+            for ref in range(n_ref):
+                n_bin, = struct.unpack_from('<i', data, pos)
+                pos += 4
+                region = () if n_bin == 0 else None #no bin: no alignment on the contig
+                for b in range(n_bin):
+                    bin_id, n_chunk = struct.unpack_from('<Ii', data, pos)
+                    pos += 8
+                    if bin_id == 37450 and n_chunk == 2: #virtual offsets of the first and last alignments, numbers of mapped and unmapped reads
+                        region = struct.unpack_from('<4Q', data, pos)
+                    pos += 16*n_chunk
+                n_intv, = struct.unpack_from('<i', data, pos)
+                pos += 4 + 8*n_intv
+                regions.append(region)
+
+    checksums = []
+    with open(bam_file, 'rb') as bam:
+        for num in range(nb_contigs):
+            region = regions[num] if regions is not None else None
+            if region is None:
+                if whole is None:
+                    whole = file_checksum(bam_file)
+                checksums.append(whole)
+                continue
+            h = hashlib.sha1(str(region).encode())
+            if len(region) > 0:
+                #from the block of the first alignment to the end of the block of the last one
+                begin, end = region[0] >> 16, region[1] >> 16
+                bam.seek(end)
+                header = bam.read(18)
+                end += struct.unpack_from('<H', header, 16)[0] + 1 if len(header) == 18 else 0
+                bam.seek(begin)
+                while begin < end:
+                    block = bam.read(min(1 << 20, end - begin))
+                    if not block:
+                        break
+                    h.update(block)
+                    begin += len(block)
+            checksums.append(h.hexdigest())
+    return checksums
+
+def load_cached_contig(cache_dir, key):
+    #OUTPUT: (reads, haplotypes, stats) of the contig stored by a previous run, or None
+    try:
+        with open(cache_dir + '/' + key + '.win', 'rb') as f:
+            return pickle.load(f)
+    except (OSError, EOFError, pickle.UnpicklingError):
+        return None
+
+def store_cached_contig(cache_dir, key, contig):
+    #written in a temporary file then renamed, so that an interrupted run does not leave a truncated entry
+    path = cache_dir + '/' + key + '.win'
+    with open(path + '.tmp', 'wb') as f:
+        pickle.dump(contig, f)
+    os.replace(path + '.tmp', path)
+
+def select_regions(contigs, contigs_file, region):
+    #INPUT: the contigs of the BAM header, the file of --contigs and the region of --region (empty if not given)
+    #OUTPUT: for each contig, the 0-based half-open region to process, None if the contig is not processed
+    if contigs_file == '' and region == '':
+        return [(0, contig['LN']) for contig in contigs]
+    lengths = {contig['SN']: contig['LN'] for contig in contigs}
+    selected = {}
+    if contigs_file != '':
+        with open(contigs_file) as f:
+            for line in f:
+                if line.strip() != '':
+                    selected[line.split()[0]] = None
+    else:
+        name, start, end = region, None, None
+        if ':' in region:
+            name, interval = region.rsplit(':', 1)
+            try:
+                start, end = [int(p.replace(',', '')) for p in interval.split('-')]
+            except ValueError:
+                print('ERROR: could not read the region', region, ', expected name:start-end')
+                sys.exit(1)
+        if name in lengths and start is not None:
+            selected[name] = (max(0, start-1), min(end, lengths[name]))
+        else:
+            selected[name] = None
+    for name in selected:
+        if name not in lengths:
+            print('ERROR: the contig', name, 'is not in the BAM file')
+            sys.exit(1)
+    return [None if contig['SN'] not in selected else (selected[contig['SN']] or (0, contig['LN'])) for contig in contigs]
+
 def parse_arguments():
     """Parse the input arguments and retrieve the choosen resolution method and
     the instance that must be solve."""
@@ -498,16 +1072,84 @@ def parse_arguments():
         help='Size of window to perform read separation (must be at least twice shorter than average read length) [5000]',
     )
 
+    argparser.add_argument(
+        '--max-columns', dest='max_columns', required=False, default=200, type=int,
+        help='With the native pileup, cut the windows shorter where they have more suspicious positions than this, and merge the windows without any. 0 for windows of fixed size [200]',
+    )
+
+    argparser.add_argument(
+        '--pileup', dest='pileup', required=False, default='native', choices=['native', 'pysam'],
+        help='Engine used to find the suspicious positions: the compiled build/pileup_windows or pysam [native]',
+    )
+
+    argparser.add_argument(
+        '--polisher', dest='polisher', required=False, default='fast', choices=['fast', 'racon', 'medaka'],
+        help='Polisher of the new contigs: fast (in memory, from the alignments already computed), racon or medaka [fast]',
+    )
+
+    argparser.add_argument(
+        '--unzip', dest='unzip', required=False, default='native', choices=['native', 'graphunzip'],
+        help='Tool unzipping the final graph with the reads: the compiled build/graph_unzip or the Python GraphUnzip [native]',
+    )
+
+    argparser.add_argument(
+        '-t', '--threads', dest='threads', required=False, default=1, type=int,
+        help='Number of threads [1]',
+    )
+
+    argparser.add_argument(
+        '--solver', dest='solver', required=False, default='native', choices=['native', 'gurobi'],
+        help='Solver of the quasi-bicliques: native (compiled heuristic, no license needed) or gurobi (exact ILP) [native]',
+    )
+
+    argparser.add_argument(
+        '--split-format', dest='split_format', required=False, default='binary', choices=['binary', 'text'],
+        help='Format of the file tmp/reads_haplo.gro passing the reads of each window to create_new_contigs: compact binary, or text (for debugging) [binary]',
+    )
+
+    argparser.add_argument(
+        '--no-cache', dest='no_cache', action='store_true',
+        help='Recompute all the contigs instead of reusing the results that a previous run with the same input and parameters left in out/tmp/cache (the cache is emptied)',
+    )
+
+    argparser.add_argument(
+        '--read-cache', dest='read_cache', required=False, default=512, type=int,
+        help='Memory (MiB) kept by create_new_contigs for the sequences of the reads that no contig uses anymore, in case another contig needs them [512]',
+    )
+
+    subset = argparser.add_mutually_exclusive_group()
+    subset.add_argument(
+        '--contigs', dest='contigs', required=False, default='', type=str,
+        help='Only process the contigs listed in this file (one name per line). The output is then a shard, to be merged with the shards of the other contigs by build/merge_shards',
+    )
+    subset.add_argument(
+        '--region', dest='region', required=False, default='', type=str,
+        help='Only process this contig, or this region of a contig (name:start-end, 1-based and inclusive). The output is then a shard, as with --contigs',
+    )
+
+    argparser.add_argument(
+        '--profile', dest='profile', required=False, default='', type=str,
+        help='Write the time, memory and I/O of each stage and of each contig to this file (JSON, or TSV if it ends with .tsv)',
+    )
+
     arg = argparser.parse_args()
 
 
-    return (arg.bam, arg.error_rate, arg.out, arg.window, arg.reads, arg.assembly)
+    return (arg.bam, arg.error_rate, arg.out, arg.window, arg.max_columns, arg.reads, arg.assembly, arg.pileup, arg.threads, arg.polisher, arg.profile, arg.solver, arg.split_format, not arg.no_cache,
+        arg.contigs, arg.region, arg.read_cache, arg.unzip)
 
 if __name__ == '__main__':
 
     print('StrainMiner version ', __version__)
 
-    file_path,  error_rate, out, window, readsFile, originalAssembly = parse_arguments()
+    file_path,  error_rate, out, window, max_columns, readsFile, originalAssembly, pileup, threads, polisher, profile, solver, split_format, cache, contigs_file, region, read_cache, unzip = parse_arguments()
+    profiler = Profiler()
+    if solver == 'gurobi':
+        try:
+            import_gurobi()
+        except ImportError:
+            print('ERROR: --solver gurobi needs gurobipy (and a gurobi license), use --solver native otherwise')
+            sys.exit(1)
     #mkdir out
     if not os.path.exists(out):
         os.makedirs(out)
@@ -518,133 +1160,165 @@ if __name__ == '__main__':
 
     tmp_dir = out+'/tmp'
 
-    sol_file = open(out+'/tmp/reads_haplo.gro','w')
+    path_to_src = sys.argv[0].split("strainminer.py")[0]+"/"
 
-    start = time.time()
+    if path_to_src == "/":
+        path_to_src = "./"
+
+    if split_format == 'binary':
+        sol_file = open(out+'/tmp/reads_haplo.gro','wb')
+        sol_file.write(b'SGRO' + struct.pack('<I', 1))
+    else:
+        sol_file = open(out+'/tmp/reads_haplo.gro','w')
+
+    #the clusters of a contig only depend on its sequence, on its alignments and on the parameters: reuse those that a previous run left in the cache
+    cache_dir = tmp_dir + '/cache'
     file = ps.AlignmentFile(file_path,'rb')
     contigs = (file.header.to_dict())['SQ']
+    file.close()
     if len(contigs) == 0:
         print('ERROR: No contigs found when parsing the BAM file, check the bam file and the indexation of the bam file')
         sys.exit(1)
+    selection = select_regions(contigs, contigs_file, region)
+    shard = contigs_file != '' or region != ''
+    if shard:
+        with open(tmp_dir + '/regions.tsv', 'w') as f:
+            for contig, selected in zip(contigs, selection):
+                if selected is not None:
+                    f.write(contig['SN'] + '\t' + str(selected[0]) + '\t' + str(selected[1]) + '\n')
+        with open(tmp_dir + '/contigs.txt', 'w') as f:
+            for contig, selected in zip(contigs, selection):
+                if selected is not None:
+                    f.write(contig['SN'] + '\n')
+        print('Processing', sum(selected is not None for selected in selection), 'of the', len(contigs), 'contigs')
+    keys = ['' for contig in contigs]
+    cached = [None for contig in contigs]
+    if not cache and os.path.exists(cache_dir):
+        shutil.rmtree(cache_dir) #create_new_contigs uses the cache whenever the folder exists
+    if cache:
+        stage = profiler.start('cache')
+        if not os.path.exists(cache_dir):
+            os.makedirs(cache_dir)
+        sequences = contig_checksums(originalAssembly)
+        regions = bam_region_checksums(file_path, len(contigs))
+        for num in range(len(contigs)):
+            keys[num] = hashlib.sha1('\t'.join(str(p) for p in (__version__, CACHE_VERSION, contigs[num]['SN'], contigs[num]['LN'],
+                sequences.get(contigs[num]['SN'], ''), regions[num], window, max_columns, pileup, solver, selection[num])).encode()).hexdigest()
+            cached[num] = load_cached_contig(cache_dir, keys[num])
+        print(sum(contig is not None for contig in cached), 'of the', len(contigs), 'contigs found in', cache_dir)
+        profiler.stop(stage)
+    to_compute = [num for num in range(len(contigs)) if cached[num] is None and selection[num] is not None]
+
+    start = time.time()
+    stage = profiler.start('pileup')
+    pileup_file = None
+    windows = [[] for contig in contigs]
+    if len(to_compute) == 0:
+        pass #everything is in the cache
+    elif pileup == 'native':
+        #extract all the windows in one pass over the BAM file (two if the windows are adaptive)
+        pileup_file = tmp_dir + "/pileup.smpu"
+        command = path_to_src + "build/pileup_windows " + file_path + " " + str(window) + " " + pileup_file + " 10 " + str(max_columns)
+        if shard:
+            command += " " + tmp_dir + "/regions.tsv"
+        print(" Running : ", command)
+        res_pileup = profiler.run(command)
+        if res_pileup != 0:
+            print("ERROR: pileup_windows failed. Was trying to run: " + command)
+            sys.exit(1)
+        contigs, windows = index_native_pileup(pileup_file)
+    else:
+        windows = [[(start_pos, min(start_pos+window, contig['LN']), None) for start_pos in range(0,contig['LN'],window)] for contig in contigs]
+        windows = [[w for w in windows[num] if selection[num] is not None and w[0] < selection[num][1] and w[1] > selection[num][0]] for num in range(len(contigs))]
+    profiler.stop(stage)
+
+    #list all the windows, in the order in which they are written in the output
+    tasks = []
+    for num in to_compute:
+        for start_pos, stop_pos, offset in windows[num]:
+            tasks.append((contigs[num]['SN'], start_pos, stop_pos, offset))
+
+    #the windows are independent: cluster them in parallel, the results come back in the order of the tasks
+    stage = profiler.start('clustering')
+    if threads > 1:
+        pool = multiprocessing.Pool(threads, initializer=init_worker, initargs=(file_path, pileup_file, 1, 1, solver))
+        results = pool.imap(process_window, tasks, chunksize=1)
+    else:
+        pool = None
+        init_worker(file_path, pileup_file, 0, threads, solver)
+        results = map(process_window, tasks)
+    screened = {'monomorphic': 0, 'direct_split': 0, 'solver': 0} #number of windows settled by each path of screen_window
+
     for num in range(0,len(contigs)):
         contig_name = contigs[num]['SN']
         contig_length = contigs[num]['LN']
+        if selection[num] is None:
+            continue
 
         print(contig_name, contig_length, ' length')
-        window = 5000
-        filtered_col_threshold = 0.6
-        min_row_quality = 5
-        min_col_quality = 3
+        if cached[num] is not None:
+            list_of_reads, haplotypes, contig_stats = cached[num]
+            for key in screened:
+                screened[key] += contig_stats[key]
+            profiler.add(dict(contig_stats, stage='window_clustering_cached'))
+            write_split_contig(sol_file, split_format == 'binary', contig_name, contig_length, list_of_reads, haplotypes)
+            continue
+
         list_of_reads = []
         index_of_reads = {}
         haplotypes = []
+        contig_stats = {'stage': 'window_clustering', 'contig': contig_name, 'windows': 0, 'wall_s': 0, 'cpu_s': 0, 'peak_rss_kb': 0, 'gurobi_solves': 0, 'gurobi_s': 0, 'native_solves': 0, 'imputation_s': 0, 'monomorphic': 0, 'direct_split': 0, 'solver': 0}
 
-        for start_pos in range(0,contig_length,window):
+        for start_pos, stop_pos, offset in windows[num]:
 
             haplotypes_here = {}
+            reads_, labels_, window_stats = next(results)
+            contig_stats['windows'] += 1
+            for key in ('wall_s', 'cpu_s', 'gurobi_solves', 'gurobi_s', 'native_solves', 'imputation_s', 'monomorphic', 'direct_split', 'solver'):
+                contig_stats[key] += window_stats[key]
+                if key in screened:
+                    screened[key] += window_stats[key]
+            contig_stats['peak_rss_kb'] = max(contig_stats['peak_rss_kb'], window_stats['peak_rss_kb'])
+            for read, label in zip(reads_, labels_):
+                if read not in index_of_reads:
+                    index_of_reads[read] = len(list_of_reads)
+                    list_of_reads.append(read)
+                haplotypes_here[index_of_reads[read]] = label
 
-            if start_pos+window <= contig_length:
-                # sol_file.write(f'CONTIG\t{contig_name} {start_pos}<->{start_pos+window} \n')
-
-                print(f'Parsing data on contig {contig_name} {start_pos}<->{start_pos+window}')
-                dict_of_sus_pos = get_data(file, contig_name,start_pos,start_pos+window)
-            else : 
-                # sol_file.write(f'CONTIG\t{contig_name} {start_pos}<->{contig_length} \n')
-
-                print(f'Parsing data on contig  {contig_name} {start_pos}<->{contig_length}')
-                dict_of_sus_pos = get_data(file, contig_name,start_pos,contig_length)
-
+            haplotypes.append((start_pos, stop_pos, haplotypes_here))
 
-            ###create a matrix from the columns
-            df = pd.DataFrame(dict_of_sus_pos) 
-            # select the reads spanning the whole window
-            tmp_idx = df.iloc[:,:len(df.columns)//3].dropna(axis=0, how = 'all')
-            df = df.loc[tmp_idx.index,:]
-            tmp_idx = df.iloc[:,2*len(df.columns)//3:].dropna(axis=0, how = 'all')
-            df = df.loc[tmp_idx.index,:]
-            df = df.dropna(axis = 1, thresh = filtered_col_threshold*(len(df.index)))
-            reads = list(df.index)
-
-            ###clustering
-            if len(dict_of_sus_pos) > 0 :
-                X_matrix = df.to_numpy()
-                print(X_matrix.shape)
-                matrix,regions,steps = pre_processing(X_matrix,min_col_quality)
-                steps = biclustering_full_matrix(matrix, regions, steps, min_row_quality, min_col_quality,error_rate=0.025)
-                clusters = post_processing(matrix, steps, reads,distance_thresh = 0.05)
-
-                
-            reads_ = []
-            labels_ = []
-            if len(dict_of_sus_pos) > 0 and len(clusters) > 1 :
-                for idx,cluster in enumerate(clusters):
-                    for read in cluster:
-                        reads_.append(read)
-                        labels_.append(idx)
-                        if read not in index_of_reads:
-                            index_of_reads[read] = len(list_of_reads)
-                            list_of_reads.append(read)
-                        haplotypes_here[index_of_reads[read]] = idx
-
-                print('Found', len(clusters), 'groups')
-            else:
-                print('No haplotypes found')
-                for read in df.index:
-                    reads_.append(read)
-                    labels_.append(-1)
-                    if read not in index_of_reads:
-                            index_of_reads[read] = len(list_of_reads)
-                            list_of_reads.append(read)
-                    haplotypes_here[index_of_reads[read]] = -1
-
-            haplotypes.append(haplotypes_here)
-
-            # for read in reads_:
-            #     sol_file.write(f'READ\t{read}\n')
-            # if len(labels_)>0:
-            #     sol_file.write(f'LABELS\t{labels_[0]}')
-            #     for i in range(1,len(labels_)):
-            #         sol_file.write(f',{labels_[i]}')
-            
-            # sol_file.write(f'\n')   
             end = time.time()
             print('Elapsed time', end - start)
+        profiler.add(contig_stats)
 
 
         #now write the output file
-        sol_file.write(f'CONTIG\t{contig_name}\t{contig_length}\t1\n')
-        for r in list_of_reads :
-            sol_file.write(f'READ\t{r}\t-1\t-1\t-1\t-1\t-1\n')
-        for w in range(len(haplotypes)):
-            sol_file.write(f'GROUP\t{w*window}\t{min(contig_length, (w+1)*window)}\t')
-            haplotypes_list = [-2 for i in range(len(list_of_reads))]
-            for r in haplotypes[w].keys():
-                haplotypes_list[r] = haplotypes[w][r]
-            haplo_str = ""
-            for h in range(len(haplotypes_list)):
-                if haplotypes_list[h] != -2:
-                    sol_file.write(f'{h},')
-                    haplo_str = haplo_str + str(haplotypes_list[h]) + ','
-            sol_file.write(f'\t{haplo_str}\n')
+        write_split_contig(sol_file, split_format == 'binary', contig_name, contig_length, list_of_reads, haplotypes)
+        if cache:
+            store_cached_contig(cache_dir, keys[num], (list_of_reads, haplotypes, contig_stats))
                 
     sol_file.close()  
+    if pool is not None:
+        pool.close()
+        pool.join()
+    profiler.stop(stage)
+    print('Screening of the windows:', screened['monomorphic'], 'without strain signal,', screened['direct_split'], 'split directly,', screened['solver'], 'sent to the clustering')
 
     #now create the new contigs
     gaffile = tmp_dir + "/reads_on_new_contig.gaf"
     zipped_GFA = tmp_dir + "/zipped_assembly.gfa"
     polish_everything = "0"
-    polisher = "racon"
     technology = "ont"
-    nb_threads = 1
+    nb_threads = threads #create_new_contigs splits them between its backbones and minimap2/racon
     zipped_GFA = tmp_dir + "/zipped_assembly.gfa"
-    path_to_src = sys.argv[0].split("strainminer.py")[0]+"/"
-
-    if path_to_src == "/":
-        path_to_src = "./"
 
-    #create the sam file from the bam file
-    samFile = tmp_dir + "/reads_on_asm.sam"
-    os.system("samtools view -h -o "+samFile+" "+file_path)
+    #create_new_contigs reads the bam file directly (using its .bai to load the contigs in parallel), only cram needs to be converted
+    samFile = file_path
+    if file_path.endswith(".cram"):
+        samFile = tmp_dir + "/reads_on_asm.bam"
+        stage = profiler.start('cram_to_bam')
+        profiler.run("samtools view -@ "+str(threads)+" -b -o "+samFile+" "+file_path+" && samtools index "+samFile)
+        profiler.stop(stage)
 
     command = path_to_src + "build/create_new_contigs " \
         + originalAssembly + " " \
@@ -659,30 +1333,60 @@ if __name__ == '__main__':
         + gaffile +  " " \
         + polisher + " " \
         + polish_everything \
-        + " minimap2 racon  medaka  samtools  python 0 "
+        + " minimap2 racon  medaka  samtools  python 0 " \
+        + " --read-cache " + str(read_cache)
+    if shard:
+        command += " --contigs " + tmp_dir + "/contigs.txt"
     print(" Running : ", command)
-    res_create_new_contigs = os.system(command)
+    stage = profiler.start('create_new_contigs')
+    res_create_new_contigs = profiler.run(command)
+    profiler.stop(stage)
     if res_create_new_contigs != 0:
         print("ERROR: create_new_contigs failed. Was trying to run: " + command)
         sys.exit(1)
 
 
+    #the final graph is unzipped with build/graph_unzip, or with the Python GraphUnzip
+    #the native unzipping also writes the FASTA of the output, which GraphUnzip leaves to gfa2fa
+    def unzip_command(gfa, gaf, output, fasta):
+        if unzip == 'native':
+            return path_to_src + "build/graph_unzip " + gfa + " " + gaf + " " + output + " " + fasta
+        return "python " + path_to_src + "GraphUnzip/graphunzip.py unzip -l " + gaf + " -g " + gfa + " -o " + output
+
+    if shard:
+        #GraphUnzip needs the whole graph: it is run once the shards of all the contigs are merged
+        print(" - The shard is written in", zipped_GFA, "and", gaffile, ". Once all the contigs are processed, merge the shards and unzip the graph with:\n     ",
+            path_to_src + "build/merge_shards " + originalAssembly + " zipped_assembly.gfa reads_on_new_contig.gaf <shard1.gfa> <shard1.gaf> <shard2.gfa> <shard2.gaf> ...\n     ",
+            unzip_command("zipped_assembly.gfa", "reads_on_new_contig.gaf", "strainminer_final_assembly.gfa", "strainminer_final_assembly.fasta"))
+        if profile != '':
+            profiler.write(profile, tmp_dir + "/profile_create_new_contigs.json")
+            print(" - The profile of the run is written in ", profile)
+        sys.exit(0)
+
     outfile = out.rstrip('/') + "/strainminer_final_assembly.gfa"
+    fasta_name = outfile[0:-4] + ".fasta"
 
     meta = " --meta"
     # if args.multiploid :
     #     meta = ""
 
-    command = "python " + path_to_src + "GraphUnzip/graphunzip.py unzip -l " + gaffile + " -g " + zipped_GFA + " -o " + outfile + " 2>"+tmp_dir+"/logGraphUnzip.txt >"+tmp_dir+"/trash.txt";
+    command = unzip_command(zipped_GFA, gaffile, outfile, fasta_name) + " 2>"+tmp_dir+"/logGraphUnzip.txt >"+tmp_dir+"/trash.txt"
     print( " - Running GraphUnzip with command line:\n     ", command, "\n   The log of GraphUnzip is written on ",tmp_dir+"/logGraphUnzip.txt\n")
-    resultGU = os.system(command)
+    stage = profiler.start('GraphUnzip')
+    resultGU = profiler.run(command)
+    profiler.stop(stage)
     if resultGU != 0 :
         print( "ERROR: GraphUnzip failed. Please check the output of GraphUnzip in "+tmp_dir+"/logGraphUnzip.txt" )
         sys.exit(1)
-    
-    fasta_name = outfile[0:-4] + ".fasta"
-    command = path_to_src + "build/gfa2fa " + outfile + " > " + fasta_name
-    res_gfa2fasta = os.system(command)
-    if res_gfa2fasta != 0:
-        print("ERROR: gfa2fa failed. Was trying to run: " + command)
-        sys.exit(1)  
\ No newline at end of file
+
+    if unzip != 'native':
+        command = path_to_src + "build/gfa2fa " + outfile + " " + fasta_name
+        stage = profiler.start('gfa2fa')
+        res_gfa2fasta = profiler.run(command)
+        profiler.stop(stage)
+        if res_gfa2fasta != 0:
+            print("ERROR: gfa2fa failed. Was trying to run: " + command)
+            sys.exit(1)  
+    if profile != '':
+        profiler.write(profile, tmp_dir + "/profile_create_new_contigs.json")
+        print(" - The profile of the run is written in ", profile)
@@ -0,0 +1,116 @@
+#include "tokenizer.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::string_view;
+using std::vector;
+using std::cout;
+using std::endl;
+
+MappedFile::MappedFile(std::string file){
+
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    opened = false;
+
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0){
+        return;
+    }
+    opened = true;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)){
+        size = st.st_size;
+        if (size > 0){
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED){
+                data = static_cast<const char*>(p);
+                mapped = true;
+                madvise(p, size, MADV_SEQUENTIAL);
+            }
+        }
+    }
+    close(fd);
+
+    if (!mapped){ //e.g. a named pipe: read everything
+        std::ifstream in(file, std::ios::binary);
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        fallback = ss.str();
+        data = fallback.data();
+        size = fallback.size();
+    }
+}
+
+MappedFile::~MappedFile(){
+    if (mapped){
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+bool MappedFile::good() const{
+    return opened;
+}
+
+std::string_view MappedFile::view() const{
+    return string_view(data, size);
+}
+
+LineTokenizer::LineTokenizer(std::string_view text) : text(text), pos(0){
+}
+
+bool LineTokenizer::next_line(std::string_view &line){
+    if (pos >= text.size()){
+        return false;
+    }
+    size_t end = text.find('\n', pos);
+    if (end == string_view::npos){
+        end = text.size();
+    }
+    line = text.substr(pos, end-pos);
+    if (!line.empty() && line.back() == '\r'){
+        line.remove_suffix(1);
+    }
+    pos = end+1;
+    return true;
+}
+
+size_t LineTokenizer::offset() const{
+    return std::min(pos, text.size());
+}
+
+std::string_view first_word(std::string_view field){
+    return field.substr(0, field.find(' '));
+}
+
+/**
+ * @brief Cuts a text in chunks of whole lines, to parse them in parallel
+ *
+ * @param text
+ * @param nbChunks number of chunks wanted (there can be fewer if the text is short)
+ * @return the chunks, in the order of the text
+ */
+std::vector<std::string_view> split_in_chunks(std::string_view text, int nbChunks){
+
+    vector<string_view> chunks;
+    size_t start = 0;
+    for (int c = 0 ; c < nbChunks && start < text.size() ; c++){
+        size_t end = text.size();
+        if (c < nbChunks-1){
+            end = text.find('\n', start + (text.size()-start)/(nbChunks-c));
+            end = (end == string_view::npos) ? text.size() : end+1;
+        }
+        chunks.push_back(text.substr(start, end-start));
+        start = end;
+    }
+    return chunks;
+}
@@ -0,0 +1,84 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+
+/**
+ * @brief Read-only memory map of a whole file. The content is read into memory if the file cannot be mapped (e.g. a pipe)
+ */
+class MappedFile{
+
+public :
+    MappedFile(std::string file);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool good() const;
+    std::string_view view() const;
+
+private :
+    const char* data;
+    size_t size;
+    bool mapped;
+    bool opened;
+    std::string fallback;
+};
+
+/**
+ * @brief Iterates over the lines of a text, without copying them
+ */
+class LineTokenizer{
+
+public :
+    LineTokenizer(std::string_view text);
+
+    bool next_line(std::string_view &line); //the end of line (\n or \r\n) is not included in line
+    size_t offset() const; //offset in the text of the next line
+
+private :
+    std::string_view text;
+    size_t pos;
+};
+
+/**
+ * @brief Cuts the first field of line, up to sep, and advances line after the separator. Behaves as getline(stream, field, sep)
+ *
+ * @param line the rest of the line, modified
+ * @param field the field
+ * @param sep the separator
+ * @return false if there is no field left
+ */
+inline bool next_field(std::string_view &line, std::string_view &field, char sep = '\t'){
+    if (line.empty()){
+        return false;
+    }
+    size_t end = line.find(sep);
+    if (end == std::string_view::npos){
+        field = line;
+        line = std::string_view();
+        return true;
+    }
+    field = line.substr(0, end);
+    line = line.substr(end+1);
+    return true;
+}
+
+/**
+ * @brief Parses the number at the beginning of field, ignoring what comes after it (as atoi does)
+ *
+ * @return false if field does not start with a number
+ */
+template <typename T>
+inline bool parse_number(std::string_view field, T &value){
+    return std::from_chars(field.data(), field.data()+field.size(), value).ec == std::errc();
+}
+
+std::string_view first_word(std::string_view field); //up to the first blank space
+
+std::vector<std::string_view> split_in_chunks(std::string_view text, int nbChunks); //chunks of whole lines, of similar sizes
+
+#endif
@@ -1,10 +1,14 @@
 #include "tools.h"
 // #include "reassemble_unaligned_reads.h"
-#include "edlib/include/edlib.h"
+#include "aligner.h"
+#include "profiling.h"
+#include "fasta_writer.h"
 
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <unordered_map>
+#include <cstdlib>
 
 using std::cout;
 using std::endl;
@@ -16,6 +20,7 @@ using std::ofstream;
 using std::min;
 using std::max;
 using std::pair;
+using std::make_pair;
 
 //input : a CIGAR
 //output : an alignment string where 1 letter = 1 base. i.e. 5M1D1M -> MMMMMIM
@@ -159,28 +164,11 @@ int compute_edit_distance(std::string &cigar, std::string &ref, std::string &rea
  * @param fasta_file 
  */
 void convert_GFA_to_FASTA(std::string &gfa_file, std::string &fasta_file){
-    ifstream gfa(gfa_file);
-    ofstream fasta(fasta_file);
-
-    string line;
-    while (getline(gfa, line)){
-        if (line[0] == 'S'){
-
-            //the name is the second field
-            string name = line.substr(2, line.find('\t', 2) - 2);
-            name = name.substr(0, name.find(' '));
-
-            //the sequence is the third field
-            string seq = line.substr(line.find('\t', 2) + 1, line.find('\t', line.find('\t', 2) + 1) - line.find('\t', 2) - 1);
-            if (seq.size() == 0){
-                continue;
-            }
-            fasta << ">" << name << endl;
-            fasta << seq << endl;
-        }
+    FastaWriter fasta (fasta_file);
+    if (!gfa_to_fasta(gfa_file, fasta) || !fasta.close()){
+        cout << "ERROR : could not convert " << gfa_file << " to " << fasta_file << endl;
+        exit(1);
     }
-    gfa.close();
-    fasta.close();
 }
 
 /**
@@ -240,15 +228,16 @@ void convert_FASTA_to_GFA(std::string &fasta_file, std::string &gfa_file){
  * @param techno the sequencing technology used to generate the reads (ont, pacbio, hifi)
  * @param MINIMAP path to the minimap2 executable
  * @param RACON path to the racon executable
+ * @param nbThreads number of threads given to minimap2, racon and samtools
  * @return polished sequence 
  */
 string consensus_reads(
     string &backbone, 
-    string &full_backbone, 
+    const string &full_backbone, 
     int start_pos_on_full_backbone, 
     int sizeOfWindow, 
-    vector <string> &polishingReads,
-    vector <string> &fullReads,
+    vector <std::string_view> &polishingReads,
+    vector <std::string_view> &fullReads,
     vector <pair<string,int>> &CIGARs,
     string &id, 
     string &outFolder, 
@@ -256,7 +245,8 @@ string consensus_reads(
     string &MINIMAP, 
     string &RACON,
     string &path_to_python,
-    std::string &path_src){
+    std::string &path_src,
+    int nbThreads){
     
     if (polishingReads.size() == 0){
         return backbone;
@@ -315,26 +305,27 @@ string consensus_reads(
     sam.close();
 
     //sort and index mapped_id.sam
-    string command = "samtools sort "+ outFolder +"mapped_"+id+".sam > "+ outFolder +"mapped_"+id+".bam && samtools index "+ outFolder +"mapped_"+id+".bam";
-    auto sort = system(command.c_str());
+    string threads = std::to_string(nbThreads);
+    string command = "samtools sort -@ "+ threads +" "+ outFolder +"mapped_"+id+".sam > "+ outFolder +"mapped_"+id+".bam && samtools index -@ "+ threads +" "+ outFolder +"mapped_"+id+".bam";
+    auto sort = run_command(command);
     if (sort != 0){
         cout << "ERROR samtools sort failed, while running " << command << endl;
         exit(1);
     }
 
     //run a basic consensus
-    command = "samtools consensus "+ outFolder +"mapped_"+id+".bam > "+ outFolder +"consensus_"+id+".fasta";
+    command = "samtools consensus -@ "+ threads +" "+ outFolder +"mapped_"+id+".bam > "+ outFolder +"consensus_"+id+".fasta";
     // cout << "Running " << command << endl;
-    auto res_cons = system(command.c_str());
+    auto res_cons = run_command(command);
     if (res_cons != 0){
         cout << "ERROR basic_consensus failed, while running " << command << endl;
         exit(1);
     }
 
     //then map all the reads on unpolsihed.fasta to obtain a new mapped.sam
-    string com = " -a -t 1 "+ technoFlag + " " + outFolder +"consensus_"+id+".fasta "+ outFolder +"reads_"+id+".fasta > "+ outFolder +"mapped_"+id+".sam 2>"+ outFolder +"trash.txt";
+    string com = " -a -t "+ threads +" "+ technoFlag + " " + outFolder +"consensus_"+id+".fasta "+ outFolder +"reads_"+id+".fasta > "+ outFolder +"mapped_"+id+".sam 2>"+ outFolder +"trash.txt";
     command = MINIMAP + com;
-    auto map2 = system(command.c_str());
+    auto map2 = run_command(command);
     if (map2 != 0){
         cout << "ERROR minimap2 failed, while running " << command << endl;
         exit(1);
@@ -361,9 +352,9 @@ string consensus_reads(
         }
         polishseqs.close();
 
-        string com = " -a -t 1 "+ technoFlag + " " + outFolder +"consensus_"+id+".fasta "+ outFolder +"reads_"+id+".fasta > "+ outFolder +"mapped_"+id+".sam 2>"+ outFolder +"trash.txt";
+        string com = " -a -t "+ threads +" "+ technoFlag + " " + outFolder +"consensus_"+id+".fasta "+ outFolder +"reads_"+id+".fasta > "+ outFolder +"mapped_"+id+".sam 2>"+ outFolder +"trash.txt";
         string commandMap = MINIMAP + com;
-        auto map = system(commandMap.c_str());
+        auto map = run_command(commandMap);
         if (map != 0){
             cout << "ERROR minimap2 failed, while running " << commandMap << endl;
             exit(1);
@@ -378,9 +369,9 @@ string consensus_reads(
 
     // cout << "minimap2 done in tools , ran command " << commandMap << endl;
 
-    com = " -w 500 -e 1 -t 1 "+ outFolder +"reads_"+id+".fasta "+ outFolder +"mapped_"+id+".sam "+ outFolder +"consensus_"+id+".fasta > "+ outFolder +"polished_"+id+".fasta 2>"+ outFolder +"trash.txt";
+    com = " -w 500 -e 1 -t "+ threads +" "+ outFolder +"reads_"+id+".fasta "+ outFolder +"mapped_"+id+".sam "+ outFolder +"consensus_"+id+".fasta > "+ outFolder +"polished_"+id+".fasta 2>"+ outFolder +"trash.txt";
     string commandPolish = RACON + com;
-    auto polishres = system(commandPolish.c_str());
+    auto polishres = run_command(commandPolish);
     if (polishres != 0){
         cout << "ERROR racon failed, while running " << commandPolish << endl;
         exit(1);
@@ -410,26 +401,22 @@ string consensus_reads(
         string before_start = backbone.substr(0,before_size);
         string after_start = consensus.substr(0,after_size);
 
-        EdlibAlignResult result = edlibAlign(after_start.c_str(), after_start.size(), before_start.c_str(), before_start.size(),
-                                            edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
-
-
-        int start_pos = result.startLocations[0];
-        string additional_start_seq = before_start.substr(0, start_pos);
-
-        edlibFreeAlignResult(result);
-
-
-        // And do the alignment for the end of the sequence.
+        // And the same for the end of the sequence, both in one batch.
         string before_end = backbone.substr(backbone.size()-before_size, before_size);
         string after_end = consensus.substr(consensus.size()-after_size , after_size);
 
-        result = edlibAlign(after_end.c_str(), after_end.size(), before_end.c_str(), before_end.size(),
-                                            edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
+        Aligner &aligner = thread_aligner();
+        aligner.align_infix({{after_start.c_str(), int(after_start.size()), before_start.c_str(), int(before_start.size()), -1},
+                            {after_end.c_str(), int(after_end.size()), before_end.c_str(), int(before_end.size()), -1}});
+
+        //nothing is attached when the ends do not align
+        const Alignment &start_alignment = aligner.alignment(0);
+        const Alignment &end_alignment = aligner.alignment(1);
+        int start_pos = start_alignment.editDistance >= 0 ? start_alignment.targetStart : 0;
+        string additional_start_seq = before_start.substr(0, start_pos);
 
-        int end_pos = result.endLocations[0]+1;
+        int end_pos = end_alignment.editDistance >= 0 ? end_alignment.targetEnd+1 : int(before_end.size());
         string additional_end_seq = before_end.substr(end_pos , before_end.size()-end_pos);
-        edlibFreeAlignResult(result);
 
         new_seq = additional_start_seq + consensus + additional_end_seq;
 
@@ -452,6 +439,173 @@ string consensus_reads(
 
 }
 
+/**
+ * @brief Votes, position by position of the backbone, for the base (or the deletion) shown by the reads, and for the insertions between two positions
+ * 
+ * @param backbone the sequence the reads are aligned on
+ * @param reads the reads
+ * @param CIGARs CIGAR of the alignment of each read on the backbone and 1-based position of its first aligned base, as in a SAM file
+ * @return the consensus sequence. The positions covered by no read keep the base of the backbone
+ */
+string pileup_consensus(std::string &backbone, std::vector <std::string_view> &reads, std::vector <std::pair<std::string,int>> &CIGARs){
+
+    int length = backbone.size();
+    vector<int> counts (5*length, 0); //A, C, G, T, deletion
+    std::unordered_map<int, vector<string>> insertions; //insertions after each position of the backbone (-1 for before the first base)
+    auto code = [](char c){
+        switch (c){
+            case 'A' : case 'a' : return 0;
+            case 'C' : case 'c' : return 1;
+            case 'G' : case 'g' : return 2;
+            case 'T' : case 't' : return 3;
+        }
+        return -1;
+    };
+
+    for (int r = 0 ; r < reads.size() ; r++){
+        string &cigar = CIGARs[r].first;
+        int posOnBackbone = CIGARs[r].second-1;
+        int posOnRead = 0;
+        int num = 0;
+        for (char c : cigar){
+            if (c >= '0' && c <= '9'){
+                num = 10*num + c - '0';
+                continue;
+            }
+            if (c == 'M' || c == '=' || c == 'X'){
+                for (int i = 0 ; i < num && posOnBackbone < length && posOnRead < reads[r].size() ; i++){
+                    int b = code(reads[r][posOnRead]);
+                    if (b >= 0 && posOnBackbone >= 0){
+                        counts[5*posOnBackbone+b]++;
+                    }
+                    posOnBackbone++;
+                    posOnRead++;
+                }
+            }
+            else if (c == 'D' || c == 'N'){
+                for (int i = 0 ; i < num && posOnBackbone < length ; i++){
+                    if (posOnBackbone >= 0){
+                        counts[5*posOnBackbone+4]++;
+                    }
+                    posOnBackbone++;
+                }
+            }
+            else if (c == 'I'){
+                if (posOnRead+num <= reads[r].size()){
+                    insertions[posOnBackbone-1].push_back(string(reads[r].substr(posOnRead, num)));
+                }
+                posOnRead += num;
+            }
+            else if (c == 'S'){
+                posOnRead += num;
+            }
+            num = 0;
+        }
+    }
+
+    string consensus;
+    consensus.reserve(length + length/10);
+    string bases = "ACGT";
+    for (int pos = -1 ; pos < length ; pos++){
+        if (pos >= 0){
+            int coverage = 0;
+            int best = -1;
+            for (int b = 0 ; b < 5 ; b++){
+                coverage += counts[5*pos+b];
+                if (best == -1 || counts[5*pos+b] > counts[5*pos+best]){
+                    best = b;
+                }
+            }
+            if (coverage == 0){
+                consensus += backbone[pos];
+            }
+            else if (best < 4){
+                consensus += bases[best];
+            }
+        }
+
+        //add the insertion if most of the reads spanning this position show one
+        auto ins = insertions.find(pos);
+        if (ins != insertions.end()){
+            int coverage = 0;
+            int p = max(0, pos);
+            for (int b = 0 ; b < 5 ; b++){
+                coverage += counts[5*p+b];
+            }
+            if (2*ins->second.size() <= coverage){
+                continue;
+            }
+            //take the most frequent length of insertion and vote base by base among the insertions of this length
+            std::unordered_map<int,int> lengths;
+            int bestLength = 0;
+            for (string &s : ins->second){
+                lengths[s.size()]++;
+                if (lengths[s.size()] > lengths[bestLength] || (lengths[s.size()] == lengths[bestLength] && s.size() < bestLength)){
+                    bestLength = s.size();
+                }
+            }
+            for (int i = 0 ; i < bestLength ; i++){
+                int votes[4] = {0,0,0,0};
+                for (string &s : ins->second){
+                    if (s.size() == bestLength && code(s[i]) >= 0){
+                        votes[code(s[i])]++;
+                    }
+                }
+                consensus += bases[std::max_element(votes, votes+4) - votes];
+            }
+        }
+    }
+    return consensus;
+}
+
+/**
+ * @brief Polishes a sequence in memory: a first pileup consensus is computed from the CIGARs already known, then the reads are realigned on it and a second consensus is computed
+ * 
+ * @param backbone sequence to be polished
+ * @param polishingReads list of reads to polish it
+ * @param CIGARs list of CIGARs of the alignment of the reads on the backbone, with the 1-based position of the first aligned base
+ * @return polished sequence
+ */
+string consensus_reads_fast(
+    std::string &backbone, 
+    std::vector <std::string_view> &polishingReads,
+    std::vector <std::pair<std::string,int>> &CIGARs){
+
+    //only the reads long enough are used, as in consensus_reads
+    vector<std::string_view> reads;
+    vector<pair<string,int>> cigars;
+    for (int read = 0 ; read < polishingReads.size() ; read++){
+        if (polishingReads[read].size() > 100){
+            reads.push_back(polishingReads[read]);
+            cigars.push_back(CIGARs[read]);
+        }
+    }
+    if (reads.size() == 0){
+        return backbone;
+    }
+
+    string consensus = pileup_consensus(backbone, reads, cigars);
+
+    //realign the reads on the first consensus to correct the alignments that were biased towards the backbone
+    vector<AlignmentJob> jobs;
+    for (int read = 0 ; read < reads.size() ; read++){
+        jobs.push_back({reads[read].data(), int(reads[read].size()), consensus.c_str(), int(consensus.size()), -1});
+    }
+    Aligner &aligner = thread_aligner();
+    aligner.align_infix(jobs);
+    for (int read = 0 ; read < reads.size() ; read++){
+        const Alignment &alignment = aligner.alignment(read);
+        if (alignment.editDistance >= 0){
+            cigars[read] = make_pair(ops_to_cigar(alignment.ops), alignment.targetStart+1);
+        }
+        else{
+            cigars[read] = make_pair(string(""), 1);
+        }
+    }
+
+    return pileup_consensus(consensus, reads, cigars);
+}
+
 /**
  * @brief renames all the reads of the fasta file adding the prefix
  * 
@@ -485,19 +639,22 @@ void rename_reads(std::string &fasta_file, std::string &prefix){
  * @param polishingReads reads to polish it
  * @param id thread id to be sure intermediate files do not get mixed up with other threads
  * @param outFolder tmp folder to store intermediate files
+ * @param nbThreads number of threads given to minimap2, samtools and medaka
  * @return std::string 
  */
 std::string consensus_reads_medaka(
     std::string const &backbone, 
-    std::vector <std::string> &polishingReads, 
+    std::vector <std::string_view> &polishingReads, 
     std::string &id,
     std::string outFolder,
     std::string &MEDAKA,
     std::string &SAMTOOLS,
     std::string &path_to_python,
-    std::string &path_src){
+    std::string &path_src,
+    int nbThreads){
 
     outFolder += "/";
+    string threads = std::to_string(nbThreads);
     //output all polishing reads in a file
     std::ofstream polishseqs(outFolder+"reads_"+id+".fasta");
     for (int read =0 ; read < polishingReads.size() ; read++){
@@ -513,9 +670,9 @@ std::string consensus_reads_medaka(
     outseq.close();
 
     //create a bam file with the reads aligned on the backbone and index it
-    string comMap = "minimap2 -ax map-pb -r2k "+ outFolder +"unpolished_"+id+".fasta "+ outFolder +"reads_"+id+".fasta 2>"+ outFolder +"trash.txt "
-        +"| "+ SAMTOOLS + " sort >"+ outFolder +"mapped_"+id+".bam && "+ SAMTOOLS + " index "+ outFolder +"mapped_"+id+".bam 2>"+ outFolder +"trash.txt";
-    auto map = system(comMap.c_str());
+    string comMap = "minimap2 -ax map-pb -r2k -t "+ threads +" "+ outFolder +"unpolished_"+id+".fasta "+ outFolder +"reads_"+id+".fasta 2>"+ outFolder +"trash.txt "
+        +"| "+ SAMTOOLS + " sort -@ "+ threads +" >"+ outFolder +"mapped_"+id+".bam && "+ SAMTOOLS + " index "+ outFolder +"mapped_"+id+".bam 2>"+ outFolder +"trash.txt";
+    auto map = run_command(comMap);
     if (map != 0){
         cout << "ERROR minimap2 yuq fd failed, while running " << comMap << endl;
         exit(1);
@@ -524,12 +681,12 @@ std::string consensus_reads_medaka(
     //now create a first rough polish using a basic pileup
     // Build the command to run haplodmf_count_freqs.py
     string command;
-    command = SAMTOOLS + " consensus " + outFolder +"mapped_"+id+".bam > "+ outFolder +"consensus_"+id+".fasta";
+    command = SAMTOOLS + " consensus -@ " + threads + " " + outFolder +"mapped_"+id+".bam > "+ outFolder +"consensus_"+id+".fasta";
     // command =  path_to_python + " " + path_src + "/haplodmf_count_freqs.py " + outFolder +"mapped_"+id+".bam " + outFolder +"acgt_"+id+".txt 2>"+ outFolder +"trash.txt";    
     // cout << "Running " << command << endl;
     
     // Run the command
-    int return_code = system(command.c_str());
+    int return_code = run_command(command);
     if (return_code != 0) {
         cout << "Error running command: " << command << endl;
         exit(1);
@@ -538,9 +695,9 @@ std::string consensus_reads_medaka(
 
 
     //run medaka on the consensus
-    string com = MEDAKA + "_consensus -i "+ outFolder +"reads_"+id+".fasta -d "+ outFolder +"consensus_"+id+".fasta -o "+ outFolder +"medaka_"+id+" -t 1 -f -x 2>"+ outFolder +"trash.txt >" +outFolder +"trash.txt" ;
+    string com = MEDAKA + "_consensus -i "+ outFolder +"reads_"+id+".fasta -d "+ outFolder +"consensus_"+id+".fasta -o "+ outFolder +"medaka_"+id+" -t "+ threads +" -f -x 2>"+ outFolder +"trash.txt >" +outFolder +"trash.txt" ;
     // cout << "Running in tools.cpp yyxk" << com << endl;
-    auto med_res = system(com.c_str());
+    auto med_res = run_command(com);
     if (med_res != 0){        
         cout << "ERROR medaka failed, while running " << com << endl;
         exit(1);
@@ -573,7 +730,7 @@ std::string consensus_reads_medaka(
     std::remove((outFolder+"reads_"+id+".fasta").c_str());
     //remove the medaka folder
     command = "rm -r "+ outFolder +"medaka_"+id;
-    auto rm = system(command.c_str());
+    auto rm = run_command(command);
     if (rm != 0){
         cout << "ERROR rm failed, while running " << command << endl;
         exit(1);
@@ -612,7 +769,7 @@ std::string consensus_reads_wtdbg2(
         return backbone;
     }
 
-    system("mkdir tmp/ 2> trash.txt");
+    run_command("mkdir tmp/ 2> trash.txt");
     std::ofstream outseq(outFolder+"unpolished_"+id+".fasta");
     outseq << ">seq\n" << backbone;
     outseq.close();
@@ -640,7 +797,7 @@ std::string consensus_reads_wtdbg2(
 
     string com = " -t 1 "+ technoFlag + " "+ outFolder +"unpolished_"+id+".fasta "+ outFolder +"reads_"+id+".fasta > "+ outFolder +"mapped_"+id+".paf 2>"+ outFolder +"trash.txt";
     string commandMap = MINIMAP + com; 
-    system(commandMap.c_str());
+    run_command(commandMap);
 
     vector<string> clippedReads;
 
@@ -750,14 +907,14 @@ void assemble_with_wtdbg2(std::string &fileReads, std::string outputFolder, std:
     if (ref == ""){
         string comAsm = wtdbg2_folder+ "/wtdbg2 -A -e 1 -l 200 -L 0 -S 100 --no-read-clip --no-chainning-clip --ctg-min-length 200 --ctg-min-nodes 0 -R -o "
                                 + outputFolder + "wtdbg2_"+id+" -i " + fileReads + " 2>"+outputFolder+"trash.txt";
-        auto res = system(comAsm.c_str());
+        auto res = run_command(comAsm);
         if (res != 0){
             cout << "ERROR wtdbg2 failed, while running " << comAsm << endl;
             exit(1);
         }
 
         string cons_wtdbg2 = wtdbg2_folder+"/wtpoa-cns -t 1 -i " + outputFolder + "wtdbg2_"+id+".ctg.lay.gz -fo " + outputFolder + "dbg_"+id+".raw.fa 2>tmp/trash.txt";
-        int res_wtdbg2 = system(cons_wtdbg2.c_str());
+        int res_wtdbg2 = run_command(cons_wtdbg2);
         ref = outputFolder + "dbg_"+id+".raw.fa";
     }
 
@@ -766,7 +923,7 @@ void assemble_with_wtdbg2(std::string &fileReads, std::string outputFolder, std:
     //                     +SAMTOOLS+" sort >" + outputFolder + "dbg_"+id+".bam 2>" + outputFolder + "trash.txt";
     string comMap = MINIMAP+" -ax map-pb " + ref + " " + fileReads + " 2>" + outputFolder + "trash.txt | "
                         + SAMTOOLS+" sort >" + outputFolder + "dbg_"+id+".bam 2>" + outputFolder + "trash.txt";
-    auto res = system(comMap.c_str());
+    auto res = run_command(comMap);
     if (res != 0){
         cout << "ERROR minimap2 failed tt, while running " << comMap << endl;
         exit(1);
@@ -777,7 +934,7 @@ void assemble_with_wtdbg2(std::string &fileReads, std::string outputFolder, std:
     string comSamtools = SAMTOOLS+" view -F0x900 " + outputFolder + "dbg_"+id+".bam 2>" + outputFolder + "trash.txt | "
                     +wtdbg2_folder+"/wtpoa-cns -t 1 -d " + ref + " -i - -fo " + outputFolder + "dbg_"+id+".cns.fa 2>" + outputFolder + "trash.txt";
     
-    res = system(comSamtools.c_str());
+    res = run_command(comSamtools);
     if (res != 0){
         cout << "ERROR samtools failed, while running " << comSamtools << endl;
         exit(1);
@@ -786,7 +943,7 @@ void assemble_with_wtdbg2(std::string &fileReads, std::string outputFolder, std:
 
     string new_contigs_file = outputFolder + "wtdbg2_"+id+".fa";
     string comUnfold = "awk '{if(\">\" == substr($1,1,1)){ printf \"\\n\"; print;} else printf $1;}' " + outputFolder + "dbg_"+id+".cns.fa >" + new_contigs_file + " 2>" + outputFolder + "trash.txt";
-    res = system(comUnfold.c_str());
+    res = run_command(comUnfold);
     if (res != 0){
         cout << "ERROR awk failed, while running " << comUnfold << endl;
         exit(1);
@@ -2,6 +2,7 @@
 #define TOOLS
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -23,11 +24,11 @@ void rename_reads(std::string &fasta_file, std::string &prefix);
 
 std::string consensus_reads(
     std::string &backbone, 
-    std::string &full_backbone, 
+    const std::string &full_backbone, 
     int start_pos_on_full_backbone,
     int sizeOfWindow,
-    std::vector <std::string> &polishingReads, 
-    std::vector <std::string> &fullReads,
+    std::vector <std::string_view> &polishingReads, 
+    std::vector <std::string_view> &fullReads,
     std::vector <std::pair<std::string,int>> &CIGARs,
     std::string &id,
     std::string &outFolder,
@@ -35,19 +36,28 @@ std::string consensus_reads(
     std::string &MINIMAP, 
     std::string &RACON,
     std::string &path_to_python,
-    std::string &path_src);
+    std::string &path_src,
+    int nbThreads = 1);
+
+std::string pileup_consensus(std::string &backbone, std::vector <std::string_view> &reads, std::vector <std::pair<std::string,int>> &CIGARs);
+
+std::string consensus_reads_fast(
+    std::string &backbone, 
+    std::vector <std::string_view> &polishingReads,
+    std::vector <std::pair<std::string,int>> &CIGARs);
 
 bool check_alignment(std::string &paf_file);
 
 std::string consensus_reads_medaka(
     std::string const &backbone, 
-    std::vector <std::string> &polishingReads, 
+    std::vector <std::string_view> &polishingReads, 
     std::string &id,
     std::string outFolder,
     std::string &MEDAKA,
     std::string &SAMTOOLS,
     std::string &path_to_python,
-    std::string &path_src);
+    std::string &path_src,
+    int nbThreads = 1);
 
 std::string consensus_reads_wtdbg2(
     std::string const &backbone, 